@@ -0,0 +1,657 @@
+#include "matrix_design/matrix.h"
+#include "matrix_design/matrix_broadcast.h"
+#include "matrix_design/matrix_conv.h"
+#include "matrix_design/matrix_convert.h"
+#include "matrix_design/matrix_dispatch.h"
+#include "matrix_design/matrix_fixed.h"
+#include "matrix_design/matrix_gemm.h"
+#include "matrix_design/matrix_linalg.h"
+#include "matrix_design/matrix_ops.h"
+#include "matrix_design/matrix_quant.h"
+#include "matrix_design/matrix_reduce.h"
+#include "matrix_design/matrix_transpose.h"
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// The per-row recursion Matrix(Matrix_ref) used before the strided copy
+// engine (with the innermost stride honoured), kept as the baseline the
+// engine is measured against.
+template <typename T, std::size_t N>
+auto legacy_insert(const T *first, std::array<std::size_t, N> extents,
+                   std::array<std::size_t, N> strides, std::vector<T> &vec)
+    -> void {
+    if constexpr (N == 1) {
+        for (std::size_t i = 0; i < extents[0]; ++i) {
+            vec.push_back(first[i * strides[0]]);
+        }
+    } else {
+        std::array<std::size_t, N - 1> extents_;
+        std::array<std::size_t, N - 1> strides_;
+        std::copy(extents.begin() + 1, extents.end(), extents_.begin());
+        std::copy(strides.begin() + 1, strides.end(), strides_.begin());
+        for (std::size_t i = 0; i < extents[0]; ++i) {
+            legacy_insert<T, N - 1>(first + i * strides[0], extents_,
+                                    strides_, vec);
+        }
+    }
+}
+
+auto make_tensor(std::size_t n) -> Matrix<float, 4> {
+    Matrix<float, 4> t(n, n, n, n);
+    for (std::size_t i = 0; i < t.size(); ++i) {
+        t.data()[i] = static_cast<float>(i);
+    }
+    return t;
+}
+
+// the three view shapes: a whole row, a column plane and an interior block
+template <typename M> auto view(M &t, int kind, std::size_t n) {
+    switch (kind) {
+    case 0:
+        return t(Slice(1, 2), Slice(0, n), Slice(0, n), Slice(0, n));
+    case 1:
+        return t(Slice(0, n), Slice(0, n), Slice(0, n), Slice(3, 4));
+    default:
+        return t(Slice(1, n - 1), Slice(1, n - 1), Slice(1, n - 1),
+                 Slice(1, n - 1));
+    }
+}
+
+// a 4x4 transform applied to a fresh 4x4 block, the per-sample pattern
+// small fixed-shape matrices are meant for
+template <typename M> auto transform_block(const M &t, float seed) -> float {
+    M x(std::array<std::size_t, 2>{4, 4});
+    M y(std::array<std::size_t, 2>{4, 4});
+    for (std::size_t i = 0; i < 4; ++i) {
+        for (std::size_t j = 0; j < 4; ++j) {
+            x(i, j) = seed + float(i * 4 + j);
+        }
+    }
+    for (std::size_t i = 0; i < 4; ++i) {
+        for (std::size_t j = 0; j < 4; ++j) {
+            float acc = 0;
+            for (std::size_t k = 0; k < 4; ++k) {
+                acc += t.data()[i * 4 + k] * x(k, j);
+            }
+            y(i, j) = acc;
+        }
+    }
+    return y(3, 3);
+}
+
+void set_counters(benchmark::State &state, std::size_t elements,
+                  std::size_t element_size = sizeof(float)) {
+    state.SetItemsProcessed(state.iterations() * elements);
+    state.SetBytesProcessed(state.iterations() * elements * element_size);
+}
+
+// extents of an order-N matrix with about `elements` elements, as close
+// to a cube as possible
+template <std::size_t N>
+auto cube_extents(std::size_t elements) -> std::array<std::size_t, N> {
+    const auto n = static_cast<std::size_t>(
+        std::lround(std::pow(double(elements), 1.0 / double(N))));
+    std::array<std::size_t, N> extents;
+    extents.fill(std::max<std::size_t>(n, 3));
+    return extents;
+}
+
+template <std::size_t N>
+auto make_matrix(std::size_t elements) -> Matrix<float, N> {
+    Matrix<float, N> m(cube_extents<N>(elements));
+    for (std::size_t i = 0; i < m.size(); ++i) {
+        m.data()[i] = static_cast<float>(i % 1000) * 0.25F;
+    }
+    return m;
+}
+
+// m(Slice(first, last), ...) with the same slice in every dimension
+template <typename M, std::size_t... I>
+auto cube_slice(M &m, std::size_t first, std::size_t last,
+                std::index_sequence<I...> /*dims*/) {
+    return m(((void)I, Slice(first, last))...);
+}
+
+template <typename M>
+auto cube_slice(M &m, std::size_t first, std::size_t last) {
+    return cube_slice(m, first, last,
+                      std::make_index_sequence<std::remove_cv_t<M>::order>{});
+}
+
+// the sum of every element of an order 1 to 4 matrix through m(i, j, ...)
+template <typename M> auto subscript_sum(const M &m) -> float {
+    constexpr std::size_t N = M::order;
+    const auto &e = m.descriptor().extents;
+    float sum = 0;
+    if constexpr (N == 1) {
+        for (std::size_t i = 0; i < e[0]; ++i) {
+            sum += m(i);
+        }
+    } else if constexpr (N == 2) {
+        for (std::size_t i = 0; i < e[0]; ++i) {
+            for (std::size_t j = 0; j < e[1]; ++j) {
+                sum += m(i, j);
+            }
+        }
+    } else if constexpr (N == 3) {
+        for (std::size_t i = 0; i < e[0]; ++i) {
+            for (std::size_t j = 0; j < e[1]; ++j) {
+                for (std::size_t k = 0; k < e[2]; ++k) {
+                    sum += m(i, j, k);
+                }
+            }
+        }
+    } else {
+        for (std::size_t i = 0; i < e[0]; ++i) {
+            for (std::size_t j = 0; j < e[1]; ++j) {
+                for (std::size_t k = 0; k < e[2]; ++k) {
+                    for (std::size_t l = 0; l < e[3]; ++l) {
+                        sum += m(i, j, k, l);
+                    }
+                }
+            }
+        }
+    }
+    return sum;
+}
+
+// every benchmark of the core operations at a small and a large size
+void core_sizes(benchmark::internal::Benchmark *b) {
+    b->Arg(1 << 12)->Arg(1 << 18);
+}
+
+} // namespace
+
+static void BM_copy_engine(benchmark::State &state) {
+    const auto n = static_cast<std::size_t>(state.range(1));
+    auto t = make_tensor(n);
+    const auto v = view(t, static_cast<int>(state.range(0)), n);
+    for (auto _ : state) {
+        Matrix<float, 4> m(v);
+        benchmark::DoNotOptimize(m.data());
+    }
+    set_counters(state, v.size());
+}
+
+static void BM_copy_legacy(benchmark::State &state) {
+    const auto n = static_cast<std::size_t>(state.range(1));
+    auto t = make_tensor(n);
+    const auto v = view(t, static_cast<int>(state.range(0)), n);
+    const auto &desc = v.descriptor();
+    for (auto _ : state) {
+        std::vector<float> elems;
+        legacy_insert<float, 4>(v.pointer() + desc.start, desc.extents,
+                                desc.strides, elems);
+        benchmark::DoNotOptimize(elems.data());
+    }
+    set_counters(state, v.size());
+}
+
+// Fixed_matrix has no constructor from extents; give it one for the
+// shared benchmark body
+struct Fixed_4x4 : Fixed_matrix<float, 4, 4> {
+    explicit Fixed_4x4(const std::array<std::size_t, 2> & /*extents*/) {}
+};
+
+template <typename M> static void BM_small_transform(benchmark::State &state) {
+    const M t(std::array<std::size_t, 2>{4, 4});
+    float seed = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(seed = transform_block(t, seed * 1e-3F));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// m(i, j) in a tight loop against the same loop over data()[i * ld + j];
+// with NDEBUG the two compile to the same code
+static void BM_access_subscript(benchmark::State &state) {
+    const auto n = static_cast<std::size_t>(state.range(0));
+    Matrix<double, 2> m(n, n);
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < n; ++i) {
+            for (std::size_t j = 0; j < n; ++j) {
+                m(i, j) = m(i, j) * 0.5 + double(j);
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * n * n);
+}
+
+static void BM_access_pointer(benchmark::State &state) {
+    const auto n = static_cast<std::size_t>(state.range(0));
+    Matrix<double, 2> m(n, n);
+    for (auto _ : state) {
+        double *p = m.data();
+        const std::size_t ld = m.extent(1);
+        for (std::size_t i = 0; i < n; ++i) {
+            for (std::size_t j = 0; j < n; ++j) {
+                p[i * ld + j] = p[i * ld + j] * 0.5 + double(j);
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * n * n);
+}
+
+// out-of-place transpose of an n x n float matrix
+static void BM_transpose_engine(benchmark::State &state) {
+    const auto n = static_cast<std::size_t>(state.range(0));
+    Matrix<float, 2> a(n, n);
+    for (auto _ : state) {
+        Matrix<float, 2> t(transpose(a));
+        benchmark::DoNotOptimize(t.data());
+    }
+    set_counters(state, n * n);
+}
+
+static void BM_transpose_naive(benchmark::State &state) {
+    const auto n = static_cast<std::size_t>(state.range(0));
+    Matrix<float, 2> a(n, n);
+    for (auto _ : state) {
+        Matrix<float, 2> t(n, n);
+        for (std::size_t i = 0; i < n; ++i) {
+            for (std::size_t j = 0; j < n; ++j) {
+                t.data()[i * n + j] = a.data()[j * n + i];
+            }
+        }
+        benchmark::DoNotOptimize(t.data());
+    }
+    set_counters(state, n * n);
+}
+
+// a batch of 8 images with 64 channels of 56 x 56 to channels-last
+static void BM_nchw_to_nhwc_engine(benchmark::State &state) {
+    Matrix<float, 4> x(8, 64, 56, 56);
+    for (auto _ : state) {
+        auto y = nchw_to_nhwc(x);
+        benchmark::DoNotOptimize(y.data());
+    }
+    set_counters(state, x.size());
+}
+
+static void BM_nchw_to_nhwc_naive(benchmark::State &state) {
+    Matrix<float, 4> x(8, 64, 56, 56);
+    for (auto _ : state) {
+        Matrix<float, 4> y(8, 56, 56, 64);
+        for (std::size_t n = 0; n < 8; ++n) {
+            for (std::size_t h = 0; h < 56; ++h) {
+                for (std::size_t w = 0; w < 56; ++w) {
+                    for (std::size_t c = 0; c < 64; ++c) {
+                        y(n, h, w, c) = x(n, c, h, w);
+                    }
+                }
+            }
+        }
+        benchmark::DoNotOptimize(y.data());
+    }
+    set_counters(state, x.size());
+}
+
+// scale every channel of a batch of 8 images with 64 channels of 56 x 56
+static void BM_channel_scale_broadcast(benchmark::State &state) {
+    Matrix<float, 4> x(8, 64, 56, 56);
+    Matrix<float, 3> scale(64, 1, 1);
+    Matrix<float, 4> y(8, 64, 56, 56);
+    for (auto _ : state) {
+        y = multiply(x, broadcast_to(scale, x.descriptor().extents));
+        benchmark::DoNotOptimize(y.data());
+    }
+    set_counters(state, x.size());
+}
+
+// the same with the scale expanded to the full shape beforehand
+static void BM_channel_scale_expanded(benchmark::State &state) {
+    Matrix<float, 4> x(8, 64, 56, 56);
+    Matrix<float, 3> scale(64, 1, 1);
+    Matrix<float, 4> y(8, 64, 56, 56);
+    for (auto _ : state) {
+        Matrix<float, 4> expanded(broadcast_to(scale, x.descriptor().extents));
+        y = multiply(x, expanded);
+        benchmark::DoNotOptimize(y.data());
+    }
+    set_counters(state, x.size());
+}
+
+// LU of an n x n diagonally dominant matrix, counted in factored elements
+static void BM_lu_blocked(benchmark::State &state) {
+    const auto n = static_cast<std::size_t>(state.range(0));
+    Matrix<double, 2> a(n, n);
+    for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t j = 0; j < n; ++j) {
+            a(i, j) = i == j ? double(n) : double((i * 7 + j * 3) % 11) - 5.0;
+        }
+    }
+    for (auto _ : state) {
+        auto f = lu(a);
+        benchmark::DoNotOptimize(f.matrix().data());
+    }
+    set_counters(state, a.size(), sizeof(double));
+}
+
+// the same as one unblocked panel: rank-1 updates over the whole matrix
+static void BM_lu_unblocked(benchmark::State &state) {
+    const auto n = static_cast<std::size_t>(state.range(0));
+    Matrix<double, 2> a(n, n);
+    for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t j = 0; j < n; ++j) {
+            a(i, j) = i == j ? double(n) : double((i * 7 + j * 3) % 11) - 5.0;
+        }
+    }
+    std::vector<std::size_t> pivots(n);
+    for (auto _ : state) {
+        Matrix<double, 2> f(a);
+        matrix_impl::lu_panel(n, n, f.data(), n, pivots.data());
+        benchmark::DoNotOptimize(f.data());
+    }
+    set_counters(state, a.size(), sizeof(double));
+}
+
+// The core operations for orders 1 to 4; range(0) is the element count.
+
+// allocation and zero fill
+template <std::size_t N> static void BM_construct(benchmark::State &state) {
+    const auto extents =
+        cube_extents<N>(static_cast<std::size_t>(state.range(0)));
+    std::size_t size = 0;
+    for (auto _ : state) {
+        Matrix<float, N> m(extents);
+        benchmark::DoNotOptimize(m.data());
+        size = m.size();
+    }
+    set_counters(state, size);
+}
+
+// every element read through m(i, j, ...)
+template <std::size_t N> static void BM_subscript(benchmark::State &state) {
+    const auto m = make_matrix<N>(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(subscript_sum(m));
+    }
+    set_counters(state, m.size());
+}
+
+// a view of every row, counted in views
+template <std::size_t N> static void BM_row(benchmark::State &state) {
+    auto m = make_matrix<N>(static_cast<std::size_t>(state.range(0)));
+    const std::size_t rows = m.extent(0);
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < rows; ++i) {
+            auto r = m.row(i);
+            benchmark::DoNotOptimize(r);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * rows);
+}
+
+// a view of every column, counted in views
+template <std::size_t N> static void BM_col(benchmark::State &state) {
+    auto m = make_matrix<N>(static_cast<std::size_t>(state.range(0)));
+    const std::size_t cols = m.extent(1);
+    for (auto _ : state) {
+        for (std::size_t j = 0; j < cols; ++j) {
+            auto c = m.col(j);
+            benchmark::DoNotOptimize(c);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * cols);
+}
+
+// m(Slice(i, n - i), ...) for every nested cube, counted in views
+template <std::size_t N> static void BM_slice(benchmark::State &state) {
+    auto m = make_matrix<N>(static_cast<std::size_t>(state.range(0)));
+    const std::size_t n = m.extent(0);
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < n / 2; ++i) {
+            auto v = cube_slice(m, i, n - i);
+            benchmark::DoNotOptimize(v);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * (n / 2));
+}
+
+// Matrix(Matrix_ref) from an interior block and from a column
+template <std::size_t N>
+static void BM_materialize_block(benchmark::State &state) {
+    const auto m = make_matrix<N>(static_cast<std::size_t>(state.range(0)));
+    const auto v = cube_slice(m, 1, m.extent(0) - 1);
+    for (auto _ : state) {
+        Matrix<float, N> copy(v);
+        benchmark::DoNotOptimize(copy.data());
+    }
+    set_counters(state, v.size());
+}
+
+template <std::size_t N>
+static void BM_materialize_col(benchmark::State &state) {
+    const auto m = make_matrix<N>(static_cast<std::size_t>(state.range(0)));
+    const auto v = m.col(1);
+    for (auto _ : state) {
+        Matrix<float, N - 1> copy(v);
+        benchmark::DoNotOptimize(copy.data());
+    }
+    set_counters(state, v.size());
+}
+
+// operator<< of every element into a string stream
+template <std::size_t N> static void BM_print(benchmark::State &state) {
+    const auto m = make_matrix<N>(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state) {
+        std::ostringstream os;
+        os << m;
+        benchmark::DoNotOptimize(os.str().data());
+    }
+    set_counters(state, m.size());
+}
+
+// 256K multiply-adds of n x n products in a Matrix<double, 3> stack,
+// counted in products
+static void BM_gemm_batched(benchmark::State &state) {
+    const auto n = static_cast<std::size_t>(state.range(0));
+    const std::size_t batches = (std::size_t{1} << 18) / (n * n * n);
+    Matrix<double, 3> a(batches, n, n);
+    Matrix<double, 3> b(batches, n, n);
+    Matrix<double, 3> c(batches, n, n);
+    for (auto _ : state) {
+        gemm_batched(1.0, a, b, 0.0, Matrix_ref<double, 3>(c));
+        benchmark::DoNotOptimize(c.data());
+    }
+    state.SetItemsProcessed(state.iterations() * batches);
+}
+
+// the same with one packed gemm per row(i) view
+static void BM_gemm_per_batch(benchmark::State &state) {
+    const auto n = static_cast<std::size_t>(state.range(0));
+    const std::size_t batches = (std::size_t{1} << 18) / (n * n * n);
+    Matrix<double, 3> a(batches, n, n);
+    Matrix<double, 3> b(batches, n, n);
+    Matrix<double, 3> c(batches, n, n);
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < batches; ++i) {
+            gemm(1.0, a.row(i), b.row(i), 0.0, c.row(i));
+        }
+        benchmark::DoNotOptimize(c.data());
+    }
+    state.SetItemsProcessed(state.iterations() * batches);
+}
+
+// Matrix<To, 2>(Matrix<From, 2>) of 1M elements, through the conversion
+// kernels
+template <typename From, typename To>
+static void BM_convert(benchmark::State &state) {
+    Matrix<From, 2> a(1024, 1024);
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        a.data()[i] = static_cast<From>(float(i % 1000) * 0.125F);
+    }
+    for (auto _ : state) {
+        Matrix<To, 2> b(a);
+        benchmark::DoNotOptimize(b.data());
+    }
+    set_counters(state, a.size(), sizeof(From) + sizeof(To));
+}
+
+// the same one element at a time
+template <typename From, typename To>
+static void BM_convert_scalar(benchmark::State &state) {
+    Matrix<From, 2> a(1024, 1024);
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        a.data()[i] = static_cast<From>(float(i % 1000) * 0.125F);
+    }
+    for (auto _ : state) {
+        Matrix<To, 2> b(1024, 1024);
+        const From *src = a.data();
+        To *dst = b.data();
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            benchmark::DoNotOptimize(
+                dst[i] = static_cast<To>(static_cast<float>(src[i])));
+        }
+        benchmark::DoNotOptimize(b.data());
+    }
+    set_counters(state, a.size(), sizeof(From) + sizeof(To));
+}
+
+// a 3 x 3 convolution of c channels into c over a 56 x 56 image with
+// "same" padding, direct (0) or im2col (1); counted in multiply-adds
+static void BM_conv2d(benchmark::State &state) {
+    const auto channels = static_cast<std::size_t>(state.range(1));
+    Matrix<float, 3> x(channels, 56, 56);
+    Matrix<float, 4> w(channels, channels, 3, 3);
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        x.data()[i] = float(i % 13) * 0.25F;
+    }
+    for (std::size_t i = 0; i < w.size(); ++i) {
+        w.data()[i] = float(i % 7) * 0.125F;
+    }
+    Conv_params params;
+    params.padding = {1, 1};
+    params.algorithm = state.range(0) == 0 ? Conv_algorithm::direct
+                                           : Conv_algorithm::im2col;
+    for (auto _ : state) {
+        auto y = conv2d(x, w, params);
+        benchmark::DoNotOptimize(y.data());
+    }
+    state.SetItemsProcessed(state.iterations() * channels * channels * 9 *
+                            56 * 56);
+}
+
+// n x n products in int8 (0), of quantized float matrices (1) and in
+// float (2); counted in multiply-adds
+static void BM_gemm_int8(benchmark::State &state) {
+    const auto n = static_cast<std::size_t>(state.range(1));
+    Matrix<float, 2> a(n, n);
+    Matrix<float, 2> b(n, n);
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        a.data()[i] = float(int(i % 251) - 125) * 0.01F;
+        b.data()[i] = float(int(i % 241) - 120) * 0.02F;
+    }
+    const Quantized_matrix qa = quantize(a, Quant_axis::rows);
+    const Quantized_matrix qb = quantize(b, Quant_axis::cols);
+    for (auto _ : state) {
+        if (state.range(0) == 0) {
+            auto c = matmul_int8(qa.values(), qb.values());
+            benchmark::DoNotOptimize(c.data());
+        } else if (state.range(0) == 1) {
+            auto c = matmul(qa, qb);
+            benchmark::DoNotOptimize(c.data());
+        } else {
+            auto c = matmul(a, b);
+            benchmark::DoNotOptimize(c.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * n * n * n);
+}
+
+// a fused element-wise expression (0), a sum (1) and a float product (2)
+// at each forced instruction set level: scalar, sse2, avx2, avx512
+static void BM_dispatch_levels(benchmark::State &state) {
+    const auto level = static_cast<matrix_dispatch::Isa>(state.range(1));
+    if (level > matrix_dispatch::detected_isa()) {
+        state.SkipWithError("level not supported on this machine");
+        return;
+    }
+    const std::size_t n = 256;
+    Matrix<float, 2> a(n, n);
+    Matrix<float, 2> b(n, n);
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        a.data()[i] = std::sin(float(i));
+        b.data()[i] = std::cos(float(i));
+    }
+    const matrix_dispatch::Isa old = matrix_dispatch::set_isa(level);
+    for (auto _ : state) {
+        if (state.range(0) == 0) {
+            Matrix<float, 2> c = a * 2.0F + b;
+            benchmark::DoNotOptimize(c.data());
+        } else if (state.range(0) == 1) {
+            benchmark::DoNotOptimize(sum(a));
+        } else {
+            auto c = matmul(a, b);
+            benchmark::DoNotOptimize(c.data());
+        }
+    }
+    matrix_dispatch::set_isa(old);
+    state.SetItemsProcessed(state.iterations() * n * n *
+                            (state.range(0) == 2 ? n : 1));
+}
+
+// range(0): 0 = row, 1 = column, 2 = interior; range(1): extent per dim
+BENCHMARK(BM_copy_engine)->ArgsProduct({{0, 1, 2}, {16, 48}});
+BENCHMARK(BM_copy_legacy)->ArgsProduct({{0, 1, 2}, {16, 48}});
+BENCHMARK_TEMPLATE(BM_small_transform, Fixed_4x4);
+BENCHMARK_TEMPLATE(BM_small_transform, Matrix<float, 2>);
+BENCHMARK(BM_access_subscript)->Arg(64)->Arg(512);
+BENCHMARK(BM_access_pointer)->Arg(64)->Arg(512);
+BENCHMARK(BM_transpose_engine)->Arg(256)->Arg(2048);
+BENCHMARK(BM_transpose_naive)->Arg(256)->Arg(2048);
+BENCHMARK(BM_nchw_to_nhwc_engine);
+BENCHMARK(BM_nchw_to_nhwc_naive);
+BENCHMARK(BM_channel_scale_broadcast);
+BENCHMARK(BM_channel_scale_expanded);
+BENCHMARK(BM_lu_blocked)->Arg(256)->Arg(1024);
+BENCHMARK(BM_lu_unblocked)->Arg(256)->Arg(1024);
+BENCHMARK_TEMPLATE(BM_construct, 1)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_construct, 2)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_construct, 3)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_construct, 4)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_subscript, 1)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_subscript, 2)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_subscript, 3)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_subscript, 4)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_row, 2)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_row, 3)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_row, 4)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_col, 2)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_col, 3)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_col, 4)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_slice, 2)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_slice, 3)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_slice, 4)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_materialize_block, 2)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_materialize_block, 3)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_materialize_block, 4)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_materialize_col, 2)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_materialize_col, 3)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_materialize_col, 4)->Apply(core_sizes);
+BENCHMARK_TEMPLATE(BM_print, 1)->Arg(1 << 12);
+BENCHMARK_TEMPLATE(BM_print, 2)->Arg(1 << 12);
+BENCHMARK_TEMPLATE(BM_print, 3)->Arg(1 << 12);
+BENCHMARK_TEMPLATE(BM_print, 4)->Arg(1 << 12);
+BENCHMARK(BM_gemm_batched)->Arg(4)->Arg(8)->Arg(12)->Arg(32);
+BENCHMARK(BM_gemm_per_batch)->Arg(4)->Arg(8)->Arg(12)->Arg(32);
+BENCHMARK(BM_conv2d)->ArgsProduct({{0, 1}, {3, 16, 64, 128}});
+BENCHMARK(BM_gemm_int8)->ArgsProduct({{0, 1, 2}, {128, 512}});
+BENCHMARK_TEMPLATE(BM_convert, double, float);
+BENCHMARK_TEMPLATE(BM_convert, float, std::int32_t);
+BENCHMARK_TEMPLATE(BM_convert, float, float16);
+BENCHMARK_TEMPLATE(BM_convert, float16, float);
+BENCHMARK_TEMPLATE(BM_convert, float, bfloat16);
+BENCHMARK_TEMPLATE(BM_convert, bfloat16, float);
+BENCHMARK_TEMPLATE(BM_convert_scalar, float, float16);
+BENCHMARK_TEMPLATE(BM_convert_scalar, float16, float);
+BENCHMARK_TEMPLATE(BM_convert_scalar, float, bfloat16);
+BENCHMARK_TEMPLATE(BM_convert_scalar, bfloat16, float);
+BENCHMARK(BM_dispatch_levels)->ArgsProduct({{0, 1, 2}, {0, 1, 2, 3}});
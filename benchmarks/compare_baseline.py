@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+"""Compare a Google Benchmark JSON run against a stored baseline.
+
+Record a baseline and, later, a run to check against it:
+
+    Matrix_Design_Bench --benchmark_repetitions=5 \\
+        --benchmark_out=baseline.json --benchmark_out_format=json
+    Matrix_Design_Bench --benchmark_repetitions=5 \\
+        --benchmark_out=current.json --benchmark_out_format=json
+    compare_baseline.py baseline.json current.json --tolerance 0.05
+
+Benchmarks are matched by name. With repetitions the median of each is
+compared, otherwise the single run. Throughput (items/s, then bytes/s) is
+compared when both runs report it, and CPU time otherwise. The exit status
+is 1 when any benchmark is slower than the baseline by more than the
+tolerance, so the script can gate an upgrade in CI.
+"""
+
+import argparse
+import json
+import re
+import statistics
+import sys
+
+TIME_UNITS = {"ns": 1e-9, "us": 1e-6, "ms": 1e-3, "s": 1.0}
+THROUGHPUT = ("items_per_second", "bytes_per_second")
+
+
+def load(path):
+    """The run's context and {name: [entries]} of its iterations."""
+    with open(path, encoding="utf-8") as f:
+        report = json.load(f)
+    runs = {}
+    medians = {}
+    for entry in report.get("benchmarks", []):
+        name = entry.get("run_name", entry["name"])
+        if entry.get("run_type") == "aggregate":
+            if entry.get("aggregate_name") == "median":
+                medians[name] = [entry]
+        elif "error_occurred" not in entry:
+            runs.setdefault(name, []).append(entry)
+    runs.update(medians)
+    return report.get("context", {}), runs
+
+
+def value(entries, metric):
+    """The median of `metric` over the entries, with times in seconds."""
+    if metric in THROUGHPUT:
+        values = [e[metric] for e in entries if metric in e]
+    else:
+        values = [e[metric] * TIME_UNITS[e.get("time_unit", "ns")]
+                  for e in entries]
+    return statistics.median(values) if values else None
+
+
+def choose_metric(base, current, requested):
+    if requested != "auto":
+        return requested
+    for metric in THROUGHPUT:
+        if value(base, metric) and value(current, metric):
+            return metric
+    return "cpu_time"
+
+
+def check_context(base, current):
+    for key in ("num_cpus", "mhz_per_cpu", "library_build_type"):
+        if key in base and key in current and base[key] != current[key]:
+            print(f"warning: {key} differs: {base[key]} (baseline) vs "
+                  f"{current[key]} (current)", file=sys.stderr)
+    if current.get("library_build_type") == "debug":
+        print("warning: the benchmark library is a debug build",
+              file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Compare Google Benchmark JSON output to a baseline.")
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--metric", default="auto",
+                        choices=("auto",) + THROUGHPUT +
+                        ("real_time", "cpu_time"),
+                        help="what to compare (default: throughput when "
+                        "reported, else cpu_time)")
+    parser.add_argument("--tolerance", type=float, default=0.05,
+                        help="allowed slowdown as a fraction (default 0.05)")
+    parser.add_argument("--filter", default="",
+                        help="only compare benchmarks matching this regex")
+    args = parser.parse_args()
+
+    base_context, base = load(args.baseline)
+    current_context, current = load(args.current)
+    check_context(base_context, current_context)
+    pattern = re.compile(args.filter)
+
+    regressions = []
+    width = max((len(n) for n in current), default=9)
+    print(f"{'benchmark':<{width}}  {'metric':<16} {'baseline':>12} "
+          f"{'current':>12} {'change':>8}")
+    for name in current:
+        if not pattern.search(name):
+            continue
+        if name not in base:
+            print(f"{name:<{width}}  (new, no baseline)")
+            continue
+        metric = choose_metric(base[name], current[name], args.metric)
+        before = value(base[name], metric)
+        after = value(current[name], metric)
+        if not before or not after:
+            print(f"{name:<{width}}  {metric:<16} (not reported)")
+            continue
+        # positive change is always an improvement
+        if metric in THROUGHPUT:
+            change = after / before - 1.0
+        else:
+            change = before / after - 1.0
+        flag = ""
+        if change < -args.tolerance:
+            flag = "  REGRESSION"
+            regressions.append(name)
+        print(f"{name:<{width}}  {metric:<16} {before:>12.4g} {after:>12.4g} "
+              f"{change:>+8.1%}{flag}")
+    for name in base:
+        if pattern.search(name) and name not in current:
+            print(f"{name:<{width}}  (missing from the current run)")
+
+    if regressions:
+        print(f"\n{len(regressions)} benchmark(s) slower than the baseline "
+              f"by more than {args.tolerance:.0%}", file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
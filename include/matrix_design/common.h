@@ -6,6 +6,8 @@
 #include <cstddef>
 #include <functional>
 #include <initializer_list>
+#include <type_traits>
+#include <utility>
 
 
 template <bool B, typename T> using Enable_if = std::enable_if_t<B, T>;
@@ -16,6 +18,13 @@ using Same = typename std::is_same<T, U>::type;
 
 namespace matrix_impl {
 
+// element-wise expression nodes (see matrix_expr.h) advertise themselves
+// through a static is_expression member
+template <typename E, typename = void> struct Is_expr : std::false_type {};
+template <typename E>
+struct Is_expr<E, std::void_t<decltype(E::is_expression)>>
+    : std::bool_constant<E::is_expression> {};
+
 // N > 1
 template <typename T, std::size_t N> struct Matrix_init {
   using type = std::initializer_list<typename Matrix_init<T, N - 1>::type>;
@@ -79,30 +88,6 @@ void insert_flat(std::initializer_list<T> list, Vec &vec) {
   add_list(list.begin(), list.end(), vec);
 }
 
-template <typename T, std::size_t N, typename Vec>
-auto insert_from_m_r(T *first, std::array<std::size_t, N> extents,
-                     std::array<std::size_t, N> strides, Vec &vec)
-    -> std::enable_if_t<(N == 1), void> {
-  T *last = first + extents[0];
-  vec.insert(vec.end(), first, last);
-}
-
-template <typename T, std::size_t N, typename Vec>
-auto insert_from_m_r(T *first, std::array<std::size_t, N> extents,
-                     std::array<std::size_t, N> strides, Vec &vec)
-    -> std::enable_if_t<(N > 1), void> {
-  std::size_t extent = extents[0];
-  std::size_t stride = strides[0];
-  std::array<std::size_t, N - 1> extents_;
-  std::array<std::size_t, N - 1> strides_;
-  std::copy(extents.begin() + 1, extents.end(), extents_.begin());
-  std::copy(strides.begin() + 1, strides.end(), strides_.begin());
-  for (std::size_t i = 0; i < extent; ++i) {
-    T *offset = first + i * stride;
-    insert_from_m_r<T, N - 1, Vec>(offset, extents_, strides_, vec);
-  }
-}
-
 template <std::size_t N, typename Array>
 auto computing_stride(const Array &extents) -> std::array<std::size_t, N> {
   std::array<std::size_t, N> strides;
@@ -119,8 +104,28 @@ auto computing_stride(const Array &extents) -> std::array<std::size_t, N> {
   return strides;
 }
 
+// sum of dims[i] * strides[i], unrolled at compile time
+template <std::size_t... I, typename Strides, typename... Dims>
+constexpr auto dot_strides(const Strides &strides,
+                           std::index_sequence<I...> /*dims*/, Dims... dims)
+    -> std::size_t {
+  return ((static_cast<std::size_t>(dims) * strides[I]) + ... + 0);
+}
+
+// as above for a dense row-major layout, whose innermost stride is known to
+// be 1 (the compiler can then address elements exactly as data()[i * ld + j])
+template <std::size_t... I, typename Strides, typename... Dims>
+constexpr auto dense_offset(const Strides &strides,
+                            std::index_sequence<I...> /*dims*/, Dims... dims)
+    -> std::size_t {
+  constexpr std::size_t last = sizeof...(Dims) - 1;
+  return ((static_cast<std::size_t>(dims) *
+           (I == last ? std::size_t{1} : strides[I])) +
+          ... + 0);
+}
+
 template <std::size_t N, typename... Dims, typename Array>
-auto check_bounds(const Array &extents, Dims... dims) -> bool {
+constexpr auto check_bounds(const Array &extents, Dims... dims) -> bool {
   std::array<std::size_t, N> indexes{std::size_t(dims)...};
   return std::equal(indexes.begin(), indexes.begin() + N, extents.begin(),
                     std::less<std::size_t>{});
@@ -153,4 +158,102 @@ auto computing_size(const Array &extents) -> std::size_t {
   return size;
 }
 
+// The shape shared by K operands after dropping dimensions of extent 1 and
+// merging adjacent dimensions that are contiguous in every operand. The
+// surviving dimensions are stored innermost first: extents[0] is the length
+// of the innermost run.
+template <std::size_t N, std::size_t K> struct Collapsed_dims {
+  std::size_t rank{};
+  bool empty{};
+  std::array<std::size_t, N> extents{};
+  std::array<std::array<std::size_t, N>, K> strides{};
+};
+
+template <std::size_t N, std::size_t K>
+auto collapse_dims(const std::array<std::size_t, N> &extents,
+                   const std::array<std::array<std::size_t, N>, K> &strides)
+    -> Collapsed_dims<N, K> {
+  Collapsed_dims<N, K> c;
+  for (std::size_t d = N; d-- > 0;) {
+    if (extents[d] == 0) {
+      c.empty = true;
+      return c;
+    }
+    if (extents[d] == 1) {
+      continue;
+    }
+    bool mergeable = c.rank > 0;
+    for (std::size_t k = 0; k < K && mergeable; ++k) {
+      mergeable =
+          strides[k][d] == c.strides[k][c.rank - 1] * c.extents[c.rank - 1];
+    }
+    if (mergeable) {
+      c.extents[c.rank - 1] *= extents[d];
+      continue;
+    }
+    c.extents[c.rank] = extents[d];
+    for (std::size_t k = 0; k < K; ++k) {
+      c.strides[k][c.rank] = strides[k][d];
+    }
+    ++c.rank;
+  }
+  return c;
+}
+
+// f(offsets) for every index of the collapsed dimensions first..rank-1,
+// with the K offsets updated incrementally (odometer carry)
+template <std::size_t N, std::size_t K, typename F>
+auto for_each_outer(const Collapsed_dims<N, K> &c, std::size_t first,
+                    std::array<std::size_t, K> offsets, F &&f) -> void {
+  if constexpr (N > 1) {
+    std::array<std::size_t, N> index{};
+    while (true) {
+      f(offsets);
+      std::size_t d = first;
+      for (; d < c.rank; ++d) {
+        for (std::size_t k = 0; k < K; ++k) {
+          offsets[k] += c.strides[k][d];
+        }
+        if (++index[d] < c.extents[d]) {
+          break;
+        }
+        for (std::size_t k = 0; k < K; ++k) {
+          offsets[k] -= c.strides[k][d] * c.extents[d];
+        }
+        index[d] = 0;
+      }
+      if (d >= c.rank) {
+        return;
+      }
+    }
+  } else {
+    f(offsets);
+  }
+}
+
+// Walks K operands that share `extents` (each with its own strides and
+// starting offset) one innermost run at a time, calling
+// f(offsets, length, inner_strides); a dense operand is visited as a single
+// run (see collapse_dims).
+template <std::size_t N, std::size_t K, typename F>
+auto for_each_run(const std::array<std::size_t, N> &extents,
+                  const std::array<std::array<std::size_t, N>, K> &strides,
+                  std::array<std::size_t, K> offsets, F &&f) -> void {
+  const auto c = collapse_dims<N, K>(extents, strides);
+  if (c.empty) {
+    return;
+  }
+  std::array<std::size_t, K> inner{};
+  if (c.rank == 0) {
+    f(offsets, std::size_t{1}, inner);
+    return;
+  }
+  for (std::size_t k = 0; k < K; ++k) {
+    inner[k] = c.strides[k][0];
+  }
+  for_each_outer(c, 1, offsets, [&](const std::array<std::size_t, K> &off) {
+    f(off, c.extents[0], inner);
+  });
+}
+
 } // namespace matrix_impl
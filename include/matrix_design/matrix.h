@@ -1,23 +1,34 @@
 #pragma once
 
 #include "common.h"
+#include "matrix_allocator.h"
 #include "matrix_base.h"
+#include "matrix_copy.h"
+#include "matrix_execution.h"
+#include "matrix_format.h"
 #include "matrix_ref.h"
 #include "matrix_slice.h"
 #include <array>
 #include <cassert>
 #include <initializer_list>
 #include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 template <typename T, std::size_t N>
 using Matrix_initializer = typename matrix_impl::Matrix_init<T, N>::type;
 
-template <typename T, std::size_t N> class Matrix;
-template <typename T> class Matrix<T, 0>;
-template <typename T> class Matrix<T, 1>;
+// Allocator supplies the element storage; the default aligns it to a cache
+// line (see matrix_allocator.h)
+template <typename T, std::size_t N, typename Allocator = Aligned_allocator<T>>
+class Matrix;
+template <typename T, typename Allocator> class Matrix<T, 0, Allocator>;
+template <typename T, typename Allocator> class Matrix<T, 1, Allocator>;
 
 // scalar
-template <typename T> class Matrix<T, 0> {
+template <typename T, typename Allocator> class Matrix<T, 0, Allocator> {
 public:
   static constexpr std::size_t order = 0;
   using value_type = T;
@@ -49,33 +60,108 @@ private:
   T elem;
 };
 
-template <typename T> class Matrix<T, 1> {
+template <typename T, typename Allocator> class Matrix<T, 1, Allocator> {
 public:
   static constexpr std::size_t order = 1;
   using value_type = T;
+  using allocator_type = Allocator;
 
-  Matrix() = default;                                   // default constructor
-  Matrix(Matrix const &) = default;                     // copy constructor
-  auto operator=(Matrix const &) -> Matrix & = default; // copy assignment
-  Matrix(Matrix &&) = default;                          // move constructor
-  auto operator=(Matrix &&) -> Matrix & = default;      // move assignment
+  Matrix() = default; // default constructor
+  // copies and moves as the defaults, counted when instrumented
+  Matrix(Matrix const &other) : desc(other.desc), elems(other.elems) {
+    matrix_impl::count_copy(elems.size() * sizeof(T));
+  }
+  auto operator=(Matrix const &other) -> Matrix & {
+    desc = other.desc;
+    elems = other.elems;
+    matrix_impl::count_copy(elems.size() * sizeof(T));
+    return *this;
+  }
+  Matrix(Matrix &&other) noexcept
+      : desc(std::move(other.desc)), elems(std::move(other.elems)) {
+    matrix_impl::count_move();
+  }
+  auto operator=(Matrix &&other) noexcept(
+      std::is_nothrow_move_assignable_v<std::vector<T, Allocator>>)
+      -> Matrix & {
+    desc = std::move(other.desc);
+    elems = std::move(other.elems);
+    matrix_impl::count_move();
+    return *this;
+  }
   ~Matrix() = default;
 
-  // constructor
-  explicit Matrix(const T &n);
+  explicit Matrix(const Allocator &alloc) : elems(alloc) {} // empty
 
-  explicit Matrix(Matrix_initializer<T, 1> /*list*/); // initializer from list
+  // constructor
+  explicit Matrix(const T &n, const Allocator &alloc = Allocator());
+
+  explicit Matrix(const std::array<std::size_t, 1> &extents,
+                  const Allocator &alloc = Allocator()); // init from dims
+
+  template <typename E,
+            typename = Enable_if<matrix_impl::Is_expr<E>::value, void>>
+  Matrix(const E &expr,
+         const Allocator &alloc =
+             Allocator()); // evaluate an element-wise expression
+  template <typename E,
+            typename = Enable_if<matrix_impl::Is_expr<E>::value, void>>
+  auto operator=(const E &expr) -> Matrix &; // assign from an expression
+  template <typename Policy, typename E,
+            typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy> &&
+                                     matrix_impl::Is_expr<E>::value,
+                                 void>>
+  Matrix(const Policy &policy, const E &expr,
+         const Allocator &alloc = Allocator()); // evaluate under a policy
+  template <typename Policy, typename U,
+            typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy>,
+                                 void>>
+  Matrix(const Policy &policy, const Matrix_ref<U, 1> &m_r,
+         const Allocator &alloc = Allocator()); // copy a view under a policy
+
+  explicit Matrix(Matrix_initializer<T, 1> /*list*/,
+                  const Allocator &alloc = Allocator()); // init from list
   auto operator=(Matrix_initializer<T, 1> /*list*/)
       -> Matrix &; // assign from list
 
   template <typename U>
-  explicit Matrix(
-      Matrix_ref<U, 1> const & /*m_r*/); // construct from Matrix_ref
+  explicit Matrix(Matrix_ref<U, 1> const & /*m_r*/,
+                  const Allocator &alloc =
+                      Allocator()); // construct from Matrix_ref
+  explicit Matrix(const Matrix_ref<const T, 1> &m_r,
+                  const Allocator &alloc = Allocator())
+      : Matrix(m_r.descriptor().extents, alloc) {
+    matrix_impl::count_materialization(size() * sizeof(T));
+    matrix_impl::strided_copy(m_r, Matrix_ref<T, 1>(*this));
+  } // from anything convertible to a view, such as a Fixed_matrix
+  template <typename U, typename A,
+            typename = Enable_if<!std::is_same_v<U, T>, void>>
+  explicit Matrix(const Matrix<U, 1, A> &m,
+                  const Allocator &alloc = Allocator())
+      : Matrix(Matrix_ref<const U, 1>(m), alloc) {
+  } // another element type, converted with vector instructions
   template <typename U>
   auto operator=(Matrix_ref<U, 1> const & /*m_r*/)
       -> Matrix &; // assign from Matrix_ref
 
-  auto operator()(std::size_t index) -> T & { return elems[index]; }
+  auto operator()(std::size_t index) -> T & {
+    assert(index < elems.size());
+    return elems[index];
+  }
+  auto operator()(std::size_t index) const -> const T & {
+    assert(index < elems.size());
+    return elems[index];
+  }
+
+  // element access without the debug-build bounds check
+  auto unchecked(std::size_t index) -> T & { return elems[index]; }
+  auto unchecked(std::size_t index) const -> const T & {
+    return elems[index];
+  }
+
+  // element access that throws std::out_of_range for a bad subscript
+  auto at(std::size_t index) -> T & { return elems.at(index); }
+  auto at(std::size_t index) const -> const T & { return elems.at(index); }
 
   auto row(std::size_t index) -> T & = delete;
 
@@ -85,47 +171,97 @@ public:
 
   auto data() const -> const T * { return elems.data(); }
 
-  template <typename T1, std::size_t N1>
-  friend auto operator<<(std::ostream &ost, const Matrix<T, 1> &matrix)
+  [[nodiscard]] auto size() const -> std::size_t { return elems.size(); }
+
+  auto begin() { return elems.begin(); } // every element, row-major
+  auto end() { return elems.end(); }
+  auto begin() const { return elems.begin(); }
+  auto end() const { return elems.end(); }
+
+  auto get_allocator() const -> Allocator { return elems.get_allocator(); }
+
+  operator Matrix_ref<T, 1>() { return {desc, data()}; } // view of the whole
+  operator Matrix_ref<const T, 1>() const { return {desc, data()}; }
+
+  template <typename T1, std::size_t N1, typename A1>
+  friend auto operator<<(std::ostream &ost, const Matrix<T1, N1, A1> &matrix)
       -> std::ostream &;
   [[nodiscard]] auto descriptor() const -> const Matrix_slice<1> & {
     return desc;
   } // the slice defining subscripting
 private:
   Matrix_slice<1> desc;
-  std::vector<T> elems;
+  std::vector<T, Allocator> elems;
 };
 
-template <typename T> Matrix<T, 1>::Matrix(const T &n) : desc(1), elems(n) {}
+template <typename T, typename Allocator>
+Matrix<T, 1, Allocator>::Matrix(const T &n, const Allocator &alloc)
+    : desc(n), elems(n, alloc) {}
+
+template <typename T, typename Allocator>
+Matrix<T, 1, Allocator>::Matrix(const std::array<std::size_t, 1> &extents,
+                                const Allocator &alloc)
+    : desc(extents[0]), elems(extents[0], alloc) {}
 
-template <typename T>
+template <typename T, typename Allocator>
 template <typename U>
-Matrix<T, 1>::Matrix(Matrix_ref<U, 1> const &m_r) : desc{m_r.descriptor()} {
-  T *first = m_r.pointer() + desc.start;
-  matrix_impl::insert_from_m_r<T, 1>(first, desc.extents, desc.strides, elems);
+Matrix<T, 1, Allocator>::Matrix(Matrix_ref<U, 1> const &m_r,
+                                const Allocator &alloc)
+    : Matrix(m_r.descriptor().extents, alloc) {
+  matrix_impl::count_materialization(size() * sizeof(T));
+  matrix_impl::strided_copy(m_r, Matrix_ref<T, 1>(*this));
 }
 
-template <typename T>
+template <typename T, typename Allocator>
 template <typename U>
-auto Matrix<T, 1>::operator=(Matrix_ref<U, 1> const &m_r) -> Matrix<T, 1> & {
-  desc = m_r.descriptor();
-  T *first = m_r.pointer() + desc.start;
-  matrix_impl::insert_from_m_r<T, 1>(first, desc.extents, desc.strides, elems);
+auto Matrix<T, 1, Allocator>::operator=(Matrix_ref<U, 1> const &m_r)
+    -> Matrix & {
+  // a view of our own elements, or a different shape, needs fresh storage
+  if (desc.extents != m_r.descriptor().extents ||
+      static_cast<const void *>(m_r.pointer()) == data()) {
+    return *this = Matrix(m_r, get_allocator());
+  }
+  matrix_impl::count_materialization(size() * sizeof(T));
+  matrix_impl::strided_copy(m_r, Matrix_ref<T, 1>(*this));
   return *this;
 }
 
-template <typename T, std::size_t N> class Matrix : public Matrix_base<T, N> {
+template <typename T, std::size_t N, typename Allocator>
+class Matrix : public Matrix_base<T, N, Allocator> {
   // special to matrix
 public:
   static constexpr std::size_t order = N; // dimensions
   Matrix() = default;
 
-  Matrix(Matrix &&) = default;                          // move constructor
-  auto operator=(Matrix &&) -> Matrix & = default;      // move assignment
-  Matrix(Matrix const &) = default;                     // copy constructor
-  auto operator=(Matrix const &) -> Matrix & = default; // copy assignment
+  // copies and moves as the defaults, counted when instrumented
+  Matrix(Matrix &&other) noexcept
+      : Matrix_base<T, N, Allocator>(other), desc(std::move(other.desc)),
+        elems(std::move(other.elems)) {
+    matrix_impl::count_move();
+  }
+  auto operator=(Matrix &&other) noexcept(
+      std::is_nothrow_move_assignable_v<std::vector<T, Allocator>>)
+      -> Matrix & {
+    desc = std::move(other.desc);
+    elems = std::move(other.elems);
+    matrix_impl::count_move();
+    return *this;
+  }
+  Matrix(Matrix const &other)
+      : Matrix_base<T, N, Allocator>(other), desc(other.desc),
+        elems(other.elems) {
+    matrix_impl::count_copy(elems.size() * sizeof(T));
+  }
+  auto operator=(Matrix const &other) -> Matrix & {
+    desc = other.desc;
+    elems = other.elems;
+    matrix_impl::count_copy(elems.size() * sizeof(T));
+    return *this;
+  }
   ~Matrix() = default;
 
+  explicit Matrix(const Allocator &alloc) : elems(alloc) {} // empty
+
   static constexpr auto get_order() -> std::size_t {
     return N;
   } // number of order
@@ -135,18 +271,62 @@ public:
   } // # elements in the nth dimension
 
   template <typename U>
-  explicit Matrix(
-      const Matrix_ref<U, N> & /*m_r*/); // construct from Matrix_ref
+  explicit Matrix(const Matrix_ref<U, N> & /*m_r*/,
+                  const Allocator &alloc =
+                      Allocator()); // construct from Matrix_ref
+  explicit Matrix(const Matrix_ref<const T, N> &m_r,
+                  const Allocator &alloc = Allocator())
+      : Matrix(m_r.descriptor().extents, alloc) {
+    matrix_impl::count_materialization(size() * sizeof(T));
+    matrix_impl::strided_copy(m_r, Matrix_ref<T, N>(*this));
+  } // from anything convertible to a view, such as a Fixed_matrix
+  template <typename U, typename A,
+            typename = Enable_if<!std::is_same_v<U, T>, void>>
+  explicit Matrix(const Matrix<U, N, A> &m,
+                  const Allocator &alloc = Allocator())
+      : Matrix(Matrix_ref<const U, N>(m), alloc) {
+  } // another element type, converted with vector instructions
   template <typename U>
   auto operator=(const Matrix_ref<U, N> & /*m_r*/)
       -> Matrix &; // assign from Matrix_ref
 
-  explicit Matrix(Matrix_initializer<T, N> /*list*/); // initializer from list
+  explicit Matrix(Matrix_initializer<T, N> /*list*/,
+                  const Allocator &alloc = Allocator()); // init from list
   auto operator=(Matrix_initializer<T, N> /*list*/)
       -> Matrix &; // assign from list
 
-  template <typename... Extents>
+  template <typename... Extents,
+            typename = Enable_if<
+                matrix_impl::Requesting_element<Extents...>(), void>>
   explicit Matrix(Extents... extents); // init from dims
+  template <typename... Extents,
+            typename = Enable_if<
+                matrix_impl::Requesting_element<Extents...>(), void>>
+  Matrix(const Allocator &alloc,
+         Extents... extents); // init from dims, with an allocator
+
+  explicit Matrix(const std::array<std::size_t, N> &extents,
+                  const Allocator &alloc = Allocator()); // init from dims
+
+  template <typename E,
+            typename = Enable_if<matrix_impl::Is_expr<E>::value, void>>
+  Matrix(const E &expr,
+         const Allocator &alloc =
+             Allocator()); // evaluate an element-wise expression
+  template <typename E,
+            typename = Enable_if<matrix_impl::Is_expr<E>::value, void>>
+  auto operator=(const E &expr) -> Matrix &; // assign from an expression
+  template <typename Policy, typename E,
+            typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy> &&
+                                     matrix_impl::Is_expr<E>::value,
+                                 void>>
+  Matrix(const Policy &policy, const E &expr,
+         const Allocator &alloc = Allocator()); // evaluate under a policy
+  template <typename Policy, typename U,
+            typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy>,
+                                 void>>
+  Matrix(const Policy &policy, const Matrix_ref<U, N> &m_r,
+         const Allocator &alloc = Allocator()); // copy a view under a policy
   // disable init Matrix from std::initializer_list<T> or
   // std::initializer_list<std::initializer_list<D>> because Matrix<T, N>,
   // where N > 2, can only be init from 3D std::initializer_list.
@@ -157,14 +337,21 @@ public:
   template <typename U>
   auto operator=(std::initializer_list<U>) -> Matrix & = delete;
 
-  template <typename T1, std::size_t N1>
-  friend auto operator<<(std::ostream &ost, const Matrix<T1, N1> &matrix)
+  template <typename T1, std::size_t N1, typename A1>
+  friend auto operator<<(std::ostream &ost, const Matrix<T1, N1, A1> &matrix)
       -> std::ostream &;
 
   [[nodiscard]] auto size() const -> std::size_t {
     return elems.size();
   } // total number of elements
 
+  auto begin() { return elems.begin(); } // every element, row-major
+  auto end() { return elems.end(); }
+  auto begin() const { return elems.begin(); }
+  auto end() const { return elems.end(); }
+
+  auto get_allocator() const -> Allocator { return elems.get_allocator(); }
+
   auto descriptor() const -> const Matrix_slice<N> & {
     return desc;
   } // the slice defining subscripting
@@ -194,7 +381,27 @@ public:
 
   template <typename... Args>
   auto operator()(Args... args) const
+      -> Enable_if<matrix_impl::Requesting_element<Args...>(), const T &>;
+
+  // element access without the debug-build bounds check
+  template <typename... Args>
+  auto unchecked(Args... args)
+      -> Enable_if<matrix_impl::Requesting_element<Args...>(), T &> {
+    return elems[offset(args...)];
+  }
+  template <typename... Args>
+  auto unchecked(Args... args) const
+      -> Enable_if<matrix_impl::Requesting_element<Args...>(), const T &> {
+    return elems[offset(args...)];
+  }
+
+  // element access that throws std::out_of_range for a bad subscript
+  template <typename... Args>
+  auto at(Args... args)
       -> Enable_if<matrix_impl::Requesting_element<Args...>(), T &>;
+  template <typename... Args>
+  auto at(Args... args) const
+      -> Enable_if<matrix_impl::Requesting_element<Args...>(), const T &>;
 
   template <typename... Args>
   auto operator()(const Args &...args)
@@ -202,45 +409,147 @@ public:
 
   template <typename... Args>
   auto operator()(const Args &...args) const
-      -> Enable_if<Requesting_slice<Args...>(), Matrix_ref<T, N>>;
+      -> Enable_if<Requesting_slice<Args...>(), Matrix_ref<const T, N>>;
 
-  auto rows() -> int { return desc.extents[0]; }
+  auto rows() const -> int { return desc.extents[0]; }
 
-  auto cols() -> int { return desc.extents[1]; }
+  auto cols() const -> int { return desc.extents[1]; }
+
+  operator Matrix_ref<T, N>() { return {desc, data()}; } // view of the whole
+  operator Matrix_ref<const T, N>() const { return {desc, data()}; }
 
 private:
+  // the elements are dense and row-major: no start offset, unit inner stride
+  template <typename... Args> auto offset(Args... args) const -> std::size_t {
+    static_assert(sizeof...(Args) == N, "Number of params must be N");
+    return matrix_impl::dense_offset(desc.strides,
+                                     std::make_index_sequence<N>{}, args...);
+  }
+
   Matrix_slice<N> desc;
-  std::vector<T> elems;
+  std::vector<T, Allocator> elems;
 };
 
-template <typename T, std::size_t N>
+template <typename T, std::size_t N, typename Allocator>
 template <typename U>
-Matrix<T, N>::Matrix(const Matrix_ref<U, N> &m_r) {
-  desc = m_r.descriptor();
-  T *first = m_r.pointer() + desc.start;
-  matrix_impl::insert_from_m_r<T, N>(first, desc.extents, desc.strides, elems);
-  desc.strides = matrix_impl::computing_stride<N>(desc.extents);
-  desc.start = 0;
+Matrix<T, N, Allocator>::Matrix(const Matrix_ref<U, N> &m_r,
+                                const Allocator &alloc)
+    : Matrix(m_r.descriptor().extents, alloc) {
+  matrix_impl::count_materialization(size() * sizeof(T));
+  matrix_impl::strided_copy(m_r, Matrix_ref<T, N>(*this));
 }
 
-template <typename T, std::size_t N>
+template <typename T, std::size_t N, typename Allocator>
 template <typename U>
-auto Matrix<T, N>::operator=(const Matrix_ref<U, N> &m_r) -> Matrix<T, N> & {
-  desc = m_r.get_matrix_desc();
-  T *first = m_r.get_first_element_ptr() + desc.start;
-  matrix_impl::insert_from_m_r<T, N, std::vector<T>>(first, desc.extents,
-                                                     desc.strides, this->elems);
-  desc.strides = matrix_impl::computing_stride<N>(desc.extents);
-  desc.start = 0;
+auto Matrix<T, N, Allocator>::operator=(const Matrix_ref<U, N> &m_r)
+    -> Matrix & {
+  // a view of our own elements, or a different shape, needs fresh storage
+  if (desc.extents != m_r.descriptor().extents ||
+      static_cast<const void *>(m_r.pointer()) == data()) {
+    return *this = Matrix(m_r, get_allocator());
+  }
+  matrix_impl::count_materialization(size() * sizeof(T));
+  matrix_impl::strided_copy(m_r, Matrix_ref<T, N>(*this));
   return *this;
 }
 
-template <typename T, std::size_t N>
-template <typename... Extents>
-Matrix<T, N>::Matrix(Extents... extents)
+template <typename T, std::size_t N, typename Allocator>
+template <typename... Extents, typename>
+Matrix<T, N, Allocator>::Matrix(Extents... extents)
     : desc{static_cast<std::size_t>(extents)...}, elems(desc.size) {}
 
-template <typename T> Matrix<T, 1>::Matrix(Matrix_initializer<T, 1> list) {
+template <typename T, std::size_t N, typename Allocator>
+template <typename... Extents, typename>
+Matrix<T, N, Allocator>::Matrix(const Allocator &alloc, Extents... extents)
+    : desc{static_cast<std::size_t>(extents)...}, elems(desc.size, alloc) {}
+
+template <typename T, typename Allocator>
+template <typename E, typename>
+Matrix<T, 1, Allocator>::Matrix(const E &expr, const Allocator &alloc)
+    : Matrix(expr.extents(), alloc) {
+  matrix_impl::evaluate(Matrix_ref<T, 1>(*this), expr);
+}
+
+template <typename T, typename Allocator>
+template <typename E, typename>
+auto Matrix<T, 1, Allocator>::operator=(const E &expr) -> Matrix & {
+  if (desc.extents != expr.extents()) {
+    // the expression may still read the old elements
+    return *this = Matrix(expr, get_allocator());
+  }
+  matrix_impl::evaluate(Matrix_ref<T, 1>(*this), expr);
+  return *this;
+}
+
+template <typename T, typename Allocator>
+template <typename Policy, typename E, typename>
+Matrix<T, 1, Allocator>::Matrix(const Policy &policy, const E &expr,
+                                const Allocator &alloc)
+    : Matrix(expr.extents(), alloc) {
+  matrix_impl::evaluate(policy, Matrix_ref<T, 1>(*this), expr);
+}
+
+template <typename T, typename Allocator>
+template <typename Policy, typename U, typename>
+Matrix<T, 1, Allocator>::Matrix(const Policy &policy,
+                                const Matrix_ref<U, 1> &m_r,
+                                const Allocator &alloc)
+    : Matrix(m_r.descriptor().extents, alloc) {
+  matrix_impl::count_materialization(size() * sizeof(T));
+  matrix_impl::strided_copy(policy, m_r, Matrix_ref<T, 1>(*this));
+}
+
+template <typename T, std::size_t N, typename Allocator>
+template <typename Policy, typename E, typename>
+Matrix<T, N, Allocator>::Matrix(const Policy &policy, const E &expr,
+                                const Allocator &alloc)
+    : Matrix(expr.extents(), alloc) {
+  matrix_impl::evaluate(policy, Matrix_ref<T, N>(*this), expr);
+}
+
+template <typename T, std::size_t N, typename Allocator>
+template <typename Policy, typename U, typename>
+Matrix<T, N, Allocator>::Matrix(const Policy &policy,
+                                const Matrix_ref<U, N> &m_r,
+                                const Allocator &alloc)
+    : Matrix(m_r.descriptor().extents, alloc) {
+  matrix_impl::count_materialization(size() * sizeof(T));
+  matrix_impl::strided_copy(policy, m_r, Matrix_ref<T, N>(*this));
+}
+
+template <typename T, std::size_t N, typename Allocator>
+template <typename E, typename>
+Matrix<T, N, Allocator>::Matrix(const E &expr, const Allocator &alloc)
+    : Matrix(expr.extents(), alloc) {
+  matrix_impl::evaluate(Matrix_ref<T, N>(*this), expr);
+}
+
+template <typename T, std::size_t N, typename Allocator>
+template <typename E, typename>
+auto Matrix<T, N, Allocator>::operator=(const E &expr) -> Matrix & {
+  if (desc.extents != expr.extents()) {
+    // the expression may still read the old elements
+    return *this = Matrix(expr, get_allocator());
+  }
+  matrix_impl::evaluate(Matrix_ref<T, N>(*this), expr);
+  return *this;
+}
+
+template <typename T, std::size_t N, typename Allocator>
+Matrix<T, N, Allocator>::Matrix(const std::array<std::size_t, N> &extents,
+                                const Allocator &alloc)
+    : elems(alloc) {
+  desc.start = 0;
+  desc.extents = extents;
+  desc.strides = matrix_impl::computing_stride<N>(extents);
+  desc.size = matrix_impl::computing_size<N>(extents);
+  elems.resize(desc.size);
+}
+
+template <typename T, typename Allocator>
+Matrix<T, 1, Allocator>::Matrix(Matrix_initializer<T, 1> list,
+                                const Allocator &alloc)
+    : elems(alloc) {
   std::array<std::size_t, 1> extents = matrix_impl::derive_extents<1>(list);
   std::array<std::size_t, 1> strides =
       matrix_impl::computing_stride<1>(extents);
@@ -251,8 +560,9 @@ template <typename T> Matrix<T, 1>::Matrix(Matrix_initializer<T, 1> list) {
   matrix_impl::insert_flat(list, this->elems);
 }
 
-template <typename T>
-auto Matrix<T, 1>::operator=(Matrix_initializer<T, 1> list) -> Matrix<T, 1> & {
+template <typename T, typename Allocator>
+auto Matrix<T, 1, Allocator>::operator=(Matrix_initializer<T, 1> list)
+    -> Matrix & {
   std::array<std::size_t, 1> extents = matrix_impl::derive_extents<1>(list);
   std::array<std::size_t, 1> strides =
       matrix_impl::computing_stride<1>(extents);
@@ -264,8 +574,10 @@ auto Matrix<T, 1>::operator=(Matrix_initializer<T, 1> list) -> Matrix<T, 1> & {
   return *this;
 }
 
-template <typename T, std::size_t N>
-Matrix<T, N>::Matrix(Matrix_initializer<T, N> list) {
+template <typename T, std::size_t N, typename Allocator>
+Matrix<T, N, Allocator>::Matrix(Matrix_initializer<T, N> list,
+                                const Allocator &alloc)
+    : elems(alloc) {
   std::array<std::size_t, N> extents = matrix_impl::derive_extents<N>(list);
   std::array<std::size_t, N> strides =
       matrix_impl::computing_stride<N>(extents);
@@ -276,9 +588,9 @@ Matrix<T, N>::Matrix(Matrix_initializer<T, N> list) {
   matrix_impl::insert_flat(list, this->elems);
 }
 
-template <typename T, std::size_t N>
-inline auto Matrix<T, N>::operator=(Matrix_initializer<T, N> list)
-    -> Matrix<T, N> & {
+template <typename T, std::size_t N, typename Allocator>
+inline auto Matrix<T, N, Allocator>::operator=(Matrix_initializer<T, N> list)
+    -> Matrix<T, N, Allocator> & {
   // TODO: insert return statement here
   std::array<std::size_t, N> extents = matrix_impl::derive_extents<N>(list);
   std::array<std::size_t, N> strides = computing_stride<N>(extents);
@@ -290,74 +602,22 @@ inline auto Matrix<T, N>::operator=(Matrix_initializer<T, N> list)
   return *this;
 }
 
-template <typename T1, std::size_t N1>
-auto operator<<(std::ostream &ost, const Matrix<T1, N1> &matrix)
+template <typename T1, std::size_t N1, typename A1>
+auto operator<<(std::ostream &ost, const Matrix<T1, N1, A1> &matrix)
     -> std::ostream & {
-  print_matrix<N1>(ost, matrix, 0);
-  return ost;
-}
-
-template <std::size_t dim, typename T1, std::size_t N1>
-auto print_matrix(std::ostream &out, const Matrix<T1, N1> &matrix,
-                  std::size_t offset) -> Enable_if<(dim == 1), void> {
-  out << "[";
-  for (std::size_t i = 0; i < matrix.descriptor().extents[N1 - dim]; ++i) {
-    out << *(matrix.data() + offset + i);
-    if (i < matrix.descriptor().extents[N1 - dim] - 1) {
-      out << ", ";
-    }
-  }
-  out << "]";
-}
-
-template <std::size_t dim, typename T1, std::size_t N1>
-auto print_matrix(std::ostream &out, const Matrix<T1, N1> &matrix,
-                  std::size_t offset) -> Enable_if<(dim == 2), void> {
-  out << "[";
-  for (std::size_t i = 0; i < matrix.descriptor().extents[N1 - dim]; ++i) {
-    if (i > 0) {
-      for (std::size_t j = 0; j < N1 - dim + 1; j++) {
-        out << " ";
-      }
-    }
-    std::size_t offset_ = offset + i * matrix.descriptor().strides[N1 - dim];
-    print_matrix<dim - 1>(out, matrix, offset_);
-    if (i < matrix.descriptor().extents[N1 - dim] - 1) {
-      out << "," << '\n';
-    }
-  }
-  out << "]";
-}
-
-template <std::size_t dim, typename T1, std::size_t N1>
-auto print_matrix(std::ostream &out, const Matrix<T1, N1> &matrix,
-                  std::size_t offset) -> Enable_if<(dim > 2), void> {
-  out << "[";
-  for (std::size_t i = 0; i < matrix.descriptor().extents[N1 - dim]; ++i) {
-    if (i > 0) {
-      for (std::size_t j = 0; j < N1 - dim + 1; j++) {
-        out << " ";
-      }
-    }
-    std::size_t offset_ = offset + i * matrix.descriptor().strides[N1 - dim];
-    print_matrix<dim - 1>(out, matrix, offset_);
-    if (i < matrix.descriptor().extents[N1 - dim] - 1) {
-      out << "," << '\n' << '\n';
-    }
-  }
-  out << "]";
+  return matrix_impl::stream_matrix(ost, matrix);
 }
 
-template <typename T, std::size_t N>
-auto Matrix<T, N>::row(std::size_t n) -> Matrix_ref<T, N - 1> {
+template <typename T, std::size_t N, typename Allocator>
+auto Matrix<T, N, Allocator>::row(std::size_t n) -> Matrix_ref<T, N - 1> {
   assert(n < rows());
   Matrix_slice<N - 1> row;
   slice_dim<0, T, N>(n, desc, row);
   return {row, data()};
 }
 
-template <typename T, std::size_t N>
-inline auto Matrix<T, N>::row(std::size_t n) const
+template <typename T, std::size_t N, typename Allocator>
+inline auto Matrix<T, N, Allocator>::row(std::size_t n) const
     -> Matrix_ref<const T, N - 1> {
   assert(n < rows());
   Matrix_slice<N - 1> row;
@@ -365,42 +625,64 @@ inline auto Matrix<T, N>::row(std::size_t n) const
   return {row, data()};
 }
 
-template <typename T, std::size_t N>
-auto Matrix<T, N>::col(std::size_t n) -> Matrix_ref<T, N - 1> {
+template <typename T, std::size_t N, typename Allocator>
+auto Matrix<T, N, Allocator>::col(std::size_t n) -> Matrix_ref<T, N - 1> {
   assert(n < cols());
   Matrix_slice<N - 1> col;
-  slice_dim<1>(n, desc, col);
+  slice_dim<1, T, N>(n, desc, col);
   return {col, data()};
 }
 
-template <typename T, std::size_t N>
-inline auto Matrix<T, N>::col(std::size_t n) const
+template <typename T, std::size_t N, typename Allocator>
+inline auto Matrix<T, N, Allocator>::col(std::size_t n) const
     -> Matrix_ref<const T, N - 1> {
   assert(n < cols());
   Matrix_slice<N - 1> col;
-  slice_dim<1>(n, desc, col);
+  slice_dim<1, T, N>(n, desc, col);
   return {col, data()};
 }
 
-template <typename T, std::size_t N>
+template <typename T, std::size_t N, typename Allocator>
 template <typename... Args>
-auto Matrix<T, N>::operator()(Args... args)
+auto Matrix<T, N, Allocator>::operator()(Args... args)
     -> Enable_if<matrix_impl::Requesting_element<Args...>(), T &> {
   assert(matrix_impl::check_bounds<N>(desc.extents, args...));
-  return *(data() + desc(args...));
+  return unchecked(args...);
 }
 
-template <typename T, std::size_t N>
+template <typename T, std::size_t N, typename Allocator>
 template <typename... Args>
-inline auto Matrix<T, N>::operator()(Args... args) const
+inline auto Matrix<T, N, Allocator>::operator()(Args... args) const
+    -> Enable_if<matrix_impl::Requesting_element<Args...>(), const T &> {
+  assert(matrix_impl::check_bounds<N>(desc.extents, args...));
+  return unchecked(args...);
+}
+
+template <typename T, std::size_t N, typename Allocator>
+template <typename... Args>
+auto Matrix<T, N, Allocator>::at(Args... args)
     -> Enable_if<matrix_impl::Requesting_element<Args...>(), T &> {
-  assert(check_bounds(desc, args...));
-  return *(data() + desc(args...));
+  static_assert(sizeof...(Args) == N, "Number of params must be N");
+  if (!matrix_impl::check_bounds<N>(desc.extents, args...)) {
+    throw std::out_of_range("Matrix::at: subscript out of range");
+  }
+  return unchecked(args...);
 }
 
-template <typename T, std::size_t N>
+template <typename T, std::size_t N, typename Allocator>
+template <typename... Args>
+auto Matrix<T, N, Allocator>::at(Args... args) const
+    -> Enable_if<matrix_impl::Requesting_element<Args...>(), const T &> {
+  static_assert(sizeof...(Args) == N, "Number of params must be N");
+  if (!matrix_impl::check_bounds<N>(desc.extents, args...)) {
+    throw std::out_of_range("Matrix::at: subscript out of range");
+  }
+  return unchecked(args...);
+}
+
+template <typename T, std::size_t N, typename Allocator>
 template <typename... Args>
-inline auto Matrix<T, N>::operator()(const Args &...args)
+inline auto Matrix<T, N, Allocator>::operator()(const Args &...args)
     -> Enable_if<Requesting_slice<Args...>(), Matrix_ref<T, N>> {
   Matrix_slice<N> descriptor;
   descriptor.start = do_slice(desc, descriptor, args...);
@@ -408,12 +690,55 @@ inline auto Matrix<T, N>::operator()(const Args &...args)
   return {descriptor, this->data()};
 }
 
-template <typename T, std::size_t N>
+template <typename T, std::size_t N, typename Allocator>
 template <typename... Args>
-inline auto Matrix<T, N>::operator()(const Args &...args) const
-    -> Enable_if<Requesting_slice<Args...>(), Matrix_ref<T, N>> {
+inline auto Matrix<T, N, Allocator>::operator()(const Args &...args) const
+    -> Enable_if<Requesting_slice<Args...>(), Matrix_ref<const T, N>> {
   Matrix_slice<N> descriptor;
   descriptor.start = do_slice(desc, descriptor, args...);
   descriptor.size = matrix_impl::computing_size<N>(descriptor.extents);
   return {descriptor, this->data()};
 }
+
+namespace matrix_impl {
+
+// Matrix and Matrix_ref of order >= 1 are the operands accepted by the free
+// algorithms built on top of the containers
+template <typename M> struct Is_matrix : std::false_type {};
+template <typename T, std::size_t N, typename A>
+struct Is_matrix<Matrix<T, N, A>> : std::bool_constant<(N > 0)> {};
+template <typename T, std::size_t N>
+struct Is_matrix<Matrix_ref<T, N>> : std::true_type {};
+
+template <typename M>
+constexpr bool Is_matrix_v =
+    Is_matrix<std::remove_cv_t<std::remove_reference_t<M>>>::value;
+
+template <typename M>
+using Value_type = std::remove_const_t<typename M::value_type>;
+
+// uniform Matrix_ref view over either kind of operand
+template <typename T, std::size_t N, typename A>
+auto as_ref(Matrix<T, N, A> &m) -> Matrix_ref<T, N> {
+  return m;
+}
+
+template <typename T, std::size_t N, typename A>
+auto as_ref(const Matrix<T, N, A> &m) -> Matrix_ref<const T, N> {
+  return m;
+}
+
+// other matrix types (such as Fixed_matrix) provide a view() of themselves
+template <typename M> auto as_ref(M &m) -> decltype(m.view()) {
+  return m.view();
+}
+
+template <typename T, std::size_t N>
+auto as_ref(const Matrix_ref<T, N> &m_r) -> Matrix_ref<T, N> {
+  return m_r;
+}
+
+} // namespace matrix_impl
+
+// element-wise expressions are part of the basic Matrix interface
+#include "matrix_expr.h"
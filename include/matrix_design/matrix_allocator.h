@@ -0,0 +1,186 @@
+#pragma once
+
+#include "matrix_instrument.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Allocators for the elements of a Matrix.
+//
+//   Aligned_allocator<T>  the default: every block starts on a 64-byte
+//                         boundary, so the first row of a fresh matrix
+//                         begins on a cache line and whole SIMD registers
+//                         load aligned from it; later rows do too only when
+//                         a row is a multiple of 64 bytes long
+//   Arena_allocator<T>    hands out memory from a Monotonic_arena; freeing
+//                         is a no-op and the arena's release() reclaims
+//                         everything at once
+//
+// A request-scoped arena is used like this:
+//
+//   Monotonic_arena arena;
+//   Arena_allocator<double> alloc(arena);
+//   Matrix<double, 2, Arena_allocator<double>> m(alloc, rows, cols);
+//   ...
+//   arena.release(); // every matrix built from the arena is gone
+//
+// Matrices built from an arena must be destroyed before it is released.
+
+// the alignment of Matrix storage by default: one cache line, which is also
+// the width of the largest vector registers
+inline constexpr std::size_t matrix_alignment = 64;
+
+template <typename T, std::size_t Alignment = matrix_alignment>
+class Aligned_allocator {
+  static_assert((Alignment & (Alignment - 1)) == 0,
+                "alignment must be a power of two");
+
+public:
+  using value_type = T;
+  using is_always_equal = std::true_type;
+
+  template <typename U> struct rebind {
+    using other = Aligned_allocator<U, Alignment>;
+  };
+
+  static constexpr std::size_t alignment = std::max(Alignment, alignof(T));
+
+  Aligned_allocator() noexcept = default;
+  template <typename U>
+  Aligned_allocator(
+      const Aligned_allocator<U, Alignment> & /*other*/) noexcept {}
+
+  [[nodiscard]] auto allocate(std::size_t n) -> T * {
+    if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+      throw std::bad_array_new_length();
+    }
+    matrix_impl::count_allocation(n * sizeof(T));
+    return static_cast<T *>(
+        ::operator new(n * sizeof(T), std::align_val_t(alignment)));
+  }
+
+  auto deallocate(T *p, std::size_t /*n*/) noexcept -> void {
+    ::operator delete(p, std::align_val_t(alignment));
+  }
+
+  template <typename U>
+  auto operator==(const Aligned_allocator<U, Alignment> & /*other*/) const
+      noexcept -> bool {
+    return true;
+  }
+};
+
+// A bump allocator over a list of large blocks. Memory is only given back
+// by release(), which rewinds to the first block in constant time and keeps
+// every block for the next round, so a steady-state request allocates
+// nothing from the system at all.
+class Monotonic_arena {
+public:
+  explicit Monotonic_arena(std::size_t block_size = std::size_t{1} << 20)
+      : block_size{block_size} {}
+
+  Monotonic_arena(const Monotonic_arena &) = delete;
+  auto operator=(const Monotonic_arena &) -> Monotonic_arena & = delete;
+
+  ~Monotonic_arena() {
+    for (auto &block : blocks) {
+      ::operator delete(block.first, std::align_val_t(matrix_alignment));
+    }
+  }
+
+  // `bytes` bytes aligned to `alignment` (a power of two)
+  [[nodiscard]] auto allocate(std::size_t bytes, std::size_t alignment)
+      -> void * {
+    while (true) {
+      if (current < blocks.size()) {
+        const auto base =
+            reinterpret_cast<std::uintptr_t>(blocks[current].first);
+        const std::size_t offset =
+            ((base + used + alignment - 1) & ~(alignment - 1)) - base;
+        if (offset + bytes <= blocks[current].second) {
+          used = offset + bytes;
+          return blocks[current].first + offset;
+        }
+        if (current + 1 < blocks.size() &&
+            bytes + alignment <= blocks[current + 1].second) {
+          ++current;
+          used = 0;
+          continue;
+        }
+      }
+      // a new block big enough for this request, placed after the current
+      // one so it is reused in the same order after release()
+      const std::size_t size = std::max(block_size, bytes + alignment);
+      matrix_impl::count_allocation(size);
+      auto *block = static_cast<std::byte *>(
+          ::operator new(size, std::align_val_t(matrix_alignment)));
+      const std::size_t at = blocks.empty() ? 0 : current + 1;
+      blocks.insert(blocks.begin() + static_cast<std::ptrdiff_t>(at),
+                    {block, size});
+      current = at;
+      used = 0;
+    }
+  }
+
+  // forget every allocation; the blocks are kept for reuse
+  auto release() noexcept -> void {
+    current = 0;
+    used = 0;
+  }
+
+  // bytes obtained from the system so far
+  [[nodiscard]] auto capacity() const noexcept -> std::size_t {
+    std::size_t total = 0;
+    for (const auto &block : blocks) {
+      total += block.second;
+    }
+    return total;
+  }
+
+private:
+  std::size_t block_size;
+  std::vector<std::pair<std::byte *, std::size_t>> blocks;
+  std::size_t current = 0; // the block being carved up
+  std::size_t used = 0;    // bytes of it already handed out
+};
+
+template <typename T> class Arena_allocator {
+public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  explicit Arena_allocator(Monotonic_arena &arena) noexcept : arena{&arena} {}
+  template <typename U>
+  Arena_allocator(const Arena_allocator<U> &other) noexcept
+      : arena{other.resource()} {}
+
+  [[nodiscard]] auto allocate(std::size_t n) -> T * {
+    if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+      throw std::bad_array_new_length();
+    }
+    return static_cast<T *>(arena->allocate(
+        n * sizeof(T), std::max(matrix_alignment, alignof(T))));
+  }
+
+  auto deallocate(T * /*p*/, std::size_t /*n*/) noexcept -> void {}
+
+  [[nodiscard]] auto resource() const noexcept -> Monotonic_arena * {
+    return arena;
+  }
+
+  template <typename U>
+  auto operator==(const Arena_allocator<U> &other) const noexcept -> bool {
+    return arena == other.resource();
+  }
+
+private:
+  Monotonic_arena *arena;
+};
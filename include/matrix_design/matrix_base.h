@@ -1,11 +1,18 @@
 #pragma once
 
+#include "matrix_allocator.h"
+#include <type_traits>
 #include <vector>
-template <typename T, std::size_t N> class Matrix_base;
-template <typename T, std::size_t N> class Matrix_base {
+template <typename T, std::size_t N,
+          typename Allocator = Aligned_allocator<std::remove_const_t<T>>>
+class Matrix_base;
+template <typename T, std::size_t N, typename Allocator> class Matrix_base {
   // common stuff
 public:
   using value_type = T;
-  using iterator = typename std::vector<T>::iterator;
-  using const_iterator = typename std::vector<T>::const_iterator;
-};
\ No newline at end of file
+  using allocator_type = Allocator;
+  using iterator =
+      typename std::vector<std::remove_const_t<T>, Allocator>::iterator;
+  using const_iterator =
+      typename std::vector<std::remove_const_t<T>, Allocator>::const_iterator;
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "matrix.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+// NumPy-style broadcasting.
+//
+//   broadcast_to(m, extents)      a read-only view of m with the given
+//                                 extents; nothing is copied
+//   is_broadcastable(from, to)    whether extents `from` broadcast to `to`
+//   broadcast_extents(a, b)       the extents two operands broadcast to
+//
+// Extents are matched from the innermost dimension outwards: each dimension
+// of m must equal the target's or be 1, and missing outer dimensions count
+// as 1. Every dimension that is expanded gets stride 0 in the view, so
+//
+//   y = x + broadcast_to(bias, x.descriptor().extents);
+//   y = multiply(x, broadcast_to(scale, x.descriptor().extents));
+//
+// add a bias to every row, or scale every channel, without materializing
+// the expanded operand. The element-wise kernels recognize stride-0 runs
+// and read their one element once per run. The functions that take
+// extents throw std::invalid_argument when they are not compatible.
+
+template <std::size_t M, std::size_t N>
+constexpr auto is_broadcastable(const std::array<std::size_t, M> &from,
+                                const std::array<std::size_t, N> &to)
+    -> bool {
+  if constexpr (M > N) {
+    return false;
+  } else {
+    for (std::size_t d = 0; d < M; ++d) {
+      const std::size_t f = from[M - 1 - d];
+      if (f != 1 && f != to[N - 1 - d]) {
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+namespace matrix_impl {
+
+template <std::size_t N>
+auto extents_string(const std::array<std::size_t, N> &extents)
+    -> std::string {
+  std::string s = "(";
+  for (std::size_t d = 0; d < N; ++d) {
+    s += (d > 0 ? ", " : "") + std::to_string(extents[d]);
+  }
+  return s + ")";
+}
+
+} // namespace matrix_impl
+
+template <std::size_t M, std::size_t N>
+auto broadcast_extents(const std::array<std::size_t, M> &a,
+                       const std::array<std::size_t, N> &b)
+    -> std::array<std::size_t, std::max(M, N)> {
+  constexpr std::size_t R = std::max(M, N);
+  std::array<std::size_t, R> extents{};
+  for (std::size_t d = 0; d < R; ++d) {
+    const std::size_t x = d < M ? a[M - 1 - d] : 1;
+    const std::size_t y = d < N ? b[N - 1 - d] : 1;
+    if (x != y && x != 1 && y != 1) {
+      throw std::invalid_argument(
+          "broadcast_extents: " + matrix_impl::extents_string(a) + " and " +
+          matrix_impl::extents_string(b) + " are not compatible");
+    }
+    extents[R - 1 - d] = x == 1 ? y : x;
+  }
+  return extents;
+}
+
+// a view of m with the given extents, in which every broadcast dimension
+// has stride 0
+template <typename M, std::size_t N,
+          typename = Enable_if<matrix_impl::Is_matrix_v<M>, void>>
+auto broadcast_to(const M &m, const std::array<std::size_t, N> &extents)
+    -> Matrix_ref<const matrix_impl::Value_type<M>, N> {
+  const auto m_r = matrix_impl::as_ref(m);
+  constexpr std::size_t K = decltype(m_r)::order;
+  const auto &desc = m_r.descriptor();
+  if (!is_broadcastable(desc.extents, extents)) {
+    throw std::invalid_argument(
+        "broadcast_to: cannot broadcast " +
+        matrix_impl::extents_string(desc.extents) + " to " +
+        matrix_impl::extents_string(extents));
+  }
+  Matrix_slice<N> view;
+  view.start = desc.start;
+  view.extents = extents;
+  view.size = matrix_impl::computing_size<N>(extents);
+  view.strides.fill(0);
+  for (std::size_t d = 0; d < K; ++d) {
+    const std::size_t from = K - 1 - d;
+    const std::size_t to = N - 1 - d;
+    if (desc.extents[from] == extents[to]) {
+      view.strides[to] = desc.strides[from];
+    }
+  }
+  return {view, m_r.pointer()};
+}
+
+template <typename M, std::size_t N,
+          typename = Enable_if<matrix_impl::Is_matrix_v<M>, void>>
+auto broadcast_to(const M &m, const std::size_t (&extents)[N])
+    -> Matrix_ref<const matrix_impl::Value_type<M>, N> {
+  std::array<std::size_t, N> e;
+  std::copy(extents, extents + N, e.begin());
+  return broadcast_to(m, e);
+}
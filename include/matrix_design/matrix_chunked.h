@@ -0,0 +1,654 @@
+#pragma once
+
+#include "matrix.h"
+#include "matrix_copy.h"
+#include "matrix_npy.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Chunked storage for arrays larger than memory (POSIX only).
+//
+// The array is cut into tiles of a fixed chunk shape, and each tile is
+// stored, optionally compressed, as one independent chunk. The header
+// records the shape, the chunk shape and where every chunk lives, so a
+// reader fetches exactly the chunks a request touches with pread:
+//
+//   Chunked_writer<float, 2> w("big.mdc", {rows, cols}, {256, 256},
+//                              Chunk_codec::shuffle_lz);
+//   for (...) {
+//     w.append(slab); // the next rows, a multiple of 256 of them
+//   }
+//   w.close();
+//
+//   Chunked_file<float, 2> f("big.mdc");
+//   Matrix<float, 2> part = f.read(Slice(1000, 1100), Slice(0, 64));
+//
+// Subscripts of read() follow m(...): an index or a Slice(i, j) for each
+// dimension, and the result keeps every dimension. Chunks that were never
+// written read as zeros.
+//
+// Codecs:
+//   none              elements stored as they are
+//   shuffle_lz        bytes regrouped by position in the element (all first
+//                     bytes, then all second bytes, ...), then compressed
+//                     with a small LZ77 coder; smooth or low-entropy data
+//                     turns into long runs of equal bytes
+//   delta_shuffle_lz  integers only: differences of consecutive elements
+//                     first, which makes counters and sorted ids nearly
+//                     constant
+// A chunk that does not shrink is stored as it is, so compression never
+// costs space.
+
+enum class Chunk_codec : std::uint32_t { none, shuffle_lz, delta_shuffle_lz };
+
+namespace matrix_impl {
+
+inline constexpr char chunk_magic[8] = {'M', 'D', 'C', 'H', 'U', 'N', 'K', '1'};
+
+// magic, order, codec and the dtype string, then the extents and the chunk
+// extents, then (offset, bytes) for each chunk in row-major chunk order
+inline constexpr std::size_t chunk_prefix_size = 24;
+
+inline auto chunk_header_size(std::size_t order, std::size_t chunks)
+    -> std::size_t {
+  return chunk_prefix_size + 2 * order * 8 + chunks * 16;
+}
+
+inline auto put_varint(std::vector<unsigned char> &out, std::size_t v)
+    -> void {
+  while (v >= 0x80) {
+    out.push_back(static_cast<unsigned char>(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<unsigned char>(v));
+}
+
+inline auto get_varint(const unsigned char *&in, const unsigned char *end)
+    -> std::size_t {
+  std::size_t v = 0;
+  for (unsigned shift = 0; in != end && shift < 64; shift += 7) {
+    const unsigned char byte = *in++;
+    v |= std::size_t{byte & 0x7fU} << shift;
+    if ((byte & 0x80) == 0) {
+      return v;
+    }
+  }
+  throw std::runtime_error("chunked: corrupt chunk");
+}
+
+// LZ77 with a 4-byte hash of the last position seen: a stream of
+// (literal count, literals, match length - 4, match distance) sequences,
+// ending with a literal-only sequence
+inline auto lz_compress(const unsigned char *in, std::size_t n,
+                        std::vector<unsigned char> &out) -> void {
+  constexpr std::size_t min_match = 4;
+  constexpr std::size_t window = 1U << 16;
+  constexpr unsigned hash_bits = 12;
+  std::vector<std::size_t> last(std::size_t{1} << hash_bits, n);
+  const auto load = [in](std::size_t i) {
+    std::uint32_t v;
+    std::memcpy(&v, in + i, 4);
+    return v;
+  };
+  std::size_t anchor = 0;
+  std::size_t i = 0;
+  while (i + min_match <= n) {
+    const std::uint32_t v = load(i);
+    const std::size_t h = (v * 2654435761U) >> (32 - hash_bits);
+    const std::size_t cand = last[h];
+    last[h] = i;
+    if (cand == n || i - cand > window || load(cand) != v) {
+      ++i;
+      continue;
+    }
+    std::size_t len = min_match;
+    while (i + len < n && in[cand + len] == in[i + len]) {
+      ++len;
+    }
+    put_varint(out, i - anchor);
+    out.insert(out.end(), in + anchor, in + i);
+    put_varint(out, len - min_match);
+    put_varint(out, i - cand);
+    i += len;
+    anchor = i;
+  }
+  put_varint(out, n - anchor);
+  out.insert(out.end(), in + anchor, in + n);
+}
+
+inline auto lz_decompress(const unsigned char *in, std::size_t n,
+                          unsigned char *out, std::size_t out_size) -> void {
+  const unsigned char *end = in + n;
+  std::size_t o = 0;
+  while (true) {
+    const std::size_t literals = get_varint(in, end);
+    if (literals > static_cast<std::size_t>(end - in) ||
+        literals > out_size - o) {
+      throw std::runtime_error("chunked: corrupt chunk");
+    }
+    std::memcpy(out + o, in, literals);
+    in += literals;
+    o += literals;
+    if (o == out_size) {
+      return;
+    }
+    const std::size_t len = get_varint(in, end) + 4;
+    const std::size_t dist = get_varint(in, end);
+    if (dist == 0 || dist > o || len > out_size - o) {
+      throw std::runtime_error("chunked: corrupt chunk");
+    }
+    for (std::size_t k = 0; k < len; ++k, ++o) { // may overlap itself
+      out[o] = out[o - dist];
+    }
+  }
+}
+
+// out[b * n + i] = byte b of element i
+inline auto byte_shuffle(const unsigned char *in, std::size_t n,
+                         std::size_t width, unsigned char *out) -> void {
+  for (std::size_t i = 0; i < n; ++i) {
+    for (std::size_t b = 0; b < width; ++b) {
+      out[b * n + i] = in[i * width + b];
+    }
+  }
+}
+
+inline auto byte_unshuffle(const unsigned char *in, std::size_t n,
+                           std::size_t width, unsigned char *out) -> void {
+  for (std::size_t b = 0; b < width; ++b) {
+    for (std::size_t i = 0; i < n; ++i) {
+      out[i * width + b] = in[b * n + i];
+    }
+  }
+}
+
+// the stored form of n elements; the elements themselves when the codec
+// does not make them smaller
+template <typename T>
+auto encode_chunk(Chunk_codec codec, const T *elems, std::size_t n,
+                  std::vector<unsigned char> &out) -> void {
+  const auto *raw = reinterpret_cast<const unsigned char *>(elems);
+  const std::size_t bytes = n * sizeof(T);
+  out.clear();
+  if (codec != Chunk_codec::none) {
+    std::vector<unsigned char> shuffled(bytes);
+    if constexpr (std::is_integral_v<T>) {
+      if (codec == Chunk_codec::delta_shuffle_lz) {
+        using U = std::make_unsigned_t<T>;
+        std::vector<U> delta(n);
+        for (std::size_t i = 0; i < n; ++i) {
+          delta[i] = static_cast<U>(static_cast<U>(elems[i]) -
+                                    static_cast<U>(i ? elems[i - 1] : 0));
+        }
+        byte_shuffle(reinterpret_cast<const unsigned char *>(delta.data()), n,
+                     sizeof(T), shuffled.data());
+      }
+    }
+    if (codec == Chunk_codec::shuffle_lz) {
+      byte_shuffle(raw, n, sizeof(T), shuffled.data());
+    }
+    lz_compress(shuffled.data(), bytes, out);
+    if (out.size() < bytes) {
+      return;
+    }
+    out.clear();
+  }
+  out.assign(raw, raw + bytes);
+}
+
+template <typename T>
+auto decode_chunk(Chunk_codec codec, const unsigned char *in,
+                  std::size_t stored, T *elems, std::size_t n) -> void {
+  const std::size_t bytes = n * sizeof(T);
+  auto *raw = reinterpret_cast<unsigned char *>(elems);
+  if (stored == bytes) {
+    std::memcpy(raw, in, bytes);
+    return;
+  }
+  if (codec == Chunk_codec::none || stored > bytes) {
+    throw std::runtime_error("chunked: corrupt chunk");
+  }
+  std::vector<unsigned char> shuffled(bytes);
+  lz_decompress(in, stored, shuffled.data(), bytes);
+  byte_unshuffle(shuffled.data(), n, sizeof(T), raw);
+  if constexpr (std::is_integral_v<T>) {
+    if (codec == Chunk_codec::delta_shuffle_lz) {
+      using U = std::make_unsigned_t<T>;
+      U prev = 0;
+      for (std::size_t i = 0; i < n; ++i) {
+        U d;
+        std::memcpy(&d, raw + i * sizeof(T), sizeof(T));
+        prev = static_cast<U>(prev + d);
+        std::memcpy(raw + i * sizeof(T), &prev, sizeof(T));
+      }
+    }
+  }
+}
+
+inline auto pread_all(int fd, void *buf, std::size_t n, std::size_t offset)
+    -> void {
+  auto *p = static_cast<char *>(buf);
+  while (n > 0) {
+    const ssize_t got = ::pread(fd, p, n, static_cast<off_t>(offset));
+    if (got <= 0) {
+      throw std::runtime_error("chunked: read failed or file truncated");
+    }
+    p += got;
+    n -= static_cast<std::size_t>(got);
+    offset += static_cast<std::size_t>(got);
+  }
+}
+
+inline auto pwrite_all(int fd, const void *buf, std::size_t n,
+                       std::size_t offset) -> void {
+  const auto *p = static_cast<const char *>(buf);
+  while (n > 0) {
+    const ssize_t put = ::pwrite(fd, p, n, static_cast<off_t>(offset));
+    if (put <= 0) {
+      throw std::runtime_error("chunked: write failed");
+    }
+    p += put;
+    n -= static_cast<std::size_t>(put);
+    offset += static_cast<std::size_t>(put);
+  }
+}
+
+// the chunk grid of an array: chunks per dimension and the clipped extents
+// of a chunk
+template <std::size_t N> struct Chunk_grid {
+  std::array<std::size_t, N> extents{};
+  std::array<std::size_t, N> chunk{};
+
+  [[nodiscard]] auto chunks(std::size_t d) const -> std::size_t {
+    return (extents[d] + chunk[d] - 1) / chunk[d];
+  }
+  [[nodiscard]] auto count() const -> std::size_t {
+    std::size_t n = 1;
+    for (std::size_t d = 0; d < N; ++d) {
+      n *= chunks(d);
+    }
+    return n;
+  }
+  // position of a chunk in the index
+  [[nodiscard]] auto linear(const std::array<std::size_t, N> &c) const
+      -> std::size_t {
+    std::size_t k = 0;
+    for (std::size_t d = 0; d < N; ++d) {
+      assert(c[d] < chunks(d));
+      k = k * chunks(d) + c[d];
+    }
+    return k;
+  }
+  [[nodiscard]] auto tile(const std::array<std::size_t, N> &c) const
+      -> std::array<std::size_t, N> {
+    std::array<std::size_t, N> t{};
+    for (std::size_t d = 0; d < N; ++d) {
+      t[d] = std::min(chunk[d], extents[d] - c[d] * chunk[d]);
+    }
+    return t;
+  }
+};
+
+template <std::size_t N>
+auto dense_slice(const std::array<std::size_t, N> &extents)
+    -> Matrix_slice<N> {
+  Matrix_slice<N> desc;
+  desc.start = 0;
+  desc.extents = extents;
+  desc.strides = computing_stride<N>(extents);
+  desc.size = computing_size<N>(extents);
+  return desc;
+}
+
+// the half-open range [first, last) picked by one subscript of read()
+inline auto chunk_range(std::size_t i) -> std::pair<std::size_t, std::size_t> {
+  return {i, i + 1};
+}
+inline auto chunk_range(const Slice &s)
+    -> std::pair<std::size_t, std::size_t> {
+  return {s.i, s.j};
+}
+
+class File_descriptor {
+public:
+  File_descriptor(const std::string &path, int flags) {
+    fd = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("chunked: cannot open " + path);
+    }
+  }
+  File_descriptor(const File_descriptor &) = delete;
+  auto operator=(const File_descriptor &) -> File_descriptor & = delete;
+  File_descriptor(File_descriptor &&other) noexcept
+      : fd{std::exchange(other.fd, -1)} {}
+  auto operator=(File_descriptor &&other) noexcept -> File_descriptor & {
+    std::swap(fd, other.fd);
+    return *this;
+  }
+  ~File_descriptor() { reset(); }
+
+  auto reset() -> int {
+    const int result = fd < 0 ? 0 : ::close(fd);
+    fd = -1;
+    return result;
+  }
+  [[nodiscard]] auto get() const -> int { return fd; }
+
+private:
+  int fd = -1;
+};
+
+} // namespace matrix_impl
+
+// Writes a chunked file one chunk, or one slab of chunk rows, at a time;
+// only the chunk index stays in memory. The index goes into the header on
+// close(), which the destructor calls if nobody did.
+template <typename T, std::size_t N> class Chunked_writer {
+  static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>,
+                "chunked files hold numbers");
+
+public:
+  Chunked_writer(const std::string &path,
+                 const std::array<std::size_t, N> &extents,
+                 const std::array<std::size_t, N> &chunk_extents,
+                 Chunk_codec codec = Chunk_codec::none)
+      : grid{extents, chunk_extents}, codec{codec},
+        file{path, O_WRONLY | O_CREAT | O_TRUNC} {
+    for (std::size_t d = 0; d < N; ++d) {
+      if (chunk_extents[d] == 0) {
+        throw std::invalid_argument("Chunked_writer: empty chunk extent");
+      }
+    }
+    if (codec == Chunk_codec::delta_shuffle_lz && !std::is_integral_v<T>) {
+      throw std::invalid_argument(
+          "Chunked_writer: delta coding needs integer elements");
+    }
+    index.assign(2 * grid.count(), 0);
+    end = matrix_impl::chunk_header_size(N, grid.count());
+  }
+
+  Chunked_writer(const Chunked_writer &) = delete;
+  auto operator=(const Chunked_writer &) -> Chunked_writer & = delete;
+
+  ~Chunked_writer() {
+    try {
+      close();
+    } catch (...) { // call close() to see errors
+    }
+  }
+
+  // store the chunk at chunk coordinates c; tile has its clipped extents
+  template <typename M,
+            typename = Enable_if<matrix_impl::Is_matrix_v<M>, void>>
+  auto write_chunk(const std::array<std::size_t, N> &c, const M &tile)
+      -> void {
+    const auto m_r = matrix_impl::as_ref(tile);
+    static_assert(decltype(m_r)::order == N, "order must match");
+    const auto extents = grid.tile(c);
+    assert(m_r.descriptor().extents == extents);
+    const auto desc = matrix_impl::dense_slice<N>(extents);
+    elems.resize(desc.size);
+    matrix_impl::strided_copy(m_r, Matrix_ref<T, N>(desc, elems.data()));
+    matrix_impl::encode_chunk(codec, elems.data(), desc.size, stored);
+    matrix_impl::pwrite_all(file.get(), stored.data(), stored.size(), end);
+    const std::size_t k = grid.linear(c);
+    index[2 * k] = end;
+    index[2 * k + 1] = stored.size();
+    end += stored.size();
+  }
+
+  // store the next slab.extent(0) rows of the array; every slab but the
+  // last must cover whole chunk rows
+  template <typename M,
+            typename = Enable_if<matrix_impl::Is_matrix_v<M>, void>>
+  auto append(const M &slab) -> void {
+    const auto m_r = matrix_impl::as_ref(slab);
+    const auto &desc = m_r.descriptor();
+    const std::size_t rows = desc.extents[0];
+    assert(rows_written % grid.chunk[0] == 0);
+    assert(rows_written + rows <= grid.extents[0]);
+    assert(rows % grid.chunk[0] == 0 ||
+           rows_written + rows == grid.extents[0]);
+    for (std::size_t d = 1; d < N; ++d) {
+      assert(desc.extents[d] == grid.extents[d]);
+    }
+    // every chunk of the slab, in row-major chunk order
+    std::array<std::size_t, N> c{};
+    c[0] = rows_written / grid.chunk[0];
+    const std::size_t last_row = (rows_written + rows + grid.chunk[0] - 1) /
+                                 grid.chunk[0];
+    while (c[0] < last_row) {
+      Matrix_slice<N> part = desc;
+      const auto extents = grid.tile(c);
+      for (std::size_t d = 0; d < N; ++d) {
+        const std::size_t first =
+            c[d] * grid.chunk[d] - (d == 0 ? rows_written : 0);
+        part.start += first * desc.strides[d];
+        part.extents[d] = extents[d];
+      }
+      part.size = matrix_impl::computing_size<N>(part.extents);
+      write_chunk(c, Matrix_ref<const T, N>(part, m_r.pointer()));
+      std::size_t d = N - 1;
+      while (d > 0 && ++c[d] == grid.chunks(d)) {
+        c[d--] = 0;
+      }
+      if (d == 0) {
+        ++c[0];
+      }
+    }
+    rows_written += rows;
+  }
+
+  // write the header; further writes are not allowed
+  auto close() -> void {
+    if (file.get() < 0) {
+      return;
+    }
+    std::vector<unsigned char> header(
+        matrix_impl::chunk_header_size(N, grid.count()));
+    unsigned char *p = header.data();
+    std::memcpy(p, matrix_impl::chunk_magic, 8);
+    const std::uint32_t order = N;
+    const auto codec_id = static_cast<std::uint32_t>(codec);
+    std::memcpy(p + 8, &order, 4);
+    std::memcpy(p + 12, &codec_id, 4);
+    const std::string descr = matrix_impl::npy_descr<T>();
+    std::memcpy(p + 16, descr.data(), std::min<std::size_t>(descr.size(), 8));
+    p += matrix_impl::chunk_prefix_size;
+    for (const auto *dims : {&grid.extents, &grid.chunk}) {
+      for (std::size_t d = 0; d < N; ++d, p += 8) {
+        const std::uint64_t v = (*dims)[d];
+        std::memcpy(p, &v, 8);
+      }
+    }
+    std::memcpy(p, index.data(), index.size() * 8);
+    matrix_impl::pwrite_all(file.get(), header.data(), header.size(), 0);
+    if (file.reset() != 0) {
+      throw std::runtime_error("chunked: close failed");
+    }
+  }
+
+private:
+  matrix_impl::Chunk_grid<N> grid;
+  Chunk_codec codec;
+  matrix_impl::File_descriptor file;
+  std::vector<std::uint64_t> index; // (offset, bytes) per chunk
+  std::size_t end = 0;              // where the next chunk goes
+  std::size_t rows_written = 0;     // by append()
+  std::vector<T> elems;             // the chunk being encoded
+  std::vector<unsigned char> stored;
+};
+
+// A chunked file opened for reading. Only the header is read up front;
+// every read() fetches and decodes the chunks it intersects.
+template <typename T, std::size_t N> class Chunked_file {
+public:
+  explicit Chunked_file(const std::string &path) : file{path, O_RDONLY} {
+    unsigned char prefix[matrix_impl::chunk_prefix_size];
+    matrix_impl::pread_all(file.get(), prefix, sizeof(prefix), 0);
+    if (std::memcmp(prefix, matrix_impl::chunk_magic, 8) != 0) {
+      throw std::runtime_error("chunked: " + path + " is not a chunked file");
+    }
+    std::uint32_t order = 0;
+    std::uint32_t codec_id = 0;
+    std::memcpy(&order, prefix + 8, 4);
+    std::memcpy(&codec_id, prefix + 12, 4);
+    const std::string descr(reinterpret_cast<const char *>(prefix + 16),
+                            strnlen(reinterpret_cast<const char *>(prefix + 16),
+                                    8));
+    if (order != N || descr != matrix_impl::npy_descr<T>()) {
+      throw std::runtime_error("chunked: " + path + " holds " +
+                               std::to_string(order) + "-d " + descr +
+                               " elements");
+    }
+    if (codec_id > static_cast<std::uint32_t>(Chunk_codec::delta_shuffle_lz)) {
+      throw std::runtime_error("chunked: unknown codec");
+    }
+    codec_ = static_cast<Chunk_codec>(codec_id);
+
+    std::array<std::uint64_t, 2 * N> dims{};
+    matrix_impl::pread_all(file.get(), dims.data(), sizeof(dims),
+                           matrix_impl::chunk_prefix_size);
+    for (std::size_t d = 0; d < N; ++d) {
+      grid.extents[d] = dims[d];
+      grid.chunk[d] = dims[N + d];
+      if (grid.chunk[d] == 0) {
+        throw std::runtime_error("chunked: corrupt header");
+      }
+    }
+    index.resize(2 * grid.count());
+    matrix_impl::pread_all(file.get(), index.data(), index.size() * 8,
+                           matrix_impl::chunk_prefix_size + sizeof(dims));
+  }
+
+  [[nodiscard]] auto extents() const -> const std::array<std::size_t, N> & {
+    return grid.extents;
+  }
+  [[nodiscard]] auto chunk_extents() const
+      -> const std::array<std::size_t, N> & {
+    return grid.chunk;
+  }
+  [[nodiscard]] auto codec() const -> Chunk_codec { return codec_; }
+  // stored (possibly compressed) bytes read by this object so far
+  [[nodiscard]] auto bytes_read() const -> std::size_t { return bytes; }
+
+  // the chunk at chunk coordinates c
+  auto read_chunk(const std::array<std::size_t, N> &c) -> Matrix<T, N> {
+    Matrix<T, N> tile(grid.tile(c));
+    load(grid.linear(c), tile.data(), tile.size());
+    return tile;
+  }
+
+  // the whole array
+  auto read() -> Matrix<T, N> {
+    std::array<std::size_t, N> first{};
+    return read_box(first, grid.extents);
+  }
+
+  // part of the array; one index or Slice per dimension
+  template <typename... Args>
+  auto read(const Args &...args)
+      -> Enable_if<sizeof...(Args) == N &&
+                       matrix_impl::All((std::is_convertible_v<Args,
+                                                               std::size_t> ||
+                                         std::is_same_v<Args, Slice>)...),
+                   Matrix<T, N>> {
+    std::array<std::size_t, N> first{};
+    std::array<std::size_t, N> last{};
+    std::size_t d = 0;
+    (
+        [&](const auto &s) {
+          std::tie(first[d], last[d]) = matrix_impl::chunk_range(s);
+          ++d;
+        }(args),
+        ...);
+    return read_box(first, last);
+  }
+
+private:
+  // decode chunk k into n elements at out
+  auto load(std::size_t k, T *out, std::size_t n) -> void {
+    const std::size_t offset = index[2 * k];
+    const std::size_t size = index[2 * k + 1];
+    if (size == 0) { // never written
+      std::fill(out, out + n, T{});
+      return;
+    }
+    stored.resize(size);
+    matrix_impl::pread_all(file.get(), stored.data(), size, offset);
+    bytes += size;
+    matrix_impl::decode_chunk(codec_, stored.data(), size, out, n);
+  }
+
+  auto read_box(const std::array<std::size_t, N> &first,
+                const std::array<std::size_t, N> &last) -> Matrix<T, N> {
+    std::array<std::size_t, N> out_extents{};
+    std::array<std::size_t, N> c{};
+    std::array<std::size_t, N> c_first{};
+    std::array<std::size_t, N> c_last{};
+    for (std::size_t d = 0; d < N; ++d) {
+      assert(first[d] <= last[d] && last[d] <= grid.extents[d]);
+      out_extents[d] = last[d] - first[d];
+      if (out_extents[d] == 0) {
+        return Matrix<T, N>(out_extents);
+      }
+      c_first[d] = first[d] / grid.chunk[d];
+      c_last[d] = (last[d] - 1) / grid.chunk[d];
+    }
+    Matrix<T, N> out(out_extents);
+    const auto out_desc = matrix_impl::dense_slice<N>(out_extents);
+    c = c_first;
+    while (true) {
+      // the part of chunk c inside the box, in chunk and in box coordinates
+      const auto tile_extents = grid.tile(c);
+      const auto tile_desc = matrix_impl::dense_slice<N>(tile_extents);
+      Matrix_slice<N> src = tile_desc;
+      Matrix_slice<N> dst = out_desc;
+      for (std::size_t d = 0; d < N; ++d) {
+        const std::size_t origin = c[d] * grid.chunk[d];
+        const std::size_t lo = std::max(first[d], origin);
+        const std::size_t hi = std::min(last[d], origin + tile_extents[d]);
+        src.start += (lo - origin) * tile_desc.strides[d];
+        dst.start += (lo - first[d]) * out_desc.strides[d];
+        src.extents[d] = dst.extents[d] = hi - lo;
+      }
+      src.size = dst.size = matrix_impl::computing_size<N>(src.extents);
+      elems.resize(tile_desc.size);
+      load(grid.linear(c), elems.data(), tile_desc.size);
+      matrix_impl::strided_copy(Matrix_ref<const T, N>(src, elems.data()),
+                                Matrix_ref<T, N>(dst, out.data()));
+
+      std::size_t d = N;
+      while (d-- > 0) {
+        if (++c[d] <= c_last[d]) {
+          break;
+        }
+        c[d] = c_first[d];
+      }
+      if (d == std::size_t(-1)) {
+        return out;
+      }
+    }
+  }
+
+  matrix_impl::File_descriptor file;
+  matrix_impl::Chunk_grid<N> grid;
+  Chunk_codec codec_ = Chunk_codec::none;
+  std::vector<std::uint64_t> index; // (offset, bytes) per chunk
+  std::size_t bytes = 0;
+  std::vector<T> elems;              // the chunk being decoded
+  std::vector<unsigned char> stored; // its stored bytes
+};
@@ -0,0 +1,510 @@
+#pragma once
+
+#include "matrix.h"
+#include "matrix_execution.h"
+#include "matrix_gemm.h"
+#include "matrix_instrument.h"
+#include "matrix_simd.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// 2-D convolutions and stencils over image-like tensors.
+//
+//   conv2d(x, w, params)        x (C, H, W) or (N, C, H, W) with filters
+//                               w (K, C, R, S): a (K, Ho, Wo) or
+//                               (N, K, Ho, Wo) matrix
+//   stencil(x, k, params)       the same R x S weights k over every H x W
+//                               plane of x (the last two dimensions)
+//
+// Both are cross-correlations, as in deep-learning frameworks:
+//
+//   y(k, i, j) = sum over c, r, s of
+//     w(k, c, r, s) * x(c, i * sh + r * dh - ph, j * sw + s * dw - pw)
+//
+// where elements outside x read as zero. Conv_params holds the stride
+// (sh, sw), the zero padding on each side (ph, pw) and the dilation
+// (dh, dw), with Ho = (H + 2 ph - dh (R - 1) - 1) / sh + 1 and likewise Wo.
+// Operands are read through their strides, so a halo region sliced out of a
+// larger tensor is convolved in place.
+//
+// The direct kernel keeps two vector registers of outputs for each of 4
+// output channels and reuses every input element it loads for all four,
+// with the registers of the instruction set level in use (see
+// matrix_dispatch.h); it suits few input channels and stencils. With many
+// input channels conv2d turns each block of output rows into an im2col
+// matrix and multiplies the filters with it through gemm. Conv_algorithm
+// picks one explicitly.
+// Output rows are split across the thread pool under a parallel policy.
+// Invalid parameters or mismatched channels throw std::invalid_argument.
+
+enum class Conv_algorithm { automatic, direct, im2col };
+
+struct Conv_params {
+  std::array<std::size_t, 2> stride{1, 1};
+  std::array<std::size_t, 2> padding{0, 0}; // zeros on each side
+  std::array<std::size_t, 2> dilation{1, 1};
+  Conv_algorithm algorithm = Conv_algorithm::automatic;
+};
+
+namespace matrix_impl {
+
+// outputs per register tile of the direct kernel at level I (two packs),
+// and output channels
+template <typename T, Isa I>
+inline constexpr std::size_t conv_tile =
+    simd::Isa_pack<T, I>::width > 1 ? 2 * simd::Isa_pack<T, I>::width : 16;
+inline constexpr std::size_t conv_channels = 4;
+// automatic chooses im2col from this many multiply-adds per output (64
+// channels of a 3 x 3 filter), where packed gemm overtakes the direct kernel
+inline constexpr std::size_t im2col_min_depth = 512;
+// bytes of im2col matrix built at a time
+inline constexpr std::size_t im2col_budget = std::size_t{4} << 20;
+
+struct Conv_geometry {
+  std::size_t channels, h, w; // input plane
+  std::size_t r, s;           // filter
+  std::size_t ho, wo;         // output plane
+  std::size_t sh, sw, ph, pw, dh, dw;
+};
+
+inline auto conv_geometry(std::size_t channels, std::size_t h, std::size_t w,
+                          std::size_t r, std::size_t s,
+                          const Conv_params &p, const char *caller)
+    -> Conv_geometry {
+  const auto fail = [&](const std::string &what) {
+    throw std::invalid_argument(std::string(caller) + ": " + what);
+  };
+  if (p.stride[0] == 0 || p.stride[1] == 0 || p.dilation[0] == 0 ||
+      p.dilation[1] == 0) {
+    fail("stride and dilation must be positive");
+  }
+  if (r == 0 || s == 0) {
+    fail("empty filter");
+  }
+  const std::size_t span_h = p.dilation[0] * (r - 1) + 1;
+  const std::size_t span_w = p.dilation[1] * (s - 1) + 1;
+  if (h + 2 * p.padding[0] < span_h || w + 2 * p.padding[1] < span_w) {
+    fail("the filter is larger than the padded input");
+  }
+  return {channels,
+          h,
+          w,
+          r,
+          s,
+          (h + 2 * p.padding[0] - span_h) / p.stride[0] + 1,
+          (w + 2 * p.padding[1] - span_w) / p.stride[1] + 1,
+          p.stride[0],
+          p.stride[1],
+          p.padding[0],
+          p.padding[1],
+          p.dilation[0],
+          p.dilation[1]};
+}
+
+// the output columns [first, last) whose input column j * sw + off - pw is
+// inside the input
+inline auto valid_columns(const Conv_geometry &g, std::size_t off)
+    -> std::pair<std::size_t, std::size_t> {
+  const std::size_t first =
+      g.pw > off ? (g.pw - off + g.sw - 1) / g.sw : 0;
+  const std::size_t last =
+      g.w + g.pw > off ? (g.w + g.pw - off + g.sw - 1) / g.sw : 0;
+  return {std::min(first, g.wo), std::min(last, g.wo)};
+}
+
+MATRIX_DESIGN_BEGIN_INLINE_VECTORS
+
+// KB output channels times WT outputs from column j0 of output row i, for
+// a tile whose input columns are all inside x: the accumulators stay in
+// registers, and Unit when the columns the tile reads are contiguous
+template <Isa I, std::size_t KB, bool Unit, typename T>
+MATRIX_DESIGN_ALWAYS_INLINE inline auto
+conv_direct_tile(const Conv_geometry &g, const T *x, std::size_t xc,
+                 std::size_t xh, std::size_t xw, const T *w, T *out,
+                 std::size_t ok, std::size_t i, std::size_t j0) -> void {
+  constexpr std::size_t WT = conv_tile<T, I>;
+  const std::size_t filter = g.channels * g.r * g.s;
+  if constexpr (Unit && simd::Isa_pack<T, I>::width > 1) {
+    using P = simd::Isa_pack<T, I>;
+    constexpr std::size_t NV = WT / P::width;
+    typename P::type acc[KB][NV];
+    for (std::size_t kb = 0; kb < KB; ++kb) {
+      for (std::size_t v = 0; v < NV; ++v) {
+        acc[kb][v] = P::set1(T{});
+      }
+    }
+    for (std::size_t c = 0; c < g.channels; ++c) {
+      for (std::size_t r = 0; r < g.r; ++r) {
+        const std::size_t row = i * g.sh + r * g.dh;
+        if (row < g.ph || row - g.ph >= g.h) {
+          continue;
+        }
+        const T *x_row = x + c * xc + (row - g.ph) * xh + j0 - g.pw;
+        const T *w_rs = w + (c * g.r + r) * g.s;
+        for (std::size_t s = 0; s < g.s; ++s) {
+          const T *xs = x_row + s * g.dw;
+          typename P::type xv[NV];
+          for (std::size_t v = 0; v < NV; ++v) {
+            xv[v] = P::load(xs + v * P::width);
+          }
+          for (std::size_t kb = 0; kb < KB; ++kb) {
+            const auto wv = P::set1(w_rs[kb * filter + s]);
+            for (std::size_t v = 0; v < NV; ++v) {
+              acc[kb][v] = P::add(acc[kb][v], P::mul(wv, xv[v]));
+            }
+          }
+        }
+      }
+    }
+    for (std::size_t kb = 0; kb < KB; ++kb) {
+      for (std::size_t v = 0; v < NV; ++v) {
+        P::store(out + kb * ok + i * g.wo + j0 + v * P::width, acc[kb][v]);
+      }
+    }
+    return;
+  }
+  const std::size_t step = g.sw * xw;
+  T acc[KB][WT] = {};
+  for (std::size_t c = 0; c < g.channels; ++c) {
+    for (std::size_t r = 0; r < g.r; ++r) {
+      const std::size_t row = i * g.sh + r * g.dh;
+      if (row < g.ph || row - g.ph >= g.h) {
+        continue;
+      }
+      const T *x_row = x + c * xc + (row - g.ph) * xh +
+                       (j0 * g.sw - g.pw) * xw;
+      const T *w_rs = w + (c * g.r + r) * g.s;
+      for (std::size_t s = 0; s < g.s; ++s) {
+        const T *xs = x_row + s * g.dw * xw;
+        for (std::size_t kb = 0; kb < KB; ++kb) {
+          const T wv = w_rs[kb * filter + s];
+          for (std::size_t j = 0; j < WT; ++j) {
+            acc[kb][j] += wv * (Unit ? xs[j] : xs[j * step]);
+          }
+        }
+      }
+    }
+  }
+  for (std::size_t kb = 0; kb < KB; ++kb) {
+    std::copy(acc[kb], acc[kb] + WT, out + kb * ok + i * g.wo + j0);
+  }
+}
+
+// the same for the n <= WT outputs of a tile that reads padding: each
+// filter column only adds into the outputs whose input is inside x
+template <Isa I, std::size_t KB, bool Unit, typename T>
+auto conv_border_tile(const Conv_geometry &g, const T *x, std::size_t xc,
+                      std::size_t xh, std::size_t xw, const T *w, T *out,
+                      std::size_t ok, std::size_t i, std::size_t j0,
+                      std::size_t n) -> void {
+  constexpr std::size_t WT = conv_tile<T, I>;
+  const std::size_t filter = g.channels * g.r * g.s;
+  const std::size_t step = g.sw * xw;
+  T acc[KB][WT] = {};
+  for (std::size_t c = 0; c < g.channels; ++c) {
+    for (std::size_t r = 0; r < g.r; ++r) {
+      const std::size_t row = i * g.sh + r * g.dh;
+      if (row < g.ph || row - g.ph >= g.h) {
+        continue;
+      }
+      const T *x_row = x + c * xc + (row - g.ph) * xh;
+      const T *w_rs = w + (c * g.r + r) * g.s;
+      for (std::size_t s = 0; s < g.s; ++s) {
+        const std::size_t off = s * g.dw;
+        const auto [first, last] = valid_columns(g, off);
+        const std::size_t lo = std::clamp(first, j0, j0 + n) - j0;
+        const std::size_t hi = std::clamp(last, j0 + lo, j0 + n) - j0;
+        if (lo == hi) {
+          continue;
+        }
+        const T *xs = x_row + ((j0 + lo) * g.sw + off - g.pw) * xw;
+        for (std::size_t kb = 0; kb < KB; ++kb) {
+          const T wv = w_rs[kb * filter + s];
+          for (std::size_t j = lo; j < hi; ++j) {
+            acc[kb][j] += wv * (Unit ? xs[j - lo] : xs[(j - lo) * step]);
+          }
+        }
+      }
+    }
+  }
+  for (std::size_t kb = 0; kb < KB; ++kb) {
+    std::copy(acc[kb], acc[kb] + n, out + kb * ok + i * g.wo + j0);
+  }
+}
+
+// output row i of KB output channels: out[kb][i][j] for every j, from the
+// input x (channel, row and column strides xc, xh, xw) and KB dense
+// filters of channels * r * s weights starting at w
+template <Isa I, std::size_t KB, bool Unit, typename T>
+MATRIX_DESIGN_ALWAYS_INLINE inline auto
+conv_direct_row(const Conv_geometry &g, const T *x, std::size_t xc,
+                std::size_t xh, std::size_t xw, const T *w, T *out,
+                std::size_t ok, std::size_t i) -> void {
+  constexpr std::size_t WT = conv_tile<T, I>;
+  // [lo, hi): the outputs whose input columns are inside x for every s
+  const std::size_t lo = valid_columns(g, 0).first;
+  const std::size_t hi = valid_columns(g, (g.s - 1) * g.dw).second;
+  const auto border = [&](std::size_t first, std::size_t last) {
+    for (std::size_t j0 = first; j0 < last; j0 += WT) {
+      conv_border_tile<I, KB, Unit>(g, x, xc, xh, xw, w, out, ok, i, j0,
+                                 std::min(WT, last - j0));
+    }
+  };
+  if (hi < lo + WT) {
+    border(0, g.wo);
+    return;
+  }
+  border(0, lo);
+  for (std::size_t j0 = lo; j0 < hi; j0 += WT) {
+    // the last tile ends at hi, recomputing a few outputs
+    conv_direct_tile<I, KB, Unit>(g, x, xc, xh, xw, w, out, ok, i,
+                                  std::min(j0, hi - WT));
+  }
+  border(hi, g.wo);
+}
+
+// the same at the level in use
+template <std::size_t KB, typename T>
+auto conv_direct_row(const Conv_geometry &g, const T *x, std::size_t xc,
+                     std::size_t xh, std::size_t xw, const T *w, T *out,
+                     std::size_t ok, std::size_t i) -> void {
+  dispatch([&](auto isa) MATRIX_DESIGN_ALWAYS_INLINE {
+    constexpr Isa I = decltype(isa)::value;
+    if (g.sw * xw == 1) {
+      conv_direct_row<I, KB, true>(g, x, xc, xh, xw, w, out, ok, i);
+    } else {
+      conv_direct_row<I, KB, false>(g, x, xc, xh, xw, w, out, ok, i);
+    }
+  });
+}
+
+MATRIX_DESIGN_END_INLINE_VECTORS
+
+// every output row of k filters over one image; out is dense (k, ho, wo)
+template <typename Policy, typename T>
+auto conv_direct(const Policy &policy, const Conv_geometry &g, const T *x,
+                 std::size_t xc, std::size_t xh, std::size_t xw, const T *w,
+                 std::size_t k, T *out) -> void {
+  constexpr std::size_t KB = conv_channels;
+  const std::size_t filter = g.channels * g.r * g.s;
+  const std::size_t plane = g.ho * g.wo;
+  const std::size_t blocks = (k + KB - 1) / KB;
+  for_each_row_block(
+      policy, blocks * g.ho, KB * g.wo * filter,
+      [&](std::size_t first, std::size_t last) {
+        for (std::size_t t = first; t < last; ++t) {
+          const std::size_t k0 = t / g.ho * KB;
+          const std::size_t i = t % g.ho;
+          if (k0 + KB <= k) {
+            conv_direct_row<KB>(g, x, xc, xh, xw, w + k0 * filter,
+                                out + k0 * plane, plane, i);
+            continue;
+          }
+          for (std::size_t kk = k0; kk < k; ++kk) {
+            conv_direct_row<1>(g, x, xc, xh, xw, w + kk * filter,
+                               out + kk * plane, plane, i);
+          }
+        }
+      });
+}
+
+// out (k, ho, wo) = w (k x channels * r * s) times the im2col matrix of x,
+// built a block of output rows at a time
+template <typename Policy, typename T>
+auto conv_im2col(const Policy &policy, const Conv_geometry &g, const T *x,
+                 std::size_t xc, std::size_t xh, std::size_t xw, const T *w,
+                 std::size_t k, T *out) -> void {
+  const std::size_t depth = g.channels * g.r * g.s;
+  const std::size_t plane = g.ho * g.wo;
+  const std::size_t rows = std::clamp<std::size_t>(
+      im2col_budget / (sizeof(T) * depth * g.wo), 1, g.ho);
+  std::vector<T> col(depth * rows * g.wo);
+  for (std::size_t i0 = 0; i0 < g.ho; i0 += rows) {
+    const std::size_t m = std::min(rows, g.ho - i0);
+    const std::size_t cols = m * g.wo;
+    // row q = (c, r, s) of col holds x(c, i * sh + r * dh - ph,
+    // j * sw + s * dw - pw) for every output (i, j) of the block
+    for_each_row_block(
+        policy, depth, cols, [&](std::size_t first, std::size_t last) {
+          for (std::size_t q = first; q < last; ++q) {
+            const std::size_t c = q / (g.r * g.s);
+            const std::size_t r = q / g.s % g.r;
+            const std::size_t off = q % g.s * g.dw;
+            const auto [lo, hi] = valid_columns(g, off);
+            T *dst = col.data() + q * cols;
+            for (std::size_t i = i0; i < i0 + m; ++i, dst += g.wo) {
+              const std::size_t row = i * g.sh + r * g.dh;
+              if (row < g.ph || row - g.ph >= g.h || lo >= hi) {
+                std::fill(dst, dst + g.wo, T{});
+                continue;
+              }
+              const T *src = x + c * xc + (row - g.ph) * xh;
+              std::fill(dst, dst + lo, T{});
+              for (std::size_t j = lo; j < hi; ++j) {
+                dst[j] = src[(j * g.sw + off - g.pw) * xw];
+              }
+              std::fill(dst + hi, dst + g.wo, T{});
+            }
+          }
+        });
+    gemm(policy, k, cols, depth, T{1}, w, depth, std::size_t{1}, col.data(),
+         cols, std::size_t{1}, T{0}, out + i0 * g.wo, plane, std::size_t{1});
+  }
+}
+
+// the offset of H x W plane p of m, counting planes over the leading
+// dimensions in row-major order
+template <typename T, std::size_t N>
+auto plane_offset(const Matrix_ref<T, N> &m_r, std::size_t p) -> std::size_t {
+  const auto &d = m_r.descriptor();
+  std::size_t offset = d.start;
+  for (std::size_t dim = N - 2; dim-- > 0;) {
+    offset += p % d.extents[dim] * d.strides[dim];
+    p /= d.extents[dim];
+  }
+  return offset;
+}
+
+template <typename X>
+using Enable_if_conv_input =
+    Enable_if<Is_matrix_v<X> && (std::remove_cv_t<X>::order == 3 ||
+                                 std::remove_cv_t<X>::order == 4),
+              void>;
+
+template <typename W>
+using Enable_if_filters =
+    Enable_if<Is_matrix_v<W> && (std::remove_cv_t<W>::order == 4), void>;
+
+template <typename X>
+using Enable_if_planes =
+    Enable_if<Is_matrix_v<X> && (std::remove_cv_t<X>::order >= 2), void>;
+
+} // namespace matrix_impl
+
+template <typename Policy, typename X, typename W,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy>,
+                               void>,
+          typename = matrix_impl::Enable_if_conv_input<X>,
+          typename = matrix_impl::Enable_if_filters<W>>
+auto conv2d(const Policy &policy, const X &x, const W &w,
+            const Conv_params &params = {})
+    -> Matrix<matrix_impl::Value_type<X>, std::remove_cv_t<X>::order> {
+  using T = matrix_impl::Value_type<X>;
+  constexpr std::size_t N = std::remove_cv_t<X>::order;
+  static_assert(std::is_same_v<T, matrix_impl::Value_type<W>>,
+                "conv2d operands must share an element type");
+  const matrix_impl::Kernel_scope scope(matrix_instrument::Kernel::conv);
+  const auto x_r = matrix_impl::as_ref(x);
+  const auto &dx = x_r.descriptor();
+  const std::size_t images = N == 4 ? dx.extents[0] : 1;
+  const std::size_t channels = dx.extents[N - 3];
+  // the filters as dense (k, c * r * s) rows
+  const Matrix<T, 4> filters(matrix_impl::as_ref(w));
+  const auto &dw = filters.descriptor().extents;
+  if (dw[1] != channels) {
+    throw std::invalid_argument(
+        "conv2d: the filters have " + std::to_string(dw[1]) +
+        " channels and the input " + std::to_string(channels));
+  }
+  const auto g = matrix_impl::conv_geometry(
+      channels, dx.extents[N - 2], dx.extents[N - 1], dw[2], dw[3], params,
+      "conv2d");
+  const std::size_t k = dw[0];
+  const std::size_t depth = channels * g.r * g.s;
+  // an empty im2col matrix (no channels) leaves the direct kernel to write
+  // the zeros
+  const bool im2col =
+      depth * g.wo != 0 &&
+      (params.algorithm == Conv_algorithm::im2col ||
+       (params.algorithm == Conv_algorithm::automatic &&
+        depth >= matrix_impl::im2col_min_depth));
+
+  std::array<std::size_t, N> extents{};
+  if constexpr (N == 4) {
+    extents = {images, k, g.ho, g.wo};
+  } else {
+    extents = {k, g.ho, g.wo};
+  }
+  Matrix<T, N> y(extents);
+  const std::size_t xn = N == 4 ? dx.strides[0] : 0;
+  for (std::size_t n = 0; n < images; ++n) {
+    const T *image = x_r.pointer() + dx.start + n * xn;
+    T *out = y.data() + n * k * g.ho * g.wo;
+    if (im2col) {
+      matrix_impl::conv_im2col(policy, g, image, dx.strides[N - 3],
+                               dx.strides[N - 2], dx.strides[N - 1],
+                               filters.data(), k, out);
+    } else {
+      matrix_impl::conv_direct(policy, g, image, dx.strides[N - 3],
+                               dx.strides[N - 2], dx.strides[N - 1],
+                               filters.data(), k, out);
+    }
+  }
+  return y;
+}
+
+template <typename X, typename W,
+          typename = matrix_impl::Enable_if_conv_input<X>,
+          typename = matrix_impl::Enable_if_filters<W>>
+auto conv2d(const X &x, const W &w, const Conv_params &params = {})
+    -> Matrix<matrix_impl::Value_type<X>, std::remove_cv_t<X>::order> {
+  return conv2d(matrix_execution::seq, x, w, params);
+}
+
+// the R x S weights k over every H x W plane of x; the algorithm in params
+// is ignored (always direct)
+template <typename Policy, typename X, typename K,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy>,
+                               void>,
+          typename = matrix_impl::Enable_if_planes<X>,
+          typename = matrix_impl::Enable_if_matrix_2d<K>>
+auto stencil(const Policy &policy, const X &x, const K &k,
+             const Conv_params &params = {})
+    -> Matrix<matrix_impl::Value_type<X>, std::remove_cv_t<X>::order> {
+  using T = matrix_impl::Value_type<X>;
+  constexpr std::size_t N = std::remove_cv_t<X>::order;
+  static_assert(std::is_same_v<T, matrix_impl::Value_type<K>>,
+                "stencil operands must share an element type");
+  const matrix_impl::Kernel_scope scope(matrix_instrument::Kernel::conv);
+  const auto x_r = matrix_impl::as_ref(x);
+  const auto &dx = x_r.descriptor();
+  const Matrix<T, 2> weights(matrix_impl::as_ref(k));
+  const auto g = matrix_impl::conv_geometry(
+      1, dx.extents[N - 2], dx.extents[N - 1], weights.extent(0),
+      weights.extent(1), params, "stencil");
+  std::array<std::size_t, N> extents = dx.extents;
+  extents[N - 2] = g.ho;
+  extents[N - 1] = g.wo;
+  Matrix<T, N> y(extents);
+  // counted over the leading extents, as an input plane may be empty
+  std::size_t planes = 1;
+  for (std::size_t d = 0; d + 2 < N; ++d) {
+    planes *= dx.extents[d];
+  }
+  const std::size_t plane = g.ho * g.wo;
+  matrix_impl::for_each_row_block(
+      policy, planes * g.ho, g.wo * g.r * g.s,
+      [&](std::size_t first, std::size_t last) {
+        for (std::size_t t = first; t < last; ++t) {
+          const std::size_t p = t / g.ho;
+          matrix_impl::conv_direct_row<1>(
+              g, x_r.pointer() + matrix_impl::plane_offset(x_r, p), 0,
+              dx.strides[N - 2], dx.strides[N - 1], weights.data(),
+              y.data() + p * plane, plane, t % g.ho);
+        }
+      });
+  return y;
+}
+
+template <typename X, typename K,
+          typename = matrix_impl::Enable_if_planes<X>,
+          typename = matrix_impl::Enable_if_matrix_2d<K>>
+auto stencil(const X &x, const K &k, const Conv_params &params = {})
+    -> Matrix<matrix_impl::Value_type<X>, std::remove_cv_t<X>::order> {
+  return stencil(matrix_execution::seq, x, k, params);
+}
@@ -0,0 +1,469 @@
+#pragma once
+
+#include "common.h"
+#include "matrix_dispatch.h"
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Reduced-precision element types and conversions between element types.
+//
+//   float16, bfloat16        16-bit storage types: IEEE half precision, and
+//                            the upper half of a float (same range, 8-bit
+//                            mantissa)
+//   Compute_type<T>          the type arithmetic on T is done in: float for
+//                            the 16-bit types, T otherwise
+//   Matrix<float16, 2> h(m)  any Matrix(Matrix_ref<U, N>) converts
+//
+// Both types convert implicitly to float and from float and double,
+// rounding to the nearest even value (a double is rounded once, not through
+// float), so they can be stored into and read out of like the built-in
+// types; there is no arithmetic on them. Reductions accumulate
+// them in float and gemm widens them to float while packing, which is where
+// halving the bytes per element pays off.
+//
+// Contiguous runs between double, float, int32, float16 and bfloat16 are
+// converted with vector instructions (AVX-512, F16C and AVX2, or SSE2,
+// whichever level matrix_dispatch picked) and one element at a time
+// otherwise, with the same results either way. Conversions to int32
+// truncate like static_cast.
+
+namespace matrix_impl {
+
+// float <-> IEEE half, round to nearest even; NaNs stay (quiet) NaNs
+constexpr auto float_to_half_bits(float f) -> std::uint16_t {
+  const auto x = std::bit_cast<std::uint32_t>(f);
+  const std::uint32_t sign = (x >> 16) & 0x8000U;
+  const std::uint32_t abs = x & 0x7FFFFFFFU;
+  if (abs >= 0x7F800000U) { // infinity or NaN
+    const std::uint32_t nan = abs > 0x7F800000U ? 0x200U | (abs >> 13) : 0U;
+    return static_cast<std::uint16_t>(sign | 0x7C00U | (nan & 0x3FFU));
+  }
+  if (abs >= 0x477FF000U) { // rounds past 65504
+    return static_cast<std::uint16_t>(sign | 0x7C00U);
+  }
+  if (abs < 0x38800000U) {
+    // below 2^-14 the result is subnormal: adding 0.5 leaves the value in
+    // units of 2^-24 in the low mantissa bits, rounded by the FPU
+    const float v = std::bit_cast<float>(abs) + 0.5F;
+    return static_cast<std::uint16_t>(
+        sign | (std::bit_cast<std::uint32_t>(v) - 0x3F000000U));
+  }
+  // rebias the exponent and round the mantissa from 23 to 10 bits
+  const std::uint32_t odd = (abs >> 13) & 1U;
+  return static_cast<std::uint16_t>(
+      sign | ((abs - 0x38000000U + 0xFFFU + odd) >> 13));
+}
+
+constexpr auto half_bits_to_float(std::uint16_t h) -> float {
+  const std::uint32_t sign = std::uint32_t{h & 0x8000U} << 16;
+  const std::uint32_t abs = h & 0x7FFFU;
+  if (abs >= 0x7C00U) {
+    return std::bit_cast<float>(sign | 0x7F800000U | ((abs & 0x3FFU) << 13));
+  }
+  if (abs < 0x400U) { // subnormal: abs units of 2^-24
+    const float v = static_cast<float>(abs) * 0x1p-24F;
+    return sign != 0 ? -v : v;
+  }
+  return std::bit_cast<float>(sign | ((abs << 13) + 0x38000000U));
+}
+
+// float <-> bfloat16: round to nearest even, NaNs stay (quiet) NaNs
+constexpr auto float_to_bfloat16_bits(float f) -> std::uint16_t {
+  const auto x = std::bit_cast<std::uint32_t>(f);
+  if ((x & 0x7FFFFFFFU) > 0x7F800000U) {
+    return static_cast<std::uint16_t>((x >> 16) | 0x40U);
+  }
+  return static_cast<std::uint16_t>((x + 0x7FFFU + ((x >> 16) & 1U)) >> 16);
+}
+
+constexpr auto bfloat16_bits_to_float(std::uint16_t b) -> float {
+  return std::bit_cast<float>(std::uint32_t{b} << 16);
+}
+
+// double -> float rounded to odd: truncated, with the lowest bit set when
+// digits were dropped. Rounding that to nearest even in a format at least
+// two bits narrower than float gives the double correctly rounded.
+constexpr auto double_to_float_odd(double d) -> float {
+  float f = static_cast<float>(d);
+  if (d != d) { // NaN
+    return f;
+  }
+  if ((f < 0.0F ? -f : f) > (d < 0.0 ? -d : d)) { // rounded away from zero
+    f = std::bit_cast<float>(std::bit_cast<std::uint32_t>(f) - 1U);
+  }
+  if (static_cast<double>(f) != d) {
+    f = std::bit_cast<float>(std::bit_cast<std::uint32_t>(f) | 1U);
+  }
+  return f;
+}
+
+} // namespace matrix_impl
+
+struct float16 {
+  std::uint16_t bits = 0;
+
+  constexpr float16() = default;
+  constexpr float16(float f) // NOLINT: converts like the built-in types
+      : bits{matrix_impl::float_to_half_bits(f)} {}
+  template <typename D, typename = Enable_if<std::is_same_v<D, double>, void>>
+  constexpr float16(D d) // NOLINT
+      : bits{matrix_impl::float_to_half_bits(
+            matrix_impl::double_to_float_odd(d))} {}
+  constexpr operator float() const { // NOLINT
+    return matrix_impl::half_bits_to_float(bits);
+  }
+
+  static constexpr auto from_bits(std::uint16_t b) -> float16 {
+    float16 h;
+    h.bits = b;
+    return h;
+  }
+};
+
+struct bfloat16 {
+  std::uint16_t bits = 0;
+
+  constexpr bfloat16() = default;
+  constexpr bfloat16(float f) // NOLINT: converts like the built-in types
+      : bits{matrix_impl::float_to_bfloat16_bits(f)} {}
+  template <typename D, typename = Enable_if<std::is_same_v<D, double>, void>>
+  constexpr bfloat16(D d) // NOLINT
+      : bits{matrix_impl::float_to_bfloat16_bits(
+            matrix_impl::double_to_float_odd(d))} {}
+  constexpr operator float() const { // NOLINT
+    return matrix_impl::bfloat16_bits_to_float(bits);
+  }
+
+  static constexpr auto from_bits(std::uint16_t b) -> bfloat16 {
+    bfloat16 h;
+    h.bits = b;
+    return h;
+  }
+};
+
+namespace matrix_impl {
+
+template <typename T>
+inline constexpr bool Is_half_v =
+    std::is_same_v<std::remove_cv_t<T>, float16> ||
+    std::is_same_v<std::remove_cv_t<T>, bfloat16>;
+
+// arithmetic or one of the 16-bit types
+template <typename T>
+inline constexpr bool Is_number_v =
+    std::is_arithmetic_v<std::remove_cv_t<T>> || Is_half_v<T>;
+
+template <typename T> struct Compute_type_of {
+  using type = std::remove_cv_t<T>;
+};
+template <> struct Compute_type_of<float16> {
+  using type = float;
+};
+template <> struct Compute_type_of<bfloat16> {
+  using type = float;
+};
+
+} // namespace matrix_impl
+
+template <typename T>
+using Compute_type =
+    typename matrix_impl::Compute_type_of<std::remove_cv_t<T>>::type;
+
+namespace matrix_impl {
+
+// f(src + i, dst + i) for every whole block of W elements of [0, n);
+// returns the number of elements done
+template <std::size_t W, typename T, typename U, typename F>
+auto convert_blocks(std::size_t n, const U *src, T *dst, F f) -> std::size_t {
+  std::size_t i = 0;
+  for (; i + W <= n; i += W) {
+    f(src + i, dst + i);
+  }
+  return i;
+}
+
+#if defined(MATRIX_DESIGN_HAS_AVX2)
+// the bfloat16 of eight floats, each in the low half of an int32
+MATRIX_DESIGN_TARGET_AVX2 inline auto bfloat16_round(__m256i x) -> __m256i {
+  const __m256i odd =
+      _mm256_and_si256(_mm256_srli_epi32(x, 16), _mm256_set1_epi32(1));
+  const __m256i r =
+      _mm256_add_epi32(x, _mm256_add_epi32(_mm256_set1_epi32(0x7FFF), odd));
+  const __m256i abs = _mm256_and_si256(x, _mm256_set1_epi32(0x7FFFFFFF));
+  const __m256i nan = _mm256_cmpgt_epi32(abs, _mm256_set1_epi32(0x7F800000));
+  const __m256i quiet = _mm256_or_si256(x, _mm256_set1_epi32(0x400000));
+  return _mm256_srli_epi32(_mm256_blendv_epi8(r, quiet, nan), 16);
+}
+
+// the 16 bfloat16 of 16 floats; __m256i holds eight int32 each
+MATRIX_DESIGN_TARGET_AVX2 inline auto bfloat16_pack(__m256i lo, __m256i hi)
+    -> __m256i {
+  // packus interleaves the 128-bit lanes of its operands
+  return _mm256_permute4x64_epi64(
+      _mm256_packus_epi32(bfloat16_round(lo), bfloat16_round(hi)), 0xD8);
+}
+#endif
+
+// dst[i] = T(src[i]) for i in [0, n), with level I's instructions; the
+// AVX-512 conversions use all-ones masks, which compile to the unmasked
+// instructions without GCC 12's -Wmaybe-uninitialized warnings
+template <Isa I, typename T, typename U>
+auto convert_kernel(std::size_t n, const U *src, T *dst) -> void {
+  using S = std::remove_const_t<U>;
+  std::size_t i = 0;
+#if defined(MATRIX_DESIGN_X86)
+  if constexpr (std::is_same_v<T, float> && std::is_same_v<S, double>) {
+    if constexpr (I == Isa::avx512) {
+      i = convert_blocks<8>(
+          n, src, dst,
+          [](const double *s, float *d) MATRIX_DESIGN_TARGET_AVX512 {
+            _mm256_storeu_ps(d,
+                             _mm512_maskz_cvtpd_ps(0xFF, _mm512_loadu_pd(s)));
+          });
+    } else if constexpr (I == Isa::avx2) {
+      i = convert_blocks<4>(
+          n, src, dst, [](const double *s, float *d) MATRIX_DESIGN_TARGET_AVX2 {
+            _mm_storeu_ps(d, _mm256_cvtpd_ps(_mm256_loadu_pd(s)));
+          });
+    } else if constexpr (I == Isa::sse2) {
+      i = convert_blocks<4>(n, src, dst, [](const double *s, float *d) {
+        _mm_storeu_ps(d, _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(s)),
+                                       _mm_cvtpd_ps(_mm_loadu_pd(s + 2))));
+      });
+    }
+  } else if constexpr (std::is_same_v<T, double> && std::is_same_v<S, float>) {
+    if constexpr (I == Isa::avx512) {
+      i = convert_blocks<8>(
+          n, src, dst,
+          [](const float *s, double *d) MATRIX_DESIGN_TARGET_AVX512 {
+            _mm512_storeu_pd(
+                d, _mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(s)));
+          });
+    } else if constexpr (I == Isa::avx2) {
+      i = convert_blocks<4>(
+          n, src, dst, [](const float *s, double *d) MATRIX_DESIGN_TARGET_AVX2 {
+            _mm256_storeu_pd(d, _mm256_cvtps_pd(_mm_loadu_ps(s)));
+          });
+    } else if constexpr (I == Isa::sse2) {
+      i = convert_blocks<4>(n, src, dst, [](const float *s, double *d) {
+        const __m128 x = _mm_loadu_ps(s);
+        _mm_storeu_pd(d, _mm_cvtps_pd(x));
+        _mm_storeu_pd(d + 2, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+      });
+    }
+  } else if constexpr (std::is_same_v<T, std::int32_t> &&
+                       std::is_same_v<S, float>) {
+    if constexpr (I == Isa::avx512) {
+      i = convert_blocks<16>(
+          n, src, dst,
+          [](const float *s, std::int32_t *d) MATRIX_DESIGN_TARGET_AVX512 {
+            _mm512_storeu_si512(d, _mm512_maskz_cvttps_epi32(
+                                       0xFFFF, _mm512_loadu_ps(s)));
+          });
+    } else if constexpr (I == Isa::avx2) {
+      i = convert_blocks<8>(
+          n, src, dst,
+          [](const float *s, std::int32_t *d) MATRIX_DESIGN_TARGET_AVX2 {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(d),
+                                _mm256_cvttps_epi32(_mm256_loadu_ps(s)));
+          });
+    } else if constexpr (I == Isa::sse2) {
+      i = convert_blocks<4>(n, src, dst, [](const float *s, std::int32_t *d) {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(d),
+                         _mm_cvttps_epi32(_mm_loadu_ps(s)));
+      });
+    }
+  } else if constexpr (std::is_same_v<T, float> &&
+                       std::is_same_v<S, std::int32_t>) {
+    if constexpr (I == Isa::avx512) {
+      i = convert_blocks<16>(
+          n, src, dst,
+          [](const std::int32_t *s, float *d) MATRIX_DESIGN_TARGET_AVX512 {
+            _mm512_storeu_ps(d, _mm512_maskz_cvtepi32_ps(
+                                    0xFFFF, _mm512_loadu_si512(s)));
+          });
+    } else if constexpr (I == Isa::avx2) {
+      i = convert_blocks<8>(
+          n, src, dst,
+          [](const std::int32_t *s, float *d) MATRIX_DESIGN_TARGET_AVX2 {
+            _mm256_storeu_ps(d, _mm256_cvtepi32_ps(_mm256_loadu_si256(
+                                    reinterpret_cast<const __m256i *>(s))));
+          });
+    } else if constexpr (I == Isa::sse2) {
+      i = convert_blocks<4>(n, src, dst, [](const std::int32_t *s, float *d) {
+        _mm_storeu_ps(d, _mm_cvtepi32_ps(_mm_loadu_si128(
+                             reinterpret_cast<const __m128i *>(s))));
+      });
+    }
+  } else if constexpr (std::is_same_v<T, std::int32_t> &&
+                       std::is_same_v<S, double>) {
+    if constexpr (I == Isa::avx512) {
+      i = convert_blocks<8>(
+          n, src, dst,
+          [](const double *s, std::int32_t *d) MATRIX_DESIGN_TARGET_AVX512 {
+            _mm256_storeu_si256(
+                reinterpret_cast<__m256i *>(d),
+                _mm512_maskz_cvttpd_epi32(0xFF, _mm512_loadu_pd(s)));
+          });
+    } else if constexpr (I == Isa::avx2) {
+      i = convert_blocks<4>(
+          n, src, dst,
+          [](const double *s, std::int32_t *d) MATRIX_DESIGN_TARGET_AVX2 {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(d),
+                             _mm256_cvttpd_epi32(_mm256_loadu_pd(s)));
+          });
+    } else if constexpr (I == Isa::sse2) {
+      i = convert_blocks<2>(n, src, dst, [](const double *s, std::int32_t *d) {
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(d),
+                         _mm_cvttpd_epi32(_mm_loadu_pd(s)));
+      });
+    }
+  } else if constexpr (std::is_same_v<T, double> &&
+                       std::is_same_v<S, std::int32_t>) {
+    if constexpr (I == Isa::avx512) {
+      i = convert_blocks<8>(
+          n, src, dst,
+          [](const std::int32_t *s, double *d) MATRIX_DESIGN_TARGET_AVX512 {
+            const __m256i x =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s));
+            _mm512_storeu_pd(d, _mm512_maskz_cvtepi32_pd(0xFF, x));
+          });
+    } else if constexpr (I == Isa::avx2) {
+      i = convert_blocks<4>(
+          n, src, dst,
+          [](const std::int32_t *s, double *d) MATRIX_DESIGN_TARGET_AVX2 {
+            _mm256_storeu_pd(d, _mm256_cvtepi32_pd(_mm_loadu_si128(
+                                    reinterpret_cast<const __m128i *>(s))));
+          });
+    } else if constexpr (I == Isa::sse2) {
+      i = convert_blocks<2>(n, src, dst, [](const std::int32_t *s, double *d) {
+        _mm_storeu_pd(d, _mm_cvtepi32_pd(_mm_loadl_epi64(
+                             reinterpret_cast<const __m128i *>(s))));
+      });
+    }
+  } else if constexpr (std::is_same_v<T, float16> &&
+                       std::is_same_v<S, float>) {
+    if constexpr (I == Isa::avx512) {
+      i = convert_blocks<16>(
+          n, src, dst,
+          [](const float *s, float16 *d) MATRIX_DESIGN_TARGET_AVX512 {
+            _mm256_storeu_si256(
+                reinterpret_cast<__m256i *>(d),
+                _mm512_maskz_cvtps_ph(0xFFFF, _mm512_loadu_ps(s),
+                                      _MM_FROUND_TO_NEAREST_INT |
+                                          _MM_FROUND_NO_EXC));
+          });
+    } else if constexpr (I == Isa::avx2) { // F16C
+      i = convert_blocks<8>(
+          n, src, dst,
+          [](const float *s, float16 *d) MATRIX_DESIGN_TARGET_AVX2 {
+            _mm_storeu_si128(
+                reinterpret_cast<__m128i *>(d),
+                _mm256_cvtps_ph(_mm256_loadu_ps(s),
+                                _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+          });
+    }
+  } else if constexpr (std::is_same_v<T, float> &&
+                       std::is_same_v<S, float16>) {
+    if constexpr (I == Isa::avx512) {
+      i = convert_blocks<16>(
+          n, src, dst,
+          [](const float16 *s, float *d) MATRIX_DESIGN_TARGET_AVX512 {
+            const __m256i h =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s));
+            _mm512_storeu_ps(d, _mm512_maskz_cvtph_ps(0xFFFF, h));
+          });
+    } else if constexpr (I == Isa::avx2) {
+      i = convert_blocks<8>(
+          n, src, dst,
+          [](const float16 *s, float *d) MATRIX_DESIGN_TARGET_AVX2 {
+            _mm256_storeu_ps(d, _mm256_cvtph_ps(_mm_loadu_si128(
+                                    reinterpret_cast<const __m128i *>(s))));
+          });
+    }
+  } else if constexpr (std::is_same_v<T, bfloat16> &&
+                       std::is_same_v<S, float>) {
+#if defined(MATRIX_DESIGN_HAS_AVX2)
+    if constexpr (I >= Isa::avx2) {
+      i = convert_blocks<16>(
+          n, src, dst,
+          [](const float *s, bfloat16 *d) MATRIX_DESIGN_TARGET_AVX2 {
+            _mm256_storeu_si256(
+                reinterpret_cast<__m256i *>(d),
+                bfloat16_pack(_mm256_castps_si256(_mm256_loadu_ps(s)),
+                              _mm256_castps_si256(_mm256_loadu_ps(s + 8))));
+          });
+    }
+#endif
+  } else if constexpr (std::is_same_v<T, float> &&
+                       std::is_same_v<S, bfloat16>) {
+    if constexpr (I == Isa::avx512) {
+      i = convert_blocks<16>(
+          n, src, dst,
+          [](const bfloat16 *s, float *d) MATRIX_DESIGN_TARGET_AVX512 {
+            const __m512i x = _mm512_maskz_cvtepu16_epi32(
+                0xFFFF,
+                _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s)));
+            _mm512_storeu_ps(d, _mm512_castsi512_ps(
+                                    _mm512_maskz_slli_epi32(0xFFFF, x, 16)));
+          });
+    } else if constexpr (I == Isa::avx2) {
+      i = convert_blocks<8>(
+          n, src, dst,
+          [](const bfloat16 *s, float *d) MATRIX_DESIGN_TARGET_AVX2 {
+            const __m256i x = _mm256_cvtepu16_epi32(
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(s)));
+            _mm256_storeu_ps(d, _mm256_castsi256_ps(_mm256_slli_epi32(x, 16)));
+          });
+    } else if constexpr (I == Isa::sse2) {
+      i = convert_blocks<8>(n, src, dst, [](const bfloat16 *s, float *d) {
+        const __m128i x =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+        const __m128i zero = _mm_setzero_si128();
+        _mm_storeu_ps(d, _mm_castsi128_ps(_mm_unpacklo_epi16(zero, x)));
+        _mm_storeu_ps(d + 4, _mm_castsi128_ps(_mm_unpackhi_epi16(zero, x)));
+      });
+    }
+  }
+#endif
+  if constexpr ((Is_half_v<T> && !std::is_same_v<S, float> &&
+                 !Is_half_v<S>) ||
+                (Is_half_v<S> && !std::is_same_v<T, float> &&
+                 !Is_half_v<T>)) {
+    // through float, a block at a time; doubles are rounded to odd on the
+    // way, so the 16-bit result is rounded once
+    constexpr std::size_t block = 64;
+    float tmp[block];
+    for (; i + block <= n; i += block) {
+      if constexpr (Is_half_v<T> && std::is_same_v<S, double>) {
+        for (std::size_t j = 0; j < block; ++j) {
+          tmp[j] = double_to_float_odd(src[i + j]);
+        }
+      } else {
+        convert_kernel<I>(block, src + i, tmp);
+      }
+      convert_kernel<I>(block, tmp, dst + i);
+    }
+  }
+  // the 16-bit types through float both ways, except from double, which
+  // they round from directly
+  using Through =
+      std::conditional_t<Is_half_v<T> && !std::is_same_v<S, double>, float,
+                         Compute_type<S>>;
+  for (; i < n; ++i) {
+    dst[i] = static_cast<T>(
+        static_cast<Through>(static_cast<Compute_type<S>>(src[i])));
+  }
+}
+
+// dst[i] = T(src[i]) for i in [0, n)
+template <typename T, typename U>
+auto convert_run(std::size_t n, const U *src, T *dst) -> void {
+  dispatch([&](auto isa) {
+    convert_kernel<decltype(isa)::value>(n, src, dst);
+  });
+}
+
+} // namespace matrix_impl
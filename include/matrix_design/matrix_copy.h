@@ -0,0 +1,212 @@
+#pragma once
+
+#include "common.h"
+#include "matrix_convert.h"
+#include "matrix_execution.h"
+#include "matrix_instrument.h"
+#include "matrix_ref.h"
+#include "matrix_simd.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+// The strided copy engine behind Matrix(Matrix_ref) and friends.
+//
+// Source and destination descriptors are collapsed together first, so a
+// row of a dense matrix (or any slice whose inner dimensions are whole)
+// becomes one long run. Unit-stride runs of trivially copyable elements are
+// moved with memcpy, or converted with vector instructions between element
+// types (matrix_convert.h); strided runs are gathered with independent,
+// unrolled loads; broadcast (stride-0) runs are filled; and when the
+// source's unit-stride dimension is not the destination's innermost one
+// (a transposing copy) the two dimensions are walked in cache-sized tiles
+// so neither side streams through memory with a large stride. When both
+// sides have a unit-stride dimension the tiles are found by recursive
+// halving (cache-oblivious) and transposed with in-register block
+// transposes of the instruction set level in use (see matrix_dispatch.h).
+
+namespace matrix_impl {
+
+// length of one side of a tile for transposing copies
+inline constexpr std::size_t copy_tile = 32;
+
+// dst[i * ds] = src[i * ss] for i in [0, n)
+template <typename T, typename U>
+auto copy_run(std::size_t n, const U *src, std::size_t ss, T *dst,
+              std::size_t ds) -> void {
+  if (ss == 1 && ds == 1) {
+    if constexpr (std::is_same_v<T, U> && std::is_trivially_copyable_v<T>) {
+      if (n != 0) {
+        std::memcpy(dst, src, n * sizeof(T));
+      }
+    } else if constexpr (Is_number_v<T> && Is_number_v<U>) {
+      convert_run(n, src, dst);
+    } else {
+      std::copy(src, src + n, dst);
+    }
+    return;
+  }
+  if (ss == 0) { // a broadcast source repeats one element
+    const U x = *src;
+    for (std::size_t i = 0; i < n; ++i) {
+      dst[i * ds] = x;
+    }
+    return;
+  }
+  if (ds == 1) {
+    // gather: issue the loads of a block before any dependent store
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      const U a = src[i * ss];
+      const U b = src[(i + 1) * ss];
+      const U c = src[(i + 2) * ss];
+      const U d = src[(i + 3) * ss];
+      dst[i] = a;
+      dst[i + 1] = b;
+      dst[i + 2] = c;
+      dst[i + 3] = d;
+    }
+    for (; i < n; ++i) {
+      dst[i] = src[i * ss];
+    }
+    return;
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    dst[i * ds] = src[i * ss];
+  }
+}
+
+// a two-dimensional copy in square tiles; dimension 0 is the destination's
+// unit-stride dimension and dimension 1 the source's
+template <typename T, typename U>
+auto copy_tiled(std::size_t n0, std::size_t n1, const U *src, std::size_t ss0,
+                std::size_t ss1, T *dst, std::size_t ds0, std::size_t ds1)
+    -> void {
+  for (std::size_t j0 = 0; j0 < n1; j0 += copy_tile) {
+    const std::size_t j1 = std::min(n1, j0 + copy_tile);
+    for (std::size_t i0 = 0; i0 < n0; i0 += copy_tile) {
+      const std::size_t i1 = std::min(n0, i0 + copy_tile);
+      for (std::size_t j = j0; j < j1; ++j) {
+        for (std::size_t i = i0; i < i1; ++i) {
+          dst[i * ds0 + j * ds1] = src[i * ss0 + j * ss1];
+        }
+      }
+    }
+  }
+}
+
+// one tile of transpose_copy, its blocks transposed in level I's registers
+template <Isa I, typename T>
+auto transpose_tile(std::size_t n0, std::size_t n1, const T *src,
+                    std::size_t ss, T *dst, std::size_t ds) -> void {
+  using Block = simd::Transpose_block<T, I>;
+  constexpr std::size_t b = Block::size;
+  const std::size_t m0 = n0 / b * b;
+  const std::size_t m1 = n1 / b * b;
+  for (std::size_t i = 0; i < m0; i += b) {
+    for (std::size_t j = 0; j < m1; j += b) {
+      Block::apply(src + i * ss + j, ss, dst + j * ds + i, ds);
+    }
+  }
+  // the ragged right and bottom edges
+  for (std::size_t j = 0; j < n1; ++j) {
+    for (std::size_t i = j < m1 ? m0 : 0; i < n0; ++i) {
+      dst[j * ds + i] = src[i * ss + j];
+    }
+  }
+}
+
+// dst[i + j * ds] = src[i * ss + j] for i in [0, n0), j in [0, n1): the
+// longer side is halved until both fit a tile, whose blocks are then
+// transposed in registers
+template <typename T>
+auto transpose_copy(std::size_t n0, std::size_t n1, const T *src,
+                    std::size_t ss, T *dst, std::size_t ds) -> void {
+  constexpr std::size_t b = simd::transpose_block_max;
+  if (n0 > copy_tile || n1 > copy_tile) {
+    // split on a multiple of the block size so no block straddles halves
+    if (n0 >= n1) {
+      const std::size_t h = (n0 / 2 + b - 1) / b * b;
+      transpose_copy(h, n1, src, ss, dst, ds);
+      transpose_copy(n0 - h, n1, src + h * ss, ss, dst + h, ds);
+    } else {
+      const std::size_t h = (n1 / 2 + b - 1) / b * b;
+      transpose_copy(n0, h, src, ss, dst, ds);
+      transpose_copy(n0, n1 - h, src + h, ss, dst + h * ds, ds);
+    }
+    return;
+  }
+  dispatch([&](auto isa) {
+    transpose_tile<decltype(isa)::value>(n0, n1, src, ss, dst, ds);
+  });
+}
+
+// copy every element of src into the element at the same index of dst
+template <typename T, typename U, std::size_t N>
+auto copy_elements(const Matrix_ref<U, N> &src, const Matrix_ref<T, N> &dst)
+    -> void {
+  const auto &sd = src.descriptor();
+  const auto &dd = dst.descriptor();
+  assert(sd.extents == dd.extents);
+  const auto c = collapse_dims<N, 2>(dd.extents, {dd.strides, sd.strides});
+  if (c.empty) {
+    return;
+  }
+  const U *s = src.pointer();
+  T *d = dst.pointer();
+  if (c.rank == 0) {
+    d[dd.start] = s[sd.start];
+    return;
+  }
+  const std::size_t ds0 = c.strides[0][0];
+  const std::size_t ss0 = c.strides[1][0];
+  if constexpr (N >= 2) {
+    if (c.rank >= 2 && ss0 > 1 && c.strides[1][1] == 1) {
+      // transposing copy: tile the two innermost dimensions
+      if constexpr (std::is_same_v<T, std::remove_const_t<U>>) {
+        if (ds0 == 1) {
+          const std::size_t ds1 = c.strides[0][1];
+          for_each_outer(c, 2, {dd.start, sd.start}, [&](const auto &off) {
+            transpose_copy(c.extents[0], c.extents[1], s + off[1], ss0,
+                           d + off[0], ds1);
+          });
+          return;
+        }
+      }
+      for_each_outer(c, 2, {dd.start, sd.start}, [&](const auto &off) {
+        copy_tiled(c.extents[0], c.extents[1], s + off[1], ss0,
+                   std::size_t{1}, d + off[0], ds0, c.strides[0][1]);
+      });
+      return;
+    }
+  }
+  for_each_outer(c, 1, {dd.start, sd.start}, [&](const auto &off) {
+    copy_run(c.extents[0], s + off[1], ss0, d + off[0], ds0);
+  });
+}
+
+template <typename T, typename U, std::size_t N>
+auto strided_copy(const Matrix_ref<U, N> &src, const Matrix_ref<T, N> &dst)
+    -> void {
+  const Kernel_scope scope(matrix_instrument::Kernel::copy);
+  copy_elements(src, dst);
+}
+
+// as above, splitting the outermost dimension according to the policy
+template <typename Policy, typename T, typename U, std::size_t N>
+auto strided_copy(const Policy &policy, const Matrix_ref<U, N> &src,
+                  const Matrix_ref<T, N> &dst) -> void {
+  const Kernel_scope scope(matrix_instrument::Kernel::copy);
+  const auto &dd = dst.descriptor();
+  if (dd.size == 0) {
+    return;
+  }
+  for_each_row_block(policy, dd.extents[0], dd.size / dd.extents[0],
+                     [&](std::size_t first, std::size_t last) {
+                       copy_elements(row_range(src, first, last),
+                                     row_range(dst, first, last));
+                     });
+}
+
+} // namespace matrix_impl
@@ -0,0 +1,299 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define MATRIX_DESIGN_X86 1
+#include <immintrin.h>
+#if defined(__GNUC__)
+#include <cpuid.h>
+#endif
+#endif
+
+// The instruction set the compute kernels run with.
+//
+//   matrix_dispatch::cpu_features()     what cpuid reports, read once
+//   matrix_dispatch::detected_isa()     the widest level the CPU, the OS
+//                                       and the build support
+//   matrix_dispatch::isa()              the level in use
+//   matrix_dispatch::set_isa(level)     use another level (clamped to the
+//                                       detected one); returns the old one
+//
+// The levels are scalar (plain loops), sse2, avx2 (with FMA and F16C) and
+// avx512 (F, BW, DQ and VL). With GCC on x86-64 every level is compiled
+// into the program whatever -m flags the build uses, and the element-wise,
+// reduction, conversion, GEMM and convolution kernels pick theirs at run
+// time; one binary then runs AVX-512 code on an Ice Lake or Zen 4 host and
+// AVX2 code on an older one. Elsewhere (or with MATRIX_DESIGN_NO_DISPATCH
+// defined) only the levels the build targets are available.
+//
+// The environment variable MATRIX_DESIGN_ISA (scalar, sse2, avx2 or avx512)
+// sets the starting level, e.g. to test or benchmark the AVX2 kernels on an
+// AVX-512 machine; a level the machine lacks falls back to the detected one.
+
+#if defined(MATRIX_DESIGN_X86) && defined(__GNUC__) &&                        \
+    !defined(__clang__) && !defined(MATRIX_DESIGN_NO_DISPATCH)
+#define MATRIX_DESIGN_DISPATCH 1
+// code for one level, whatever the build flags
+#define MATRIX_DESIGN_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+#define MATRIX_DESIGN_TARGET_AVX512                                            \
+  __attribute__((                                                             \
+      target("avx512f,avx512bw,avx512dq,avx512vl,avx2,fma,f16c")))
+#define MATRIX_DESIGN_TARGET_VNNI                                              \
+  __attribute__((target(                                                      \
+      "avx512vnni,avx512f,avx512bw,avx512dq,avx512vl,avx2,fma,f16c")))
+// every function defined up to MATRIX_DESIGN_END_TARGET gets the attribute
+#define MATRIX_DESIGN_BEGIN_AVX2                                               \
+  _Pragma("GCC push_options") _Pragma("GCC target(\"avx2,fma,f16c\")")
+#define MATRIX_DESIGN_BEGIN_AVX512                                             \
+  _Pragma("GCC push_options") _Pragma(                                        \
+      "GCC target(\"avx512f,avx512bw,avx512dq,avx512vl,avx2,fma,f16c\")")
+#define MATRIX_DESIGN_END_TARGET _Pragma("GCC pop_options")
+// generic code holding vector registers (pack loops, expression nodes):
+// inlined into the function dispatch builds for the level at any -O, as a
+// call between it and code built without that level's instructions would
+// pass the registers under another ABI
+#define MATRIX_DESIGN_ALWAYS_INLINE __attribute__((always_inline))
+// around that code, which passes vector registers only by reference: GCC
+// notes the ABI of its calls to the level's packs as if they stayed calls
+// from code without the level's instructions (-Wpsabi)
+#define MATRIX_DESIGN_BEGIN_INLINE_VECTORS                                    \
+  _Pragma("GCC diagnostic push") _Pragma("GCC diagnostic ignored \"-Wpsabi\"")
+#define MATRIX_DESIGN_END_INLINE_VECTORS _Pragma("GCC diagnostic pop")
+#else
+#define MATRIX_DESIGN_TARGET_AVX2
+#define MATRIX_DESIGN_TARGET_AVX512
+#define MATRIX_DESIGN_TARGET_VNNI
+#define MATRIX_DESIGN_BEGIN_AVX2
+#define MATRIX_DESIGN_BEGIN_AVX512
+#define MATRIX_DESIGN_END_TARGET
+#define MATRIX_DESIGN_ALWAYS_INLINE
+#define MATRIX_DESIGN_BEGIN_INLINE_VECTORS
+#define MATRIX_DESIGN_END_INLINE_VECTORS
+#endif
+
+#if defined(__GNUC__)
+#define MATRIX_DESIGN_FLATTEN __attribute__((flatten))
+#else
+#define MATRIX_DESIGN_FLATTEN
+#endif
+
+// the AVX2 and AVX-512 kernels are compiled in
+#if defined(MATRIX_DESIGN_DISPATCH) ||                                        \
+    (defined(__AVX2__) && defined(__FMA__) && defined(__F16C__))
+#define MATRIX_DESIGN_HAS_AVX2 1
+#endif
+#if defined(MATRIX_DESIGN_DISPATCH) ||                                        \
+    (defined(__AVX512F__) && defined(__AVX512BW__) &&                         \
+     defined(__AVX512DQ__) && defined(__AVX512VL__))
+#define MATRIX_DESIGN_HAS_AVX512 1
+#endif
+#if defined(MATRIX_DESIGN_DISPATCH) ||                                        \
+    (defined(MATRIX_DESIGN_HAS_AVX512) && defined(__AVX512VNNI__))
+#define MATRIX_DESIGN_HAS_VNNI 1
+#endif
+
+namespace matrix_dispatch {
+
+enum class Isa { scalar, sse2, avx2, avx512 };
+
+struct Cpu_features {
+  bool sse2 = false;
+  bool avx2 = false; // with AVX, FMA, F16C and the OS saving ymm registers
+  bool avx512 = false; // F, BW, DQ and VL, the OS saving zmm registers
+  bool avx512_vnni = false;
+};
+
+// the level the build's own flags target
+#if defined(__AVX512F__) && defined(__AVX512BW__) && defined(__AVX512DQ__) && \
+    defined(__AVX512VL__)
+inline constexpr Isa compiled_isa = Isa::avx512;
+#elif defined(__AVX2__) && defined(__FMA__) && defined(__F16C__)
+inline constexpr Isa compiled_isa = Isa::avx2;
+#elif defined(MATRIX_DESIGN_X86)
+inline constexpr Isa compiled_isa = Isa::sse2;
+#else
+inline constexpr Isa compiled_isa = Isa::scalar;
+#endif
+
+// the widest level compiled into the program
+#if defined(MATRIX_DESIGN_DISPATCH)
+inline constexpr Isa widest_isa = Isa::avx512;
+#else
+inline constexpr Isa widest_isa = compiled_isa;
+#endif
+
+inline constexpr std::string_view isa_names[] = {"scalar", "sse2", "avx2",
+                                                 "avx512"};
+
+[[nodiscard]] inline auto isa_name(Isa level) -> std::string_view {
+  return isa_names[static_cast<int>(level)];
+}
+
+// the level called name, if any
+[[nodiscard]] inline auto parse_isa(std::string_view name)
+    -> std::optional<Isa> {
+  for (int i = 0; i < 4; ++i) {
+    if (name == isa_names[i]) {
+      return static_cast<Isa>(i);
+    }
+  }
+  return std::nullopt;
+}
+
+} // namespace matrix_dispatch
+
+namespace matrix_impl {
+
+inline auto read_cpu_features() -> matrix_dispatch::Cpu_features {
+  matrix_dispatch::Cpu_features f;
+#if defined(MATRIX_DESIGN_X86) && defined(__GNUC__)
+  unsigned a = 0;
+  unsigned b = 0;
+  unsigned c = 0;
+  unsigned d = 0;
+  if (__get_cpuid(1, &a, &b, &c, &d) == 0) {
+    return f;
+  }
+  f.sse2 = (d & bit_SSE2) != 0;
+  const bool avx = (c & bit_AVX) != 0;
+  const bool fma = (c & bit_FMA) != 0;
+  const bool f16c = (c & bit_F16C) != 0;
+  // which register states the OS saves on a context switch
+  unsigned xcr0 = 0;
+  if ((c & bit_OSXSAVE) != 0) {
+    unsigned hi = 0;
+    __asm__("xgetbv" : "=a"(xcr0), "=d"(hi) : "c"(0));
+  }
+  const bool ymm = (xcr0 & 0x6) == 0x6;
+  const bool zmm = (xcr0 & 0xE6) == 0xE6;
+  if (__get_cpuid_count(7, 0, &a, &b, &c, &d) == 0) {
+    return f;
+  }
+  f.avx2 = avx && fma && f16c && ymm && (b & bit_AVX2) != 0;
+  f.avx512 = f.avx2 && zmm && (b & bit_AVX512F) != 0 &&
+             (b & bit_AVX512BW) != 0 && (b & bit_AVX512DQ) != 0 &&
+             (b & bit_AVX512VL) != 0;
+  f.avx512_vnni = f.avx512 && (c & bit_AVX512VNNI) != 0;
+#elif defined(MATRIX_DESIGN_X86)
+  f.sse2 = true;
+#endif
+  return f;
+}
+
+inline auto initial_isa() -> matrix_dispatch::Isa;
+
+// the level in use, read from MATRIX_DESIGN_ISA on first use
+inline auto active_isa() -> std::atomic<matrix_dispatch::Isa> & {
+  static std::atomic<matrix_dispatch::Isa> level{initial_isa()};
+  return level;
+}
+
+} // namespace matrix_impl
+
+namespace matrix_dispatch {
+
+[[nodiscard]] inline auto cpu_features() -> const Cpu_features & {
+  static const Cpu_features features = matrix_impl::read_cpu_features();
+  return features;
+}
+
+[[nodiscard]] inline auto detected_isa() -> Isa {
+  const Cpu_features &f = cpu_features();
+  Isa level = Isa::scalar;
+  if (f.avx512) {
+    level = Isa::avx512;
+  } else if (f.avx2) {
+    level = Isa::avx2;
+  } else if (f.sse2) {
+    level = Isa::sse2;
+  }
+  return level < widest_isa ? level : widest_isa;
+}
+
+[[nodiscard]] inline auto isa() -> Isa {
+  return matrix_impl::active_isa().load(std::memory_order_relaxed);
+}
+
+inline auto set_isa(Isa level) -> Isa {
+  const Isa best = detected_isa();
+  return matrix_impl::active_isa().exchange(level < best ? level : best,
+                                       std::memory_order_relaxed);
+}
+
+} // namespace matrix_dispatch
+
+namespace matrix_impl {
+
+using matrix_dispatch::Isa;
+
+inline auto initial_isa() -> Isa {
+  const Isa best = matrix_dispatch::detected_isa();
+  const char *env = std::getenv("MATRIX_DESIGN_ISA");
+  if (env == nullptr) {
+    return best;
+  }
+  const std::optional<Isa> level = matrix_dispatch::parse_isa(env);
+  return level && *level < best ? *level : best;
+}
+
+template <Isa I> using Isa_tag = std::integral_constant<Isa, I>;
+
+// f(Isa_tag<I>{}) compiled for level I, in a function built with I's
+// instructions. f and the generic code it reaches that holds vector
+// registers (Isa_pack loops, expression trees) must be
+// MATRIX_DESIGN_ALWAYS_INLINE, so they are part of this function whatever
+// the optimization level; flatten inlines the rest when optimizing, so
+// plain loops are vectorized for I too
+template <typename F>
+MATRIX_DESIGN_TARGET_AVX512 MATRIX_DESIGN_FLATTEN auto
+run_avx512(F &f) -> decltype(f(Isa_tag<Isa::avx512>{})) {
+  return f(Isa_tag<Isa::avx512>{});
+}
+
+template <typename F>
+MATRIX_DESIGN_TARGET_AVX2 MATRIX_DESIGN_FLATTEN auto run_avx2(F &f)
+    -> decltype(f(Isa_tag<Isa::avx2>{})) {
+  return f(Isa_tag<Isa::avx2>{});
+}
+
+template <Isa I, typename F> auto isa_call(F &&f) -> decltype(auto) {
+  if constexpr (I <= matrix_dispatch::compiled_isa || I <= Isa::sse2) {
+    return f(Isa_tag<I>{}); // the build's own flags cover it
+  } else if constexpr (I == Isa::avx512) {
+    return run_avx512(f);
+  } else {
+    return run_avx2(f);
+  }
+}
+
+// f(Isa_tag<I>{}) for the level in use (or the given one)
+template <typename F>
+auto dispatch(Isa level, F &&f) -> decltype(auto) {
+  if constexpr (matrix_dispatch::widest_isa >= Isa::avx512) {
+    if (level == Isa::avx512) {
+      return isa_call<Isa::avx512>(f);
+    }
+  }
+  if constexpr (matrix_dispatch::widest_isa >= Isa::avx2) {
+    if (level >= Isa::avx2) {
+      return isa_call<Isa::avx2>(f);
+    }
+  }
+  if constexpr (matrix_dispatch::widest_isa >= Isa::sse2) {
+    if (level >= Isa::sse2) {
+      return isa_call<Isa::sse2>(f);
+    }
+  }
+  return isa_call<Isa::scalar>(f);
+}
+
+template <typename F> auto dispatch(F &&f) -> decltype(auto) {
+  return dispatch(matrix_dispatch::isa(), f);
+}
+
+} // namespace matrix_impl
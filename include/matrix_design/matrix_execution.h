@@ -0,0 +1,88 @@
+#pragma once
+
+#include "matrix_ref.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+
+// Execution policies for the matrix algorithms, mirroring std::execution:
+//
+//   matrix_execution::seq        run on the calling thread
+//   matrix_execution::par        split along the outermost extent and run
+//                                the pieces on Thread_pool::instance()
+//   matrix_execution::par_unseq  as par; the innermost runs are vectorized
+//                                under every policy already
+//
+// Work is only split when every piece still covers at least
+// min_task_elements elements, so small matrices stay on the calling thread.
+
+namespace matrix_execution {
+
+struct Sequenced_policy {};
+struct Parallel_policy {};
+struct Parallel_unsequenced_policy {};
+
+inline constexpr Sequenced_policy seq{};
+inline constexpr Parallel_policy par{};
+inline constexpr Parallel_unsequenced_policy par_unseq{};
+
+} // namespace matrix_execution
+
+namespace matrix_impl {
+
+template <typename P> struct Is_execution_policy : std::false_type {};
+template <>
+struct Is_execution_policy<matrix_execution::Sequenced_policy>
+    : std::true_type {};
+template <>
+struct Is_execution_policy<matrix_execution::Parallel_policy>
+    : std::true_type {};
+template <>
+struct Is_execution_policy<matrix_execution::Parallel_unsequenced_policy>
+    : std::true_type {};
+
+template <typename P>
+constexpr bool Is_execution_policy_v =
+    Is_execution_policy<std::remove_cv_t<std::remove_reference_t<P>>>::value;
+
+template <typename P>
+constexpr bool Is_parallel_policy_v =
+    Is_execution_policy_v<P> &&
+    !std::is_same_v<std::remove_cv_t<std::remove_reference_t<P>>,
+                    matrix_execution::Sequenced_policy>;
+
+// the smallest amount of work worth handing to another thread
+inline constexpr std::size_t min_task_elements = std::size_t{1} << 15;
+
+// how many slices of the outermost dimension one task should own
+inline auto grain_rows(std::size_t row_elements) -> std::size_t {
+  return std::max<std::size_t>(
+      1, min_task_elements / std::max<std::size_t>(row_elements, 1));
+}
+
+// f(first, last) over blocks of [0, rows) of the outermost dimension, in
+// parallel when the policy asks for it and the work is large enough
+template <typename Policy, typename F>
+auto for_each_row_block(const Policy & /*policy*/, std::size_t rows,
+                        std::size_t row_elements, F &&f) -> void {
+  if constexpr (Is_parallel_policy_v<Policy>) {
+    Thread_pool::instance().parallel_for(0, rows, grain_rows(row_elements),
+                                         std::forward<F>(f));
+  } else {
+    f(std::size_t{0}, rows);
+  }
+}
+
+// the slices [first, last) of the outermost dimension of a view
+template <typename T, std::size_t N>
+auto row_range(const Matrix_ref<T, N> &m_r, std::size_t first,
+               std::size_t last) -> Matrix_ref<T, N> {
+  Matrix_slice<N> desc = m_r.descriptor();
+  desc.start += first * desc.strides[0];
+  desc.extents[0] = last - first;
+  desc.size = computing_size<N>(desc.extents);
+  return {desc, m_r.pointer()};
+}
+
+} // namespace matrix_impl
@@ -0,0 +1,437 @@
+#pragma once
+
+#include "matrix.h"
+#include "matrix_execution.h"
+#include "matrix_instrument.h"
+#include "matrix_simd.h"
+#include <array>
+#include <cassert>
+#include <type_traits>
+
+// Lazy element-wise expressions. Arithmetic on matrices builds a tree of
+// small nodes that only hold views of their operands; the tree is evaluated
+// in a single fused pass when it is assigned to a Matrix or Matrix_ref.
+//
+// Every matrix operand is a leaf. At evaluation time the leaves are numbered
+// left to right (the destination is leaf 0) and walked together with
+// for_each_run, so each leaf keeps its own strides and no intermediate
+// matrix is ever materialized. Runs that are unit-stride in every leaf are
+// evaluated with vector registers, and so are runs along which some leaves
+// are broadcast (stride 0, see matrix_broadcast.h). The packed loops run at
+// the instruction set level picked at run time (see matrix_dispatch.h).
+//
+// Like any expression template, a node must not outlive the matrices it
+// refers to: assign it within the full expression that created it.
+
+namespace matrix_impl {
+
+MATRIX_DESIGN_BEGIN_INLINE_VECTORS
+
+// a matrix operand
+template <typename T, std::size_t N> class Expr_leaf {
+public:
+  static constexpr bool is_expression = true;
+  static constexpr std::size_t order = N;
+  static constexpr std::size_t leaves = 1;
+  using value_type = T;
+
+  explicit Expr_leaf(Matrix_ref<const T, N> m_r) : m_r{m_r} {}
+
+  auto extents() const -> const std::array<std::size_t, N> & {
+    return m_r.descriptor().extents;
+  }
+  auto view() const -> const Matrix_ref<const T, N> & { return m_r; }
+
+  // the same expression restricted to slices [first, last) of dimension 0
+  auto rows(std::size_t first, std::size_t last) const -> Expr_leaf {
+    return Expr_leaf(row_range(m_r, first, last));
+  }
+
+  template <std::size_t I, typename Views>
+  auto collect(Views &views) const -> void {
+    views[I] = m_r;
+  }
+
+  // element i of the current run through the run's own strides
+  template <std::size_t I, typename Bases, typename Offsets>
+  auto at(const Bases &bases, const Offsets &off, const Offsets &inner,
+          std::size_t i) const -> T {
+    return bases[I][off[I] + i * inner[I]];
+  }
+
+  // element i of the current run when every leaf is unit-stride
+  template <std::size_t I, typename Ptrs>
+  auto at(const Ptrs &ptrs, std::size_t i) const -> T {
+    return ptrs[I][i];
+  }
+
+  // v = pack i of the current run when every leaf is unit-stride
+  template <typename P, std::size_t I, typename Ptrs>
+  MATRIX_DESIGN_ALWAYS_INLINE auto packed(const Ptrs &ptrs, std::size_t i,
+                                          typename P::type &v) const -> void {
+    v = P::load(ptrs[I] + i);
+  }
+
+  // the same when each leaf is unit-stride (step 1) or broadcast along the
+  // run (step 0, read from a splat of its element)
+  template <typename P, std::size_t I, typename Ptrs, typename Steps>
+  MATRIX_DESIGN_ALWAYS_INLINE auto packed(const Ptrs &ptrs,
+                                          const Steps &steps, std::size_t i,
+                                          typename P::type &v) const -> void {
+    v = P::load(ptrs[I] + i * steps[I]);
+  }
+
+private:
+  Matrix_ref<const T, N> m_r;
+};
+
+// a scalar operand, broadcast to every element
+template <typename T> class Expr_scalar {
+public:
+  static constexpr bool is_expression = true;
+  static constexpr std::size_t order = 0;
+  static constexpr std::size_t leaves = 0;
+  using value_type = T;
+
+  explicit Expr_scalar(const T &value) : value{value} {}
+
+  auto rows(std::size_t /*first*/, std::size_t /*last*/) const
+      -> Expr_scalar {
+    return *this;
+  }
+
+  template <std::size_t I, typename Views>
+  auto collect(Views & /*views*/) const -> void {}
+
+  template <std::size_t I, typename Bases, typename Offsets>
+  auto at(const Bases & /*bases*/, const Offsets & /*off*/,
+          const Offsets & /*inner*/, std::size_t /*i*/) const -> T {
+    return value;
+  }
+
+  template <std::size_t I, typename Ptrs>
+  auto at(const Ptrs & /*ptrs*/, std::size_t /*i*/) const -> T {
+    return value;
+  }
+
+  template <typename P, std::size_t I, typename Ptrs>
+  MATRIX_DESIGN_ALWAYS_INLINE auto packed(const Ptrs & /*ptrs*/,
+                                          std::size_t /*i*/,
+                                          typename P::type &v) const -> void {
+    v = P::set1(value);
+  }
+
+  template <typename P, std::size_t I, typename Ptrs, typename Steps>
+  MATRIX_DESIGN_ALWAYS_INLINE auto packed(const Ptrs & /*ptrs*/,
+                                          const Steps & /*steps*/,
+                                          std::size_t /*i*/,
+                                          typename P::type &v) const -> void {
+    v = P::set1(value);
+  }
+
+private:
+  T value;
+};
+
+// op(l, r) element by element
+template <typename Op, typename L, typename R> class Expr_binary {
+public:
+  static constexpr bool is_expression = true;
+  static constexpr std::size_t order = L::order > R::order ? L::order
+                                                           : R::order;
+  static constexpr std::size_t leaves = L::leaves + R::leaves;
+  using value_type = typename std::conditional_t<(L::leaves > 0), L,
+                                                 R>::value_type;
+
+  Expr_binary(const L &l, const R &r) : l{l}, r{r} {}
+
+  auto rows(std::size_t first, std::size_t last) const -> Expr_binary {
+    return {l.rows(first, last), r.rows(first, last)};
+  }
+
+  auto extents() const -> const std::array<std::size_t, order> & {
+    if constexpr (L::leaves > 0 && R::leaves > 0) {
+      assert(l.extents() == r.extents());
+    }
+    if constexpr (L::leaves > 0) {
+      return l.extents();
+    } else {
+      return r.extents();
+    }
+  }
+
+  template <std::size_t I, typename Views>
+  auto collect(Views &views) const -> void {
+    l.template collect<I>(views);
+    r.template collect<I + L::leaves>(views);
+  }
+
+  template <std::size_t I, typename Bases, typename Offsets>
+  auto at(const Bases &bases, const Offsets &off, const Offsets &inner,
+          std::size_t i) const -> value_type {
+    return Op{}(l.template at<I>(bases, off, inner, i),
+                r.template at<I + L::leaves>(bases, off, inner, i));
+  }
+
+  template <std::size_t I, typename Ptrs>
+  auto at(const Ptrs &ptrs, std::size_t i) const -> value_type {
+    return Op{}(l.template at<I>(ptrs, i),
+                r.template at<I + L::leaves>(ptrs, i));
+  }
+
+  template <typename P, std::size_t I, typename Ptrs>
+  MATRIX_DESIGN_ALWAYS_INLINE auto packed(const Ptrs &ptrs, std::size_t i,
+                                          typename P::type &v) const -> void {
+    typename P::type rhs;
+    l.template packed<P, I>(ptrs, i, v);
+    r.template packed<P, I + L::leaves>(ptrs, i, rhs);
+    Op::template packed<P>(v, rhs);
+  }
+
+  template <typename P, std::size_t I, typename Ptrs, typename Steps>
+  MATRIX_DESIGN_ALWAYS_INLINE auto packed(const Ptrs &ptrs,
+                                          const Steps &steps, std::size_t i,
+                                          typename P::type &v) const -> void {
+    typename P::type rhs;
+    l.template packed<P, I>(ptrs, steps, i, v);
+    r.template packed<P, I + L::leaves>(ptrs, steps, i, rhs);
+    Op::template packed<P>(v, rhs);
+  }
+
+private:
+  L l;
+  R r;
+};
+
+MATRIX_DESIGN_END_INLINE_VECTORS
+
+// wrap any operand of an arithmetic operator as an expression node
+template <typename E, typename = Enable_if<Is_expr<E>::value, void>>
+auto as_expr(const E &e) -> const E & {
+  return e;
+}
+
+template <typename M, typename = Enable_if<Is_matrix_v<M>, void>,
+          typename = void>
+auto as_expr(const M &m) -> Expr_leaf<Value_type<M>, M::order> {
+  return Expr_leaf<Value_type<M>, M::order>(as_ref(m));
+}
+
+template <typename A>
+using Expr_type = std::decay_t<decltype(as_expr(std::declval<const A &>()))>;
+
+// true when the operand can appear in an element-wise expression
+template <typename A>
+constexpr bool Is_operand_v = Is_expr<A>::value || Is_matrix_v<A>;
+
+template <typename Op, typename A, typename B>
+auto make_binary(const A &a, const B &b)
+    -> Expr_binary<Op, Expr_type<A>, Expr_type<B>> {
+  return {as_expr(a), as_expr(b)};
+}
+
+template <typename Op, typename A>
+auto make_scalar(const A &a, const typename Expr_type<A>::value_type &s)
+    -> Expr_binary<Op, Expr_type<A>,
+                   Expr_scalar<typename Expr_type<A>::value_type>> {
+  using T = typename Expr_type<A>::value_type;
+  return {as_expr(a), Expr_scalar<T>(s)};
+}
+
+// lowest and one-past-highest offsets a view can touch
+template <typename T, std::size_t N>
+auto footprint(const Matrix_ref<T, N> &m_r)
+    -> std::array<const std::remove_const_t<T> *, 2> {
+  const auto &desc = m_r.descriptor();
+  std::size_t last = desc.start;
+  for (std::size_t d = 0; d < N; ++d) {
+    if (desc.extents[d] == 0) {
+      return {m_r.pointer(), m_r.pointer()};
+    }
+    last += (desc.extents[d] - 1) * desc.strides[d];
+  }
+  return {m_r.pointer() + desc.start, m_r.pointer() + last + 1};
+}
+
+// A leaf that shares memory with the destination is only safe when it maps
+// every index to exactly the destination's element; anything else (a
+// shifted slice, a transposed or broadcast view) could read an element
+// after it has been overwritten.
+template <typename T, std::size_t N, typename Views>
+auto any_alias(const Matrix_ref<T, N> &dst, const Views &views) -> bool {
+  const auto d_fp = footprint(dst);
+  const auto &dd = dst.descriptor();
+  for (std::size_t k = 1; k < views.size(); ++k) {
+    const auto fp = footprint(views[k]);
+    if (fp[0] >= d_fp[1] || d_fp[0] >= fp[1]) {
+      continue;
+    }
+    const auto &dv = views[k].descriptor();
+    if (views[k].pointer() + dv.start != dst.pointer() + dd.start ||
+        dv.strides != dd.strides) {
+      return true;
+    }
+  }
+  return false;
+}
+
+MATRIX_DESIGN_BEGIN_INLINE_VECTORS
+
+// out[0, n) = expr along a run where every leaf is unit-stride, with level
+// I's packs
+template <Isa I, typename T, typename E, typename Ptrs>
+MATRIX_DESIGN_ALWAYS_INLINE inline auto
+evaluate_unit_run(const E &expr, const Ptrs &ptrs, T *out, std::size_t n)
+    -> void {
+  using P = simd::Isa_pack<T, I>;
+  std::size_t i = 0;
+  if constexpr (P::width > 1) {
+    typename P::type v;
+    for (; i + P::width <= n; i += P::width) {
+      expr.template packed<P, 1>(ptrs, i, v);
+      P::store(out + i, v);
+    }
+  }
+  for (; i < n; ++i) {
+    out[i] = expr.template at<1>(ptrs, i);
+  }
+}
+
+// the same along a run where some leaves are broadcast (stride 0) and the
+// others unit-stride; false when level I has no packs for it
+template <Isa I, typename T, typename E, typename Bases, typename Offsets>
+MATRIX_DESIGN_ALWAYS_INLINE inline auto
+evaluate_broadcast_run(const E &expr, const Bases &bases, const Offsets &off,
+                       const Offsets &inner, T *out, std::size_t n) -> bool {
+  using P = simd::Isa_pack<T, I>;
+  if constexpr (P::width > 1) {
+    constexpr std::size_t K = E::leaves + 1;
+    if (n < P::width) {
+      return false;
+    }
+    // a stride-0 leaf is read from a splat of its element, made once per run
+    std::array<std::array<T, P::width>, K> splats;
+    std::array<const T *, K> ptrs;
+    for (std::size_t k = 0; k < K; ++k) {
+      if (inner[k] == 0) {
+        splats[k].fill(bases[k][off[k]]);
+        ptrs[k] = splats[k].data();
+      } else {
+        ptrs[k] = bases[k] + off[k];
+      }
+    }
+    std::size_t i = 0;
+    typename P::type v;
+    for (; i + P::width <= n; i += P::width) {
+      expr.template packed<P, 1>(ptrs, inner, i, v);
+      P::store(out + i, v);
+    }
+    for (; i < n; ++i) {
+      out[i] = expr.template at<1>(bases, off, inner, i);
+    }
+    return true;
+  } else {
+    return false;
+  }
+}
+
+// dst = expr, assuming no leaf aliases the destination
+template <typename T, std::size_t N, typename E>
+auto evaluate_runs(Matrix_ref<T, N> dst, const E &expr) -> void {
+  constexpr std::size_t K = E::leaves + 1;
+  const auto &dd = dst.descriptor();
+  std::array<Matrix_ref<const T, N>, K> views;
+  views[0] = dst;
+  expr.template collect<1>(views);
+
+  std::array<std::array<std::size_t, N>, K> strides;
+  std::array<std::size_t, K> starts;
+  std::array<const T *, K> bases;
+  for (std::size_t k = 0; k < K; ++k) {
+    strides[k] = views[k].descriptor().strides;
+    starts[k] = views[k].descriptor().start;
+    bases[k] = views[k].pointer();
+  }
+  T *d = dst.pointer();
+  const Isa level = matrix_dispatch::isa();
+
+  for_each_run<N, K>(
+      dd.extents, strides, starts,
+      [&](const auto &off, std::size_t n, const auto &inner) {
+        bool unit = true;
+        bool broadcast = inner[0] == 1;
+        for (std::size_t k = 0; k < K; ++k) {
+          unit = unit && inner[k] == 1;
+          broadcast = broadcast && inner[k] <= 1;
+        }
+        if (!unit && broadcast &&
+            dispatch(level, [&](auto isa) MATRIX_DESIGN_ALWAYS_INLINE {
+              return evaluate_broadcast_run<decltype(isa)::value>(
+                  expr, bases, off, inner, d + off[0], n);
+            })) {
+          return;
+        }
+        if (!unit) {
+          for (std::size_t i = 0; i < n; ++i) {
+            d[off[0] + i * inner[0]] =
+                expr.template at<1>(bases, off, inner, i);
+          }
+          return;
+        }
+        std::array<const T *, K> ptrs;
+        for (std::size_t k = 0; k < K; ++k) {
+          ptrs[k] = bases[k] + off[k];
+        }
+        dispatch(level, [&](auto isa) MATRIX_DESIGN_ALWAYS_INLINE {
+          evaluate_unit_run<decltype(isa)::value>(expr, ptrs, d + off[0], n);
+        });
+      });
+}
+
+MATRIX_DESIGN_END_INLINE_VECTORS
+
+template <typename T, std::size_t N, typename E>
+auto aliases(const Matrix_ref<T, N> &dst, const E &expr) -> bool {
+  std::array<Matrix_ref<const T, N>, E::leaves + 1> views;
+  views[0] = dst;
+  expr.template collect<1>(views);
+  return any_alias(dst, views);
+}
+
+template <typename T, std::size_t N, typename E>
+auto evaluate(Matrix_ref<T, N> dst, const E &expr) -> void {
+  static_assert(E::order == N, "expression order must match destination");
+  assert(dst.descriptor().extents == expr.extents());
+  const Kernel_scope scope(matrix_instrument::Kernel::elementwise);
+  if (aliases(dst, expr)) {
+    Matrix<T, N> tmp(expr);
+    evaluate_runs(dst, Expr_leaf<T, N>(tmp));
+    return;
+  }
+  evaluate_runs(dst, expr);
+}
+
+// as above, splitting the outermost dimension according to the policy
+template <typename Policy, typename T, std::size_t N, typename E, typename>
+auto evaluate(const Policy &policy, Matrix_ref<T, N> dst, const E &expr)
+    -> void {
+  static_assert(E::order == N, "expression order must match destination");
+  const auto &dd = dst.descriptor();
+  assert(dd.extents == expr.extents());
+  const Kernel_scope scope(matrix_instrument::Kernel::elementwise);
+  if (aliases(dst, expr)) {
+    Matrix<T, N> tmp(policy, expr);
+    evaluate(policy, dst, Expr_leaf<T, N>(tmp));
+    return;
+  }
+  if (dd.size == 0) {
+    return;
+  }
+  for_each_row_block(policy, dd.extents[0], dd.size / dd.extents[0],
+                     [&](std::size_t first, std::size_t last) {
+                       evaluate_runs(row_range(dst, first, last),
+                                     expr.rows(first, last));
+                     });
+}
+
+} // namespace matrix_impl
@@ -0,0 +1,234 @@
+#pragma once
+
+#include "matrix.h"
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// Fixed_matrix<T, Extents...> is a matrix whose shape is part of its type,
+// for small blocks such as 3x3 and 4x4 transforms. The elements live in an
+// inline std::array (no heap allocation), the strides are compile-time
+// constants and m(i, j) compiles to i * stride + j on constants.
+//
+// A Fixed_matrix converts to Matrix_ref, so it can be passed to gemm/matmul,
+// used in element-wise expressions and copied into a Matrix:
+//
+//   Fixed_matrix<double, 3, 3> r{{0, -1, 0}, {1, 0, 0}, {0, 0, 1}};
+//   Fixed_matrix<double, 3, 3> s = r * 2.0;
+//   Matrix<double, 2> d(s);
+
+namespace matrix_impl {
+
+template <std::size_t... Extents>
+constexpr auto fixed_strides() -> std::array<std::size_t, sizeof...(Extents)> {
+  constexpr std::size_t N = sizeof...(Extents);
+  const std::array<std::size_t, N> extents{Extents...};
+  std::array<std::size_t, N> strides{};
+  std::size_t stride = 1;
+  for (std::size_t i = N; i-- > 0;) {
+    strides[i] = stride;
+    stride *= extents[i];
+  }
+  return strides;
+}
+
+// true if every level of a nested initializer list has the given extent
+template <typename T>
+constexpr auto list_has_extents(std::initializer_list<T> list,
+                                const std::size_t *extents) -> bool {
+  return list.size() == *extents;
+}
+
+template <typename T>
+constexpr auto
+list_has_extents(std::initializer_list<std::initializer_list<T>> list,
+                 const std::size_t *extents) -> bool {
+  if (list.size() != *extents) {
+    return false;
+  }
+  for (const auto &sub : list) {
+    if (!list_has_extents(sub, extents + 1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// copy a nested initializer list, checked by list_has_extents, into out
+template <typename T, typename Out>
+constexpr auto fill_flat(std::initializer_list<T> list, Out &out) -> void {
+  for (const T &x : list) {
+    *out++ = x;
+  }
+}
+
+template <typename T, typename Out>
+constexpr auto fill_flat(std::initializer_list<std::initializer_list<T>> list,
+                         Out &out) -> void {
+  for (const auto &sub : list) {
+    fill_flat(sub, out);
+  }
+}
+
+} // namespace matrix_impl
+
+template <typename T, std::size_t... Extents> class Fixed_matrix {
+public:
+  static constexpr std::size_t order = sizeof...(Extents);
+  static_assert(order > 0, "a Fixed_matrix needs at least one extent");
+  using value_type = T;
+
+  static constexpr std::array<std::size_t, order> extents{Extents...};
+  static constexpr std::array<std::size_t, order> strides =
+      matrix_impl::fixed_strides<Extents...>();
+
+  constexpr Fixed_matrix() = default; // all elements value-initialized
+
+  // a list of another shape throws std::invalid_argument (a compile error
+  // in a constant expression)
+  constexpr Fixed_matrix(Matrix_initializer<T, order> list) {
+    if (!matrix_impl::list_has_extents(list, extents.data())) {
+      throw std::invalid_argument(
+          "Fixed_matrix: initializer list does not match the extents");
+    }
+    T *out = elems.data();
+    matrix_impl::fill_flat(list, out);
+  } // init from list
+
+  template <typename M,
+            typename = Enable_if<matrix_impl::Is_matrix_v<M>, void>>
+  explicit Fixed_matrix(const M &m) {
+    const auto m_r = matrix_impl::as_ref(m);
+    static_assert(decltype(m_r)::order == order, "order must match");
+    assert(m_r.descriptor().extents == extents);
+    matrix_impl::strided_copy(m_r, view());
+  } // copy a Matrix, Matrix_ref or Fixed_matrix of the same shape
+
+  template <typename E,
+            typename = Enable_if<matrix_impl::Is_expr<E>::value, void>,
+            typename = void>
+  Fixed_matrix(const E &expr) {
+    matrix_impl::evaluate(view(), expr);
+  } // evaluate an element-wise expression
+
+  template <typename E,
+            typename = Enable_if<matrix_impl::Is_expr<E>::value, void>>
+  auto operator=(const E &expr) -> Fixed_matrix & {
+    matrix_impl::evaluate(view(), expr);
+    return *this;
+  } // assign from an expression
+
+  [[nodiscard]] static constexpr auto extent(std::size_t n) -> std::size_t {
+    return extents[n];
+  } // # elements in the nth dimension
+  [[nodiscard]] static constexpr auto size() -> std::size_t {
+    return (Extents * ...);
+  } // total number of elements
+
+  static auto descriptor() -> Matrix_slice<order> {
+    Matrix_slice<order> desc;
+    desc.size = size();
+    desc.start = 0;
+    desc.extents = extents;
+    desc.strides = strides;
+    return desc;
+  } // the slice defining subscripting
+
+  constexpr auto data() -> T * { return elems.data(); }
+  constexpr auto data() const -> const T * { return elems.data(); }
+
+  // offset of an element: a sum of products with constant strides
+  template <typename... Args>
+  static constexpr auto offset(Args... args) -> std::size_t {
+    static_assert(sizeof...(Args) == order, "one subscript per dimension");
+    return matrix_impl::dot_strides(strides, std::make_index_sequence<order>{},
+                                    args...);
+  }
+
+  template <typename... Args>
+  constexpr auto operator()(Args... args)
+      -> Enable_if<matrix_impl::Requesting_element<Args...>(), T &> {
+    assert(matrix_impl::check_bounds<order>(extents, args...));
+    return elems[offset(args...)];
+  }
+
+  template <typename... Args>
+  constexpr auto operator()(Args... args) const
+      -> Enable_if<matrix_impl::Requesting_element<Args...>(), const T &> {
+    assert(matrix_impl::check_bounds<order>(extents, args...));
+    return elems[offset(args...)];
+  }
+
+  // element access without the debug-build bounds check
+  template <typename... Args>
+  constexpr auto unchecked(Args... args)
+      -> Enable_if<matrix_impl::Requesting_element<Args...>(), T &> {
+    return elems[offset(args...)];
+  }
+
+  template <typename... Args>
+  constexpr auto unchecked(Args... args) const
+      -> Enable_if<matrix_impl::Requesting_element<Args...>(), const T &> {
+    return elems[offset(args...)];
+  }
+
+  // element access that throws std::out_of_range for a bad subscript
+  template <typename... Args>
+  constexpr auto at(Args... args)
+      -> Enable_if<matrix_impl::Requesting_element<Args...>(), T &> {
+    if (!matrix_impl::check_bounds<order>(extents, args...)) {
+      throw std::out_of_range("Fixed_matrix::at: subscript out of range");
+    }
+    return elems[offset(args...)];
+  }
+
+  template <typename... Args>
+  constexpr auto at(Args... args) const
+      -> Enable_if<matrix_impl::Requesting_element<Args...>(), const T &> {
+    if (!matrix_impl::check_bounds<order>(extents, args...)) {
+      throw std::out_of_range("Fixed_matrix::at: subscript out of range");
+    }
+    return elems[offset(args...)];
+  }
+
+  auto row(std::size_t n) -> Matrix_ref<T, order - 1> {
+    assert(n < extents[0]);
+    Matrix_slice<order - 1> row;
+    slice_dim<0, T, order>(n, descriptor(), row);
+    return {row, data()};
+  }
+
+  auto row(std::size_t n) const -> Matrix_ref<const T, order - 1> {
+    assert(n < extents[0]);
+    Matrix_slice<order - 1> row;
+    slice_dim<0, T, order>(n, descriptor(), row);
+    return {row, data()};
+  }
+
+  auto view() -> Matrix_ref<T, order> { return {descriptor(), data()}; }
+  auto view() const -> Matrix_ref<const T, order> {
+    return {descriptor(), data()};
+  }
+
+  operator Matrix_ref<T, order>() { return view(); } // view of the whole
+  operator Matrix_ref<const T, order>() const { return view(); }
+
+  friend constexpr auto operator==(const Fixed_matrix &a,
+                                   const Fixed_matrix &b) -> bool {
+    return a.elems == b.elems;
+  }
+
+private:
+  std::array<T, (Extents * ...)> elems{};
+};
+
+namespace matrix_impl {
+
+template <typename T, std::size_t... Extents>
+struct Is_matrix<Fixed_matrix<T, Extents...>> : std::true_type {};
+
+} // namespace matrix_impl
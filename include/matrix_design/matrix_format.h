@@ -0,0 +1,201 @@
+#pragma once
+
+#include "matrix_ref.h"
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <locale>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include <fmt/format.h>
+
+// Text formatting of matrices and views with fmt.
+//
+//   format_matrix(m)         the text of m as a std::string
+//   write_matrix(os, m)      the same text, sent to os in a single write
+//
+// The text of a matrix is built in one growing buffer, with floating-point
+// elements printed to options.precision significant digits. A matrix with
+// more than options.threshold elements is summarized: every dimension
+// longer than 2 * edge_items shows only its first and last edge_items
+// entries around a "...", so printing a huge matrix costs no more than
+// printing a small one. operator<< prints through this formatter, with the
+// precision of the stream and without summarizing; a stream with other
+// format flags (fixed, hex, showpos, ...), a field width or a locale set
+// gets the same layout with each element written by its own operator<<.
+
+struct Format_options {
+  int precision = 6;            // significant digits of floating point
+  std::size_t threshold = 1000; // summarize matrices with more elements
+  std::size_t edge_items = 3;   // entries kept at each end when summarizing
+};
+
+namespace matrix_impl {
+
+template <typename T>
+auto format_element(fmt::memory_buffer &out, const T &x, int precision)
+    -> void {
+  if constexpr (std::is_floating_point_v<T>) {
+    fmt::format_to(std::back_inserter(out), "{:.{}g}", x, precision);
+  } else if constexpr (fmt::is_formattable<T>::value) {
+    fmt::format_to(std::back_inserter(out), "{}", x);
+  } else { // anything else through its operator<<
+    std::ostringstream s;
+    s << x;
+    const std::string text = s.str();
+    out.append(text.data(), text.data() + text.size());
+  }
+}
+
+// text built in a buffer, elements printed by fmt
+struct Buffer_text {
+  fmt::memory_buffer &out;
+  int precision;
+
+  auto put(std::string_view s) -> void { out.append(s); }
+  auto spaces(std::size_t n) -> void {
+    std::fill_n(std::back_inserter(out), n, ' ');
+  }
+  template <typename T> auto element(const T &x) -> void {
+    format_element(out, x, precision);
+  }
+};
+
+// text sent straight to a stream, elements printed by its operator<<
+struct Stream_text {
+  std::ostream &os;
+
+  auto put(std::string_view s) -> void { os << s; }
+  auto spaces(std::size_t n) -> void {
+    for (std::size_t i = 0; i < n; ++i) {
+      os << ' ';
+    }
+  }
+  template <typename T> auto element(const T &x) -> void { os << x; }
+};
+
+// the entries of dimension `dim` of the view whose first element is p
+template <typename Out, typename T, std::size_t N>
+auto format_dim(Out &out, const T *p,
+                const Matrix_slice<N> &desc, std::size_t dim,
+                const Format_options &options, bool summarize) -> void {
+  const std::size_t n = desc.extents[dim];
+  const std::size_t stride = desc.strides[dim];
+  const bool cut = summarize && n > 2 * options.edge_items;
+  // rows are separated by a newline, blocks of rows by an empty line too
+  const std::string_view separator = N - dim > 2 ? ",\n\n" : ",\n";
+  if (cut && options.edge_items == 0) { // no entries kept at all
+    out.put("[...]");
+    return;
+  }
+  out.put("[");
+  for (std::size_t i = 0; i < n; ++i) {
+    if (cut && i == options.edge_items) {
+      if (dim + 1 == N) {
+        out.put("..., ");
+      } else {
+        out.spaces(dim + 1);
+        out.put("...");
+        out.put(separator);
+      }
+      i = n - options.edge_items;
+    }
+    if (dim + 1 == N) {
+      out.element(p[i * stride]);
+      if (i + 1 < n) {
+        out.put(", ");
+      }
+      continue;
+    }
+    if (i > 0) {
+      out.spaces(dim + 1);
+    }
+    format_dim(out, p + i * stride, desc, dim + 1, options, summarize);
+    if (i + 1 < n) {
+      out.put(separator);
+    }
+  }
+  out.put("]");
+}
+
+// append the text of a view to out
+template <typename T, std::size_t N>
+auto format_to(fmt::memory_buffer &out, const Matrix_ref<T, N> &m_r,
+               const Format_options &options) -> void {
+  const auto &desc = m_r.descriptor();
+  const bool summarize = desc.size > options.threshold;
+  std::size_t shown = 1;
+  for (std::size_t d = 0; d < N; ++d) {
+    const std::size_t n = desc.extents[d];
+    shown *= summarize && n > 2 * options.edge_items ? 2 * options.edge_items
+                                                     : n;
+  }
+  // a guess at the digits and separators per element
+  out.reserve(out.size() + shown * (options.precision + 8));
+  Buffer_text text{out, options.precision};
+  format_dim(text, m_r.pointer() + desc.start, desc, 0, options, summarize);
+}
+
+// whether fmt prints elements as the stream would: no flags set but the
+// defaults, no field width and the classic locale (the precision is passed
+// on to fmt)
+inline auto plain_stream(const std::ostream &os) -> bool {
+  const std::ios_base::fmtflags flags =
+      os.flags() & ~(std::ios_base::skipws | std::ios_base::unitbuf);
+  return flags == std::ios_base::dec && os.width() == 0 &&
+         os.getloc() == std::locale::classic();
+}
+
+// the options operator<< uses for a stream
+inline auto stream_format_options(const std::ostream &os) -> Format_options {
+  Format_options options;
+  options.precision = static_cast<int>(os.precision());
+  options.threshold = std::numeric_limits<std::size_t>::max();
+  return options;
+}
+
+// the read-only view of any matrix type that converts to one
+template <typename M>
+using Format_view =
+    Matrix_ref<const std::remove_const_t<typename M::value_type>, M::order>;
+
+} // namespace matrix_impl
+
+template <typename M, typename = matrix_impl::Format_view<M>>
+auto format_matrix(const M &m, const Format_options &options = {})
+    -> std::string {
+  fmt::memory_buffer out;
+  matrix_impl::format_to(out, matrix_impl::Format_view<M>(m), options);
+  return fmt::to_string(out);
+}
+
+template <typename M, typename = matrix_impl::Format_view<M>>
+auto write_matrix(std::ostream &os, const M &m,
+                  const Format_options &options = {}) -> std::ostream & {
+  fmt::memory_buffer out;
+  matrix_impl::format_to(out, matrix_impl::Format_view<M>(m), options);
+  return os.write(out.data(), static_cast<std::streamsize>(out.size()));
+}
+
+namespace matrix_impl {
+
+// the text operator<< sends to os
+template <typename M>
+auto stream_matrix(std::ostream &os, const M &m) -> std::ostream & {
+  const Format_options options = stream_format_options(os);
+  if (plain_stream(os)) {
+    return write_matrix(os, m, options);
+  }
+  const Format_view<M> view(m);
+  const auto &desc = view.descriptor();
+  Stream_text text{os};
+  format_dim(text, view.pointer() + desc.start, desc, 0, options, false);
+  return os;
+}
+
+} // namespace matrix_impl
@@ -0,0 +1,703 @@
+#pragma once
+
+#include "matrix.h"
+#include "matrix_instrument.h"
+#include "matrix_simd.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// General matrix multiply C = alpha * A * B + beta * C.
+//
+// The driver follows the usual packed-panel layering: B is packed into
+// kc x nc panels that live in L3, A into mc x kc blocks that live in L2, and
+// a register-resident mr x nr micro-kernel streams both packed buffers out of
+// L1. Packing reads operands through arbitrary row/column strides, so
+// non-contiguous Matrix_ref views (column slices, sub-blocks, ...) run at the
+// same speed as dense matrices once packed. Under a parallel policy the
+// rows of C are split into whole mc-row blocks run on the thread pool.
+//
+// Batched products (gemm_batched, matmul_batched) multiply stacks of
+// matrices held as order-3 operands, batch first. An order-2 operand, or
+// one with a batch extent of 1 (such as a broadcast_to view), is shared by
+// every batch. Small products skip packing: with at most 12 columns, tiles
+// of four rows of C stay in registers with the column count fixed at
+// compile time, so batches of tiny matrices cost no packing or dispatch per
+// product. Parallel policies split the batch dimension.
+//
+// A and B may be float16 or bfloat16 with a float C: packing widens them,
+// so the narrow operands cost half the memory traffic and the micro-kernel
+// is the float one.
+//
+// The micro-kernel, and with it the register tile, follows the instruction
+// set level picked at run time (see matrix_dispatch.h): 6 x 16 doubles or
+// 6 x 32 floats in zmm registers with AVX-512, 6 x 8 or 6 x 16 in ymm
+// registers with AVX2, and a plain loop the compiler vectorizes otherwise.
+
+namespace matrix_impl {
+
+// register tile (mr x nr) and cache blocking (kc, mc, nc) per element type
+// and instruction set level
+template <typename T, Isa I> struct Gemm_blocking {
+  static constexpr std::size_t mr = 4;
+  static constexpr std::size_t nr = 4;
+  static constexpr std::size_t kc = 256;
+  static constexpr std::size_t mc = 64;
+  static constexpr std::size_t nc = 1024;
+};
+
+template <Isa I> struct Gemm_blocking<double, I> {
+  static constexpr std::size_t mr = 6;
+  static constexpr std::size_t nr = 8;
+  static constexpr std::size_t kc = 256;
+  static constexpr std::size_t mc = 96;
+  static constexpr std::size_t nc = 2048;
+};
+
+template <Isa I> struct Gemm_blocking<float, I> {
+  static constexpr std::size_t mr = 6;
+  static constexpr std::size_t nr = 16;
+  static constexpr std::size_t kc = 384;
+  static constexpr std::size_t mc = 96;
+  static constexpr std::size_t nc = 4096;
+};
+
+template <> struct Gemm_blocking<double, Isa::avx512> {
+  static constexpr std::size_t mr = 6;
+  static constexpr std::size_t nr = 16;
+  static constexpr std::size_t kc = 256;
+  static constexpr std::size_t mc = 96;
+  static constexpr std::size_t nc = 2048;
+};
+
+template <> struct Gemm_blocking<float, Isa::avx512> {
+  static constexpr std::size_t mr = 6;
+  static constexpr std::size_t nr = 32;
+  static constexpr std::size_t kc = 384;
+  static constexpr std::size_t mc = 96;
+  static constexpr std::size_t nc = 4096;
+};
+
+// pack an mc x kc block of A into row panels of height mr; rows beyond mc
+// are zero padded so the micro-kernel never needs an edge case. A narrower
+// element type (float16, bfloat16) is widened to T on the way.
+template <typename T, std::size_t MR, typename U>
+auto pack_a(std::size_t mc, std::size_t kc, const U *a, std::size_t rsa,
+            std::size_t csa, T *buf) -> void {
+  for (std::size_t ir = 0; ir < mc; ir += MR) {
+    const std::size_t mr = std::min(MR, mc - ir);
+    const U *panel = a + ir * rsa;
+    for (std::size_t p = 0; p < kc; ++p) {
+      const U *col = panel + p * csa;
+      for (std::size_t i = 0; i < mr; ++i) {
+        buf[i] = static_cast<T>(col[i * rsa]);
+      }
+      for (std::size_t i = mr; i < MR; ++i) {
+        buf[i] = T{};
+      }
+      buf += MR;
+    }
+  }
+}
+
+// pack a kc x nc panel of B into column panels of width nr, widening it
+// like A with level I's conversions
+template <Isa I, typename T, std::size_t NR, typename U>
+auto pack_b(std::size_t kc, std::size_t nc, const U *b, std::size_t rsb,
+            std::size_t csb, T *buf) -> void {
+  for (std::size_t jr = 0; jr < nc; jr += NR) {
+    const std::size_t nr = std::min(NR, nc - jr);
+    const U *panel = b + jr * csb;
+    for (std::size_t p = 0; p < kc; ++p) {
+      const U *row = panel + p * rsb;
+      if (nr == NR && csb == 1) {
+        if constexpr (std::is_same_v<T, U>) {
+          std::copy(row, row + NR, buf);
+        } else {
+          convert_kernel<I>(NR, row, buf);
+        }
+      } else {
+        for (std::size_t j = 0; j < nr; ++j) {
+          buf[j] = static_cast<T>(row[j * csb]);
+        }
+        for (std::size_t j = nr; j < NR; ++j) {
+          buf[j] = T{};
+        }
+      }
+      buf += NR;
+    }
+  }
+}
+
+// ab = sum over p of a[:, p] * b[p, :] for one packed mr x nr tile; written
+// so the compiler keeps the accumulators in vector registers
+template <Isa I, typename T, std::size_t MR, std::size_t NR>
+auto micro_kernel(std::size_t kc, const T *a, const T *b, T *ab) -> void {
+  T acc[MR][NR] = {};
+  for (std::size_t p = 0; p < kc; ++p) {
+    for (std::size_t i = 0; i < MR; ++i) {
+      const T a_ip = a[i];
+      for (std::size_t j = 0; j < NR; ++j) {
+        acc[i][j] += a_ip * b[j];
+      }
+    }
+    a += MR;
+    b += NR;
+  }
+  for (std::size_t i = 0; i < MR; ++i) {
+    for (std::size_t j = 0; j < NR; ++j) {
+      ab[i * NR + j] = acc[i][j];
+    }
+  }
+}
+
+#if defined(MATRIX_DESIGN_HAS_AVX2)
+// 6 x 8 doubles: twelve ymm accumulators, two B loads and one broadcast
+template <>
+MATRIX_DESIGN_TARGET_AVX2 inline auto
+micro_kernel<Isa::avx2, double, 6, 8>(std::size_t kc, const double *a,
+                                      const double *b, double *ab) -> void {
+  __m256d c[6][2];
+  for (auto &row : c) {
+    row[0] = _mm256_setzero_pd();
+    row[1] = _mm256_setzero_pd();
+  }
+  for (std::size_t p = 0; p < kc; ++p) {
+    const __m256d b0 = _mm256_loadu_pd(b);
+    const __m256d b1 = _mm256_loadu_pd(b + 4);
+    for (std::size_t i = 0; i < 6; ++i) {
+      const __m256d a_ip = _mm256_broadcast_sd(a + i);
+      c[i][0] = _mm256_fmadd_pd(a_ip, b0, c[i][0]);
+      c[i][1] = _mm256_fmadd_pd(a_ip, b1, c[i][1]);
+    }
+    a += 6;
+    b += 8;
+  }
+  for (std::size_t i = 0; i < 6; ++i) {
+    _mm256_storeu_pd(ab + i * 8, c[i][0]);
+    _mm256_storeu_pd(ab + i * 8 + 4, c[i][1]);
+  }
+}
+
+// 6 x 16 floats, same register budget as the double kernel
+template <>
+MATRIX_DESIGN_TARGET_AVX2 inline auto
+micro_kernel<Isa::avx2, float, 6, 16>(std::size_t kc, const float *a,
+                                      const float *b, float *ab) -> void {
+  __m256 c[6][2];
+  for (auto &row : c) {
+    row[0] = _mm256_setzero_ps();
+    row[1] = _mm256_setzero_ps();
+  }
+  for (std::size_t p = 0; p < kc; ++p) {
+    const __m256 b0 = _mm256_loadu_ps(b);
+    const __m256 b1 = _mm256_loadu_ps(b + 8);
+    for (std::size_t i = 0; i < 6; ++i) {
+      const __m256 a_ip = _mm256_broadcast_ss(a + i);
+      c[i][0] = _mm256_fmadd_ps(a_ip, b0, c[i][0]);
+      c[i][1] = _mm256_fmadd_ps(a_ip, b1, c[i][1]);
+    }
+    a += 6;
+    b += 16;
+  }
+  for (std::size_t i = 0; i < 6; ++i) {
+    _mm256_storeu_ps(ab + i * 16, c[i][0]);
+    _mm256_storeu_ps(ab + i * 16 + 8, c[i][1]);
+  }
+}
+#endif
+
+#if defined(MATRIX_DESIGN_HAS_AVX512)
+// 6 x 16 doubles: the AVX2 kernel's shape with zmm registers, which hold
+// twice the columns; twelve of the 32 registers accumulate
+template <>
+MATRIX_DESIGN_TARGET_AVX512 inline auto
+micro_kernel<Isa::avx512, double, 6, 16>(std::size_t kc, const double *a,
+                                         const double *b, double *ab)
+    -> void {
+  __m512d c[6][2];
+  for (auto &row : c) {
+    row[0] = _mm512_setzero_pd();
+    row[1] = _mm512_setzero_pd();
+  }
+  for (std::size_t p = 0; p < kc; ++p) {
+    const __m512d b0 = _mm512_loadu_pd(b);
+    const __m512d b1 = _mm512_loadu_pd(b + 8);
+    for (std::size_t i = 0; i < 6; ++i) {
+      const __m512d a_ip = _mm512_set1_pd(a[i]);
+      c[i][0] = _mm512_fmadd_pd(a_ip, b0, c[i][0]);
+      c[i][1] = _mm512_fmadd_pd(a_ip, b1, c[i][1]);
+    }
+    a += 6;
+    b += 16;
+  }
+  for (std::size_t i = 0; i < 6; ++i) {
+    _mm512_storeu_pd(ab + i * 16, c[i][0]);
+    _mm512_storeu_pd(ab + i * 16 + 8, c[i][1]);
+  }
+}
+
+// 6 x 32 floats
+template <>
+MATRIX_DESIGN_TARGET_AVX512 inline auto
+micro_kernel<Isa::avx512, float, 6, 32>(std::size_t kc, const float *a,
+                                        const float *b, float *ab) -> void {
+  __m512 c[6][2];
+  for (auto &row : c) {
+    row[0] = _mm512_setzero_ps();
+    row[1] = _mm512_setzero_ps();
+  }
+  for (std::size_t p = 0; p < kc; ++p) {
+    const __m512 b0 = _mm512_loadu_ps(b);
+    const __m512 b1 = _mm512_loadu_ps(b + 16);
+    for (std::size_t i = 0; i < 6; ++i) {
+      const __m512 a_ip = _mm512_set1_ps(a[i]);
+      c[i][0] = _mm512_fmadd_ps(a_ip, b0, c[i][0]);
+      c[i][1] = _mm512_fmadd_ps(a_ip, b1, c[i][1]);
+    }
+    a += 6;
+    b += 32;
+  }
+  for (std::size_t i = 0; i < 6; ++i) {
+    _mm512_storeu_ps(ab + i * 32, c[i][0]);
+    _mm512_storeu_ps(ab + i * 32 + 16, c[i][1]);
+  }
+}
+#endif
+
+// C tile = alpha * ab + beta * C tile, clipped to the valid m x n corner;
+// beta == 0 never reads C so uninitialized destinations are fine
+template <typename T, std::size_t NR>
+auto update_tile(std::size_t m, std::size_t n, T alpha, const T *ab, T beta,
+                 T *c, std::size_t rsc, std::size_t csc) -> void {
+  for (std::size_t i = 0; i < m; ++i) {
+    T *c_row = c + i * rsc;
+    if (beta == T{}) {
+      for (std::size_t j = 0; j < n; ++j) {
+        c_row[j * csc] = alpha * ab[i * NR + j];
+      }
+    } else {
+      for (std::size_t j = 0; j < n; ++j) {
+        c_row[j * csc] = alpha * ab[i * NR + j] + beta * c_row[j * csc];
+      }
+    }
+  }
+}
+
+template <typename T>
+auto scale(std::size_t m, std::size_t n, T beta, T *c, std::size_t rsc,
+           std::size_t csc) -> void {
+  for (std::size_t i = 0; i < m; ++i) {
+    for (std::size_t j = 0; j < n; ++j) {
+      T &c_ij = c[i * rsc + j * csc];
+      c_ij = beta == T{} ? T{} : beta * c_ij;
+    }
+  }
+}
+
+// packing buffers are reused across calls on the same thread
+template <typename T> auto gemm_buffer(std::size_t slot, std::size_t n) -> T * {
+  thread_local std::vector<T> buffers[2];
+  if (buffers[slot].size() < n) {
+    buffers[slot].resize(n);
+  }
+  return buffers[slot].data();
+}
+
+// the macro-kernel: every mr x nr tile of one packed mc x nc block of C
+template <Isa I, typename T>
+auto gemm_block(std::size_t mc, std::size_t nc, std::size_t kc, T alpha,
+                const T *packed_a, const T *packed_b, T beta, T *c,
+                std::size_t rsc, std::size_t csc) -> void {
+  constexpr std::size_t MR = Gemm_blocking<T, I>::mr;
+  constexpr std::size_t NR = Gemm_blocking<T, I>::nr;
+  alignas(64) T ab[MR * NR];
+  for (std::size_t jr = 0; jr < nc; jr += NR) {
+    const std::size_t nr = std::min(NR, nc - jr);
+    for (std::size_t ir = 0; ir < mc; ir += MR) {
+      const std::size_t mr = std::min(MR, mc - ir);
+      micro_kernel<I, T, MR, NR>(kc, packed_a + ir * kc, packed_b + jr * kc,
+                                 ab);
+      update_tile<T, NR>(mr, nr, alpha, ab, beta, c + ir * rsc + jr * csc,
+                         rsc, csc);
+    }
+  }
+}
+
+// the packed product below with level I's micro-kernel, for k > 0
+template <Isa I, typename T, typename TA, typename TB>
+auto gemm_blocked(std::size_t m, std::size_t n, std::size_t k, T alpha,
+                  const TA *a, std::size_t rsa, std::size_t csa, const TB *b,
+                  std::size_t rsb, std::size_t csb, T beta, T *c,
+                  std::size_t rsc, std::size_t csc) -> void {
+  using Blocking = Gemm_blocking<T, I>;
+  constexpr std::size_t MR = Blocking::mr;
+  constexpr std::size_t NR = Blocking::nr;
+  const std::size_t nc_max = std::min(Blocking::nc, (n + NR - 1) / NR * NR);
+  const std::size_t mc_max = std::min(Blocking::mc, (m + MR - 1) / MR * MR);
+  const std::size_t kc_max = std::min(Blocking::kc, k);
+  T *packed_b = gemm_buffer<T>(0, kc_max * nc_max);
+  T *packed_a = gemm_buffer<T>(1, kc_max * mc_max);
+
+  for (std::size_t jc = 0; jc < n; jc += Blocking::nc) {
+    const std::size_t nc = std::min(Blocking::nc, n - jc);
+    for (std::size_t pc = 0; pc < k; pc += Blocking::kc) {
+      const std::size_t kc = std::min(Blocking::kc, k - pc);
+      // only the first pass over k applies the caller's beta
+      const T beta_pc = pc == 0 ? beta : T{1};
+      pack_b<I, T, NR>(kc, nc, b + pc * rsb + jc * csb, rsb, csb, packed_b);
+      for (std::size_t ic = 0; ic < m; ic += Blocking::mc) {
+        const std::size_t mc = std::min(Blocking::mc, m - ic);
+        pack_a<T, MR>(mc, kc, a + ic * rsa + pc * csa, rsa, csa, packed_a);
+        gemm_block<I, T>(mc, nc, kc, alpha, packed_a, packed_b, beta_pc,
+                         c + ic * rsc + jc * csc, rsc, csc);
+      }
+    }
+  }
+}
+
+// C (m x n) = alpha * A (m x k) * B (k x n) + beta * C, every operand given
+// by a pointer to its first element plus row and column strides; A and B
+// may hold a narrower type than C, which they are widened to when packed
+template <typename T, typename TA, typename TB>
+auto gemm(std::size_t m, std::size_t n, std::size_t k, T alpha, const TA *a,
+          std::size_t rsa, std::size_t csa, const TB *b, std::size_t rsb,
+          std::size_t csb, T beta, T *c, std::size_t rsc, std::size_t csc)
+    -> void {
+  if (m == 0 || n == 0) {
+    return;
+  }
+  if (k == 0 || alpha == T{}) {
+    scale(m, n, beta, c, rsc, csc);
+    return;
+  }
+  dispatch([&](auto isa) {
+    gemm_blocked<decltype(isa)::value>(m, n, k, alpha, a, rsa, csa, b, rsb,
+                                       csb, beta, c, rsc, csc);
+  });
+}
+
+// as above, with the rows of C split into whole mc-row blocks across the
+// thread pool when the policy asks for it
+template <typename Policy, typename T, typename TA, typename TB>
+auto gemm(const Policy &policy, std::size_t m, std::size_t n, std::size_t k,
+          T alpha, const TA *a, std::size_t rsa, std::size_t csa,
+          const TB *b, std::size_t rsb, std::size_t csb, T beta, T *c,
+          std::size_t rsc, std::size_t csc) -> void {
+  const Kernel_scope scope(matrix_instrument::Kernel::gemm);
+  // the same at every level
+  constexpr std::size_t mc = Gemm_blocking<T, Isa::scalar>::mc;
+  const std::size_t blocks = (m + mc - 1) / mc;
+  for_each_row_block(policy, blocks, mc * n * std::max<std::size_t>(k, 1),
+                     [&](std::size_t first, std::size_t last) {
+                       const std::size_t i0 = first * mc;
+                       const std::size_t i1 = std::min(m, last * mc);
+                       gemm<T>(i1 - i0, n, k, alpha, a + i0 * rsa, rsa, csa,
+                               b, rsb, csb, beta, c + i0 * rsc, rsc, csc);
+                     });
+}
+
+template <typename M>
+using Enable_if_matrix_2d =
+    Enable_if<Is_matrix_v<M> && (std::remove_cv_t<M>::order == 2), void>;
+
+} // namespace matrix_impl
+
+// c = alpha * a * b + beta * c on any combination of matrices and views,
+// with the work split according to the policy
+template <typename Policy, typename T, typename A, typename B,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy>,
+                               void>,
+          typename = matrix_impl::Enable_if_matrix_2d<A>,
+          typename = matrix_impl::Enable_if_matrix_2d<B>>
+auto gemm(const Policy &policy, T alpha, const A &a, const B &b, T beta,
+          Matrix_ref<T, 2> c) -> void {
+  static_assert(std::is_same_v<Compute_type<matrix_impl::Value_type<A>>, T> &&
+                    std::is_same_v<Compute_type<matrix_impl::Value_type<B>>, T>,
+                "gemm operands must hold the element type of c, or float16 "
+                "or bfloat16 for a float c");
+  const auto a_r = matrix_impl::as_ref(a);
+  const auto b_r = matrix_impl::as_ref(b);
+  const auto &da = a_r.descriptor();
+  const auto &db = b_r.descriptor();
+  const auto &dc = c.descriptor();
+  assert(da.extents[1] == db.extents[0]);
+  assert(dc.extents[0] == da.extents[0] && dc.extents[1] == db.extents[1]);
+  matrix_impl::gemm(policy, dc.extents[0], dc.extents[1], da.extents[1],
+                    alpha, a_r.pointer() + da.start, da.strides[0],
+                    da.strides[1], b_r.pointer() + db.start, db.strides[0],
+                    db.strides[1], beta, c.pointer() + dc.start,
+                    dc.strides[0], dc.strides[1]);
+}
+
+template <typename T, typename A, typename B,
+          typename = matrix_impl::Enable_if_matrix_2d<A>,
+          typename = matrix_impl::Enable_if_matrix_2d<B>>
+auto gemm(T alpha, const A &a, const B &b, T beta, Matrix_ref<T, 2> c)
+    -> void {
+  gemm(matrix_execution::seq, alpha, a, b, beta, c);
+}
+
+// matrix product of two order-2 operands; either side may be a strided view,
+// and float16 or bfloat16 operands give a float product
+template <typename A, typename B,
+          typename = matrix_impl::Enable_if_matrix_2d<A>,
+          typename = matrix_impl::Enable_if_matrix_2d<B>>
+auto matmul(const A &a, const B &b)
+    -> Matrix<Compute_type<matrix_impl::Value_type<A>>, 2> {
+  using T = Compute_type<matrix_impl::Value_type<A>>;
+  static_assert(std::is_same_v<T, Compute_type<matrix_impl::Value_type<B>>>,
+                "matmul operands must share an element type");
+  Matrix<T, 2> c(a.extent(0), b.extent(1));
+  gemm(T{1}, a, b, T{0}, Matrix_ref<T, 2>(c));
+  return c;
+}
+
+template <typename A, typename B,
+          typename = matrix_impl::Enable_if_matrix_2d<A>,
+          typename = matrix_impl::Enable_if_matrix_2d<B>>
+auto operator*(const A &a, const B &b)
+    -> Matrix<Compute_type<matrix_impl::Value_type<A>>, 2> {
+  return matmul(a, b);
+}
+
+namespace matrix_impl {
+
+// products with at most this many columns and multiply-adds per batch skip
+// packing; beyond them the packed kernel is faster even for one product
+inline constexpr std::size_t small_gemm_cols_max = 12;
+inline constexpr std::size_t small_gemm_work = 32 * 32 * 32;
+
+// R rows of C with NC columns = alpha * A * B + beta * C, the whole tile
+// accumulated in registers; R independent rows hide the FMA latency
+template <std::size_t R, std::size_t NC, bool UnitB, typename T>
+auto small_gemm_tile(std::size_t k, T alpha, const T *a, std::size_t rsa,
+                     std::size_t csa, const T *b, std::size_t rsb,
+                     std::size_t csb, T beta, T *c, std::size_t rsc,
+                     std::size_t csc) -> void {
+  std::array<std::array<T, NC>, R> acc{};
+  for (std::size_t p = 0; p < k; ++p) {
+    const T *b_row = b + p * rsb;
+    std::array<T, NC> b_p;
+    for (std::size_t j = 0; j < NC; ++j) {
+      b_p[j] = UnitB ? b_row[j] : b_row[j * csb];
+    }
+    for (std::size_t r = 0; r < R; ++r) {
+      const T x = a[r * rsa + p * csa];
+      for (std::size_t j = 0; j < NC; ++j) {
+        acc[r][j] += x * b_p[j];
+      }
+    }
+  }
+  for (std::size_t r = 0; r < R; ++r) {
+    T *c_row = c + r * rsc;
+    for (std::size_t j = 0; j < NC; ++j) {
+      T &c_ij = c_row[j * csc];
+      c_ij = beta == T{} ? alpha * acc[r][j] : alpha * acc[r][j] + beta * c_ij;
+    }
+  }
+}
+
+template <std::size_t NC, bool UnitB, typename T>
+auto small_gemm_cols(std::size_t m, std::size_t k, T alpha, const T *a,
+                     std::size_t rsa, std::size_t csa, const T *b,
+                     std::size_t rsb, std::size_t csb, T beta, T *c,
+                     std::size_t rsc, std::size_t csc) -> void {
+  std::size_t i = 0;
+  for (; i + 4 <= m; i += 4) {
+    small_gemm_tile<4, NC, UnitB>(k, alpha, a + i * rsa, rsa, csa, b, rsb,
+                                  csb, beta, c + i * rsc, rsc, csc);
+  }
+  for (; i < m; ++i) {
+    small_gemm_tile<1, NC, UnitB>(k, alpha, a + i * rsa, rsa, csa, b, rsb,
+                                  csb, beta, c + i * rsc, rsc, csc);
+  }
+}
+
+// C = alpha * A * B + beta * C for C with NC columns (n == NC)
+template <std::size_t NC, typename T>
+auto small_gemm_cols(std::size_t m, std::size_t /*n*/, std::size_t k,
+                     T alpha, const T *a, std::size_t rsa, std::size_t csa,
+                     const T *b, std::size_t rsb, std::size_t csb, T beta,
+                     T *c, std::size_t rsc, std::size_t csc) -> void {
+  if (csb == 1) {
+    small_gemm_cols<NC, true>(m, k, alpha, a, rsa, csa, b, rsb, csb, beta, c,
+                              rsc, csc);
+  } else {
+    small_gemm_cols<NC, false>(m, k, alpha, a, rsa, csa, b, rsb, csb, beta,
+                               c, rsc, csc);
+  }
+}
+
+template <typename T>
+using Gemm_kernel = void (*)(std::size_t, std::size_t, std::size_t, T,
+                             const T *, std::size_t, std::size_t, const T *,
+                             std::size_t, std::size_t, T, T *, std::size_t,
+                             std::size_t);
+
+// small_gemm_cols compiled for level I
+template <Isa I, std::size_t NC, typename T>
+auto small_gemm_cols_at(std::size_t m, std::size_t n, std::size_t k, T alpha,
+                        const T *a, std::size_t rsa, std::size_t csa,
+                        const T *b, std::size_t rsb, std::size_t csb, T beta,
+                        T *c, std::size_t rsc, std::size_t csc) -> void {
+  isa_call<I>([&](auto /*isa*/) {
+    small_gemm_cols<NC>(m, n, k, alpha, a, rsa, csa, b, rsb, csb, beta, c,
+                        rsc, csc);
+  });
+}
+
+template <Isa I, typename T, std::size_t... NC>
+auto small_gemm_cols_table(std::index_sequence<NC...> /*cols*/) {
+  return std::array<Gemm_kernel<T>, sizeof...(NC)>{
+      &small_gemm_cols_at<I, NC + 1, T>...};
+}
+
+// the kernel for one m x n x k product of a batch, at the level in use
+template <typename T>
+auto batch_kernel(std::size_t m, std::size_t n, std::size_t k)
+    -> Gemm_kernel<T> {
+  if (n > small_gemm_cols_max || m * n * k > small_gemm_work) {
+    return &gemm<T, T, T>;
+  }
+  return dispatch([n](auto isa) -> Gemm_kernel<T> {
+    static const auto table = small_gemm_cols_table<decltype(isa)::value, T>(
+        std::make_index_sequence<small_gemm_cols_max>{});
+    return table[n - 1];
+  });
+}
+
+// batches of C (m x n) = alpha * A (m x k) * B (k x n) + beta * C, batch i
+// of each operand at its first element plus i times its batch stride
+template <typename Policy, typename T>
+auto gemm_batched(const Policy &policy, std::size_t batches, std::size_t m,
+                  std::size_t n, std::size_t k, T alpha, const T *a,
+                  std::size_t bsa, std::size_t rsa, std::size_t csa,
+                  const T *b, std::size_t bsb, std::size_t rsb,
+                  std::size_t csb, T beta, T *c, std::size_t bsc,
+                  std::size_t rsc, std::size_t csc) -> void {
+  if (batches == 1) { // one product: split its rows instead
+    gemm(policy, m, n, k, alpha, a, rsa, csa, b, rsb, csb, beta, c, rsc,
+         csc);
+    return;
+  }
+  const Kernel_scope scope(matrix_instrument::Kernel::gemm);
+  if (batches == 0 || m == 0 || n == 0) {
+    return;
+  }
+  const Gemm_kernel<T> kernel = batch_kernel<T>(m, n, k);
+  for_each_row_block(policy, batches, m * n * std::max<std::size_t>(k, 1),
+                     [&](std::size_t first, std::size_t last) {
+                       for (std::size_t i = first; i < last; ++i) {
+                         kernel(m, n, k, alpha, a + i * bsa, rsa, csa,
+                                b + i * bsb, rsb, csb, beta, c + i * bsc,
+                                rsc, csc);
+                       }
+                     });
+}
+
+template <typename M>
+using Enable_if_batch_operand =
+    Enable_if<Is_matrix_v<M> && (std::remove_cv_t<M>::order == 2 ||
+                                 std::remove_cv_t<M>::order == 3),
+              void>;
+
+// batch count, batch stride and matrix slice of a batched operand; shared
+// operands have batch stride 0
+template <typename T, std::size_t N>
+auto batch_layout(const Matrix_ref<T, N> &m_r)
+    -> std::pair<std::array<std::size_t, 2>, Matrix_slice<2>> {
+  const auto &d = m_r.descriptor();
+  Matrix_slice<2> mat;
+  mat.start = d.start;
+  mat.extents = {d.extents[N - 2], d.extents[N - 1]};
+  mat.strides = {d.strides[N - 2], d.strides[N - 1]};
+  mat.size = mat.extents[0] * mat.extents[1];
+  if constexpr (N == 3) {
+    return {{d.extents[0], d.extents[0] == 1 ? 0 : d.strides[0]}, mat};
+  } else {
+    return {{std::size_t{1}, std::size_t{0}}, mat};
+  }
+}
+
+} // namespace matrix_impl
+
+// c[i] = alpha * a[i] * b[i] + beta * c[i] for every batch i of c; an
+// order-2 operand, or one with a single batch, is used for every batch
+template <typename Policy, typename T, typename A, typename B,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy>,
+                               void>,
+          typename = matrix_impl::Enable_if_batch_operand<A>,
+          typename = matrix_impl::Enable_if_batch_operand<B>>
+auto gemm_batched(const Policy &policy, T alpha, const A &a, const B &b,
+                  T beta, Matrix_ref<T, 3> c) -> void {
+  const auto a_r = matrix_impl::as_ref(a);
+  const auto b_r = matrix_impl::as_ref(b);
+  const auto [ba, da] = matrix_impl::batch_layout(a_r);
+  const auto [bb, db] = matrix_impl::batch_layout(b_r);
+  const auto &dc = c.descriptor();
+  const std::size_t batches = dc.extents[0];
+  assert(ba[0] == batches || ba[0] == 1);
+  assert(bb[0] == batches || bb[0] == 1);
+  assert(da.extents[1] == db.extents[0]);
+  assert(dc.extents[1] == da.extents[0] && dc.extents[2] == db.extents[1]);
+  matrix_impl::gemm_batched(
+      policy, batches, dc.extents[1], dc.extents[2], da.extents[1], alpha,
+      a_r.pointer() + da.start, ba[1], da.strides[0], da.strides[1],
+      b_r.pointer() + db.start, bb[1], db.strides[0], db.strides[1], beta,
+      c.pointer() + dc.start, dc.strides[0], dc.strides[1], dc.strides[2]);
+}
+
+template <typename T, typename A, typename B,
+          typename = matrix_impl::Enable_if_batch_operand<A>,
+          typename = matrix_impl::Enable_if_batch_operand<B>>
+auto gemm_batched(T alpha, const A &a, const B &b, T beta, Matrix_ref<T, 3> c)
+    -> void {
+  gemm_batched(matrix_execution::seq, alpha, a, b, beta, c);
+}
+
+// the product of every batch of a and b, batch first; throws
+// std::invalid_argument when their batch extents are neither equal nor 1
+template <typename Policy, typename A, typename B,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy>,
+                               void>,
+          typename = matrix_impl::Enable_if_batch_operand<A>,
+          typename = matrix_impl::Enable_if_batch_operand<B>>
+auto matmul_batched(const Policy &policy, const A &a, const B &b)
+    -> Matrix<matrix_impl::Value_type<A>, 3> {
+  using T = matrix_impl::Value_type<A>;
+  static_assert(std::is_same_v<T, matrix_impl::Value_type<B>>,
+                "matmul operands must share an element type");
+  static_assert(std::remove_cv_t<A>::order == 3 ||
+                    std::remove_cv_t<B>::order == 3,
+                "matmul_batched needs at least one order-3 operand");
+  const auto a_r = matrix_impl::as_ref(a);
+  const auto b_r = matrix_impl::as_ref(b);
+  const std::size_t ba = matrix_impl::batch_layout(a_r).first[0];
+  const std::size_t bb = matrix_impl::batch_layout(b_r).first[0];
+  if (ba != bb && ba != 1 && bb != 1) {
+    throw std::invalid_argument("matmul_batched: batch extents " +
+                                std::to_string(ba) + " and " +
+                                std::to_string(bb) + " are not compatible");
+  }
+  constexpr std::size_t na = std::remove_cv_t<A>::order;
+  constexpr std::size_t nb = std::remove_cv_t<B>::order;
+  Matrix<T, 3> c(std::max(ba, bb), a_r.descriptor().extents[na - 2],
+                 b_r.descriptor().extents[nb - 1]);
+  gemm_batched(policy, T{1}, a_r, b_r, T{0}, Matrix_ref<T, 3>(c));
+  return c;
+}
+
+template <typename A, typename B,
+          typename = matrix_impl::Enable_if_batch_operand<A>,
+          typename = matrix_impl::Enable_if_batch_operand<B>>
+auto matmul_batched(const A &a, const B &b)
+    -> Matrix<matrix_impl::Value_type<A>, 3> {
+  return matmul_batched(matrix_execution::seq, a, b);
+}
@@ -0,0 +1,334 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(MATRIX_DESIGN_INSTRUMENT) && defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define MATRIX_DESIGN_HAS_PERF 1
+#endif
+
+// Counters for what the library does on behalf of a piece of code.
+//
+//   matrix_instrument::Scope scope;     counts from here...
+//   ...
+//   auto c = scope.counters();          ...to here, on every thread
+//   c.allocations, c.deep_copies, c.kernel_calls[...], ...
+//   format_counters(c)                  the nonzero counters as text
+//
+// Counted are the heap blocks allocated for matrix storage, copies and
+// moves of whole matrices, matrices built or assigned from views
+// (materializations) and calls of the library's kernels by kind. With
+// enable_hardware_counters(true) every kernel call is also timed in CPU
+// cycles and last-level cache misses through Linux perf_event_open; a
+// kernel that calls another (a factorization running gemm) includes the
+// inner one's counts.
+//
+// Counting is compiled in only when MATRIX_DESIGN_INSTRUMENT is defined for
+// the whole program. Otherwise every hook is an empty inline function, the
+// counters stay zero and the library's code is what it would be without
+// them. Counters are process-wide relaxed atomics, so a scope also sees the
+// work of other threads running at the same time.
+
+namespace matrix_instrument {
+
+#if defined(MATRIX_DESIGN_INSTRUMENT)
+inline constexpr bool enabled = true;
+#else
+inline constexpr bool enabled = false;
+#endif
+
+enum class Kernel : std::size_t {
+  elementwise,   // expression evaluation
+  copy,          // strided copies, including transposing ones
+  transpose,     // in-place transposes
+  reduce,        // reduce and the statistics of matrix_reduce.h
+  gemm,          // dense matrix products
+  sparse,        // sparse products
+  factorization, // LU, Cholesky and QR
+  conv,          // convolutions and stencils
+};
+
+inline constexpr std::size_t kernel_kinds = 8;
+
+inline constexpr std::array<const char *, kernel_kinds> kernel_names = {
+    "elementwise", "copy", "transpose", "reduce",
+    "gemm",        "sparse", "factorization", "conv"};
+
+struct Counters {
+  std::uint64_t allocations = 0; // heap blocks for matrix storage
+  std::uint64_t allocated_bytes = 0;
+  std::uint64_t deep_copies = 0; // Matrix copy construction and assignment
+  std::uint64_t copied_bytes = 0;
+  std::uint64_t moves = 0;
+  std::uint64_t materializations = 0; // a Matrix built or assigned from a view
+  std::uint64_t materialized_bytes = 0;
+  std::array<std::uint64_t, kernel_kinds> kernel_calls{};
+  // with hardware counters enabled
+  std::array<std::uint64_t, kernel_kinds> kernel_cycles{};
+  std::array<std::uint64_t, kernel_kinds> kernel_llc_misses{};
+
+  [[nodiscard]] auto calls(Kernel k) const -> std::uint64_t {
+    return kernel_calls[static_cast<std::size_t>(k)];
+  }
+};
+
+inline auto operator-(Counters a, const Counters &b) -> Counters {
+  a.allocations -= b.allocations;
+  a.allocated_bytes -= b.allocated_bytes;
+  a.deep_copies -= b.deep_copies;
+  a.copied_bytes -= b.copied_bytes;
+  a.moves -= b.moves;
+  a.materializations -= b.materializations;
+  a.materialized_bytes -= b.materialized_bytes;
+  for (std::size_t k = 0; k < kernel_kinds; ++k) {
+    a.kernel_calls[k] -= b.kernel_calls[k];
+    a.kernel_cycles[k] -= b.kernel_cycles[k];
+    a.kernel_llc_misses[k] -= b.kernel_llc_misses[k];
+  }
+  return a;
+}
+
+} // namespace matrix_instrument
+
+namespace matrix_impl {
+
+struct Instrument_totals {
+  using Counter = std::atomic<std::uint64_t>;
+  static constexpr std::size_t kinds = matrix_instrument::kernel_kinds;
+
+  Counter allocations{};
+  Counter allocated_bytes{};
+  Counter deep_copies{};
+  Counter copied_bytes{};
+  Counter moves{};
+  Counter materializations{};
+  Counter materialized_bytes{};
+  std::array<Counter, kinds> kernel_calls{};
+  std::array<Counter, kinds> kernel_cycles{};
+  std::array<Counter, kinds> kernel_llc_misses{};
+  std::atomic<bool> hardware{false};
+};
+
+inline Instrument_totals instrument_totals;
+
+inline auto bump(std::atomic<std::uint64_t> &counter, std::uint64_t n = 1)
+    -> void {
+  counter.fetch_add(n, std::memory_order_relaxed);
+}
+
+inline auto count_allocation(std::size_t bytes) -> void {
+  if constexpr (matrix_instrument::enabled) {
+    bump(instrument_totals.allocations);
+    bump(instrument_totals.allocated_bytes, bytes);
+  }
+}
+
+inline auto count_copy(std::size_t bytes) -> void {
+  if constexpr (matrix_instrument::enabled) {
+    bump(instrument_totals.deep_copies);
+    bump(instrument_totals.copied_bytes, bytes);
+  }
+}
+
+inline auto count_move() -> void {
+  if constexpr (matrix_instrument::enabled) {
+    bump(instrument_totals.moves);
+  }
+}
+
+inline auto count_materialization(std::size_t bytes) -> void {
+  if constexpr (matrix_instrument::enabled) {
+    bump(instrument_totals.materializations);
+    bump(instrument_totals.materialized_bytes, bytes);
+  }
+}
+
+// cycles and LLC misses of the calling thread, counted in user space from
+// the first use on that thread; closed when the thread exits
+class Perf_group {
+public:
+  Perf_group() {
+#if defined(MATRIX_DESIGN_HAS_PERF)
+    leader = open(PERF_COUNT_HW_CPU_CYCLES, -1);
+    if (leader >= 0) {
+      misses = open(PERF_COUNT_HW_CACHE_MISSES, leader);
+    }
+#endif
+  }
+
+  Perf_group(const Perf_group &) = delete;
+  auto operator=(const Perf_group &) -> Perf_group & = delete;
+
+  ~Perf_group() {
+#if defined(MATRIX_DESIGN_HAS_PERF)
+    if (misses >= 0) {
+      ::close(misses);
+    }
+    if (leader >= 0) {
+      ::close(leader);
+    }
+#endif
+  }
+
+  [[nodiscard]] auto available() const -> bool { return leader >= 0; }
+
+  // {cycles, LLC misses} so far; false when they cannot be read
+  auto read(std::array<std::uint64_t, 2> &values) const -> bool {
+#if defined(MATRIX_DESIGN_HAS_PERF)
+    if (leader < 0) {
+      return false;
+    }
+    std::array<std::uint64_t, 3> group{}; // nr, then one value per event
+    if (::read(leader, group.data(), sizeof(group)) < 16) {
+      return false;
+    }
+    values = {group[1], group[0] > 1 ? group[2] : 0};
+    return true;
+#else
+    (void)values;
+    return false;
+#endif
+  }
+
+private:
+#if defined(MATRIX_DESIGN_HAS_PERF)
+  static auto open(std::uint64_t config, int group) -> int {
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = 1; // allowed at the default perf_event_paranoid
+    attr.exclude_hv = 1;
+    return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1,
+                                      group, PERF_FLAG_FD_CLOEXEC));
+  }
+#endif
+
+  int leader = -1;
+  int misses = -1;
+};
+
+inline auto perf_group() -> const Perf_group & {
+  thread_local const Perf_group group;
+  return group;
+}
+
+// counts one call of a kernel, and its cycles and cache misses while
+// hardware counters are enabled; placed at the entry of each kernel
+class Kernel_scope {
+public:
+  explicit Kernel_scope(matrix_instrument::Kernel kernel)
+      : kind{static_cast<std::size_t>(kernel)} {
+    if constexpr (matrix_instrument::enabled) {
+      bump(instrument_totals.kernel_calls[kind]);
+      if (instrument_totals.hardware.load(std::memory_order_relaxed)) {
+        timed = perf_group().read(start);
+      }
+    }
+  }
+
+  Kernel_scope(const Kernel_scope &) = delete;
+  auto operator=(const Kernel_scope &) -> Kernel_scope & = delete;
+
+  ~Kernel_scope() {
+    if constexpr (matrix_instrument::enabled) {
+      std::array<std::uint64_t, 2> end{};
+      if (timed && perf_group().read(end)) {
+        bump(instrument_totals.kernel_cycles[kind], end[0] - start[0]);
+        bump(instrument_totals.kernel_llc_misses[kind], end[1] - start[1]);
+      }
+    }
+  }
+
+private:
+  std::size_t kind;
+  bool timed = false;
+  std::array<std::uint64_t, 2> start{};
+};
+
+} // namespace matrix_impl
+
+namespace matrix_instrument {
+
+// every counter since the program started
+inline auto snapshot() -> Counters {
+  const auto &t = matrix_impl::instrument_totals;
+  const auto load = [](const std::atomic<std::uint64_t> &c) {
+    return c.load(std::memory_order_relaxed);
+  };
+  Counters c;
+  c.allocations = load(t.allocations);
+  c.allocated_bytes = load(t.allocated_bytes);
+  c.deep_copies = load(t.deep_copies);
+  c.copied_bytes = load(t.copied_bytes);
+  c.moves = load(t.moves);
+  c.materializations = load(t.materializations);
+  c.materialized_bytes = load(t.materialized_bytes);
+  for (std::size_t k = 0; k < kernel_kinds; ++k) {
+    c.kernel_calls[k] = load(t.kernel_calls[k]);
+    c.kernel_cycles[k] = load(t.kernel_cycles[k]);
+    c.kernel_llc_misses[k] = load(t.kernel_llc_misses[k]);
+  }
+  return c;
+}
+
+// whether the calling thread can read cycles and cache misses: needs an
+// instrumented build on Linux, and perf_event_paranoid <= 2
+inline auto hardware_counters_available() -> bool {
+  return enabled && matrix_impl::perf_group().available();
+}
+
+// time kernels with hardware counters from now on (or stop); returns
+// whether they are available
+inline auto enable_hardware_counters(bool on) -> bool {
+  const bool available = hardware_counters_available();
+  matrix_impl::instrument_totals.hardware.store(on && available,
+                                                std::memory_order_relaxed);
+  return available;
+}
+
+// the counters between its construction and each call of counters()
+class Scope {
+public:
+  Scope() : start{snapshot()} {}
+
+  [[nodiscard]] auto counters() const -> Counters {
+    return snapshot() - start;
+  }
+
+private:
+  Counters start;
+};
+
+// one "name value" line per nonzero counter
+inline auto format_counters(const Counters &c) -> std::string {
+  std::string out;
+  const auto line = [&](const std::string &name, std::uint64_t value) {
+    if (value != 0) {
+      out += name + ' ' + std::to_string(value) + '\n';
+    }
+  };
+  line("allocations", c.allocations);
+  line("allocated_bytes", c.allocated_bytes);
+  line("deep_copies", c.deep_copies);
+  line("copied_bytes", c.copied_bytes);
+  line("moves", c.moves);
+  line("materializations", c.materializations);
+  line("materialized_bytes", c.materialized_bytes);
+  for (std::size_t k = 0; k < kernel_kinds; ++k) {
+    const std::string name = kernel_names[k];
+    line(name + ".calls", c.kernel_calls[k]);
+    line(name + ".cycles", c.kernel_cycles[k]);
+    line(name + ".llc_misses", c.kernel_llc_misses[k]);
+  }
+  return out;
+}
+
+} // namespace matrix_instrument
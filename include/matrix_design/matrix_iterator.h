@@ -0,0 +1,95 @@
+#pragma once
+
+#include "matrix_slice.h"
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+// Forward iterator over the elements of a (possibly strided) view in
+// row-major order. The iterator keeps a pointer to the current element and
+// a multi-index; advancing adds the innermost stride and only on reaching
+// the end of a row carries into the outer dimensions, like an odometer, so
+// no offset is recomputed from the subscripts.
+//
+// Iterators compare by their position in the traversal, so two iterators
+// over the same view are equal exactly when they have advanced equally.
+// The pointer only ever moves between elements of the view; past the last
+// one it is null, as in an end iterator.
+template <typename T, std::size_t N> class Matrix_iterator {
+public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = std::remove_const_t<T>;
+  using difference_type = std::ptrdiff_t;
+  using pointer = T *;
+  using reference = T &;
+
+  Matrix_iterator() = default;
+
+  // the first element of the view described by desc over base, or the
+  // position past its last element when `end` is set
+  Matrix_iterator(const Matrix_slice<N> &desc, T *base, bool end)
+      : extents{desc.extents}, strides{desc.strides},
+        cur{end || desc.size == 0 ? nullptr : base + desc.start},
+        pos{end ? desc.size : 0}, size{desc.size} {}
+
+  // a read-only iterator from a mutable one
+  template <typename U,
+            typename = Enable_if<std::is_same_v<const U, T> &&
+                                     !std::is_same_v<U, T>,
+                                 void>>
+  Matrix_iterator(const Matrix_iterator<U, N> &it)
+      : extents{it.extents}, strides{it.strides}, index{it.index},
+        cur{it.cur}, pos{it.pos}, size{it.size} {}
+
+  auto operator*() const -> reference { return *cur; }
+  auto operator->() const -> pointer { return cur; }
+
+  auto operator++() -> Matrix_iterator & {
+    if (++pos == size) {
+      cur = nullptr;
+      return *this;
+    }
+    // step the innermost dimension that has elements left, rewinding the
+    // ones inside it to their first element
+    for (std::size_t d = N; d-- > 0;) {
+      if (++index[d] < extents[d]) {
+        cur += strides[d];
+        return *this;
+      }
+      cur -= (extents[d] - 1) * strides[d];
+      index[d] = 0;
+    }
+    return *this;
+  }
+
+  auto operator++(int) -> Matrix_iterator {
+    Matrix_iterator old = *this;
+    ++*this;
+    return old;
+  }
+
+  friend auto operator==(const Matrix_iterator &a, const Matrix_iterator &b)
+      -> bool {
+    return a.pos == b.pos;
+  }
+  friend auto operator!=(const Matrix_iterator &a, const Matrix_iterator &b)
+      -> bool {
+    return a.pos != b.pos;
+  }
+
+  // the multi-index of the current element
+  [[nodiscard]] auto indexes() const -> const std::array<std::size_t, N> & {
+    return index;
+  }
+
+private:
+  template <typename U, std::size_t M> friend class Matrix_iterator;
+
+  std::array<std::size_t, N> extents{};
+  std::array<std::size_t, N> strides{};
+  std::array<std::size_t, N> index{};
+  T *cur = nullptr;
+  std::size_t pos = 0;  // elements visited so far
+  std::size_t size = 0; // elements in the view
+};
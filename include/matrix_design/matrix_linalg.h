@@ -0,0 +1,679 @@
+#pragma once
+
+#include "matrix.h"
+#include "matrix_execution.h"
+#include "matrix_gemm.h"
+#include "matrix_instrument.h"
+#include "matrix_simd.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Dense factorizations and solvers.
+//
+//   lu(a)          P a = L U with partial pivoting, for square a
+//   cholesky(a)    a = L L^T, for symmetric positive-definite a
+//   qr(a)          a = Q R with Householder reflections, for any shape
+//   solve(a, b)    x with a x = b, for a vector b or a matrix of columns b
+//   inverse(a)     a^-1
+//   det(a)         the determinant of a
+//
+// The factorizations are blocked and right-looking: a panel of nb columns
+// is factored with vector operations, then the trailing matrix is updated
+// with a triangular solve and a matrix product (gemm, matrix_gemm.h), so
+// for large matrices nearly all the flops run in the gemm kernel. Each
+// function also takes an execution policy first, which splits those
+// trailing updates across the thread pool.
+//
+// The factorizations work on a copy of their operand and keep the factors,
+// so one factorization solves for any number of right-hand sides. lu
+// accepts singular matrices (det is then 0); solving with one throws
+// std::runtime_error, as do cholesky for a matrix that is not positive
+// definite and QR least squares with a rank-deficient R.
+
+namespace matrix_impl {
+
+// columns per panel
+inline constexpr std::size_t factor_block = 64;
+
+// solve op(t) x = b in place of b, where t (n x n) is lower or upper
+// triangular, with a unit diagonal when `unit`, and b is n x m; every
+// operand is given by its first element and row and column strides
+template <typename T>
+auto trsm_unblocked(bool lower, bool unit, std::size_t n, std::size_t m,
+                    const T *t, std::size_t rst, std::size_t cst, T *b,
+                    std::size_t rsb, std::size_t csb) -> void {
+  for (std::size_t s = 0; s < n; ++s) {
+    const std::size_t i = lower ? s : n - 1 - s;
+    T *bi = b + i * rsb;
+    const std::size_t first = lower ? 0 : i + 1;
+    const std::size_t last = lower ? i : n;
+    for (std::size_t p = first; p < last; ++p) {
+      axpy(m, -t[i * rst + p * cst], b + p * rsb, csb, bi, csb);
+    }
+    if (!unit) {
+      const T r = T{1} / t[i * (rst + cst)];
+      for (std::size_t j = 0; j < m; ++j) {
+        bi[j * csb] *= r;
+      }
+    }
+  }
+}
+
+// as above, by diagonal blocks: each block row is solved, then eliminated
+// from the rows still to be solved with one gemm
+template <typename Policy, typename T>
+auto trsm(const Policy &policy, bool lower, bool unit, std::size_t n,
+          std::size_t m, const T *t, std::size_t rst, std::size_t cst, T *b,
+          std::size_t rsb, std::size_t csb) -> void {
+  constexpr std::size_t nb = factor_block;
+  for (std::size_t s = 0; s < n; s += nb) {
+    const std::size_t ib = std::min(nb, n - s);
+    // rows [i0, i0 + ib) in order top down (lower) or bottom up (upper)
+    const std::size_t i0 = lower ? s : n - s - ib;
+    trsm_unblocked(lower, unit, ib, m, t + i0 * (rst + cst), rst, cst,
+                   b + i0 * rsb, rsb, csb);
+    const std::size_t rest = n - s - ib;
+    const std::size_t r0 = lower ? i0 + ib : 0;
+    gemm(policy, rest, m, ib, T{-1}, t + r0 * rst + i0 * cst, rst, cst,
+         b + i0 * rsb, rsb, csb, T{1}, b + r0 * rsb, rsb, csb);
+  }
+}
+
+// unblocked LU of an m x b panel (m >= b) with row stride ld: pivots[j] is
+// the panel row swapped with row j; rows are only swapped within the panel
+template <typename T>
+auto lu_panel(std::size_t m, std::size_t b, T *a, std::size_t ld,
+              std::size_t *pivots) -> void {
+  for (std::size_t j = 0; j < b; ++j) {
+    std::size_t p = j;
+    T largest = std::abs(a[j * ld + j]);
+    for (std::size_t i = j + 1; i < m; ++i) {
+      if (std::abs(a[i * ld + j]) > largest) {
+        largest = std::abs(a[i * ld + j]);
+        p = i;
+      }
+    }
+    pivots[j] = p;
+    if (p != j) {
+      std::swap_ranges(a + j * ld, a + j * ld + b, a + p * ld);
+    }
+    const T pivot = a[j * ld + j];
+    if (pivot == T{0}) { // a singular column: nothing left to eliminate
+      continue;
+    }
+    const T r = T{1} / pivot;
+    for (std::size_t i = j + 1; i < m; ++i) {
+      T *ai = a + i * ld;
+      const T l = ai[j] *= r;
+      axpy_run(b - j - 1, -l, a + j * ld + j + 1, ai + j + 1);
+    }
+  }
+}
+
+// LU with partial pivoting of the n x n matrix a (row stride ld) in place:
+// L below the diagonal (unit diagonal implied), U on and above it, and
+// row i swapped with row pivots[i] in order
+template <typename Policy, typename T>
+auto lu_blocked(const Policy &policy, std::size_t n, T *a, std::size_t ld,
+                std::size_t *pivots) -> void {
+  const Kernel_scope scope(matrix_instrument::Kernel::factorization);
+  for (std::size_t k = 0; k < n; k += factor_block) {
+    const std::size_t b = std::min(factor_block, n - k);
+    const std::size_t rest = n - k - b;
+    T *a11 = a + k * ld + k;
+    lu_panel(n - k, b, a11, ld, pivots + k);
+    // the panel's row swaps, applied left and right of the panel
+    for (std::size_t j = k; j < k + b; ++j) {
+      pivots[j] += k;
+      if (pivots[j] != j) {
+        T *x = a + j * ld;
+        T *y = a + pivots[j] * ld;
+        std::swap_ranges(x, x + k, y);
+        std::swap_ranges(x + k + b, x + n, y + k + b);
+      }
+    }
+    // U12 = L11^-1 A12, then A22 -= L21 U12
+    trsm(policy, true, true, b, rest, a11, ld, std::size_t{1}, a11 + b, ld,
+         std::size_t{1});
+    gemm(policy, rest, rest, b, T{-1}, a11 + b * ld, ld, std::size_t{1},
+         a11 + b, ld, std::size_t{1}, T{1}, a11 + b * ld + b, ld,
+         std::size_t{1});
+  }
+}
+
+// unblocked Cholesky of the lower triangle of a b x b block; false when
+// the block is not positive definite
+template <typename T>
+auto cholesky_panel(std::size_t b, T *a, std::size_t ld) -> bool {
+  for (std::size_t j = 0; j < b; ++j) {
+    T *aj = a + j * ld;
+    T d = aj[j] - dot_run(j, aj, aj);
+    if (!(d > T{0})) {
+      return false;
+    }
+    d = std::sqrt(d);
+    aj[j] = d;
+    for (std::size_t i = j + 1; i < b; ++i) {
+      T *ai = a + i * ld;
+      ai[j] = (ai[j] - dot_run(j, ai, aj)) / d;
+    }
+  }
+  return true;
+}
+
+// x = x l^-T for the rows of x (rows x b) with l lower triangular (b x b),
+// one forward substitution per row
+template <typename Policy, typename T>
+auto solve_rows_lower_t(const Policy &policy, std::size_t rows, std::size_t b,
+                        const T *l, std::size_t ldl, T *x, std::size_t ldx)
+    -> void {
+  for_each_row_block(policy, rows, b * b,
+                     [&](std::size_t first, std::size_t last) {
+                       for (std::size_t r = first; r < last; ++r) {
+                         T *xr = x + r * ldx;
+                         for (std::size_t j = 0; j < b; ++j) {
+                           const T *lj = l + j * ldl;
+                           xr[j] = (xr[j] - dot_run(j, xr, lj)) / lj[j];
+                         }
+                       }
+                     });
+}
+
+// Cholesky of the n x n matrix a in place: L in the lower triangle, the
+// upper triangle is not referenced; false when a is not positive definite
+template <typename Policy, typename T>
+auto cholesky_blocked(const Policy &policy, std::size_t n, T *a,
+                      std::size_t ld) -> bool {
+  const Kernel_scope scope(matrix_instrument::Kernel::factorization);
+  for (std::size_t k = 0; k < n; k += factor_block) {
+    const std::size_t b = std::min(factor_block, n - k);
+    const std::size_t rest = n - k - b;
+    T *a11 = a + k * ld + k;
+    if (!cholesky_panel(b, a11, ld)) {
+      return false;
+    }
+    // L21 = A21 L11^-T, then A22 -= L21 L21^T one block column at a time,
+    // on and below the diagonal only
+    T *l21 = a11 + b * ld;
+    solve_rows_lower_t(policy, rest, b, a11, ld, l21, ld);
+    for (std::size_t j = 0; j < rest; j += factor_block) {
+      const std::size_t w = std::min(factor_block, rest - j);
+      gemm(policy, rest - j, w, b, T{-1}, l21 + j * ld, ld, std::size_t{1},
+           l21 + j * ld, std::size_t{1}, ld, T{1}, l21 + j * ld + b + j, ld,
+           std::size_t{1});
+    }
+  }
+  return true;
+}
+
+// Householder QR of an m x b panel with row stride ld: R on and above the
+// diagonal, the reflectors' vectors below it (their leading 1 implied), and
+// H_j = I - tau[j] v_j v_j^T
+template <typename T>
+auto qr_panel(std::size_t m, std::size_t b, T *a, std::size_t ld, T *tau)
+    -> void {
+  std::vector<T> w(b);
+  for (std::size_t j = 0; j < std::min(m, b); ++j) {
+    T *ajj = a + j * ld + j;
+    T norm2{};
+    for (std::size_t i = j + 1; i < m; ++i) {
+      norm2 += a[i * ld + j] * a[i * ld + j];
+    }
+    if (norm2 == T{0}) { // already zero below the diagonal
+      tau[j] = T{0};
+      continue;
+    }
+    const T alpha = *ajj;
+    const T beta = -std::copysign(std::sqrt(alpha * alpha + norm2), alpha);
+    tau[j] = (beta - alpha) / beta;
+    const T r = T{1} / (alpha - beta);
+    for (std::size_t i = j + 1; i < m; ++i) {
+      a[i * ld + j] *= r;
+    }
+    *ajj = beta;
+    // the rest of the panel: w = v^T A, then A -= tau v w
+    const std::size_t n = b - j - 1;
+    std::copy(ajj + 1, ajj + 1 + n, w.begin());
+    for (std::size_t i = j + 1; i < m; ++i) {
+      axpy_run(n, a[i * ld + j], a + i * ld + j + 1, w.data());
+    }
+    axpy_run(n, -tau[j], w.data(), ajj + 1);
+    for (std::size_t i = j + 1; i < m; ++i) {
+      axpy_run(n, -tau[j] * a[i * ld + j], w.data(), a + i * ld + j + 1);
+    }
+  }
+}
+
+// the reflectors of a factored panel (m x b, as left by qr_panel) as
+// explicit columns v (m x b, row-major) and the upper triangular t (b x b)
+// of the block reflector H_0 ... H_b-1 = I - V T V^T
+template <typename T>
+auto block_reflector(std::size_t m, std::size_t b, const T *a,
+                     std::size_t ld, const T *tau, T *v, T *t) -> void {
+  std::fill(v, v + m * b, T{0});
+  for (std::size_t i = 0; i < m; ++i) {
+    for (std::size_t j = 0; j < std::min(i + 1, b); ++j) {
+      v[i * b + j] = i == j ? T{1} : a[i * ld + j];
+    }
+  }
+  std::fill(t, t + b * b, T{0});
+  std::vector<T> z(b);
+  for (std::size_t j = 0; j < b; ++j) {
+    // z = V[:, 0:j]^T v_j, then t[0:j, j] = -tau_j T[0:j, 0:j] z
+    std::fill(z.begin(), z.end(), T{0});
+    for (std::size_t i = j; i < m; ++i) {
+      axpy_run(j, v[i * b + j], v + i * b, z.data());
+    }
+    for (std::size_t p = 0; p < j; ++p) {
+      t[p * b + j] = -tau[j] * dot_run(j - p, t + p * b + p, z.data() + p);
+    }
+    t[j * b + j] = tau[j];
+  }
+}
+
+// c = H^T c for the block reflector H = I - V T V^T, with c m x n
+template <typename Policy, typename T>
+auto apply_block_reflector_t(const Policy &policy, std::size_t m,
+                             std::size_t n, std::size_t b, const T *v,
+                             const T *t, T *c, std::size_t ldc) -> void {
+  // w = V^T c, w = T^T w, c -= V w
+  std::vector<T> w(b * n);
+  gemm(policy, b, n, m, T{1}, v, std::size_t{1}, b, c, ldc, std::size_t{1},
+       T{0}, w.data(), n, std::size_t{1});
+  for (std::size_t p = b; p-- > 0;) {
+    T *wp = w.data() + p * n;
+    for (std::size_t j = 0; j < n; ++j) {
+      wp[j] *= t[p * b + p];
+    }
+    for (std::size_t q = 0; q < p; ++q) {
+      axpy_run(n, t[q * b + p], w.data() + q * n, wp);
+    }
+  }
+  gemm(policy, m, n, b, T{-1}, v, b, std::size_t{1}, w.data(), n,
+       std::size_t{1}, T{1}, c, ldc, std::size_t{1});
+}
+
+// QR of the m x n matrix a in place (see qr_panel), tau min(m, n) long
+template <typename Policy, typename T>
+auto qr_blocked(const Policy &policy, std::size_t m, std::size_t n, T *a,
+                std::size_t ld, T *tau) -> void {
+  const Kernel_scope scope(matrix_instrument::Kernel::factorization);
+  const std::size_t kmax = std::min(m, n);
+  std::vector<T> v;
+  std::vector<T> t;
+  for (std::size_t k = 0; k < kmax; k += factor_block) {
+    const std::size_t b = std::min(factor_block, kmax - k);
+    T *a11 = a + k * ld + k;
+    qr_panel(m - k, b, a11, ld, tau + k);
+    if (k + b < n) {
+      v.resize((m - k) * b);
+      t.resize(b * b);
+      block_reflector(m - k, b, a11, ld, tau + k, v.data(), t.data());
+      apply_block_reflector_t(policy, m - k, n - k - b, b, v.data(),
+                              t.data(), a11 + b, ld);
+    }
+  }
+}
+
+// c = H_j c for the reflector j of a factored matrix (row stride ld), with
+// c holding m rows of n elements
+template <typename T>
+auto apply_reflector(std::size_t m, std::size_t j, const T *a,
+                     std::size_t ld, T tau, T *c, std::size_t n,
+                     std::size_t ldc) -> void {
+  if (tau == T{0}) {
+    return;
+  }
+  std::vector<T> w(c + j * ldc, c + j * ldc + n);
+  for (std::size_t i = j + 1; i < m; ++i) {
+    axpy_run(n, a[i * ld + j], c + i * ldc, w.data());
+  }
+  axpy_run(n, -tau, w.data(), c + j * ldc);
+  for (std::size_t i = j + 1; i < m; ++i) {
+    axpy_run(n, -tau * a[i * ld + j], w.data(), c + i * ldc);
+  }
+}
+
+// the right-hand sides b as the columns of a dense n x m matrix (a vector
+// is one column)
+template <typename T, typename B>
+auto rhs_columns(const B &b) -> Matrix<T, 2> {
+  const auto b_r = as_ref(b);
+  if constexpr (decltype(b_r)::order == 1) {
+    Matrix<T, 2> x(b_r.extent(0), 1);
+    std::copy(b_r.begin(), b_r.end(), x.data());
+    return x;
+  } else {
+    return Matrix<T, 2>(b_r);
+  }
+}
+
+// the solution in the shape of the right-hand sides
+template <std::size_t N, typename T>
+auto rhs_result(Matrix<T, 2> &&x) -> Matrix<T, N> {
+  if constexpr (N == 1) {
+    Matrix<T, 1> y(std::array<std::size_t, 1>{x.extent(0)});
+    std::copy(x.data(), x.data() + x.size(), y.data());
+    return y;
+  } else {
+    return std::move(x);
+  }
+}
+
+template <typename B>
+using Enable_if_rhs =
+    Enable_if<Is_matrix_v<B> && (std::remove_cv_t<B>::order == 1 ||
+                                 std::remove_cv_t<B>::order == 2),
+              void>;
+
+} // namespace matrix_impl
+
+// P a = L U of a square matrix
+template <typename T> class Lu_decomposition {
+  static_assert(std::is_floating_point_v<T>,
+                "factorizations need a floating-point element type");
+
+public:
+  template <typename Policy, typename M>
+  Lu_decomposition(const Policy &policy, const M &a)
+      : factors(matrix_impl::as_ref(a)), pivot_rows(factors.extent(0)) {
+    const std::size_t n = factors.extent(0);
+    assert(factors.extent(1) == n);
+    matrix_impl::lu_blocked(policy, n, factors.data(), n, pivot_rows.data());
+  }
+
+  // L strictly below the diagonal (its diagonal is 1), U on and above it
+  auto matrix() const -> const Matrix<T, 2> & { return factors; }
+  // row i was swapped with row pivots()[i], for i = 0, 1, ... in order
+  auto pivots() const -> const std::vector<std::size_t> & {
+    return pivot_rows;
+  }
+
+  [[nodiscard]] auto singular() const -> bool {
+    for (std::size_t i = 0; i < factors.extent(0); ++i) {
+      if (factors(i, i) == T{0}) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  auto det() const -> T {
+    T d{1};
+    for (std::size_t i = 0; i < factors.extent(0); ++i) {
+      d *= pivot_rows[i] != i ? -factors(i, i) : factors(i, i);
+    }
+    return d;
+  }
+
+  // x with a x = b, for a vector or a matrix of columns b
+  template <typename Policy, typename B,
+            typename = matrix_impl::Enable_if_rhs<B>>
+  auto solve(const Policy &policy, const B &b) const {
+    constexpr std::size_t N = std::remove_cv_t<B>::order;
+    const std::size_t n = factors.extent(0);
+    if (singular()) {
+      throw std::runtime_error("solve: the matrix is singular");
+    }
+    Matrix<T, 2> x = matrix_impl::rhs_columns<T>(b);
+    assert(x.extent(0) == n);
+    const std::size_t m = x.extent(1);
+    for (std::size_t i = 0; i < n; ++i) {
+      if (pivot_rows[i] != i) {
+        std::swap_ranges(x.data() + i * m, x.data() + (i + 1) * m,
+                         x.data() + pivot_rows[i] * m);
+      }
+    }
+    matrix_impl::trsm(policy, true, true, n, m, factors.data(), n,
+                      std::size_t{1}, x.data(), m, std::size_t{1});
+    matrix_impl::trsm(policy, false, false, n, m, factors.data(), n,
+                      std::size_t{1}, x.data(), m, std::size_t{1});
+    return matrix_impl::rhs_result<N>(std::move(x));
+  }
+
+  template <typename B, typename = matrix_impl::Enable_if_rhs<B>>
+  auto solve(const B &b) const {
+    return solve(matrix_execution::seq, b);
+  }
+
+  template <typename Policy> auto inverse(const Policy &policy) const {
+    const std::size_t n = factors.extent(0);
+    Matrix<T, 2> identity(n, n);
+    for (std::size_t i = 0; i < n; ++i) {
+      identity(i, i) = T{1};
+    }
+    return solve(policy, identity);
+  }
+
+  auto inverse() const { return inverse(matrix_execution::seq); }
+
+private:
+  Matrix<T, 2> factors;
+  std::vector<std::size_t> pivot_rows;
+};
+
+// a = L L^T of a symmetric positive-definite matrix; only the lower
+// triangle of a is read
+template <typename T> class Cholesky_decomposition {
+  static_assert(std::is_floating_point_v<T>,
+                "factorizations need a floating-point element type");
+
+public:
+  template <typename Policy, typename M>
+  Cholesky_decomposition(const Policy &policy, const M &a)
+      : factor(matrix_impl::as_ref(a)) {
+    const std::size_t n = factor.extent(0);
+    assert(factor.extent(1) == n);
+    if (!matrix_impl::cholesky_blocked(policy, n, factor.data(), n)) {
+      throw std::runtime_error("cholesky: the matrix is not positive definite");
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+      std::fill(factor.data() + i * n + i + 1, factor.data() + (i + 1) * n,
+                T{0});
+    }
+  }
+
+  // L, with zeros above the diagonal
+  auto l() const -> const Matrix<T, 2> & { return factor; }
+
+  auto det() const -> T {
+    T d{1};
+    for (std::size_t i = 0; i < factor.extent(0); ++i) {
+      d *= factor(i, i) * factor(i, i);
+    }
+    return d;
+  }
+
+  template <typename Policy, typename B,
+            typename = matrix_impl::Enable_if_rhs<B>>
+  auto solve(const Policy &policy, const B &b) const {
+    constexpr std::size_t N = std::remove_cv_t<B>::order;
+    const std::size_t n = factor.extent(0);
+    Matrix<T, 2> x = matrix_impl::rhs_columns<T>(b);
+    assert(x.extent(0) == n);
+    const std::size_t m = x.extent(1);
+    // L y = b, then L^T x = y through the transposed strides of L
+    matrix_impl::trsm(policy, true, false, n, m, factor.data(), n,
+                      std::size_t{1}, x.data(), m, std::size_t{1});
+    matrix_impl::trsm(policy, false, false, n, m, factor.data(),
+                      std::size_t{1}, n, x.data(), m, std::size_t{1});
+    return matrix_impl::rhs_result<N>(std::move(x));
+  }
+
+  template <typename B, typename = matrix_impl::Enable_if_rhs<B>>
+  auto solve(const B &b) const {
+    return solve(matrix_execution::seq, b);
+  }
+
+private:
+  Matrix<T, 2> factor;
+};
+
+// a = Q R of an m x n matrix, with Q kept as min(m, n) Householder
+// reflectors
+template <typename T> class Qr_decomposition {
+  static_assert(std::is_floating_point_v<T>,
+                "factorizations need a floating-point element type");
+
+public:
+  template <typename Policy, typename M>
+  Qr_decomposition(const Policy &policy, const M &a)
+      : factors(matrix_impl::as_ref(a)),
+        tau(std::min(factors.extent(0), factors.extent(1))) {
+    matrix_impl::qr_blocked(policy, factors.extent(0), factors.extent(1),
+                            factors.data(), factors.extent(1), tau.data());
+  }
+
+  // the min(m, n) x n upper triangular R
+  auto r() const -> Matrix<T, 2> {
+    const std::size_t n = factors.extent(1);
+    Matrix<T, 2> r(tau.size(), n);
+    for (std::size_t i = 0; i < tau.size(); ++i) {
+      std::copy(factors.data() + i * n + i, factors.data() + (i + 1) * n,
+                r.data() + i * n + i);
+    }
+    return r;
+  }
+
+  // the m x min(m, n) Q with orthonormal columns
+  auto q() const -> Matrix<T, 2> {
+    const std::size_t m = factors.extent(0);
+    const std::size_t k = tau.size();
+    Matrix<T, 2> q(m, k);
+    for (std::size_t i = 0; i < k; ++i) {
+      q(i, i) = T{1};
+    }
+    for (std::size_t j = k; j-- > 0;) {
+      matrix_impl::apply_reflector(m, j, factors.data(), factors.extent(1),
+                                   tau[j], q.data() + j, k - j, k);
+    }
+    return q;
+  }
+
+  // the least-squares solution of a x = b (m >= n), which is exact for
+  // square a
+  template <typename B, typename = matrix_impl::Enable_if_rhs<B>>
+  auto solve(const B &b) const {
+    constexpr std::size_t N = std::remove_cv_t<B>::order;
+    const std::size_t m = factors.extent(0);
+    const std::size_t n = factors.extent(1);
+    assert(m >= n);
+    for (std::size_t i = 0; i < n; ++i) {
+      if (factors(i, i) == T{0}) {
+        throw std::runtime_error("solve: R is singular");
+      }
+    }
+    Matrix<T, 2> c = matrix_impl::rhs_columns<T>(b);
+    assert(c.extent(0) == m);
+    const std::size_t nrhs = c.extent(1);
+    // Q^T b, then R x = its first n rows
+    for (std::size_t j = 0; j < n; ++j) {
+      matrix_impl::apply_reflector(m, j, factors.data(), n, tau[j], c.data(),
+                                   nrhs, nrhs);
+    }
+    Matrix<T, 2> x(n, nrhs);
+    std::copy(c.data(), c.data() + n * nrhs, x.data());
+    matrix_impl::trsm(matrix_execution::seq, false, false, n, nrhs,
+                      factors.data(), n, std::size_t{1}, x.data(), nrhs,
+                      std::size_t{1});
+    return matrix_impl::rhs_result<N>(std::move(x));
+  }
+
+private:
+  Matrix<T, 2> factors;
+  std::vector<T> tau;
+};
+
+template <typename Policy, typename M,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy>,
+                               void>,
+          typename = matrix_impl::Enable_if_matrix_2d<M>>
+auto lu(const Policy &policy, const M &a)
+    -> Lu_decomposition<matrix_impl::Value_type<M>> {
+  return {policy, a};
+}
+
+template <typename M, typename = matrix_impl::Enable_if_matrix_2d<M>>
+auto lu(const M &a) -> Lu_decomposition<matrix_impl::Value_type<M>> {
+  return {matrix_execution::seq, a};
+}
+
+template <typename Policy, typename M,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy>,
+                               void>,
+          typename = matrix_impl::Enable_if_matrix_2d<M>>
+auto cholesky(const Policy &policy, const M &a)
+    -> Cholesky_decomposition<matrix_impl::Value_type<M>> {
+  return {policy, a};
+}
+
+template <typename M, typename = matrix_impl::Enable_if_matrix_2d<M>>
+auto cholesky(const M &a)
+    -> Cholesky_decomposition<matrix_impl::Value_type<M>> {
+  return {matrix_execution::seq, a};
+}
+
+template <typename Policy, typename M,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy>,
+                               void>,
+          typename = matrix_impl::Enable_if_matrix_2d<M>>
+auto qr(const Policy &policy, const M &a)
+    -> Qr_decomposition<matrix_impl::Value_type<M>> {
+  return {policy, a};
+}
+
+template <typename M, typename = matrix_impl::Enable_if_matrix_2d<M>>
+auto qr(const M &a) -> Qr_decomposition<matrix_impl::Value_type<M>> {
+  return {matrix_execution::seq, a};
+}
+
+// x with a x = b for square a, through its LU decomposition
+template <typename Policy, typename M, typename B,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy>,
+                               void>,
+          typename = matrix_impl::Enable_if_matrix_2d<M>,
+          typename = matrix_impl::Enable_if_rhs<B>>
+auto solve(const Policy &policy, const M &a, const B &b) {
+  return lu(policy, a).solve(policy, b);
+}
+
+template <typename M, typename B,
+          typename = matrix_impl::Enable_if_matrix_2d<M>,
+          typename = matrix_impl::Enable_if_rhs<B>>
+auto solve(const M &a, const B &b) {
+  return lu(a).solve(b);
+}
+
+template <typename Policy, typename M,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy>,
+                               void>,
+          typename = matrix_impl::Enable_if_matrix_2d<M>>
+auto inverse(const Policy &policy, const M &a)
+    -> Matrix<matrix_impl::Value_type<M>, 2> {
+  return lu(policy, a).inverse(policy);
+}
+
+template <typename M, typename = matrix_impl::Enable_if_matrix_2d<M>>
+auto inverse(const M &a) -> Matrix<matrix_impl::Value_type<M>, 2> {
+  return lu(a).inverse();
+}
+
+template <typename Policy, typename M,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy>,
+                               void>,
+          typename = matrix_impl::Enable_if_matrix_2d<M>>
+auto det(const Policy &policy, const M &a) -> matrix_impl::Value_type<M> {
+  return lu(policy, a).det();
+}
+
+template <typename M, typename = matrix_impl::Enable_if_matrix_2d<M>>
+auto det(const M &a) -> matrix_impl::Value_type<M> {
+  return lu(a).det();
+}
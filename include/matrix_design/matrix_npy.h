@@ -0,0 +1,388 @@
+#pragma once
+
+#include "matrix.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MATRIX_DESIGN_HAS_MMAP 1
+#endif
+
+// NumPy .npy files.
+//
+//   save_npy(path, m)        write any matrix or view in C order
+//   load_npy<T, N>(path)     read a file into a Matrix<T, N>
+//   map_npy<T, N>(path)      map a file into memory; the Mapped_matrix views
+//                            the file's pages directly, without copying
+//
+// The element type must match the file's dtype exactly and the file must be
+// in C order; anything else throws std::runtime_error, as do I/O errors.
+// A mapped matrix shares the page cache with every other process mapping
+// the same file, and opening one costs a few system calls no matter how
+// large the file is; pages are read on first touch, guided by the access
+// hint given to madvise.
+
+namespace matrix_impl {
+
+// the dtype string of an element type, e.g. "<f8" for double
+template <typename T> auto npy_descr() -> std::string {
+  static_assert(std::is_arithmetic_v<T> || std::is_same_v<T, float16>,
+                "no .npy dtype for this type");
+  char kind = 'f';
+  if constexpr (std::is_same_v<T, bool>) {
+    kind = 'b';
+  } else if constexpr (std::is_integral_v<T>) {
+    kind = std::is_signed_v<T> ? 'i' : 'u';
+  }
+  char order = std::endian::native == std::endian::little ? '<' : '>';
+  if constexpr (sizeof(T) == 1) {
+    order = '|';
+  }
+  return std::string{order, kind} + std::to_string(sizeof(T));
+}
+
+struct Npy_header {
+  std::string descr;
+  bool fortran_order = false;
+  std::vector<std::size_t> shape;
+  std::size_t data_offset = 0; // bytes before the first element
+};
+
+inline constexpr char npy_magic[] = "\x93NUMPY";
+inline constexpr std::size_t npy_magic_size = 6;
+inline constexpr std::size_t npy_alignment = 64;
+
+// the header for an array of the given dtype and shape, padded so the data
+// that follows it starts on a 64-byte boundary
+inline auto npy_header(const std::string &descr,
+                       const std::vector<std::size_t> &shape) -> std::string {
+  std::string dict = "{'descr': '" + descr +
+                     "', 'fortran_order': False, 'shape': (";
+  for (std::size_t d = 0; d < shape.size(); ++d) {
+    dict += std::to_string(shape[d]);
+    if (d + 1 < shape.size() || shape.size() == 1) {
+      dict += ",";
+    }
+    if (d + 1 < shape.size()) {
+      dict += " ";
+    }
+  }
+  dict += "), }";
+  // version 1.0 has a 2-byte header length, version 2.0 a 4-byte one
+  const bool v1 = dict.size() + 1 + 10 + npy_alignment <= 0xffff;
+  const std::size_t prefix = v1 ? 10 : 12;
+  const std::size_t total =
+      (prefix + dict.size() + 1 + npy_alignment - 1) / npy_alignment *
+      npy_alignment;
+  dict.append(total - prefix - dict.size() - 1, ' ');
+  dict += '\n';
+
+  std::string header(npy_magic, npy_magic_size);
+  header += static_cast<char>(v1 ? 1 : 2);
+  header += static_cast<char>(0);
+  const std::size_t len = dict.size();
+  for (std::size_t b = 0; b < (v1 ? 2U : 4U); ++b) {
+    header += static_cast<char>((len >> (8 * b)) & 0xff);
+  }
+  return header + dict;
+}
+
+// the value following 'key': in a header dictionary
+inline auto npy_field(const std::string &dict, const std::string &key)
+    -> std::size_t {
+  const std::size_t at = dict.find("'" + key + "'");
+  if (at == std::string::npos) {
+    throw std::runtime_error("npy: header has no '" + key + "'");
+  }
+  const std::size_t colon = dict.find(':', at);
+  if (colon == std::string::npos) {
+    throw std::runtime_error("npy: malformed header");
+  }
+  return dict.find_first_not_of(' ', colon + 1);
+}
+
+// the total size of a header from its first 12 bytes (fewer are fine when
+// they say it is a version 1 header)
+inline auto npy_header_size(const char *bytes, std::size_t available)
+    -> std::size_t {
+  if (available < 10 || std::memcmp(bytes, npy_magic, npy_magic_size) != 0) {
+    throw std::runtime_error("npy: not a .npy file");
+  }
+  const auto major = static_cast<unsigned char>(bytes[6]);
+  if (major < 1 || major > 3 || (major > 1 && available < 12)) {
+    throw std::runtime_error("npy: unsupported format version");
+  }
+  const std::size_t width = major == 1 ? 2 : 4;
+  std::size_t len = 0;
+  for (std::size_t b = 0; b < width; ++b) {
+    len |= std::size_t{static_cast<unsigned char>(bytes[8 + b])} << (8 * b);
+  }
+  return 8 + width + len;
+}
+
+// parse the fixed prefix and the dictionary of a header; `bytes` must hold
+// at least the whole header
+inline auto parse_npy_header(const char *bytes, std::size_t available)
+    -> Npy_header {
+  Npy_header h;
+  h.data_offset = npy_header_size(bytes, available);
+  if (h.data_offset > available) {
+    throw std::runtime_error("npy: truncated header");
+  }
+  const std::size_t prefix = bytes[6] == 1 ? 10 : 12;
+  const std::string dict(bytes + prefix, h.data_offset - prefix);
+
+  std::size_t at = npy_field(dict, "descr");
+  const std::size_t end = dict.find(dict[at], at + 1);
+  if (end == std::string::npos) {
+    throw std::runtime_error("npy: malformed descr");
+  }
+  h.descr = dict.substr(at + 1, end - at - 1);
+
+  at = npy_field(dict, "fortran_order");
+  h.fortran_order = dict.compare(at, 4, "True") == 0;
+
+  at = npy_field(dict, "shape");
+  const std::size_t close = dict.find(')', at);
+  if (dict[at] != '(' || close == std::string::npos) {
+    throw std::runtime_error("npy: malformed shape");
+  }
+  for (std::size_t i = at + 1; i < close;) {
+    i = dict.find_first_of("0123456789", i);
+    if (i >= close) {
+      break;
+    }
+    std::size_t used = 0;
+    h.shape.push_back(std::stoull(dict.substr(i), &used));
+    i += used;
+  }
+  return h;
+}
+
+// the extents of a header, checked against the type it is loaded as
+template <typename T, std::size_t N>
+auto npy_extents(const Npy_header &h) -> std::array<std::size_t, N> {
+  if (h.descr != npy_descr<T>()) {
+    throw std::runtime_error("npy: dtype " + h.descr + " does not match " +
+                             npy_descr<T>());
+  }
+  if (h.fortran_order) {
+    throw std::runtime_error("npy: Fortran-order arrays are not supported");
+  }
+  if (h.shape.size() != N) {
+    throw std::runtime_error("npy: array has " +
+                             std::to_string(h.shape.size()) +
+                             " dimensions, expected " + std::to_string(N));
+  }
+  std::array<std::size_t, N> extents{};
+  std::copy(h.shape.begin(), h.shape.end(), extents.begin());
+  return extents;
+}
+
+} // namespace matrix_impl
+
+// write m to path in .npy format
+template <typename M, typename = Enable_if<matrix_impl::Is_matrix_v<M>, void>>
+auto save_npy(const std::string &path, const M &m) -> void {
+  using T = matrix_impl::Value_type<M>;
+  const auto m_r = matrix_impl::as_ref(m);
+  const auto &desc = m_r.descriptor();
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw std::runtime_error("npy: cannot open " + path + " for writing");
+  }
+  const std::string header = matrix_impl::npy_header(
+      matrix_impl::npy_descr<T>(),
+      {desc.extents.begin(), desc.extents.end()});
+  out.write(header.data(), static_cast<std::streamsize>(header.size()));
+
+  // unit-stride runs are written in place, strided ones through a buffer
+  std::vector<T> buffer;
+  m_r.for_each_run([&](const T *first, std::size_t n, std::size_t stride) {
+    if (stride != 1) {
+      buffer.resize(n);
+      for (std::size_t i = 0; i < n; ++i) {
+        buffer[i] = first[i * stride];
+      }
+      first = buffer.data();
+    }
+    out.write(reinterpret_cast<const char *>(first),
+              static_cast<std::streamsize>(n * sizeof(T)));
+  });
+  if (!out.flush()) {
+    throw std::runtime_error("npy: error writing " + path);
+  }
+}
+
+// read a .npy file holding an N-dimensional array of T
+template <typename T, std::size_t N>
+auto load_npy(const std::string &path) -> Matrix<T, N> {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("npy: cannot open " + path);
+  }
+  std::string bytes(12, '\0');
+  in.read(bytes.data(), 12);
+  bytes.resize(matrix_impl::npy_header_size(
+      bytes.data(), static_cast<std::size_t>(in.gcount())));
+  in.clear();
+  in.seekg(0);
+  in.read(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+  const auto h = matrix_impl::parse_npy_header(
+      bytes.data(), static_cast<std::size_t>(in.gcount()));
+
+  Matrix<T, N> m(matrix_impl::npy_extents<T, N>(h));
+  in.read(reinterpret_cast<char *>(m.data()),
+          static_cast<std::streamsize>(m.size() * sizeof(T)));
+  if (static_cast<std::size_t>(in.gcount()) != m.size() * sizeof(T)) {
+    throw std::runtime_error("npy: " + path + " is truncated");
+  }
+  return m;
+}
+
+#if defined(MATRIX_DESIGN_HAS_MMAP)
+
+// how a mapped file will be read, passed on to madvise
+enum class Access {
+  normal,     // no particular pattern
+  sequential, // front to back: read ahead aggressively, drop pages behind
+  random,     // scattered reads: no read-ahead
+  will_need,  // the whole file soon: start reading it in now
+};
+
+// A read-only .npy file mapped into memory. The elements are viewed in
+// place, so the matrix is usable (as a Matrix_ref<const T, N>) as soon as
+// the header is parsed; the mapping is released with the object.
+template <typename T, std::size_t N> class Mapped_matrix {
+public:
+  static constexpr std::size_t order = N;
+  using value_type = const T;
+
+  explicit Mapped_matrix(const std::string &path,
+                         Access access = Access::normal) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw std::runtime_error("npy: cannot open " + path);
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+      ::close(fd);
+      throw std::runtime_error("npy: cannot map " + path);
+    }
+    length = static_cast<std::size_t>(st.st_size);
+    base = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps the file alive
+    if (base == MAP_FAILED) {
+      base = nullptr;
+      throw std::runtime_error("npy: cannot map " + path);
+    }
+    try {
+      const auto h = matrix_impl::parse_npy_header(
+          static_cast<const char *>(base), length);
+      const auto extents = matrix_impl::npy_extents<T, N>(h);
+      desc.start = 0;
+      desc.extents = extents;
+      desc.strides = matrix_impl::computing_stride<N>(extents);
+      desc.size = matrix_impl::computing_size<N>(extents);
+      if (h.data_offset + desc.size * sizeof(T) > length) {
+        throw std::runtime_error("npy: " + path + " is truncated");
+      }
+      if (h.data_offset % alignof(T) != 0) {
+        throw std::runtime_error("npy: " + path + " has misaligned data");
+      }
+      elems = reinterpret_cast<const T *>(static_cast<const char *>(base) +
+                                          h.data_offset);
+    } catch (...) {
+      ::munmap(base, length);
+      throw;
+    }
+    advise(access);
+  }
+
+  Mapped_matrix(const Mapped_matrix &) = delete;
+  auto operator=(const Mapped_matrix &) -> Mapped_matrix & = delete;
+  Mapped_matrix(Mapped_matrix &&other) noexcept { swap(other); }
+  auto operator=(Mapped_matrix &&other) noexcept -> Mapped_matrix & {
+    Mapped_matrix(std::move(other)).swap(*this);
+    return *this;
+  }
+  ~Mapped_matrix() {
+    if (base != nullptr) {
+      ::munmap(base, length);
+    }
+  }
+
+  // change the expected access pattern of the mapping
+  auto advise(Access access) const -> void {
+    int advice = MADV_NORMAL;
+    switch (access) {
+    case Access::normal:
+      break;
+    case Access::sequential:
+      advice = MADV_SEQUENTIAL;
+      break;
+    case Access::random:
+      advice = MADV_RANDOM;
+      break;
+    case Access::will_need:
+      advice = MADV_WILLNEED;
+      break;
+    }
+    ::madvise(base, length, advice); // only a hint: failure is harmless
+  }
+
+  [[nodiscard]] auto extent(std::size_t n) const -> std::size_t {
+    return desc.extents[n];
+  } // # elements in the nth dimension
+  [[nodiscard]] auto size() const -> std::size_t {
+    return desc.size;
+  } // total number of elements
+  auto descriptor() const -> const Matrix_slice<N> & { return desc; }
+  auto data() const -> const T * { return elems; }
+
+  auto view() const -> Matrix_ref<const T, N> { return {desc, elems}; }
+  operator Matrix_ref<const T, N>() const { return view(); }
+
+private:
+  auto swap(Mapped_matrix &other) noexcept -> void {
+    std::swap(base, other.base);
+    std::swap(length, other.length);
+    std::swap(desc, other.desc);
+    std::swap(elems, other.elems);
+  }
+
+  void *base = nullptr;
+  std::size_t length = 0;
+  Matrix_slice<N> desc;
+  const T *elems = nullptr;
+};
+
+// map a .npy file holding an N-dimensional array of T
+template <typename T, std::size_t N>
+auto map_npy(const std::string &path, Access access = Access::normal)
+    -> Mapped_matrix<T, N> {
+  return Mapped_matrix<T, N>(path, access);
+}
+
+namespace matrix_impl {
+
+template <typename T, std::size_t N>
+struct Is_matrix<Mapped_matrix<T, N>> : std::true_type {};
+
+} // namespace matrix_impl
+
+#endif
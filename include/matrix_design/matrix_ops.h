@@ -0,0 +1,211 @@
+#pragma once
+
+#include "matrix.h"
+#include "matrix_execution.h"
+#include "matrix_expr.h"
+#include "matrix_simd.h"
+#include <type_traits>
+
+// Element-wise arithmetic on Matrix and Matrix_ref operands of equal shape.
+// The operators return lazy expressions (see matrix_expr.h), so
+// `a = b * 2.0 + c - d` is evaluated in one fused pass straight into a,
+// without a temporary matrix per operator.
+
+namespace matrix_impl {
+
+template <typename A, typename B>
+using Enable_if_operands =
+    Enable_if<Is_operand_v<A> && Is_operand_v<B> &&
+                  (Expr_type<A>::order == Expr_type<B>::order),
+              void>;
+
+template <typename A, typename S>
+using Enable_if_scalar =
+    Enable_if<Is_operand_v<A> && !Is_operand_v<S> &&
+                  std::is_convertible_v<S, typename Expr_type<A>::value_type>,
+              void>;
+
+} // namespace matrix_impl
+
+template <typename A, typename B,
+          typename = matrix_impl::Enable_if_operands<A, B>>
+auto operator+(const A &a, const B &b) {
+  return matrix_impl::make_binary<matrix_impl::simd::Plus>(a, b);
+}
+
+template <typename A, typename B,
+          typename = matrix_impl::Enable_if_operands<A, B>>
+auto operator-(const A &a, const B &b) {
+  return matrix_impl::make_binary<matrix_impl::simd::Minus>(a, b);
+}
+
+template <typename A, typename S,
+          typename = matrix_impl::Enable_if_scalar<A, S>>
+auto operator*(const A &a, const S &s) {
+  return matrix_impl::make_scalar<matrix_impl::simd::Multiplies>(a, s);
+}
+
+template <typename S, typename A,
+          typename = matrix_impl::Enable_if_scalar<A, S>, typename = void>
+auto operator*(const S &s, const A &a) {
+  return matrix_impl::make_scalar<matrix_impl::simd::Multiplies>(a, s);
+}
+
+template <typename A, typename S,
+          typename = matrix_impl::Enable_if_scalar<A, S>>
+auto operator/(const A &a, const S &s) {
+  return matrix_impl::make_scalar<matrix_impl::simd::Divides>(a, s);
+}
+
+template <typename A,
+          typename = Enable_if<matrix_impl::Is_operand_v<A>, void>>
+auto operator-(const A &a) {
+  using T = typename matrix_impl::Expr_type<A>::value_type;
+  return matrix_impl::make_scalar<matrix_impl::simd::Multiplies>(a, T(-1));
+}
+
+// element-wise product and quotient; a * b of two matrices is the matrix
+// product (see matrix_gemm.h)
+template <typename A, typename B,
+          typename = matrix_impl::Enable_if_operands<A, B>>
+auto multiply(const A &a, const B &b) {
+  return matrix_impl::make_binary<matrix_impl::simd::Multiplies>(a, b);
+}
+
+template <typename A, typename B,
+          typename = matrix_impl::Enable_if_operands<A, B>>
+auto divide(const A &a, const B &b) {
+  return matrix_impl::make_binary<matrix_impl::simd::Divides>(a, b);
+}
+
+// compound assignment updates the left operand in place; a Matrix_ref
+// target writes through to the matrix it views
+template <typename T, std::size_t N, typename B,
+          typename = Enable_if<matrix_impl::Is_operand_v<B>, void>>
+auto operator+=(Matrix_ref<T, N> lhs, const B &rhs) -> Matrix_ref<T, N> {
+  matrix_impl::evaluate(lhs, lhs + rhs);
+  return lhs;
+}
+
+template <typename T, std::size_t N, typename B,
+          typename = Enable_if<matrix_impl::Is_operand_v<B>, void>>
+auto operator-=(Matrix_ref<T, N> lhs, const B &rhs) -> Matrix_ref<T, N> {
+  matrix_impl::evaluate(lhs, lhs - rhs);
+  return lhs;
+}
+
+template <typename T, std::size_t N, typename S,
+          typename = matrix_impl::Enable_if_scalar<Matrix_ref<T, N>, S>>
+auto operator*=(Matrix_ref<T, N> lhs, const S &s) -> Matrix_ref<T, N> {
+  matrix_impl::evaluate(lhs, lhs * s);
+  return lhs;
+}
+
+template <typename T, std::size_t N, typename S,
+          typename = matrix_impl::Enable_if_scalar<Matrix_ref<T, N>, S>>
+auto operator/=(Matrix_ref<T, N> lhs, const S &s) -> Matrix_ref<T, N> {
+  matrix_impl::evaluate(lhs, lhs / s);
+  return lhs;
+}
+
+template <typename T, std::size_t N, typename A, typename B,
+          typename = Enable_if<matrix_impl::Is_operand_v<B>, void>>
+auto operator+=(Matrix<T, N, A> &lhs, const B &rhs) -> Matrix<T, N, A> & {
+  Matrix_ref<T, N>(lhs) += rhs;
+  return lhs;
+}
+
+template <typename T, std::size_t N, typename A, typename B,
+          typename = Enable_if<matrix_impl::Is_operand_v<B>, void>>
+auto operator-=(Matrix<T, N, A> &lhs, const B &rhs) -> Matrix<T, N, A> & {
+  Matrix_ref<T, N>(lhs) -= rhs;
+  return lhs;
+}
+
+template <typename T, std::size_t N, typename A, typename S,
+          typename = matrix_impl::Enable_if_scalar<Matrix<T, N, A>, S>>
+auto operator*=(Matrix<T, N, A> &lhs, const S &s) -> Matrix<T, N, A> & {
+  Matrix_ref<T, N>(lhs) *= s;
+  return lhs;
+}
+
+template <typename T, std::size_t N, typename A, typename S,
+          typename = matrix_impl::Enable_if_scalar<Matrix<T, N, A>, S>>
+auto operator/=(Matrix<T, N, A> &lhs, const S &s) -> Matrix<T, N, A> & {
+  Matrix_ref<T, N>(lhs) /= s;
+  return lhs;
+}
+
+// dst = expr, with the work split according to the policy
+template <typename Policy, typename T, std::size_t N, typename B,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy> &&
+                                   matrix_impl::Is_operand_v<B>,
+                               void>>
+auto assign(const Policy &policy, Matrix_ref<T, N> dst, const B &expr)
+    -> Matrix_ref<T, N> {
+  matrix_impl::evaluate(policy, dst, matrix_impl::as_expr(expr));
+  return dst;
+}
+
+template <typename Policy, typename T, std::size_t N, typename A, typename B,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy> &&
+                                   matrix_impl::Is_operand_v<B>,
+                               void>>
+auto assign(const Policy &policy, Matrix<T, N, A> &dst, const B &expr)
+    -> Matrix<T, N, A> & {
+  if (dst.descriptor().extents != matrix_impl::as_expr(expr).extents()) {
+    // the expression may still read the old elements
+    return dst = Matrix<T, N, A>(policy, matrix_impl::as_expr(expr),
+                                 dst.get_allocator());
+  }
+  assign(policy, Matrix_ref<T, N>(dst), expr);
+  return dst;
+}
+
+// f(x) for every element x of the view
+template <typename T, std::size_t N, typename F>
+auto apply(Matrix_ref<T, N> m_r, F f) -> Matrix_ref<T, N> {
+  m_r.for_each_run([&](T *first, std::size_t n, std::size_t stride) {
+    if (stride == 1) {
+      for (std::size_t i = 0; i < n; ++i) {
+        f(first[i]);
+      }
+      return;
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+      f(first[i * stride]);
+    }
+  });
+  return m_r;
+}
+
+// f(x) for every element x of the matrix
+template <typename T, std::size_t N, typename A, typename F>
+auto apply(Matrix<T, N, A> &m, F f) -> Matrix<T, N, A> & {
+  T *p = m.data();
+  for (std::size_t i = 0; i < m.size(); ++i) {
+    f(p[i]);
+  }
+  return m;
+}
+
+// apply(m, f) with the outermost dimension split according to the policy;
+// f may be called concurrently on different elements. Like apply(m, f), it
+// returns a matrix by reference and a temporary view by value.
+template <typename Policy, typename M, typename F,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy> &&
+                                   matrix_impl::Is_matrix_v<M>,
+                               void>>
+auto apply(const Policy &policy, M &&m, F f)
+    -> std::conditional_t<std::is_lvalue_reference_v<M>, M, std::decay_t<M>> {
+  const auto m_r = matrix_impl::as_ref(m);
+  const auto &desc = m_r.descriptor();
+  if (desc.size != 0) {
+    matrix_impl::for_each_row_block(
+        policy, desc.extents[0], desc.size / desc.extents[0],
+        [&](std::size_t first, std::size_t last) {
+          apply(matrix_impl::row_range(m_r, first, last), f);
+        });
+  }
+  return std::forward<M>(m);
+}
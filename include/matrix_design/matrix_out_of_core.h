@@ -0,0 +1,289 @@
+#pragma once
+
+#include "matrix.h"
+#include "matrix_chunked.h"
+#include "matrix_gemm.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+// Out-of-core algorithms over chunked files (see matrix_chunked.h).
+//
+//   matmul_out_of_core(a, b, path)        c = a * b, written to a chunked
+//                                         file tile by tile
+//   reduce_out_of_core(a, init, op)       op-fold of every element
+//   reduce_axis_out_of_core(a, axis, init, op)
+//                                         op-fold along one axis
+//
+// The operands are read in tiles sized to options.memory_budget. A
+// background I/O thread reads the next tile while the current one is
+// computed on, so once the first tile is in, a run takes about as long as
+// the slower of reading and computing rather than their sum. Tiles are
+// rounded to whole chunks of the files, which are the smallest unit read.
+//
+// Arrays in .npy files need none of this: a Mapped_matrix (matrix_npy.h)
+// is an ordinary operand whose pages the kernel reads and evicts on demand.
+
+struct Out_of_core_stats {
+  std::size_t bytes_read = 0;   // stored bytes read from the operands
+  double io_wait_seconds = 0.0; // time computation waited for reads
+};
+
+struct Out_of_core_options {
+  // bytes of tiles held at once, counting the tiles being prefetched
+  std::size_t memory_budget = std::size_t{256} << 20;
+  // compression of the files written
+  Chunk_codec codec = Chunk_codec::none;
+  // filled in when set
+  Out_of_core_stats *stats = nullptr;
+};
+
+namespace matrix_impl {
+
+// one thread running I/O jobs in submission order
+class Io_thread {
+public:
+  Io_thread() : worker{[this] { run(); }} {}
+
+  Io_thread(const Io_thread &) = delete;
+  auto operator=(const Io_thread &) -> Io_thread & = delete;
+
+  // finishes the running job; queued ones are dropped
+  ~Io_thread() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+      jobs.clear();
+    }
+    wake.notify_one();
+    worker.join();
+  }
+
+  template <typename F> auto submit(F f) -> std::future<decltype(f())> {
+    auto task =
+        std::make_shared<std::packaged_task<decltype(f())()>>(std::move(f));
+    auto result = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      jobs.emplace_back([task] { (*task)(); });
+    }
+    wake.notify_one();
+    return result;
+  }
+
+private:
+  auto run() -> void {
+    while (true) {
+      std::function<void()> job;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (stopping) {
+          return;
+        }
+        job = std::move(jobs.front());
+        jobs.pop_front();
+      }
+      job();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::deque<std::function<void()>> jobs;
+  bool stopping = false;
+  std::thread worker; // last: starts once the rest is ready
+};
+
+// the result of a prefetch, counting the time spent waiting for it
+template <typename R>
+auto await(std::future<R> &f, Out_of_core_stats &stats) -> R {
+  const auto start = std::chrono::steady_clock::now();
+  R result = f.get();
+  stats.io_wait_seconds += std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+  return result;
+}
+
+// a tile extent near `target`, in whole chunks and at most the extent
+inline auto tile_extent(std::size_t target, std::size_t chunk,
+                        std::size_t extent) -> std::size_t {
+  const std::size_t t = std::max(chunk, target / chunk * chunk);
+  return std::max<std::size_t>(1, std::min(t, extent));
+}
+
+inline auto blocks(std::size_t extent, std::size_t tile) -> std::size_t {
+  return (extent + tile - 1) / tile;
+}
+
+} // namespace matrix_impl
+
+// c = a * b for chunked files a (m x k) and b (k x n); c is written to a
+// new chunked file at c_path whose chunks are the output tiles
+template <typename T>
+auto matmul_out_of_core(Chunked_file<T, 2> &a, Chunked_file<T, 2> &b,
+                        const std::string &c_path,
+                        const Out_of_core_options &options = {}) -> void {
+  const std::size_t m = a.extents()[0];
+  const std::size_t k = a.extents()[1];
+  const std::size_t n = b.extents()[1];
+  assert(b.extents()[0] == k);
+  Out_of_core_stats stats;
+  const std::size_t bytes_before = a.bytes_read() + b.bytes_read();
+
+  // a c tile plus two tiles each of a and b; square tiles of side t
+  const auto t = static_cast<std::size_t>(
+      std::sqrt(double(options.memory_budget / sizeof(T)) / 5.0));
+  const std::size_t tm = matrix_impl::tile_extent(t, a.chunk_extents()[0], m);
+  const std::size_t tk = matrix_impl::tile_extent(t, a.chunk_extents()[1], k);
+  const std::size_t tn = matrix_impl::tile_extent(t, b.chunk_extents()[1], n);
+  const std::size_t mb = matrix_impl::blocks(m, tm);
+  const std::size_t kb = matrix_impl::blocks(k, tk);
+  const std::size_t nb = matrix_impl::blocks(n, tn);
+
+  Chunked_writer<T, 2> c(c_path, {m, n}, {tm, tn}, options.codec);
+  // step s multiplies a(i, p) by b(p, j) with s = (i * nb + j) * kb + p;
+  // without a k extent no tile is written and c reads as zeros
+  const std::size_t steps = mb * nb * kb;
+  {
+    using Tiles = std::pair<Matrix<T, 2>, Matrix<T, 2>>;
+    matrix_impl::Io_thread io;
+    const auto fetch = [&](std::size_t s) {
+      const std::size_t i = s / (nb * kb) * tm;
+      const std::size_t j = s / kb % nb * tn;
+      const std::size_t p = s % kb * tk;
+      return io.submit([&a, &b, i, j, p, m, n, k, tm, tn, tk] {
+        return Tiles(a.read(Slice(i, std::min(m, i + tm)),
+                            Slice(p, std::min(k, p + tk))),
+                     b.read(Slice(p, std::min(k, p + tk)),
+                            Slice(j, std::min(n, j + tn))));
+      });
+    };
+    std::future<Tiles> next;
+    if (steps > 0) {
+      next = fetch(0);
+    }
+    Matrix<T, 2> c_tile;
+    for (std::size_t s = 0; s < steps; ++s) {
+      const Tiles tiles = matrix_impl::await(next, stats);
+      if (s + 1 < steps) {
+        next = fetch(s + 1);
+      }
+      const bool first = s % kb == 0;
+      if (first) {
+        c_tile = Matrix<T, 2>(tiles.first.extent(0), tiles.second.extent(1));
+      }
+      gemm(T{1}, tiles.first, tiles.second, first ? T{0} : T{1},
+           Matrix_ref<T, 2>(c_tile));
+      if (s % kb == kb - 1) {
+        c.write_chunk({s / (nb * kb), s / kb % nb}, c_tile);
+      }
+    }
+  }
+  c.close();
+  if (options.stats != nullptr) {
+    stats.bytes_read = a.bytes_read() + b.bytes_read() - bytes_before;
+    *options.stats = stats;
+  }
+}
+
+namespace matrix_impl {
+
+// f(first_row, slab) for consecutive row slabs of a, each read while the
+// previous one is processed
+template <typename T, typename F>
+auto for_each_row_slab(Chunked_file<T, 2> &a,
+                       const Out_of_core_options &options, F f) -> void {
+  const std::size_t m = a.extents()[0];
+  const std::size_t n = a.extents()[1];
+  Out_of_core_stats stats;
+  const std::size_t bytes_before = a.bytes_read();
+  // two slabs in memory at a time
+  const std::size_t rows = tile_extent(
+      options.memory_budget / sizeof(T) / 2 / std::max<std::size_t>(n, 1),
+      a.chunk_extents()[0], m);
+  {
+    Io_thread io;
+    const auto fetch = [&](std::size_t i) {
+      return io.submit([&a, i, rows, m, n] {
+        return a.read(Slice(i, std::min(m, i + rows)), Slice(0, n));
+      });
+    };
+    std::future<Matrix<T, 2>> next;
+    if (m > 0) {
+      next = fetch(0);
+    }
+    for (std::size_t i = 0; i < m; i += rows) {
+      const Matrix<T, 2> slab = await(next, stats);
+      if (i + rows < m) {
+        next = fetch(i + rows);
+      }
+      f(i, slab);
+    }
+  }
+  if (options.stats != nullptr) {
+    stats.bytes_read = a.bytes_read() - bytes_before;
+    *options.stats = stats;
+  }
+}
+
+} // namespace matrix_impl
+
+// op(init, e0, e1, ...) over every element of a chunked file, in row-major
+// order
+template <typename T, typename Op>
+auto reduce_out_of_core(Chunked_file<T, 2> &a, T init, Op op,
+                        const Out_of_core_options &options = {}) -> T {
+  matrix_impl::for_each_row_slab(
+      a, options, [&](std::size_t /*first*/, const Matrix<T, 2> &slab) {
+        for (const T &x : slab) {
+          init = op(init, x);
+        }
+      });
+  return init;
+}
+
+// op-fold along one axis: axis 0 folds every column into one element of
+// the result (n elements), axis 1 every row (m elements)
+template <typename T, typename Op>
+auto reduce_axis_out_of_core(Chunked_file<T, 2> &a, std::size_t axis, T init,
+                             Op op, const Out_of_core_options &options = {})
+    -> Matrix<T, 1> {
+  assert(axis < 2);
+  Matrix<T, 1> result(
+      std::array<std::size_t, 1>{a.extents()[axis == 0 ? 1 : 0]});
+  std::fill(result.data(), result.data() + result.size(), init);
+  T *r = result.data();
+  matrix_impl::for_each_row_slab(
+      a, options, [&](std::size_t first, const Matrix<T, 2> &slab) {
+        const std::size_t rows = slab.extent(0);
+        const std::size_t cols = slab.extent(1);
+        const T *x = slab.data();
+        for (std::size_t i = 0; i < rows; ++i, x += cols) {
+          if (axis == 0) {
+            for (std::size_t j = 0; j < cols; ++j) {
+              r[j] = op(r[j], x[j]);
+            }
+          } else {
+            T acc = r[first + i];
+            for (std::size_t j = 0; j < cols; ++j) {
+              acc = op(acc, x[j]);
+            }
+            r[first + i] = acc;
+          }
+        }
+      });
+  return result;
+}
@@ -0,0 +1,561 @@
+#pragma once
+
+#include "matrix.h"
+#include "matrix_dispatch.h"
+#include "matrix_execution.h"
+#include "matrix_gemm.h"
+#include "matrix_instrument.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// 8-bit quantized matrices and their products.
+//
+//   quantize(m, axis[, scheme])   a Quantized_matrix of a float matrix or
+//                                 view, one scale and zero point per row
+//                                 or per column
+//   dequantize(q)                 back to a Matrix<float, 2>
+//   matmul(qa, qb)                the float product of a matrix quantized
+//                                 per row and one quantized per column
+//   matmul_int8(a, b)             the exact int32 product of two int8
+//                                 operands
+//
+// A quantized element q stands for scale * (q - zero_point). Symmetric
+// quantization maps the largest magnitude of a row or column to 127 with a
+// zero point of 0; asymmetric maps its [min, max] range (widened to
+// include 0) onto [-128, 127].
+//
+// The int8 product follows the float gemm's packed-panel layering with
+// int32 accumulators, and its micro-kernel is picked at run time like the
+// float one's (see matrix_dispatch.h). With AVX-512 VNNI it multiplies four
+// unsigned bytes of A (stored offset by 128) with four signed bytes of B
+// per int32 lane (vpdpbusd) and subtracts the offset's contribution once
+// per column; otherwise the operands are widened to int16 and multiplied
+// in pairs (vpmaddwd with AVX2, plain loops elsewhere), which unlike
+// vpmaddubsw cannot saturate. Every path gives the exact product. Parallel
+// policies split the rows of the result as for gemm.
+
+enum class Quant_axis { rows, cols }; // a scale per row or per column
+
+enum class Quant_scheme { symmetric, asymmetric };
+
+class Quantized_matrix {
+public:
+  Quantized_matrix() = default;
+
+  // values with one scale and zero point per row or column of values
+  Quantized_matrix(Matrix<std::int8_t, 2> values, Matrix<float, 1> scales,
+                   Matrix<std::int32_t, 1> zero_points, Quant_axis axis)
+      : q(std::move(values)), s(std::move(scales)),
+        z(std::move(zero_points)), ax{axis} {
+    const std::size_t groups = q.extent(ax == Quant_axis::rows ? 0 : 1);
+    if (s.size() != groups || z.size() != groups) {
+      throw std::invalid_argument(
+          "Quantized_matrix: need one scale and zero point per " +
+          std::string(ax == Quant_axis::rows ? "row" : "column"));
+    }
+  }
+
+  [[nodiscard]] auto values() const -> const Matrix<std::int8_t, 2> & {
+    return q;
+  }
+  [[nodiscard]] auto scales() const -> const Matrix<float, 1> & { return s; }
+  [[nodiscard]] auto zero_points() const -> const Matrix<std::int32_t, 1> & {
+    return z;
+  }
+  [[nodiscard]] auto axis() const -> Quant_axis { return ax; }
+  [[nodiscard]] auto extent(std::size_t n) const -> std::size_t {
+    return q.extent(n);
+  }
+
+  // the scale and zero point of element (i, j)
+  [[nodiscard]] auto group(std::size_t i, std::size_t j) const
+      -> std::size_t {
+    return ax == Quant_axis::rows ? i : j;
+  }
+
+private:
+  Matrix<std::int8_t, 2> q;
+  Matrix<float, 1> s;
+  Matrix<std::int32_t, 1> z;
+  Quant_axis ax = Quant_axis::rows;
+};
+
+namespace matrix_impl {
+
+// the micro-kernels: vpdpbusd (AVX-512 VNNI), vpmaddwd (AVX2), plain loops
+enum class Qgemm_kernel { generic, madd, vnni };
+
+// the k values one int32 lane of kernel K multiplies and adds in one step,
+// and how the packed operands store them
+template <Qgemm_kernel K> struct Qgemm_layout {
+  static constexpr std::size_t group = 2; // s16 x s16
+  using A = std::int16_t;
+  using B = std::int16_t;
+  static constexpr std::int32_t a_offset = 0;
+  static constexpr std::size_t nr = 16;
+};
+
+template <> struct Qgemm_layout<Qgemm_kernel::vnni> {
+  static constexpr std::size_t group = 4; // u8 x s8
+  using A = std::uint8_t;
+  using B = std::int8_t;
+  static constexpr std::int32_t a_offset = 128;
+  static constexpr std::size_t nr = 32;
+};
+
+inline constexpr std::size_t qgemm_mr = 6;
+inline constexpr std::size_t qgemm_kc = 1024; // a multiple of the group
+inline constexpr std::size_t qgemm_mc = 96;
+inline constexpr std::size_t qgemm_nc = 2048;
+
+// the widest kernel the level in use and the CPU allow
+inline auto qgemm_kernel() -> Qgemm_kernel {
+  [[maybe_unused]] const Isa level = matrix_dispatch::isa();
+#if defined(MATRIX_DESIGN_HAS_VNNI)
+  if (level == Isa::avx512 && matrix_dispatch::cpu_features().avx512_vnni) {
+    return Qgemm_kernel::vnni;
+  }
+#endif
+#if defined(MATRIX_DESIGN_HAS_AVX2)
+  if (level >= Isa::avx2) {
+    return Qgemm_kernel::madd;
+  }
+#endif
+  return Qgemm_kernel::generic;
+}
+
+// pack an mc x kc block of A into row panels of height mr, each k group of
+// a row contiguous and offset by the layout's a_offset; padding is zero
+template <Qgemm_kernel K, typename L = Qgemm_layout<K>>
+auto qgemm_pack_a(std::size_t mc, std::size_t kc, const std::int8_t *a,
+                  std::size_t rsa, std::size_t csa, typename L::A *buf)
+    -> void {
+  constexpr std::size_t MR = qgemm_mr;
+  constexpr std::size_t G = L::group;
+  for (std::size_t ir = 0; ir < mc; ir += MR) {
+    const std::size_t mr = std::min(MR, mc - ir);
+    for (std::size_t p0 = 0; p0 < kc; p0 += G) {
+      for (std::size_t i = 0; i < MR; ++i) {
+        for (std::size_t t = 0; t < G; ++t) {
+          const std::size_t p = p0 + t;
+          buf[i * G + t] =
+              i < mr && p < kc
+                  ? static_cast<typename L::A>(a[(ir + i) * rsa + p * csa] +
+                                               L::a_offset)
+                  : typename L::A{};
+        }
+      }
+      buf += MR * G;
+    }
+  }
+}
+
+// pack a kc x nc panel of B into column panels of width nr, each k group of
+// a column contiguous; sums[j] gets the sum of column j
+template <Qgemm_kernel K, typename L = Qgemm_layout<K>>
+auto qgemm_pack_b(std::size_t kc, std::size_t nc, const std::int8_t *b,
+                  std::size_t rsb, std::size_t csb, typename L::B *buf,
+                  std::int32_t *sums) -> void {
+  constexpr std::size_t NR = L::nr;
+  constexpr std::size_t G = L::group;
+  std::fill(sums, sums + nc, 0);
+  for (std::size_t jr = 0; jr < nc; jr += NR) {
+    const std::size_t nr = std::min(NR, nc - jr);
+    for (std::size_t p0 = 0; p0 < kc; p0 += G) {
+      for (std::size_t j = 0; j < NR; ++j) {
+        for (std::size_t t = 0; t < G; ++t) {
+          const std::size_t p = p0 + t;
+          const std::int8_t x =
+              j < nr && p < kc ? b[p * rsb + (jr + j) * csb] : std::int8_t{0};
+          buf[j * G + t] = x;
+          if (j < nr) {
+            sums[jr + j] += x;
+          }
+        }
+      }
+      buf += NR * G;
+    }
+  }
+}
+
+// G packed values of a row of A as one int32 to broadcast
+template <typename A> auto qgemm_lane(const A *p) -> std::int32_t {
+  std::int32_t x;
+  std::memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+// ab = the mr x nr int32 tile of groups k groups of packed A and B
+template <Qgemm_kernel K, typename L = Qgemm_layout<K>>
+auto qgemm_micro_kernel(std::size_t groups, const typename L::A *a,
+                        const typename L::B *b, std::int32_t *ab) -> void {
+  constexpr std::size_t MR = qgemm_mr;
+  constexpr std::size_t NR = L::nr;
+  constexpr std::size_t G = L::group;
+  std::int32_t acc[MR][NR] = {};
+  for (std::size_t g = 0; g < groups; ++g) {
+    for (std::size_t i = 0; i < MR; ++i) {
+      for (std::size_t j = 0; j < NR; ++j) {
+        for (std::size_t t = 0; t < G; ++t) {
+          acc[i][j] += std::int32_t{a[i * G + t]} * std::int32_t{b[j * G + t]};
+        }
+      }
+    }
+    a += MR * G;
+    b += NR * G;
+  }
+  for (std::size_t i = 0; i < MR; ++i) {
+    std::copy(acc[i], acc[i] + NR, ab + i * NR);
+  }
+}
+
+#if defined(MATRIX_DESIGN_HAS_VNNI)
+template <>
+MATRIX_DESIGN_TARGET_VNNI inline auto
+qgemm_micro_kernel<Qgemm_kernel::vnni>(std::size_t groups,
+                                       const std::uint8_t *a,
+                                       const std::int8_t *b, std::int32_t *ab)
+    -> void {
+  constexpr std::size_t MR = qgemm_mr;
+  constexpr std::size_t NR = Qgemm_layout<Qgemm_kernel::vnni>::nr;
+  constexpr std::size_t G = Qgemm_layout<Qgemm_kernel::vnni>::group;
+  __m512i c[MR][2];
+  for (auto &row : c) {
+    row[0] = _mm512_setzero_si512();
+    row[1] = _mm512_setzero_si512();
+  }
+  for (std::size_t g = 0; g < groups; ++g) {
+    const __m512i b0 = _mm512_loadu_si512(b);
+    const __m512i b1 = _mm512_loadu_si512(b + 64);
+    for (std::size_t i = 0; i < MR; ++i) {
+      const __m512i a_i = _mm512_set1_epi32(qgemm_lane(a + i * G));
+      c[i][0] = _mm512_dpbusd_epi32(c[i][0], a_i, b0);
+      c[i][1] = _mm512_dpbusd_epi32(c[i][1], a_i, b1);
+    }
+    a += MR * G;
+    b += NR * G;
+  }
+  for (std::size_t i = 0; i < MR; ++i) {
+    _mm512_storeu_si512(ab + i * NR, c[i][0]);
+    _mm512_storeu_si512(ab + i * NR + 16, c[i][1]);
+  }
+}
+#endif
+
+#if defined(MATRIX_DESIGN_HAS_AVX2)
+template <>
+MATRIX_DESIGN_TARGET_AVX2 inline auto
+qgemm_micro_kernel<Qgemm_kernel::madd>(std::size_t groups,
+                                       const std::int16_t *a,
+                                       const std::int16_t *b, std::int32_t *ab)
+    -> void {
+  constexpr std::size_t MR = qgemm_mr;
+  constexpr std::size_t NR = Qgemm_layout<Qgemm_kernel::madd>::nr;
+  constexpr std::size_t G = Qgemm_layout<Qgemm_kernel::madd>::group;
+  __m256i c[MR][2];
+  for (auto &row : c) {
+    row[0] = _mm256_setzero_si256();
+    row[1] = _mm256_setzero_si256();
+  }
+  for (std::size_t g = 0; g < groups; ++g) {
+    const __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b));
+    const __m256i b1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + 16));
+    for (std::size_t i = 0; i < MR; ++i) {
+      const __m256i a_i = _mm256_set1_epi32(qgemm_lane(a + i * G));
+      c[i][0] = _mm256_add_epi32(c[i][0], _mm256_madd_epi16(a_i, b0));
+      c[i][1] = _mm256_add_epi32(c[i][1], _mm256_madd_epi16(a_i, b1));
+    }
+    a += MR * G;
+    b += NR * G;
+  }
+  for (std::size_t i = 0; i < MR; ++i) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(ab + i * NR), c[i][0]);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(ab + i * NR + 8),
+                        c[i][1]);
+  }
+}
+#endif
+
+// the product below with kernel K, for m, n, k > 0
+template <Qgemm_kernel K>
+auto qgemm_blocked(std::size_t m, std::size_t n, std::size_t k,
+                   const std::int8_t *a, std::size_t rsa, std::size_t csa,
+                   const std::int8_t *b, std::size_t rsb, std::size_t csb,
+                   std::int32_t *c, std::size_t rsc, std::size_t csc)
+    -> void {
+  using L = Qgemm_layout<K>;
+  constexpr std::size_t MR = qgemm_mr;
+  constexpr std::size_t NR = L::nr;
+  constexpr std::size_t G = L::group;
+  const std::size_t nc_max = std::min(qgemm_nc, (n + NR - 1) / NR * NR);
+  const std::size_t mc_max = std::min(qgemm_mc, (m + MR - 1) / MR * MR);
+  const std::size_t kc_max = std::min(qgemm_kc, (k + G - 1) / G * G);
+  auto *packed_b = gemm_buffer<typename L::B>(0, kc_max * nc_max);
+  auto *packed_a = gemm_buffer<typename L::A>(1, kc_max * mc_max);
+  thread_local std::vector<std::int32_t> sums;
+  sums.resize(nc_max);
+  alignas(64) std::int32_t ab[MR * NR];
+
+  for (std::size_t jc = 0; jc < n; jc += qgemm_nc) {
+    const std::size_t nc = std::min(qgemm_nc, n - jc);
+    for (std::size_t pc = 0; pc < k; pc += qgemm_kc) {
+      const std::size_t kc = std::min(qgemm_kc, k - pc);
+      const std::size_t groups = (kc + G - 1) / G;
+      qgemm_pack_b<K>(kc, nc, b + pc * rsb + jc * csb, rsb, csb, packed_b,
+                      sums.data());
+      for (std::size_t ic = 0; ic < m; ic += qgemm_mc) {
+        const std::size_t mc = std::min(qgemm_mc, m - ic);
+        qgemm_pack_a<K>(mc, kc, a + ic * rsa + pc * csa, rsa, csa, packed_a);
+        for (std::size_t jr = 0; jr < nc; jr += NR) {
+          const std::size_t nr = std::min(NR, nc - jr);
+          for (std::size_t ir = 0; ir < mc; ir += MR) {
+            const std::size_t mr = std::min(MR, mc - ir);
+            qgemm_micro_kernel<K>(groups, packed_a + ir * groups * G,
+                                  packed_b + jr * groups * G, ab);
+            std::int32_t *c_tile = c + (ic + ir) * rsc + (jc + jr) * csc;
+            for (std::size_t i = 0; i < mr; ++i) {
+              for (std::size_t j = 0; j < nr; ++j) {
+                // the offset added to A contributed offset * sum of column
+                const std::int32_t x =
+                    ab[i * NR + j] - L::a_offset * sums[jr + j];
+                std::int32_t &c_ij = c_tile[i * rsc + j * csc];
+                c_ij = pc == 0 ? x : c_ij + x;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+// C (m x n) = A (m x k) * B (k x n) in int32, every operand given by a
+// pointer to its first element plus row and column strides
+inline auto qgemm(std::size_t m, std::size_t n, std::size_t k,
+                  const std::int8_t *a, std::size_t rsa, std::size_t csa,
+                  const std::int8_t *b, std::size_t rsb, std::size_t csb,
+                  std::int32_t *c, std::size_t rsc, std::size_t csc) -> void {
+  if (m == 0 || n == 0) {
+    return;
+  }
+  if (k == 0) {
+    scale(m, n, std::int32_t{0}, c, rsc, csc);
+    return;
+  }
+  switch (qgemm_kernel()) {
+#if defined(MATRIX_DESIGN_HAS_VNNI)
+  case Qgemm_kernel::vnni:
+    qgemm_blocked<Qgemm_kernel::vnni>(m, n, k, a, rsa, csa, b, rsb, csb, c,
+                                      rsc, csc);
+    break;
+#endif
+#if defined(MATRIX_DESIGN_HAS_AVX2)
+  case Qgemm_kernel::madd:
+    qgemm_blocked<Qgemm_kernel::madd>(m, n, k, a, rsa, csa, b, rsb, csb, c,
+                                      rsc, csc);
+    break;
+#endif
+  default:
+    qgemm_blocked<Qgemm_kernel::generic>(m, n, k, a, rsa, csa, b, rsb, csb,
+                                         c, rsc, csc);
+    break;
+  }
+}
+
+template <typename Policy>
+auto qgemm(const Policy &policy, std::size_t m, std::size_t n, std::size_t k,
+           const std::int8_t *a, std::size_t rsa, std::size_t csa,
+           const std::int8_t *b, std::size_t rsb, std::size_t csb,
+           std::int32_t *c, std::size_t rsc, std::size_t csc) -> void {
+  const Kernel_scope scope(matrix_instrument::Kernel::gemm);
+  constexpr std::size_t mc = qgemm_mc;
+  const std::size_t blocks = (m + mc - 1) / mc;
+  for_each_row_block(policy, blocks, mc * n * std::max<std::size_t>(k, 1),
+                     [&](std::size_t first, std::size_t last) {
+                       const std::size_t i0 = first * mc;
+                       const std::size_t i1 = std::min(m, last * mc);
+                       qgemm(i1 - i0, n, k, a + i0 * rsa, rsa, csa, b, rsb,
+                             csb, c + i0 * rsc, rsc, csc);
+                     });
+}
+
+template <typename M>
+using Enable_if_int8_2d =
+    Enable_if<Is_matrix_v<M> && (std::remove_cv_t<M>::order == 2) &&
+                  std::is_same_v<Value_type<M>, std::int8_t>,
+              void>;
+
+} // namespace matrix_impl
+
+// the exact int32 product of two int8 matrices or views
+template <typename Policy, typename A, typename B,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy>,
+                               void>,
+          typename = matrix_impl::Enable_if_int8_2d<A>,
+          typename = matrix_impl::Enable_if_int8_2d<B>>
+auto matmul_int8(const Policy &policy, const A &a, const B &b)
+    -> Matrix<std::int32_t, 2> {
+  const auto a_r = matrix_impl::as_ref(a);
+  const auto b_r = matrix_impl::as_ref(b);
+  const auto &da = a_r.descriptor();
+  const auto &db = b_r.descriptor();
+  assert(da.extents[1] == db.extents[0]);
+  Matrix<std::int32_t, 2> c(da.extents[0], db.extents[1]);
+  matrix_impl::qgemm(policy, da.extents[0], db.extents[1], da.extents[1],
+                     a_r.pointer() + da.start, da.strides[0], da.strides[1],
+                     b_r.pointer() + db.start, db.strides[0], db.strides[1],
+                     c.data(), db.extents[1], std::size_t{1});
+  return c;
+}
+
+template <typename A, typename B,
+          typename = matrix_impl::Enable_if_int8_2d<A>,
+          typename = matrix_impl::Enable_if_int8_2d<B>>
+auto matmul_int8(const A &a, const B &b) -> Matrix<std::int32_t, 2> {
+  return matmul_int8(matrix_execution::seq, a, b);
+}
+
+// m quantized with a scale and zero point per row or per column
+template <typename M, typename = matrix_impl::Enable_if_matrix_2d<M>>
+auto quantize(const M &m, Quant_axis axis,
+              Quant_scheme scheme = Quant_scheme::symmetric)
+    -> Quantized_matrix {
+  static_assert(std::is_same_v<matrix_impl::Value_type<M>, float>,
+                "quantize takes a float matrix");
+  const auto m_r = matrix_impl::as_ref(m);
+  const auto &d = m_r.descriptor();
+  const float *p = m_r.pointer() + d.start;
+  const std::size_t rows = d.extents[0];
+  const std::size_t cols = d.extents[1];
+  const auto at = [&](std::size_t i, std::size_t j) {
+    return p[i * d.strides[0] + j * d.strides[1]];
+  };
+  const bool by_row = axis == Quant_axis::rows;
+  const std::size_t groups = by_row ? rows : cols;
+
+  // the range of each group, including 0
+  std::vector<float> lo(groups, 0.0F);
+  std::vector<float> hi(groups, 0.0F);
+  for (std::size_t i = 0; i < rows; ++i) {
+    for (std::size_t j = 0; j < cols; ++j) {
+      const std::size_t g = by_row ? i : j;
+      lo[g] = std::min(lo[g], at(i, j));
+      hi[g] = std::max(hi[g], at(i, j));
+    }
+  }
+  Matrix<float, 1> scales(std::array<std::size_t, 1>{groups});
+  Matrix<std::int32_t, 1> zeros(std::array<std::size_t, 1>{groups});
+  for (std::size_t g = 0; g < groups; ++g) {
+    float s = 0.0F;
+    std::int32_t z = 0;
+    if (scheme == Quant_scheme::symmetric) {
+      s = std::max(-lo[g], hi[g]) / 127.0F;
+    } else {
+      s = (hi[g] - lo[g]) / 255.0F;
+      if (s > 0.0F) {
+        z = static_cast<std::int32_t>(
+            std::clamp(std::nearbyint(-128.0F - lo[g] / s), -128.0F, 127.0F));
+      }
+    }
+    scales(g) = s > 0.0F ? s : 1.0F;
+    zeros(g) = z;
+  }
+  const float q_min = scheme == Quant_scheme::symmetric ? -127.0F : -128.0F;
+  Matrix<std::int8_t, 2> q(rows, cols);
+  std::int8_t *out = q.data();
+  for (std::size_t i = 0; i < rows; ++i) {
+    for (std::size_t j = 0; j < cols; ++j) {
+      const std::size_t g = by_row ? i : j;
+      const float x = std::nearbyint(at(i, j) / scales(g)) +
+                      static_cast<float>(zeros(g));
+      out[i * cols + j] =
+          static_cast<std::int8_t>(std::clamp(x, q_min, 127.0F));
+    }
+  }
+  return {std::move(q), std::move(scales), std::move(zeros), axis};
+}
+
+inline auto dequantize(const Quantized_matrix &q) -> Matrix<float, 2> {
+  const std::size_t rows = q.extent(0);
+  const std::size_t cols = q.extent(1);
+  Matrix<float, 2> m(rows, cols);
+  const std::int8_t *in = q.values().data();
+  float *out = m.data();
+  for (std::size_t i = 0; i < rows; ++i) {
+    for (std::size_t j = 0; j < cols; ++j) {
+      const std::size_t g = q.group(i, j);
+      out[i * cols + j] =
+          q.scales()(g) *
+          static_cast<float>(std::int32_t{in[i * cols + j]} -
+                             q.zero_points()(g));
+    }
+  }
+  return m;
+}
+
+// the float product of a quantized per row and b quantized per column:
+// c(i, j) = sa(i) sb(j) sum over p of (a(i, p) - za(i)) (b(p, j) - zb(j)),
+// from the int8 product and the row sums of a and column sums of b
+template <typename Policy,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy>,
+                               void>>
+auto matmul(const Policy &policy, const Quantized_matrix &a,
+            const Quantized_matrix &b) -> Matrix<float, 2> {
+  if (a.axis() != Quant_axis::rows || b.axis() != Quant_axis::cols) {
+    throw std::invalid_argument(
+        "matmul: the left operand must be quantized per row and the right "
+        "one per column");
+  }
+  const std::size_t m = a.extent(0);
+  const std::size_t k = a.extent(1);
+  const std::size_t n = b.extent(1);
+  assert(b.extent(0) == k);
+  const Matrix<std::int32_t, 2> s =
+      matmul_int8(policy, a.values(), b.values());
+  std::vector<std::int32_t> row_sums(m, 0);
+  std::vector<std::int32_t> col_sums(n, 0);
+  const std::int8_t *qa = a.values().data();
+  const std::int8_t *qb = b.values().data();
+  for (std::size_t i = 0; i < m; ++i) {
+    for (std::size_t p = 0; p < k; ++p) {
+      row_sums[i] += qa[i * k + p];
+    }
+  }
+  for (std::size_t p = 0; p < k; ++p) {
+    for (std::size_t j = 0; j < n; ++j) {
+      col_sums[j] += qb[p * n + j];
+    }
+  }
+  Matrix<float, 2> c(m, n);
+  const auto kk = static_cast<std::int64_t>(k);
+  const float *sb = b.scales().data();
+  const std::int32_t *zb = b.zero_points().data();
+  for (std::size_t i = 0; i < m; ++i) {
+    const float sa = a.scales()(i);
+    const std::int64_t za = a.zero_points()(i);
+    const std::int32_t *s_i = s.data() + i * n;
+    float *c_i = c.data() + i * n;
+    for (std::size_t j = 0; j < n; ++j) {
+      const std::int64_t dot = s_i[j] - za * col_sums[j] -
+                               zb[j] * (row_sums[i] - kk * za);
+      c_i[j] = sa * sb[j] * static_cast<float>(dot);
+    }
+  }
+  return c;
+}
+
+inline auto matmul(const Quantized_matrix &a, const Quantized_matrix &b)
+    -> Matrix<float, 2> {
+  return matmul(matrix_execution::seq, a, b);
+}
@@ -0,0 +1,800 @@
+#pragma once
+
+#include "matrix.h"
+#include "matrix_convert.h"
+#include "matrix_execution.h"
+#include "matrix_instrument.h"
+#include "matrix_simd.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Reductions over every element of a Matrix or Matrix_ref, and along an
+// axis. Unit-stride runs are summed and searched with the packs of the
+// instruction set level picked at run time (see matrix_dispatch.h).
+
+namespace matrix_impl {
+
+// op-fold of every element of a view, or nothing for an empty view
+template <typename T, std::size_t N, typename Op>
+auto fold(const Matrix_ref<T, N> &m_r, Op &op)
+    -> std::optional<std::remove_const_t<T>> {
+  std::optional<std::remove_const_t<T>> acc;
+  const auto &desc = m_r.descriptor();
+  const T *p = m_r.pointer();
+  for_each_run<N, 1>(desc.extents, {desc.strides}, {desc.start},
+                     [&](const auto &off, std::size_t n, const auto &inner) {
+                       const T *first = p + off[0];
+                       std::size_t i = 0;
+                       if (!acc) {
+                         acc = first[0];
+                         i = 1;
+                       }
+                       for (; i < n; ++i) {
+                         acc = op(*acc, first[i * inner[0]]);
+                       }
+                     });
+  return acc;
+}
+
+} // namespace matrix_impl
+
+// op(init, e0, e1, ...) over every element. The outermost dimension is cut
+// into fixed chunks whose partial results are combined in chunk order, so op
+// must be associative; since the chunks do not depend on the policy or the
+// number of threads, every policy returns the same result.
+template <typename Policy, typename M, typename T, typename Op,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy> &&
+                                   matrix_impl::Is_matrix_v<M>,
+                               void>>
+auto reduce(const Policy &policy, const M &m, T init, Op op) -> T {
+  const matrix_impl::Kernel_scope scope(matrix_instrument::Kernel::reduce);
+  const auto m_r = matrix_impl::as_ref(m);
+  const auto &desc = m_r.descriptor();
+  if (desc.size == 0) {
+    return init;
+  }
+  const std::size_t rows = desc.extents[0];
+  const std::size_t row_elements = desc.size / rows;
+  const std::size_t grain = matrix_impl::grain_rows(row_elements);
+  const std::size_t chunks = (rows + grain - 1) / grain;
+  std::vector<std::optional<matrix_impl::Value_type<M>>> partial(chunks);
+  matrix_impl::for_each_row_block(
+      policy, chunks, grain * row_elements,
+      [&](std::size_t first, std::size_t last) {
+        for (std::size_t c = first; c < last; ++c) {
+          const std::size_t b = c * grain;
+          partial[c] = matrix_impl::fold(
+              matrix_impl::row_range(m_r, b, std::min(rows, b + grain)), op);
+        }
+      });
+  for (const auto &value : partial) {
+    if (value) {
+      init = op(init, *value);
+    }
+  }
+  return init;
+}
+
+template <typename M, typename T, typename Op,
+          typename = Enable_if<matrix_impl::Is_matrix_v<M>, void>>
+auto reduce(const M &m, T init, Op op) -> T {
+  return reduce(matrix_execution::seq, m, init, op);
+}
+
+// Statistics over all elements or along one axis:
+//
+//   sum(m)   mean(m)   min(m)   max(m)   norm2(m)   argmin(m)   argmax(m)
+//   sum(m, axis) ...                     a Matrix<R, N - 1> of the same
+//                                        statistic along `axis`
+//
+// each also taking an execution policy first. mean and norm2 of integers
+// are doubles, and float16 and bfloat16 are summed in float; argmin/argmax
+// give the first position of the extreme, as a multi-index over all
+// elements and as indexes along the axis otherwise.
+//
+// Floating-point sums are accurate and reproducible: a run of elements is
+// summed by halving it down to blocks added with SIMD (pairwise
+// summation), partial sums are combined with Kahan compensation, and the
+// work is cut into pieces that do not depend on the policy or the number of
+// threads, so every policy returns bit-identical results. Reductions along
+// the innermost axis sum each line horizontally; along an outer axis whole
+// rows are added into a block of results that stays in cache.
+// NaNs are not treated specially. min, max and argmin/argmax need at least
+// one element.
+
+template <typename T>
+using Real_type = std::conditional_t<std::is_floating_point_v<Compute_type<T>>,
+                                     Compute_type<T>, double>;
+
+namespace matrix_impl {
+
+// runs up to this long are summed directly, longer ones in halves
+inline constexpr std::size_t pairwise_block = 128;
+
+// results per block of an outer-axis reduction
+inline constexpr std::size_t vertical_block = 2048;
+
+template <typename R> struct Compensated_sum {
+  R sum{};
+  R carry{};
+  auto add(R x) -> void {
+    if constexpr (std::is_floating_point_v<R>) {
+      const R y = x - carry;
+      const R t = sum + y;
+      carry = (t - sum) - y;
+      sum = t;
+    } else {
+      sum += x;
+    }
+  }
+};
+
+// the term an element contributes to a sum of R: x or x * x
+template <bool Square, typename R, typename T> auto term(T x) -> R {
+  if constexpr (Square) {
+    return static_cast<R>(x) * static_cast<R>(x);
+  } else {
+    return static_cast<R>(x);
+  }
+}
+
+MATRIX_DESIGN_BEGIN_INLINE_VECTORS
+
+// the sum of one block of terms, with level I's packs
+template <Isa I, bool Square, typename R, typename T>
+MATRIX_DESIGN_ALWAYS_INLINE inline auto
+block_sum(const T *p, std::size_t n, std::size_t stride) -> R {
+  using P = simd::Isa_pack<T, I>;
+  std::size_t i = 0;
+  R s{};
+  if constexpr (P::width > 1 && std::is_same_v<R, T>) {
+    if (stride == 1 && n >= 2 * P::width) {
+      auto a0 = P::set1(T{});
+      auto a1 = P::set1(T{});
+      for (; i + 2 * P::width <= n; i += 2 * P::width) {
+        auto x0 = P::load(p + i);
+        auto x1 = P::load(p + i + P::width);
+        if constexpr (Square) {
+          x0 = P::mul(x0, x0);
+          x1 = P::mul(x1, x1);
+        }
+        a0 = P::add(a0, x0);
+        a1 = P::add(a1, x1);
+      }
+      s = P::hsum(P::add(a0, a1));
+    }
+  }
+  for (; i < n; ++i) {
+    s += term<Square, R>(p[i * stride]);
+  }
+  return s;
+}
+
+template <bool Square, typename R, typename T>
+auto pairwise_sum(const T *p, std::size_t n, std::size_t stride) -> R {
+  if (n > pairwise_block) {
+    const std::size_t half = n / 2;
+    return pairwise_sum<Square, R>(p, half, stride) +
+           pairwise_sum<Square, R>(p + half * stride, n - half, stride);
+  }
+  if (stride != 1) {
+    return block_sum<Isa::scalar, Square, R>(p, n, stride);
+  }
+  if constexpr (Is_half_v<T> && std::is_same_v<R, float>) {
+    float wide[pairwise_block]; // widened a block at a time
+    convert_run(n, p, wide);
+    return pairwise_sum<Square, R>(wide, n, std::size_t{1});
+  } else {
+    return dispatch([&](auto isa) MATRIX_DESIGN_ALWAYS_INLINE {
+      return block_sum<decltype(isa)::value, Square, R>(p, n, stride);
+    });
+  }
+}
+
+template <bool Max, typename T> auto better(T x, T best) -> bool {
+  return Max ? best < x : x < best;
+}
+
+// the smallest (or largest) of n >= 1 elements, with level I's packs
+template <Isa I, bool Max, typename T>
+MATRIX_DESIGN_ALWAYS_INLINE inline auto
+extreme_kernel(const T *p, std::size_t n, std::size_t stride) -> T {
+  using P = simd::Isa_pack<T, I>;
+  std::size_t i = 0;
+  T best = p[0];
+  if constexpr (P::width > 1) {
+    if (stride == 1 && n >= P::width) {
+      auto b = P::load(p);
+      for (i = P::width; i + P::width <= n; i += P::width) {
+        b = Max ? P::max(b, P::load(p + i)) : P::min(b, P::load(p + i));
+      }
+      best = Max ? P::hmax(b) : P::hmin(b);
+    }
+  }
+  for (; i < n; ++i) {
+    if (better<Max>(p[i * stride], best)) {
+      best = p[i * stride];
+    }
+  }
+  return best;
+}
+
+template <bool Max, typename T>
+auto run_extreme(const T *p, std::size_t n, std::size_t stride) -> T {
+  if (stride != 1) {
+    return extreme_kernel<Isa::scalar, Max>(p, n, stride);
+  }
+  return dispatch([&](auto isa) MATRIX_DESIGN_ALWAYS_INLINE {
+    return extreme_kernel<decltype(isa)::value, Max>(p, n, stride);
+  });
+}
+
+MATRIX_DESIGN_END_INLINE_VECTORS
+
+// the first position of the smallest (or largest) of n >= 1 elements: the
+// extreme is found with SIMD, then searched for
+template <bool Max, typename T>
+auto run_arg_extreme(const T *p, std::size_t n, std::size_t stride)
+    -> std::size_t {
+  const T best = run_extreme<Max>(p, n, stride);
+  for (std::size_t i = 0; i < n; ++i) {
+    if (p[i * stride] == best) {
+      return i;
+    }
+  }
+  return 0;
+}
+
+// partial(chunk, first) for fixed chunks of the outermost dimension, where
+// first is the row-major position of the chunk's first element; the results
+// come back in chunk order whatever the policy
+template <typename R, typename Policy, typename T, std::size_t N,
+          typename F>
+auto chunk_partials(const Policy &policy, const Matrix_ref<T, N> &m_r,
+                    F partial) -> std::vector<R> {
+  const Kernel_scope scope(matrix_instrument::Kernel::reduce);
+  const auto &desc = m_r.descriptor();
+  const std::size_t rows = desc.extents[0];
+  const std::size_t row_elements = desc.size / rows;
+  const std::size_t grain = grain_rows(row_elements);
+  std::vector<R> partials((rows + grain - 1) / grain);
+  for_each_row_block(policy, partials.size(), grain * row_elements,
+                     [&](std::size_t first, std::size_t last) {
+                       for (std::size_t c = first; c < last; ++c) {
+                         const std::size_t b = c * grain;
+                         partials[c] = partial(
+                             row_range(m_r, b, std::min(rows, b + grain)),
+                             b * row_elements);
+                       }
+                     });
+  return partials;
+}
+
+template <bool Square, typename R, typename Policy, typename T, std::size_t N>
+auto sum_all(const Policy &policy, const Matrix_ref<T, N> &m_r) -> R {
+  if (m_r.size() == 0) {
+    return R{};
+  }
+  Compensated_sum<R> total;
+  for (const R s : chunk_partials<R>(
+           policy, m_r, [](const Matrix_ref<T, N> &chunk, std::size_t) {
+             Compensated_sum<R> acc;
+             chunk.for_each_run([&](const T *p, std::size_t n,
+                                    std::size_t stride) {
+               acc.add(pairwise_sum<Square, R>(p, n, stride));
+             });
+             return acc.sum;
+           })) {
+    total.add(s);
+  }
+  return total.sum;
+}
+
+template <bool Max, typename Policy, typename T, std::size_t N>
+auto extreme_all(const Policy &policy, const Matrix_ref<T, N> &m_r)
+    -> std::remove_const_t<T> {
+  using V = std::remove_const_t<T>;
+  assert(m_r.size() > 0);
+  const auto partials = chunk_partials<V>(
+      policy, m_r, [](const Matrix_ref<T, N> &chunk, std::size_t) {
+        std::optional<V> best;
+        chunk.for_each_run([&](const T *p, std::size_t n,
+                               std::size_t stride) {
+          const V x = run_extreme<Max>(p, n, stride);
+          if (!best || better<Max>(x, *best)) {
+            best = x;
+          }
+        });
+        return *best;
+      });
+  V best = partials[0];
+  for (const V x : partials) {
+    if (better<Max>(x, best)) {
+      best = x;
+    }
+  }
+  return best;
+}
+
+template <bool Max, typename Policy, typename T, std::size_t N>
+auto arg_extreme_all(const Policy &policy, const Matrix_ref<T, N> &m_r)
+    -> std::array<std::size_t, N> {
+  using V = std::remove_const_t<T>;
+  using Candidate = std::pair<V, std::size_t>; // value, row-major position
+  assert(m_r.size() > 0);
+  const auto partials = chunk_partials<Candidate>(
+      policy, m_r, [](const Matrix_ref<T, N> &chunk, std::size_t first) {
+        std::optional<Candidate> best;
+        std::size_t pos = first;
+        chunk.for_each_run([&](const T *p, std::size_t n,
+                               std::size_t stride) {
+          const std::size_t i = run_arg_extreme<Max>(p, n, stride);
+          if (!best || better<Max>(p[i * stride], best->first)) {
+            best = Candidate(p[i * stride], pos + i);
+          }
+          pos += n;
+        });
+        return *best;
+      });
+  Candidate best = partials[0];
+  for (const Candidate &c : partials) {
+    if (better<Max>(c.first, best.first)) {
+      best = c;
+    }
+  }
+  // the row-major position as a multi-index
+  std::array<std::size_t, N> index{};
+  const auto &extents = m_r.descriptor().extents;
+  for (std::size_t d = N; d-- > 0;) {
+    index[d] = best.second % extents[d];
+    best.second /= extents[d];
+  }
+  return index;
+}
+
+// the elements at index i of the first dimension of v, as a view of the
+// other dimensions
+template <typename T, std::size_t N>
+auto drop_first(const Matrix_ref<T, N> &v, std::size_t i)
+    -> Matrix_ref<T, N - 1> {
+  const auto &desc = v.descriptor();
+  Matrix_slice<N - 1> rest;
+  rest.start = desc.start + i * desc.strides[0];
+  std::copy(desc.extents.begin() + 1, desc.extents.end(),
+            rest.extents.begin());
+  std::copy(desc.strides.begin() + 1, desc.strides.end(),
+            rest.strides.begin());
+  rest.size = computing_size<N - 1>(rest.extents);
+  return {rest, v.pointer()};
+}
+
+// Reduce m along `axis` into a Matrix<R, N - 1>. Along the innermost axis
+// line(p, n, stride) reduces one line per result; along an outer axis
+// row(i, out, aux, x, n, stride) folds row i of the axis into n results
+// (aux is scratch of type Aux kept with each result, i == 0 starts afresh).
+// Every result is computed by one task in a fixed order.
+template <typename R, typename Aux, typename Policy, typename T, std::size_t N,
+          typename Line, typename Row>
+auto reduce_along(const Policy &policy, const Matrix_ref<T, N> &m_r,
+                  std::size_t axis, Line line, Row row) -> Matrix<R, N - 1> {
+  assert(axis < N);
+  const Kernel_scope scope(matrix_instrument::Kernel::reduce);
+  const auto &desc = m_r.descriptor();
+  // the view with `axis` first
+  Matrix_slice<N> moved = desc;
+  for (std::size_t d = 0, k = 1; d < N; ++d) {
+    if (d != axis) {
+      moved.extents[k] = desc.extents[d];
+      moved.strides[k++] = desc.strides[d];
+    }
+  }
+  moved.extents[0] = desc.extents[axis];
+  moved.strides[0] = desc.strides[axis];
+  const Matrix_ref<T, N> v(moved, m_r.pointer());
+  const std::size_t n = moved.extents[0];
+  const std::size_t stride = moved.strides[0];
+
+  std::array<std::size_t, N - 1> extents{};
+  std::copy(moved.extents.begin() + 1, moved.extents.end(), extents.begin());
+  Matrix<R, N - 1> result(extents);
+  const Matrix_ref<R, N - 1> out(result);
+  const Matrix_ref<T, N - 1> heads = drop_first(v, 0);
+  if (result.size() == 0) {
+    return result;
+  }
+  assert(n > 0);
+  const std::size_t rows = extents[0];
+  const std::size_t row_elements = result.size() / rows;
+  // an axis closer in memory than the results' rows is summed line by line
+  const bool horizontal = stride < moved.strides[N - 1] || extents[N - 2] == 1;
+
+  for_each_row_block(
+      policy, rows, row_elements * n, [&](std::size_t first, std::size_t last) {
+        if (horizontal) {
+          const auto src = row_range(heads, first, last);
+          const auto dst = row_range(out, first, last);
+          for_each_run<N - 1, 2>(
+              src.descriptor().extents,
+              {src.descriptor().strides, dst.descriptor().strides},
+              {src.descriptor().start, dst.descriptor().start},
+              [&](const auto &off, std::size_t m, const auto &inner) {
+                const T *x = heads.pointer() + off[0];
+                R *r = result.data() + off[1];
+                for (std::size_t j = 0; j < m; ++j) {
+                  r[j * inner[1]] = line(x + j * inner[0], n, stride);
+                }
+              });
+          return;
+        }
+        // blocks of whole rows of about vertical_block results
+        const std::size_t block_rows =
+            std::max<std::size_t>(1, vertical_block / row_elements);
+        std::vector<Aux> aux(block_rows * row_elements);
+        for (std::size_t b = first; b < last; b += block_rows) {
+          const std::size_t e = std::min(last, b + block_rows);
+          const auto dst = row_range(out, b, e);
+          R *base = result.data() + dst.descriptor().start;
+          for (std::size_t i = 0; i < n; ++i) {
+            const auto src = row_range(drop_first(v, i), b, e);
+            for_each_run<N - 1, 2>(
+                src.descriptor().extents,
+                {src.descriptor().strides, dst.descriptor().strides},
+                {src.descriptor().start, dst.descriptor().start},
+                [&](const auto &off, std::size_t m, const auto &inner) {
+                  R *r = result.data() + off[1];
+                  assert(inner[1] == 1);
+                  (void)inner;
+                  row(i, r, aux.data() + (r - base), v.pointer() + off[0], m,
+                      inner[0]);
+                });
+          }
+        }
+      });
+  return result;
+}
+
+template <bool Square, typename R, typename Policy, typename T, std::size_t N>
+auto sum_along(const Policy &policy, const Matrix_ref<T, N> &m_r,
+               std::size_t axis) -> Matrix<R, N - 1> {
+  return reduce_along<R, R>(
+      policy, m_r, axis,
+      [](const T *p, std::size_t n, std::size_t stride) {
+        return pairwise_sum<Square, R>(p, n, stride);
+      },
+      [](std::size_t i, R *out, R *carry, const T *x, std::size_t n,
+         std::size_t stride) {
+        if (i == 0) {
+          for (std::size_t j = 0; j < n; ++j) {
+            out[j] = term<Square, R>(x[j * stride]);
+            carry[j] = R{};
+          }
+          return;
+        }
+        for (std::size_t j = 0; j < n; ++j) {
+          if constexpr (std::is_floating_point_v<R>) {
+            const R y = term<Square, R>(x[j * stride]) - carry[j];
+            const R t = out[j] + y;
+            carry[j] = (t - out[j]) - y;
+            out[j] = t;
+          } else {
+            out[j] += term<Square, R>(x[j * stride]);
+          }
+        }
+      });
+}
+
+template <bool Max, typename Policy, typename T, std::size_t N>
+auto extreme_along(const Policy &policy, const Matrix_ref<T, N> &m_r,
+                   std::size_t axis) -> Matrix<std::remove_const_t<T>, N - 1> {
+  using V = std::remove_const_t<T>;
+  return reduce_along<V, char>(
+      policy, m_r, axis,
+      [](const T *p, std::size_t n, std::size_t stride) {
+        return run_extreme<Max>(p, n, stride);
+      },
+      [](std::size_t i, V *out, char *, const T *x, std::size_t n,
+         std::size_t stride) {
+        for (std::size_t j = 0; j < n; ++j) {
+          const V y = x[j * stride];
+          out[j] = i == 0 || better<Max>(y, out[j]) ? y : out[j];
+        }
+      });
+}
+
+template <bool Max, typename Policy, typename T, std::size_t N>
+auto arg_extreme_along(const Policy &policy, const Matrix_ref<T, N> &m_r,
+                       std::size_t axis) -> Matrix<std::size_t, N - 1> {
+  using V = std::remove_const_t<T>;
+  return reduce_along<std::size_t, V>(
+      policy, m_r, axis,
+      [](const T *p, std::size_t n, std::size_t stride) {
+        return run_arg_extreme<Max>(p, n, stride);
+      },
+      [](std::size_t i, std::size_t *out, V *best, const T *x, std::size_t n,
+         std::size_t stride) {
+        for (std::size_t j = 0; j < n; ++j) {
+          const V y = x[j * stride];
+          if (i == 0 || better<Max>(y, best[j])) {
+            best[j] = y;
+            out[j] = i;
+          }
+        }
+      });
+}
+
+template <typename M>
+using Enable_if_reducible = Enable_if<Is_matrix_v<M>, void>;
+
+template <typename Policy, typename M>
+using Enable_if_policy_reducible =
+    Enable_if<Is_execution_policy_v<Policy> && Is_matrix_v<M>, void>;
+
+// the order of a matrix type
+template <typename M>
+constexpr std::size_t order_of =
+    decltype(as_ref(std::declval<const M &>()))::order;
+
+} // namespace matrix_impl
+
+// the sum of every element
+template <typename Policy, typename M,
+          typename = matrix_impl::Enable_if_policy_reducible<Policy, M>>
+auto sum(const Policy &policy, const M &m)
+    -> Compute_type<matrix_impl::Value_type<M>> {
+  return matrix_impl::sum_all<false, Compute_type<matrix_impl::Value_type<M>>>(
+      policy, matrix_impl::as_ref(m));
+}
+
+template <typename M, typename = matrix_impl::Enable_if_reducible<M>>
+auto sum(const M &m) -> Compute_type<matrix_impl::Value_type<M>> {
+  return sum(matrix_execution::seq, m);
+}
+
+// the sums along an axis
+template <typename Policy, typename M,
+          typename = matrix_impl::Enable_if_policy_reducible<Policy, M>>
+auto sum(const Policy &policy, const M &m, std::size_t axis)
+    -> Matrix<Compute_type<matrix_impl::Value_type<M>>,
+              matrix_impl::order_of<M> - 1> {
+  using T = Compute_type<matrix_impl::Value_type<M>>;
+  if constexpr (matrix_impl::order_of<M> == 1) {
+    assert(axis == 0);
+    return Matrix<T, 0>(sum(policy, m));
+  } else {
+    return matrix_impl::sum_along<false, T>(policy, matrix_impl::as_ref(m),
+                                            axis);
+  }
+}
+
+template <typename M, typename = matrix_impl::Enable_if_reducible<M>>
+auto sum(const M &m, std::size_t axis)
+    -> Matrix<Compute_type<matrix_impl::Value_type<M>>,
+              matrix_impl::order_of<M> - 1> {
+  return sum(matrix_execution::seq, m, axis);
+}
+
+// the mean of every element
+template <typename Policy, typename M,
+          typename = matrix_impl::Enable_if_policy_reducible<Policy, M>>
+auto mean(const Policy &policy, const M &m)
+    -> Real_type<matrix_impl::Value_type<M>> {
+  using R = Real_type<matrix_impl::Value_type<M>>;
+  const auto m_r = matrix_impl::as_ref(m);
+  assert(m_r.size() > 0);
+  return matrix_impl::sum_all<false, R>(policy, m_r) /
+         static_cast<R>(m_r.size());
+}
+
+template <typename M, typename = matrix_impl::Enable_if_reducible<M>>
+auto mean(const M &m) -> Real_type<matrix_impl::Value_type<M>> {
+  return mean(matrix_execution::seq, m);
+}
+
+// the means along an axis
+template <typename Policy, typename M,
+          typename = matrix_impl::Enable_if_policy_reducible<Policy, M>>
+auto mean(const Policy &policy, const M &m, std::size_t axis)
+    -> Matrix<Real_type<matrix_impl::Value_type<M>>,
+              matrix_impl::order_of<M> - 1> {
+  using R = Real_type<matrix_impl::Value_type<M>>;
+  if constexpr (matrix_impl::order_of<M> == 1) {
+    assert(axis == 0);
+    return Matrix<R, 0>(mean(policy, m));
+  } else {
+    const auto m_r = matrix_impl::as_ref(m);
+    auto result = matrix_impl::sum_along<false, R>(policy, m_r, axis);
+    const auto n = static_cast<R>(m_r.descriptor().extents[axis]);
+    for (R &x : result) {
+      x /= n;
+    }
+    return result;
+  }
+}
+
+template <typename M, typename = matrix_impl::Enable_if_reducible<M>>
+auto mean(const M &m, std::size_t axis)
+    -> Matrix<Real_type<matrix_impl::Value_type<M>>,
+              matrix_impl::order_of<M> - 1> {
+  return mean(matrix_execution::seq, m, axis);
+}
+
+// the Euclidean norm of all elements
+template <typename Policy, typename M,
+          typename = matrix_impl::Enable_if_policy_reducible<Policy, M>>
+auto norm2(const Policy &policy, const M &m)
+    -> Real_type<matrix_impl::Value_type<M>> {
+  using R = Real_type<matrix_impl::Value_type<M>>;
+  return std::sqrt(
+      matrix_impl::sum_all<true, R>(policy, matrix_impl::as_ref(m)));
+}
+
+template <typename M, typename = matrix_impl::Enable_if_reducible<M>>
+auto norm2(const M &m) -> Real_type<matrix_impl::Value_type<M>> {
+  return norm2(matrix_execution::seq, m);
+}
+
+// the Euclidean norms along an axis
+template <typename Policy, typename M,
+          typename = matrix_impl::Enable_if_policy_reducible<Policy, M>>
+auto norm2(const Policy &policy, const M &m, std::size_t axis)
+    -> Matrix<Real_type<matrix_impl::Value_type<M>>,
+              matrix_impl::order_of<M> - 1> {
+  using R = Real_type<matrix_impl::Value_type<M>>;
+  if constexpr (matrix_impl::order_of<M> == 1) {
+    assert(axis == 0);
+    return Matrix<R, 0>(norm2(policy, m));
+  } else {
+    auto result =
+        matrix_impl::sum_along<true, R>(policy, matrix_impl::as_ref(m), axis);
+    for (R &x : result) {
+      x = std::sqrt(x);
+    }
+    return result;
+  }
+}
+
+template <typename M, typename = matrix_impl::Enable_if_reducible<M>>
+auto norm2(const M &m, std::size_t axis)
+    -> Matrix<Real_type<matrix_impl::Value_type<M>>,
+              matrix_impl::order_of<M> - 1> {
+  return norm2(matrix_execution::seq, m, axis);
+}
+
+// the smallest element
+template <typename Policy, typename M,
+          typename = matrix_impl::Enable_if_policy_reducible<Policy, M>>
+auto min(const Policy &policy, const M &m) -> matrix_impl::Value_type<M> {
+  return matrix_impl::extreme_all<false>(policy, matrix_impl::as_ref(m));
+}
+
+template <typename M, typename = matrix_impl::Enable_if_reducible<M>>
+auto min(const M &m) -> matrix_impl::Value_type<M> {
+  return min(matrix_execution::seq, m);
+}
+
+// the smallest elements along an axis
+template <typename Policy, typename M,
+          typename = matrix_impl::Enable_if_policy_reducible<Policy, M>>
+auto min(const Policy &policy, const M &m, std::size_t axis)
+    -> Matrix<matrix_impl::Value_type<M>, matrix_impl::order_of<M> - 1> {
+  using T = matrix_impl::Value_type<M>;
+  if constexpr (matrix_impl::order_of<M> == 1) {
+    assert(axis == 0);
+    return Matrix<T, 0>(min(policy, m));
+  } else {
+    return matrix_impl::extreme_along<false>(policy, matrix_impl::as_ref(m),
+                                             axis);
+  }
+}
+
+template <typename M, typename = matrix_impl::Enable_if_reducible<M>>
+auto min(const M &m, std::size_t axis)
+    -> Matrix<matrix_impl::Value_type<M>, matrix_impl::order_of<M> - 1> {
+  return min(matrix_execution::seq, m, axis);
+}
+
+// the largest element
+template <typename Policy, typename M,
+          typename = matrix_impl::Enable_if_policy_reducible<Policy, M>>
+auto max(const Policy &policy, const M &m) -> matrix_impl::Value_type<M> {
+  return matrix_impl::extreme_all<true>(policy, matrix_impl::as_ref(m));
+}
+
+template <typename M, typename = matrix_impl::Enable_if_reducible<M>>
+auto max(const M &m) -> matrix_impl::Value_type<M> {
+  return max(matrix_execution::seq, m);
+}
+
+// the largest elements along an axis
+template <typename Policy, typename M,
+          typename = matrix_impl::Enable_if_policy_reducible<Policy, M>>
+auto max(const Policy &policy, const M &m, std::size_t axis)
+    -> Matrix<matrix_impl::Value_type<M>, matrix_impl::order_of<M> - 1> {
+  using T = matrix_impl::Value_type<M>;
+  if constexpr (matrix_impl::order_of<M> == 1) {
+    assert(axis == 0);
+    return Matrix<T, 0>(max(policy, m));
+  } else {
+    return matrix_impl::extreme_along<true>(policy, matrix_impl::as_ref(m),
+                                             axis);
+  }
+}
+
+template <typename M, typename = matrix_impl::Enable_if_reducible<M>>
+auto max(const M &m, std::size_t axis)
+    -> Matrix<matrix_impl::Value_type<M>, matrix_impl::order_of<M> - 1> {
+  return max(matrix_execution::seq, m, axis);
+}
+
+// the multi-index of the first smallest element
+template <typename Policy, typename M,
+          typename = matrix_impl::Enable_if_policy_reducible<Policy, M>>
+auto argmin(const Policy &policy, const M &m)
+    -> std::array<std::size_t, matrix_impl::order_of<M>> {
+  return matrix_impl::arg_extreme_all<false>(policy, matrix_impl::as_ref(m));
+}
+
+template <typename M, typename = matrix_impl::Enable_if_reducible<M>>
+auto argmin(const M &m) -> std::array<std::size_t, matrix_impl::order_of<M>> {
+  return argmin(matrix_execution::seq, m);
+}
+
+// the indexes of the first smallest elements along an axis
+template <typename Policy, typename M,
+          typename = matrix_impl::Enable_if_policy_reducible<Policy, M>>
+auto argmin(const Policy &policy, const M &m, std::size_t axis)
+    -> Matrix<std::size_t, matrix_impl::order_of<M> - 1> {
+  if constexpr (matrix_impl::order_of<M> == 1) {
+    assert(axis == 0);
+    return Matrix<std::size_t, 0>(argmin(policy, m)[0]);
+  } else {
+    return matrix_impl::arg_extreme_along<false>(
+        policy, matrix_impl::as_ref(m), axis);
+  }
+}
+
+template <typename M, typename = matrix_impl::Enable_if_reducible<M>>
+auto argmin(const M &m, std::size_t axis)
+    -> Matrix<std::size_t, matrix_impl::order_of<M> - 1> {
+  return argmin(matrix_execution::seq, m, axis);
+}
+
+// the multi-index of the first largest element
+template <typename Policy, typename M,
+          typename = matrix_impl::Enable_if_policy_reducible<Policy, M>>
+auto argmax(const Policy &policy, const M &m)
+    -> std::array<std::size_t, matrix_impl::order_of<M>> {
+  return matrix_impl::arg_extreme_all<true>(policy, matrix_impl::as_ref(m));
+}
+
+template <typename M, typename = matrix_impl::Enable_if_reducible<M>>
+auto argmax(const M &m) -> std::array<std::size_t, matrix_impl::order_of<M>> {
+  return argmax(matrix_execution::seq, m);
+}
+
+// the indexes of the first largest elements along an axis
+template <typename Policy, typename M,
+          typename = matrix_impl::Enable_if_policy_reducible<Policy, M>>
+auto argmax(const Policy &policy, const M &m, std::size_t axis)
+    -> Matrix<std::size_t, matrix_impl::order_of<M> - 1> {
+  if constexpr (matrix_impl::order_of<M> == 1) {
+    assert(axis == 0);
+    return Matrix<std::size_t, 0>(argmax(policy, m)[0]);
+  } else {
+    return matrix_impl::arg_extreme_along<true>(
+        policy, matrix_impl::as_ref(m), axis);
+  }
+}
+
+template <typename M, typename = matrix_impl::Enable_if_reducible<M>>
+auto argmax(const M &m, std::size_t axis)
+    -> Matrix<std::size_t, matrix_impl::order_of<M> - 1> {
+  return argmax(matrix_execution::seq, m, axis);
+}
@@ -1,6 +1,9 @@
 #pragma once
 #include "matrix_base.h"
+#include "matrix_iterator.h"
 #include "matrix_slice.h"
+#include <cassert>
+#include <span>
 
 template <typename T, std::size_t N>
 class Matrix_ref;
@@ -9,6 +12,9 @@ template <typename T, std::size_t N>
 class Matrix_ref : public Matrix_base<T, N>
 {
 public:
+  static constexpr std::size_t order = N; // dimensions
+  using iterator = Matrix_iterator<T, N>; // row-major, through the strides
+  using const_iterator = Matrix_iterator<const T, N>;
   Matrix_ref() = default;                                  // default constructor
   Matrix_ref(Matrix_ref &&) = default;                     // move constructor
   auto operator=(Matrix_ref &&) -> Matrix_ref & = default; // move assignment
@@ -18,10 +24,90 @@ public:
   ~Matrix_ref() = default;
 
   Matrix_ref(const Matrix_slice<N> &s, T *p) : desc{s}, ptr{p} {}
+  // a read-only view of the elements of a mutable view
+  template <typename U,
+            typename = Enable_if<std::is_same_v<const U, T> &&
+                                     !std::is_same_v<U, T>,
+                                 void>>
+  Matrix_ref(const Matrix_ref<U, N> &m_r)
+      : desc{m_r.descriptor()}, ptr{m_r.pointer()} {}
+  // write an element-wise expression through the view
+  template <typename E,
+            typename = Enable_if<matrix_impl::Is_expr<E>::value, void>>
+  auto operator=(const E &expr) -> Matrix_ref &;
+
   auto descriptor() const -> const Matrix_slice<N> & { return desc; }
   auto pointer() const -> T * { return ptr; }
 
+  [[nodiscard]] auto extent(std::size_t n) const -> std::size_t {
+    return desc.extents[n];
+  } // # elements in the nth dimension
+  [[nodiscard]] auto size() const -> std::size_t {
+    return desc.size;
+  } // total number of elements
+
+  auto begin() const -> iterator { return {desc, ptr, false}; }
+  auto end() const -> iterator { return {desc, ptr, true}; }
+  auto cbegin() const -> const_iterator { return begin(); }
+  auto cend() const -> const_iterator { return end(); }
+
+  // true when the elements are adjacent in memory in row-major order
+  [[nodiscard]] auto is_contiguous() const -> bool;
+
+  // the elements as one random-access range; the view must be contiguous
+  auto as_span() const -> std::span<T> {
+    assert(is_contiguous());
+    return {ptr + desc.start, desc.size};
+  }
+
+  // f(first, n, stride) for every innermost run of the view, where the run
+  // is first[0], first[stride], ..., first[(n - 1) * stride]. Dimensions
+  // that continue each other in memory are merged first, so a contiguous
+  // view is a single run.
+  template <typename F> auto for_each_run(F f) const -> void;
+
 private:
   Matrix_slice<N> desc; // the shape of matrix
   T *ptr;               // the first element of its matrix
-};
\ No newline at end of file
+};
+
+namespace matrix_impl {
+template <typename T, std::size_t N> class Expr_leaf;
+
+template <typename T, std::size_t N, typename E>
+auto evaluate(Matrix_ref<T, N> dst, const E &expr) -> void;
+
+template <typename Policy, typename T, std::size_t N, typename E,
+          typename = Enable_if<!Is_expr<Policy>::value, void>>
+auto evaluate(const Policy &policy, Matrix_ref<T, N> dst, const E &expr)
+    -> void;
+} // namespace matrix_impl
+
+template <typename T, std::size_t N>
+auto Matrix_ref<T, N>::is_contiguous() const -> bool {
+  std::size_t expected = 1;
+  for (std::size_t d = N; d-- > 0;) {
+    if (desc.extents[d] != 1 && desc.strides[d] != expected) {
+      return desc.size == 0;
+    }
+    expected *= desc.extents[d];
+  }
+  return true;
+}
+
+template <typename T, std::size_t N>
+template <typename F>
+auto Matrix_ref<T, N>::for_each_run(F f) const -> void {
+  matrix_impl::for_each_run<N, 1>(
+      desc.extents, {desc.strides}, {desc.start},
+      [&](const auto &off, std::size_t n, const auto &inner) {
+        f(ptr + off[0], n, inner[0]);
+      });
+}
+
+template <typename T, std::size_t N>
+template <typename E, typename>
+auto Matrix_ref<T, N>::operator=(const E &expr) -> Matrix_ref & {
+  matrix_impl::evaluate(*this, expr);
+  return *this;
+}
@@ -0,0 +1,483 @@
+#pragma once
+
+#include "matrix_dispatch.h"
+#include <cstddef>
+
+// SIMD building blocks for the element-wise kernels. Isa_pack<T, I> wraps
+// the vector register of level I (see matrix_dispatch.h) and Pack<T> the one
+// the translation unit is compiled for; element types without a pack (width
+// 1) take the plain scalar loop, which the compiler is still free to
+// vectorize. The operation functors work on both scalars and packs so one
+// expression tree serves both paths.
+//
+// Kernels written against a pack type run at another level's width when
+// instantiated inside dispatch(): the AVX2 and AVX-512 packs carry their
+// instruction sets as function attributes, and the kernels and the lambdas
+// reaching them are MATRIX_DESIGN_ALWAYS_INLINE so they end up in the one
+// function dispatch builds for that level.
+
+namespace matrix_impl::simd {
+
+template <typename T, Isa I> struct Isa_pack {
+  static constexpr std::size_t width = 1;
+};
+
+#if defined(MATRIX_DESIGN_HAS_AVX512)
+MATRIX_DESIGN_BEGIN_AVX512
+// min, max and the 256-bit halves use zero-masking intrinsics: GCC 12 warns
+// about the unmasked ones (-Wmaybe-uninitialized), and all-ones masks
+// compile to the same instructions
+template <> struct Isa_pack<double, Isa::avx512> {
+  using type = __m512d;
+  static constexpr std::size_t width = 8;
+  static auto load(const double *p) -> type { return _mm512_loadu_pd(p); }
+  static auto store(double *p, type v) -> void { _mm512_storeu_pd(p, v); }
+  static auto set1(double v) -> type { return _mm512_set1_pd(v); }
+  static auto add(type a, type b) -> type { return _mm512_add_pd(a, b); }
+  static auto sub(type a, type b) -> type { return _mm512_sub_pd(a, b); }
+  static auto mul(type a, type b) -> type { return _mm512_mul_pd(a, b); }
+  static auto div(type a, type b) -> type { return _mm512_div_pd(a, b); }
+  static auto min(type a, type b) -> type {
+    return _mm512_maskz_min_pd(0xff, a, b);
+  }
+  static auto max(type a, type b) -> type {
+    return _mm512_maskz_max_pd(0xff, a, b);
+  }
+  // the lower and upper 256 bits
+  static auto lower(type v) -> __m256d {
+    return _mm512_maskz_extractf64x4_pd(0xf, v, 0);
+  }
+  static auto upper(type v) -> __m256d {
+    return _mm512_maskz_extractf64x4_pd(0xf, v, 1);
+  }
+  // horizontal reductions: fold 512 -> 256 -> 128 bits, then the two lanes
+  static auto hsum(type v) -> double {
+    const __m256d q = _mm256_add_pd(lower(v), upper(v));
+    const __m128d h = _mm_add_pd(_mm256_castpd256_pd128(q),
+                                 _mm256_extractf128_pd(q, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+  }
+  static auto hmin(type v) -> double {
+    const __m256d q = _mm256_min_pd(lower(v), upper(v));
+    const __m128d h = _mm_min_pd(_mm256_castpd256_pd128(q),
+                                 _mm256_extractf128_pd(q, 1));
+    return _mm_cvtsd_f64(_mm_min_sd(h, _mm_unpackhi_pd(h, h)));
+  }
+  static auto hmax(type v) -> double {
+    const __m256d q = _mm256_max_pd(lower(v), upper(v));
+    const __m128d h = _mm_max_pd(_mm256_castpd256_pd128(q),
+                                 _mm256_extractf128_pd(q, 1));
+    return _mm_cvtsd_f64(_mm_max_sd(h, _mm_unpackhi_pd(h, h)));
+  }
+};
+
+template <> struct Isa_pack<float, Isa::avx512> {
+  using type = __m512;
+  static constexpr std::size_t width = 16;
+  static auto load(const float *p) -> type { return _mm512_loadu_ps(p); }
+  static auto store(float *p, type v) -> void { _mm512_storeu_ps(p, v); }
+  static auto set1(float v) -> type { return _mm512_set1_ps(v); }
+  static auto add(type a, type b) -> type { return _mm512_add_ps(a, b); }
+  static auto sub(type a, type b) -> type { return _mm512_sub_ps(a, b); }
+  static auto mul(type a, type b) -> type { return _mm512_mul_ps(a, b); }
+  static auto div(type a, type b) -> type { return _mm512_div_ps(a, b); }
+  static auto min(type a, type b) -> type {
+    return _mm512_maskz_min_ps(0xffff, a, b);
+  }
+  static auto max(type a, type b) -> type {
+    return _mm512_maskz_max_ps(0xffff, a, b);
+  }
+  // the lower and upper 256 bits
+  static auto lower(type v) -> __m256 {
+    return _mm256_castpd_ps(
+        _mm512_maskz_extractf64x4_pd(0xf, _mm512_castps_pd(v), 0));
+  }
+  static auto upper(type v) -> __m256 {
+    return _mm256_castpd_ps(
+        _mm512_maskz_extractf64x4_pd(0xf, _mm512_castps_pd(v), 1));
+  }
+  // horizontal reductions: fold 512 -> 256 -> 128 bits, then within them
+  static auto hsum(type v) -> float {
+    const __m256 q = _mm256_add_ps(lower(v), upper(v));
+    __m128 h = _mm_add_ps(_mm256_castps256_ps128(q),
+                          _mm256_extractf128_ps(q, 1));
+    h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+    return _mm_cvtss_f32(_mm_add_ss(h, _mm_shuffle_ps(h, h, 1)));
+  }
+  static auto hmin(type v) -> float {
+    const __m256 q = _mm256_min_ps(lower(v), upper(v));
+    __m128 h = _mm_min_ps(_mm256_castps256_ps128(q),
+                          _mm256_extractf128_ps(q, 1));
+    h = _mm_min_ps(h, _mm_movehl_ps(h, h));
+    return _mm_cvtss_f32(_mm_min_ss(h, _mm_shuffle_ps(h, h, 1)));
+  }
+  static auto hmax(type v) -> float {
+    const __m256 q = _mm256_max_ps(lower(v), upper(v));
+    __m128 h = _mm_max_ps(_mm256_castps256_ps128(q),
+                          _mm256_extractf128_ps(q, 1));
+    h = _mm_max_ps(h, _mm_movehl_ps(h, h));
+    return _mm_cvtss_f32(_mm_max_ss(h, _mm_shuffle_ps(h, h, 1)));
+  }
+};
+MATRIX_DESIGN_END_TARGET
+#endif
+
+#if defined(MATRIX_DESIGN_HAS_AVX2)
+MATRIX_DESIGN_BEGIN_AVX2
+template <> struct Isa_pack<double, Isa::avx2> {
+  using type = __m256d;
+  static constexpr std::size_t width = 4;
+  static auto load(const double *p) -> type { return _mm256_loadu_pd(p); }
+  static auto store(double *p, type v) -> void { _mm256_storeu_pd(p, v); }
+  static auto set1(double v) -> type { return _mm256_set1_pd(v); }
+  static auto add(type a, type b) -> type { return _mm256_add_pd(a, b); }
+  static auto sub(type a, type b) -> type { return _mm256_sub_pd(a, b); }
+  static auto mul(type a, type b) -> type { return _mm256_mul_pd(a, b); }
+  static auto div(type a, type b) -> type { return _mm256_div_pd(a, b); }
+  static auto min(type a, type b) -> type { return _mm256_min_pd(a, b); }
+  static auto max(type a, type b) -> type { return _mm256_max_pd(a, b); }
+  // horizontal reductions: fold the 128-bit halves, then the two lanes
+  static auto hsum(type v) -> double {
+    const __m128d h = _mm_add_pd(_mm256_castpd256_pd128(v),
+                                 _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+  }
+  static auto hmin(type v) -> double {
+    const __m128d h = _mm_min_pd(_mm256_castpd256_pd128(v),
+                                 _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_min_sd(h, _mm_unpackhi_pd(h, h)));
+  }
+  static auto hmax(type v) -> double {
+    const __m128d h = _mm_max_pd(_mm256_castpd256_pd128(v),
+                                 _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_max_sd(h, _mm_unpackhi_pd(h, h)));
+  }
+};
+
+template <> struct Isa_pack<float, Isa::avx2> {
+  using type = __m256;
+  static constexpr std::size_t width = 8;
+  static auto load(const float *p) -> type { return _mm256_loadu_ps(p); }
+  static auto store(float *p, type v) -> void { _mm256_storeu_ps(p, v); }
+  static auto set1(float v) -> type { return _mm256_set1_ps(v); }
+  static auto add(type a, type b) -> type { return _mm256_add_ps(a, b); }
+  static auto sub(type a, type b) -> type { return _mm256_sub_ps(a, b); }
+  static auto mul(type a, type b) -> type { return _mm256_mul_ps(a, b); }
+  static auto div(type a, type b) -> type { return _mm256_div_ps(a, b); }
+  static auto min(type a, type b) -> type { return _mm256_min_ps(a, b); }
+  static auto max(type a, type b) -> type { return _mm256_max_ps(a, b); }
+  // horizontal reductions: fold the 128-bit halves, then within them
+  static auto hsum(type v) -> float {
+    __m128 h = _mm_add_ps(_mm256_castps256_ps128(v),
+                          _mm256_extractf128_ps(v, 1));
+    h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+    return _mm_cvtss_f32(_mm_add_ss(h, _mm_shuffle_ps(h, h, 1)));
+  }
+  static auto hmin(type v) -> float {
+    __m128 h = _mm_min_ps(_mm256_castps256_ps128(v),
+                          _mm256_extractf128_ps(v, 1));
+    h = _mm_min_ps(h, _mm_movehl_ps(h, h));
+    return _mm_cvtss_f32(_mm_min_ss(h, _mm_shuffle_ps(h, h, 1)));
+  }
+  static auto hmax(type v) -> float {
+    __m128 h = _mm_max_ps(_mm256_castps256_ps128(v),
+                          _mm256_extractf128_ps(v, 1));
+    h = _mm_max_ps(h, _mm_movehl_ps(h, h));
+    return _mm_cvtss_f32(_mm_max_ss(h, _mm_shuffle_ps(h, h, 1)));
+  }
+};
+MATRIX_DESIGN_END_TARGET
+#endif
+
+#if defined(MATRIX_DESIGN_X86)
+template <> struct Isa_pack<double, Isa::sse2> {
+  using type = __m128d;
+  static constexpr std::size_t width = 2;
+  static auto load(const double *p) -> type { return _mm_loadu_pd(p); }
+  static auto store(double *p, type v) -> void { _mm_storeu_pd(p, v); }
+  static auto set1(double v) -> type { return _mm_set1_pd(v); }
+  static auto add(type a, type b) -> type { return _mm_add_pd(a, b); }
+  static auto sub(type a, type b) -> type { return _mm_sub_pd(a, b); }
+  static auto mul(type a, type b) -> type { return _mm_mul_pd(a, b); }
+  static auto div(type a, type b) -> type { return _mm_div_pd(a, b); }
+  static auto min(type a, type b) -> type { return _mm_min_pd(a, b); }
+  static auto max(type a, type b) -> type { return _mm_max_pd(a, b); }
+  static auto hsum(type v) -> double {
+    return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+  }
+  static auto hmin(type v) -> double {
+    return _mm_cvtsd_f64(_mm_min_sd(v, _mm_unpackhi_pd(v, v)));
+  }
+  static auto hmax(type v) -> double {
+    return _mm_cvtsd_f64(_mm_max_sd(v, _mm_unpackhi_pd(v, v)));
+  }
+};
+
+template <> struct Isa_pack<float, Isa::sse2> {
+  using type = __m128;
+  static constexpr std::size_t width = 4;
+  static auto load(const float *p) -> type { return _mm_loadu_ps(p); }
+  static auto store(float *p, type v) -> void { _mm_storeu_ps(p, v); }
+  static auto set1(float v) -> type { return _mm_set1_ps(v); }
+  static auto add(type a, type b) -> type { return _mm_add_ps(a, b); }
+  static auto sub(type a, type b) -> type { return _mm_sub_ps(a, b); }
+  static auto mul(type a, type b) -> type { return _mm_mul_ps(a, b); }
+  static auto div(type a, type b) -> type { return _mm_div_ps(a, b); }
+  static auto min(type a, type b) -> type { return _mm_min_ps(a, b); }
+  static auto max(type a, type b) -> type { return _mm_max_ps(a, b); }
+  static auto hsum(type v) -> float {
+    const __m128 h = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    return _mm_cvtss_f32(_mm_add_ss(h, _mm_shuffle_ps(h, h, 1)));
+  }
+  static auto hmin(type v) -> float {
+    const __m128 h = _mm_min_ps(v, _mm_movehl_ps(v, v));
+    return _mm_cvtss_f32(_mm_min_ss(h, _mm_shuffle_ps(h, h, 1)));
+  }
+  static auto hmax(type v) -> float {
+    const __m128 h = _mm_max_ps(v, _mm_movehl_ps(v, v));
+    return _mm_cvtss_f32(_mm_max_ss(h, _mm_shuffle_ps(h, h, 1)));
+  }
+};
+#endif
+
+// the pack of the translation unit's own instruction set
+template <typename T> using Pack = Isa_pack<T, matrix_dispatch::compiled_isa>;
+
+// Transpose_block<T, I>::apply transposes a size x size block in registers
+// of level I: dst[c * ds + r] = src[r * ss + c]. The scalar version (size 1)
+// is the fallback for element types without a vector kernel; AVX-512 uses
+// the AVX2 blocks.
+template <typename T, Isa I> struct Transpose_block {
+  static constexpr std::size_t size = 1;
+  static auto apply(const T *src, std::size_t /*ss*/, T *dst,
+                    std::size_t /*ds*/) -> void {
+    *dst = *src;
+  }
+};
+
+// the widest block size of any level
+inline constexpr std::size_t transpose_block_max = 8;
+
+#if defined(MATRIX_DESIGN_HAS_AVX2)
+MATRIX_DESIGN_BEGIN_AVX2
+template <> struct Transpose_block<float, Isa::avx2> {
+  static constexpr std::size_t size = 8;
+  static auto apply(const float *src, std::size_t ss, float *dst,
+                    std::size_t ds) -> void {
+    const __m256 r0 = _mm256_loadu_ps(src);
+    const __m256 r1 = _mm256_loadu_ps(src + ss);
+    const __m256 r2 = _mm256_loadu_ps(src + 2 * ss);
+    const __m256 r3 = _mm256_loadu_ps(src + 3 * ss);
+    const __m256 r4 = _mm256_loadu_ps(src + 4 * ss);
+    const __m256 r5 = _mm256_loadu_ps(src + 5 * ss);
+    const __m256 r6 = _mm256_loadu_ps(src + 6 * ss);
+    const __m256 r7 = _mm256_loadu_ps(src + 7 * ss);
+    // interleave pairs of rows, then pairs of pairs, then the 128-bit halves
+    const __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+    const __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+    const __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+    const __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+    const __m256 t4 = _mm256_unpacklo_ps(r4, r5);
+    const __m256 t5 = _mm256_unpackhi_ps(r4, r5);
+    const __m256 t6 = _mm256_unpacklo_ps(r6, r7);
+    const __m256 t7 = _mm256_unpackhi_ps(r6, r7);
+    const __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+    _mm256_storeu_ps(dst, _mm256_permute2f128_ps(s0, s4, 0x20));
+    _mm256_storeu_ps(dst + ds, _mm256_permute2f128_ps(s1, s5, 0x20));
+    _mm256_storeu_ps(dst + 2 * ds, _mm256_permute2f128_ps(s2, s6, 0x20));
+    _mm256_storeu_ps(dst + 3 * ds, _mm256_permute2f128_ps(s3, s7, 0x20));
+    _mm256_storeu_ps(dst + 4 * ds, _mm256_permute2f128_ps(s0, s4, 0x31));
+    _mm256_storeu_ps(dst + 5 * ds, _mm256_permute2f128_ps(s1, s5, 0x31));
+    _mm256_storeu_ps(dst + 6 * ds, _mm256_permute2f128_ps(s2, s6, 0x31));
+    _mm256_storeu_ps(dst + 7 * ds, _mm256_permute2f128_ps(s3, s7, 0x31));
+  }
+};
+
+template <> struct Transpose_block<double, Isa::avx2> {
+  static constexpr std::size_t size = 4;
+  static auto apply(const double *src, std::size_t ss, double *dst,
+                    std::size_t ds) -> void {
+    const __m256d r0 = _mm256_loadu_pd(src);
+    const __m256d r1 = _mm256_loadu_pd(src + ss);
+    const __m256d r2 = _mm256_loadu_pd(src + 2 * ss);
+    const __m256d r3 = _mm256_loadu_pd(src + 3 * ss);
+    const __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+    const __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+    const __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+    const __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+    _mm256_storeu_pd(dst, _mm256_permute2f128_pd(t0, t2, 0x20));
+    _mm256_storeu_pd(dst + ds, _mm256_permute2f128_pd(t1, t3, 0x20));
+    _mm256_storeu_pd(dst + 2 * ds, _mm256_permute2f128_pd(t0, t2, 0x31));
+    _mm256_storeu_pd(dst + 3 * ds, _mm256_permute2f128_pd(t1, t3, 0x31));
+  }
+};
+MATRIX_DESIGN_END_TARGET
+
+template <typename T>
+struct Transpose_block<T, Isa::avx512> : Transpose_block<T, Isa::avx2> {};
+#endif
+
+#if defined(MATRIX_DESIGN_X86)
+template <> struct Transpose_block<float, Isa::sse2> {
+  static constexpr std::size_t size = 4;
+  static auto apply(const float *src, std::size_t ss, float *dst,
+                    std::size_t ds) -> void {
+    __m128 r0 = _mm_loadu_ps(src);
+    __m128 r1 = _mm_loadu_ps(src + ss);
+    __m128 r2 = _mm_loadu_ps(src + 2 * ss);
+    __m128 r3 = _mm_loadu_ps(src + 3 * ss);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(dst, r0);
+    _mm_storeu_ps(dst + ds, r1);
+    _mm_storeu_ps(dst + 2 * ds, r2);
+    _mm_storeu_ps(dst + 3 * ds, r3);
+  }
+};
+
+template <> struct Transpose_block<double, Isa::sse2> {
+  static constexpr std::size_t size = 2;
+  static auto apply(const double *src, std::size_t ss, double *dst,
+                    std::size_t ds) -> void {
+    const __m128d r0 = _mm_loadu_pd(src);
+    const __m128d r1 = _mm_loadu_pd(src + ss);
+    _mm_storeu_pd(dst, _mm_unpacklo_pd(r0, r1));
+    _mm_storeu_pd(dst + ds, _mm_unpackhi_pd(r0, r1));
+  }
+};
+#endif
+
+MATRIX_DESIGN_BEGIN_INLINE_VECTORS
+
+// element-wise operations, usable on scalars and on packs; on packs the
+// result replaces the first operand, as generic code only passes vector
+// registers by reference (see MATRIX_DESIGN_BEGIN_INLINE_VECTORS)
+struct Plus {
+  template <typename T> auto operator()(const T &a, const T &b) const -> T {
+    return a + b;
+  }
+  template <typename P>
+  MATRIX_DESIGN_ALWAYS_INLINE static auto packed(typename P::type &a,
+                                                 const typename P::type &b)
+      -> void {
+    a = P::add(a, b);
+  }
+};
+
+struct Minus {
+  template <typename T> auto operator()(const T &a, const T &b) const -> T {
+    return a - b;
+  }
+  template <typename P>
+  MATRIX_DESIGN_ALWAYS_INLINE static auto packed(typename P::type &a,
+                                                 const typename P::type &b)
+      -> void {
+    a = P::sub(a, b);
+  }
+};
+
+struct Multiplies {
+  template <typename T> auto operator()(const T &a, const T &b) const -> T {
+    return a * b;
+  }
+  template <typename P>
+  MATRIX_DESIGN_ALWAYS_INLINE static auto packed(typename P::type &a,
+                                                 const typename P::type &b)
+      -> void {
+    a = P::mul(a, b);
+  }
+};
+
+struct Divides {
+  template <typename T> auto operator()(const T &a, const T &b) const -> T {
+    return a / b;
+  }
+  template <typename P>
+  MATRIX_DESIGN_ALWAYS_INLINE static auto packed(typename P::type &a,
+                                                 const typename P::type &b)
+      -> void {
+    a = P::div(a, b);
+  }
+};
+
+} // namespace matrix_impl::simd
+
+namespace matrix_impl {
+
+// y[0, n) += a * x[0, n) for unit-stride runs, with level I's packs
+template <Isa I, typename T>
+MATRIX_DESIGN_ALWAYS_INLINE inline auto axpy_kernel(std::size_t n, T a,
+                                                    const T *x, T *y)
+    -> void {
+  using P = simd::Isa_pack<T, I>;
+  std::size_t i = 0;
+  if constexpr (P::width > 1) {
+    const auto va = P::set1(a);
+    for (; i + P::width <= n; i += P::width) {
+      P::store(y + i, P::add(P::load(y + i), P::mul(va, P::load(x + i))));
+    }
+  }
+  for (; i < n; ++i) {
+    y[i] += a * x[i];
+  }
+}
+
+template <typename T>
+auto axpy_run(std::size_t n, T a, const T *x, T *y) -> void {
+  dispatch([&](auto isa) MATRIX_DESIGN_ALWAYS_INLINE {
+    axpy_kernel<decltype(isa)::value>(n, a, x, y);
+  });
+}
+
+// y[j * ys] += a * x[j * xs] for j in [0, n)
+template <typename T>
+auto axpy(std::size_t n, T a, const T *x, std::size_t xs, T *y,
+          std::size_t ys) -> void {
+  if (xs == 1 && ys == 1) {
+    axpy_run(n, a, x, y);
+    return;
+  }
+  for (std::size_t j = 0; j < n; ++j) {
+    y[j * ys] += a * x[j * xs];
+  }
+}
+
+// x[0, n) . y[0, n) for unit-stride runs, in two packs of partial sums
+template <Isa I, typename T>
+MATRIX_DESIGN_ALWAYS_INLINE inline auto dot_kernel(std::size_t n, const T *x,
+                                                   const T *y) -> T {
+  using P = simd::Isa_pack<T, I>;
+  std::size_t i = 0;
+  T sum{};
+  if constexpr (P::width > 1) {
+    auto s0 = P::set1(T{});
+    auto s1 = P::set1(T{});
+    for (; i + 2 * P::width <= n; i += 2 * P::width) {
+      s0 = P::add(s0, P::mul(P::load(x + i), P::load(y + i)));
+      s1 = P::add(s1, P::mul(P::load(x + i + P::width),
+                             P::load(y + i + P::width)));
+    }
+    sum = P::hsum(P::add(s0, s1));
+  }
+  for (; i < n; ++i) {
+    sum += x[i] * y[i];
+  }
+  return sum;
+}
+
+template <typename T>
+auto dot_run(std::size_t n, const T *x, const T *y) -> T {
+  return dispatch([&](auto isa) MATRIX_DESIGN_ALWAYS_INLINE {
+    return dot_kernel<decltype(isa)::value>(n, x, y);
+  });
+}
+
+MATRIX_DESIGN_END_INLINE_VECTORS
+
+} // namespace matrix_impl
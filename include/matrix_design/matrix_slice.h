@@ -5,6 +5,7 @@
 #include <cstddef>
 #include <initializer_list>
 #include <numeric>
+#include <utility>
 
 template <std::size_t N> struct Matrix_slice;
 
@@ -59,10 +60,8 @@ template <std::size_t N>
 template <typename... Dims, typename>
 inline auto Matrix_slice<N>::operator()(Dims... dims) const -> std::size_t {
   static_assert(sizeof...(Dims) == N, "Number of params must be N");
-  std::array<std::size_t, N> args{
-      static_cast<std::size_t>(dims)...}; // copy arguments into an array
-  return std::inner_product(args.begin(), args.begin() + N, strides.begin(),
-                            static_cast<std::size_t>(0));
+  return start + matrix_impl::dot_strides(
+                     strides, std::make_index_sequence<N>{}, dims...);
 }
 
 template <std::size_t N>
@@ -136,9 +135,10 @@ auto do_slice(const Matrix_slice<N> &os, Matrix_slice<N> &ns) -> std::size_t {
 
 // slice dim 0;
 template <std::size_t dim, typename T, std::size_t N>
-auto slice_dim(std::size_t n, Matrix_slice<N> &desc, Matrix_slice<N - 1> &row)
+auto slice_dim(std::size_t n, const Matrix_slice<N> &desc,
+               Matrix_slice<N - 1> &row)
     -> Enable_if<(dim == 0), void> {
-  row.start = n * desc.strides[0];
+  row.start = desc.start + n * desc.strides[0];
   std::copy(desc.extents.begin() + 1, desc.extents.end(), row.extents.begin());
   std::copy(desc.strides.begin() + 1, desc.strides.end(), row.strides.begin());
   row.size = matrix_impl::computing_size<N - 1>(row.extents);
@@ -146,15 +146,16 @@ auto slice_dim(std::size_t n, Matrix_slice<N> &desc, Matrix_slice<N - 1> &row)
 
 // slice dim 1
 template <std::size_t dim, typename T, std::size_t N>
-auto slice_dim(std::size_t n, Matrix_slice<N> &desc, Matrix_slice<N - 1> &col)
+auto slice_dim(std::size_t n, const Matrix_slice<N> &desc,
+               Matrix_slice<N - 1> &col)
     -> Enable_if<(dim == 1), void> {
-  col.start = n * desc.strides[1];
+  col.start = desc.start + n * desc.strides[1];
   std::size_t j = 0;
   for (std::size_t i = 0; i < N; ++i) {
     if (i == 1) {
       continue;
     }
-    col.extents[j++] = desc.extents[i];
+    col.extents[j] = desc.extents[i];
     col.strides[j++] = desc.strides[i];
   }
   col.size = matrix_impl::computing_size<N - 1>(col.extents);
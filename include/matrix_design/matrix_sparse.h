@@ -0,0 +1,554 @@
+#pragma once
+
+#include "matrix.h"
+#include "matrix_execution.h"
+#include "matrix_instrument.h"
+#include "matrix_simd.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Sparse matrices in compressed sparse row (CSR) and column (CSC) form.
+//
+//   Coo_builder<T> b(rows, cols)      collect (i, j, value) entries in any
+//   b.add(i, j, x)                    order; duplicates are summed
+//   Csr_matrix<T> a = b.to_csr()
+//   Csr_matrix<T> a(m)                the nonzeros of a Matrix or Matrix_ref
+//   a.to_dense()                      back to a Matrix<T, 2>
+//   a * x, a * b                      products with a dense vector or matrix
+//   spmv(policy, alpha, a, x, beta, y)
+//   spmm(policy, alpha, a, b, beta, c)
+//
+// A CSR matrix keeps the column indices and values of its nonzeros row
+// after row, each row's in increasing column order, and offsets[i], the
+// position of row i's first nonzero. CSC is the same with rows and columns
+// swapped, and either converts to the other. Indices are 32 bits by default
+// (the Index parameter), which halves their footprint; offsets are always
+// 64 bits.
+//
+// Parallel products of a CSR matrix cut its rows into pieces with about
+// the same number of nonzeros rather than the same number of rows, so the
+// few dense rows of a power-law graph do not leave one thread with most of
+// the work. A CSC product scatters into the result: under a parallel
+// policy each thread accumulates its columns into a private result, and the
+// results are added up at the end. Products with a dense operand are
+// written to a dense result, like gemm: y = alpha * a * x + beta * y, with
+// y only read when beta is not 0.
+
+enum class Sparse_layout { csr, csc };
+
+template <typename T, Sparse_layout L, typename Index = std::uint32_t>
+class Sparse_matrix;
+
+template <typename T, typename Index = std::uint32_t>
+using Csr_matrix = Sparse_matrix<T, Sparse_layout::csr, Index>;
+
+template <typename T, typename Index = std::uint32_t>
+using Csc_matrix = Sparse_matrix<T, Sparse_layout::csc, Index>;
+
+namespace matrix_impl {
+
+template <typename Index>
+auto check_index_range(std::size_t rows, std::size_t cols) -> void {
+  static_assert(std::is_unsigned_v<Index>, "sparse indices are unsigned");
+  if (std::max(rows, cols) > std::numeric_limits<Index>::max()) {
+    throw std::invalid_argument(
+        "sparse matrix: extents do not fit the index type");
+  }
+}
+
+// Bucket n entries by key with a counting sort: returns the offsets of the
+// buckets and fills order with the entries' positions, bucket by bucket and
+// in their original order within a bucket.
+template <typename Key>
+auto counting_sort(std::size_t buckets, const Key *keys, std::size_t n,
+                   std::vector<std::size_t> &order)
+    -> std::vector<std::size_t> {
+  std::vector<std::size_t> offsets(buckets + 1, 0);
+  for (std::size_t k = 0; k < n; ++k) {
+    ++offsets[std::size_t(keys[k]) + 1];
+  }
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  std::vector<std::size_t> next(offsets.begin(), offsets.end() - 1);
+  order.resize(n);
+  for (std::size_t k = 0; k < n; ++k) {
+    order[next[std::size_t(keys[k])]++] = k;
+  }
+  return offsets;
+}
+
+// the first row of each of `parts` pieces of about equal nonzeros, and rows
+// at the end
+inline auto nnz_partition(const std::vector<std::size_t> &offsets,
+                          std::size_t parts) -> std::vector<std::size_t> {
+  const std::size_t rows = offsets.size() - 1;
+  const std::size_t nnz = offsets.back();
+  std::vector<std::size_t> bounds(parts + 1, rows);
+  for (std::size_t p = 0; p < parts; ++p) {
+    const std::size_t target = nnz / parts * p + nnz % parts * p / parts;
+    bounds[p] = static_cast<std::size_t>(
+        std::lower_bound(offsets.begin(), offsets.end() - 1, target) -
+        offsets.begin());
+  }
+  bounds[0] = 0;
+  return bounds;
+}
+
+// how many pieces a product touching nnz nonzeros and `lines` result rows,
+// each `width` wide, is worth splitting into
+template <typename Policy>
+auto product_parts(const Policy & /*policy*/, std::size_t nnz,
+                   std::size_t lines, std::size_t width) -> std::size_t {
+  if constexpr (Is_parallel_policy_v<Policy>) {
+    const std::size_t work = (nnz + lines) * std::max<std::size_t>(width, 1);
+    return std::clamp<std::size_t>(work / min_task_elements, 1,
+                                   std::max<std::size_t>(lines, 1));
+  } else {
+    return 1;
+  }
+}
+
+// y[j * ys] = beta * y[j * ys], where beta == 0 clears y without reading it
+template <typename T>
+auto scale_line(std::size_t n, T beta, T *y, std::size_t ys) -> void {
+  for (std::size_t j = 0; j < n; ++j) {
+    y[j * ys] = beta == T{0} ? T{0} : beta * y[j * ys];
+  }
+}
+
+} // namespace matrix_impl
+
+template <typename T, Sparse_layout L, typename Index> class Sparse_matrix {
+public:
+  static constexpr Sparse_layout layout = L;
+  using value_type = T;
+  using index_type = Index;
+
+  Sparse_matrix() = default; // 0 x 0
+
+  // a rows x cols matrix of zeros
+  Sparse_matrix(std::size_t rows, std::size_t cols)
+      : ext{rows, cols}, offs(lines() + 1, 0) {
+    matrix_impl::check_index_range<Index>(rows, cols);
+  }
+
+  // adopt compressed arrays: offsets has one entry per row (CSR) or column
+  // (CSC) plus one, and the indices of each line increase; throws
+  // std::invalid_argument when they do not describe a rows x cols matrix
+  Sparse_matrix(std::size_t rows, std::size_t cols,
+                std::vector<std::size_t> offsets, std::vector<Index> indices,
+                std::vector<T> values);
+
+  // the nonzeros of a dense Matrix or Matrix_ref
+  template <typename M,
+            typename = Enable_if<matrix_impl::Is_matrix_v<M> &&
+                                     (std::remove_cv_t<M>::order == 2),
+                                 void>>
+  explicit Sparse_matrix(const M &m);
+
+  // the same matrix in the other layout
+  template <Sparse_layout K, typename = Enable_if<K != L, void>>
+  explicit Sparse_matrix(const Sparse_matrix<T, K, Index> &other);
+
+  [[nodiscard]] auto extent(std::size_t n) const -> std::size_t {
+    return ext[n];
+  }
+  [[nodiscard]] auto nnz() const -> std::size_t { return vals.size(); }
+
+  // the compressed arrays
+  auto offsets() const -> std::span<const std::size_t> { return offs; }
+  auto indices() const -> std::span<const Index> { return idx; }
+  auto values() const -> std::span<const T> { return vals; }
+  auto values() -> std::span<T> { return vals; }
+
+  // element (i, j), found by binary search in its line
+  auto operator()(std::size_t i, std::size_t j) const -> T;
+
+  auto to_dense() const -> Matrix<T, 2>;
+  // write every element, zeros included, into a view of the same extents
+  auto to_dense(Matrix_ref<T, 2> dst) const -> void;
+
+private:
+  template <typename U, Sparse_layout K, typename J> friend class Sparse_matrix;
+
+  // number of rows (CSR) or columns (CSC)
+  auto lines() const -> std::size_t {
+    return ext[L == Sparse_layout::csr ? 0 : 1];
+  }
+
+  std::array<std::size_t, 2> ext{};
+  std::vector<std::size_t> offs{0};
+  std::vector<Index> idx;
+  std::vector<T> vals;
+};
+
+template <typename T, Sparse_layout L, typename Index>
+Sparse_matrix<T, L, Index>::Sparse_matrix(std::size_t rows, std::size_t cols,
+                                          std::vector<std::size_t> offsets,
+                                          std::vector<Index> indices,
+                                          std::vector<T> values)
+    : ext{rows, cols}, offs(std::move(offsets)), idx(std::move(indices)),
+      vals(std::move(values)) {
+  matrix_impl::check_index_range<Index>(rows, cols);
+  const std::size_t width = ext[L == Sparse_layout::csr ? 1 : 0];
+  bool valid = offs.size() == lines() + 1 && offs.front() == 0 &&
+               offs.back() == idx.size() && idx.size() == vals.size();
+  for (std::size_t i = 0; valid && i < lines(); ++i) {
+    valid = offs[i] <= offs[i + 1];
+    for (std::size_t k = offs[i]; valid && k < offs[i + 1]; ++k) {
+      valid = idx[k] < width && (k == offs[i] || idx[k - 1] < idx[k]);
+    }
+  }
+  if (!valid) {
+    throw std::invalid_argument("sparse matrix: inconsistent arrays");
+  }
+}
+
+template <typename T, Sparse_layout L, typename Index>
+template <typename M, typename>
+Sparse_matrix<T, L, Index>::Sparse_matrix(const M &m)
+    : Sparse_matrix(m.extent(0), m.extent(1)) {
+  const auto m_r = matrix_impl::as_ref(m);
+  const auto &desc = m_r.descriptor();
+  const auto *p = m_r.pointer() + desc.start;
+  // walk lines of the dense operand in the order they are stored here
+  constexpr std::size_t major = L == Sparse_layout::csr ? 0 : 1;
+  const std::size_t width = ext[1 - major];
+  const std::size_t s_line = desc.strides[major];
+  const std::size_t s_elem = desc.strides[1 - major];
+  for (std::size_t i = 0; i < lines(); ++i) {
+    for (std::size_t j = 0; j < width; ++j) {
+      const T x = p[i * s_line + j * s_elem];
+      if (x != T{}) {
+        idx.push_back(static_cast<Index>(j));
+        vals.push_back(x);
+      }
+    }
+    offs[i + 1] = vals.size();
+  }
+}
+
+template <typename T, Sparse_layout L, typename Index>
+template <Sparse_layout K, typename>
+Sparse_matrix<T, L, Index>::Sparse_matrix(
+    const Sparse_matrix<T, K, Index> &other)
+    : ext{other.ext} {
+  // bucket the entries by their index; walking the other layout's lines in
+  // order keeps every bucket sorted
+  std::vector<std::size_t> order;
+  offs = matrix_impl::counting_sort(lines(), other.idx.data(), other.nnz(),
+                                    order);
+  idx.resize(other.nnz());
+  vals.resize(other.nnz());
+  std::vector<std::size_t> line_of(other.nnz());
+  for (std::size_t i = 0; i < other.lines(); ++i) {
+    std::fill(line_of.begin() + other.offs[i],
+              line_of.begin() + other.offs[i + 1], i);
+  }
+  for (std::size_t k = 0; k < order.size(); ++k) {
+    idx[k] = static_cast<Index>(line_of[order[k]]);
+    vals[k] = other.vals[order[k]];
+  }
+}
+
+template <typename T, Sparse_layout L, typename Index>
+auto Sparse_matrix<T, L, Index>::operator()(std::size_t i, std::size_t j) const
+    -> T {
+  assert(i < ext[0] && j < ext[1]);
+  const std::size_t line = L == Sparse_layout::csr ? i : j;
+  const auto key = static_cast<Index>(L == Sparse_layout::csr ? j : i);
+  const auto first = idx.begin() + offs[line];
+  const auto last = idx.begin() + offs[line + 1];
+  const auto it = std::lower_bound(first, last, key);
+  return it != last && *it == key ? vals[it - idx.begin()] : T{};
+}
+
+template <typename T, Sparse_layout L, typename Index>
+auto Sparse_matrix<T, L, Index>::to_dense() const -> Matrix<T, 2> {
+  Matrix<T, 2> m(ext[0], ext[1]);
+  to_dense(Matrix_ref<T, 2>(m));
+  return m;
+}
+
+template <typename T, Sparse_layout L, typename Index>
+auto Sparse_matrix<T, L, Index>::to_dense(Matrix_ref<T, 2> dst) const
+    -> void {
+  const auto &desc = dst.descriptor();
+  assert(desc.extents == ext);
+  T *p = dst.pointer() + desc.start;
+  constexpr std::size_t major = L == Sparse_layout::csr ? 0 : 1;
+  const std::size_t s_line = desc.strides[major];
+  const std::size_t s_elem = desc.strides[1 - major];
+  for (std::size_t i = 0; i < lines(); ++i) {
+    matrix_impl::scale_line(ext[1 - major], T{0}, p + i * s_line, s_elem);
+    for (std::size_t k = offs[i]; k < offs[i + 1]; ++k) {
+      p[i * s_line + idx[k] * s_elem] = vals[k];
+    }
+  }
+}
+
+// Collects the entries of a sparse matrix in any order, then compresses
+// them in two counting-sort passes (no comparison sort); entries at the
+// same position are summed.
+template <typename T, typename Index = std::uint32_t> class Coo_builder {
+public:
+  Coo_builder(std::size_t rows, std::size_t cols) : rows{rows}, cols{cols} {
+    matrix_impl::check_index_range<Index>(rows, cols);
+  }
+
+  auto reserve(std::size_t n) -> void {
+    row_idx.reserve(n);
+    col_idx.reserve(n);
+    vals.reserve(n);
+  }
+
+  auto add(std::size_t i, std::size_t j, const T &x) -> void {
+    assert(i < rows && j < cols);
+    row_idx.push_back(static_cast<Index>(i));
+    col_idx.push_back(static_cast<Index>(j));
+    vals.push_back(x);
+  }
+
+  // number of entries added, duplicates included
+  [[nodiscard]] auto size() const -> std::size_t { return vals.size(); }
+
+  auto to_csr() const -> Csr_matrix<T, Index> {
+    return build<Sparse_layout::csr>(rows, cols, row_idx, col_idx);
+  }
+  auto to_csc() const -> Csc_matrix<T, Index> {
+    return build<Sparse_layout::csc>(rows, cols, col_idx, row_idx);
+  }
+
+private:
+  // bucket by minor index first, then stably by major index, so each line
+  // comes out sorted; then merge neighbours at the same position
+  template <Sparse_layout L>
+  auto build(std::size_t rows, std::size_t cols,
+             const std::vector<Index> &major,
+             const std::vector<Index> &minor) const
+      -> Sparse_matrix<T, L, Index> {
+    const std::size_t n = vals.size();
+    const std::size_t lines = L == Sparse_layout::csr ? rows : cols;
+    const std::size_t width = L == Sparse_layout::csr ? cols : rows;
+    std::vector<std::size_t> by_minor;
+    matrix_impl::counting_sort(width, minor.data(), n, by_minor);
+    std::vector<Index> keys(n);
+    for (std::size_t k = 0; k < n; ++k) {
+      keys[k] = major[by_minor[k]];
+    }
+    std::vector<std::size_t> order;
+    std::vector<std::size_t> offsets =
+        matrix_impl::counting_sort(lines, keys.data(), n, order);
+
+    std::vector<Index> indices;
+    std::vector<T> values;
+    indices.reserve(n);
+    values.reserve(n);
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < lines; ++i) {
+      const std::size_t last = offsets[i + 1];
+      offsets[i] = values.size();
+      for (; k < last; ++k) {
+        const std::size_t e = by_minor[order[k]];
+        if (values.size() > offsets[i] && indices.back() == minor[e]) {
+          values.back() += vals[e];
+        } else {
+          indices.push_back(minor[e]);
+          values.push_back(vals[e]);
+        }
+      }
+    }
+    offsets[lines] = values.size();
+    return {rows, cols, std::move(offsets), std::move(indices),
+            std::move(values)};
+  }
+
+  std::size_t rows;
+  std::size_t cols;
+  std::vector<Index> row_idx;
+  std::vector<Index> col_idx;
+  std::vector<T> vals;
+};
+
+namespace matrix_impl {
+
+// c = alpha * a * b + beta * c with b (k x n) and c (m x n) given by their
+// first element and strides; n == 1 with column vectors is SpMV
+template <typename Policy, typename T, typename Index>
+auto sparse_product(const Policy &policy, T alpha,
+                    const Csr_matrix<T, Index> &a, std::size_t n, const T *b,
+                    std::size_t rsb, std::size_t csb, T beta, T *c,
+                    std::size_t rsc, std::size_t csc) -> void {
+  const auto offs = a.offsets();
+  const auto idx = a.indices();
+  const auto vals = a.values();
+  const auto rows = [&](std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; ++i) {
+      T *ci = c + i * rsc;
+      if (n == 1) { // a dot product per row
+        T acc{};
+        for (std::size_t k = offs[i]; k < offs[i + 1]; ++k) {
+          acc += vals[k] * b[idx[k] * rsb];
+        }
+        *ci = alpha * acc + (beta == T{0} ? T{0} : beta * *ci);
+        continue;
+      }
+      scale_line(n, beta, ci, csc);
+      for (std::size_t k = offs[i]; k < offs[i + 1]; ++k) {
+        axpy(n, alpha * vals[k], b + idx[k] * rsb, csb, ci, csc);
+      }
+    }
+  };
+  const std::size_t m = a.extent(0);
+  const std::size_t parts = product_parts(policy, a.nnz(), m, n);
+  if (parts == 1) {
+    rows(0, m);
+    return;
+  }
+  const std::vector<std::size_t> offsets(offs.begin(), offs.end());
+  const auto bounds = nnz_partition(offsets, parts);
+  Thread_pool::instance().parallel_for(
+      0, parts, 1, [&](std::size_t first, std::size_t last) {
+        for (std::size_t p = first; p < last; ++p) {
+          rows(bounds[p], bounds[p + 1]);
+        }
+      });
+}
+
+template <typename Policy, typename T, typename Index>
+auto sparse_product(const Policy &policy, T alpha,
+                    const Csc_matrix<T, Index> &a, std::size_t n, const T *b,
+                    std::size_t rsb, std::size_t csb, T beta, T *c,
+                    std::size_t rsc, std::size_t csc) -> void {
+  const auto offs = a.offsets();
+  const auto idx = a.indices();
+  const auto vals = a.values();
+  const std::size_t m = a.extent(0);
+  const std::size_t k_cols = a.extent(1);
+  // c rows += alpha * a[:, first:last] * b[first:last, :]
+  const auto scatter = [&](std::size_t first, std::size_t last, T *out,
+                           std::size_t rso, std::size_t cso) {
+    for (std::size_t j = first; j < last; ++j) {
+      const T *bj = b + j * rsb;
+      for (std::size_t k = offs[j]; k < offs[j + 1]; ++k) {
+        axpy(n, alpha * vals[k], bj, csb, out + idx[k] * rso, cso);
+      }
+    }
+  };
+  for (std::size_t i = 0; i < m; ++i) {
+    scale_line(n, beta, c + i * rsc, csc);
+  }
+  std::size_t parts = product_parts(policy, a.nnz(), k_cols, n);
+  if constexpr (Is_parallel_policy_v<Policy>) {
+    parts = std::min(parts, Thread_pool::instance().concurrency());
+  }
+  if (parts == 1) {
+    scatter(0, k_cols, c, rsc, csc);
+    return;
+  }
+  // one private m x n result per piece, added into c in piece order
+  const std::vector<std::size_t> offsets(offs.begin(), offs.end());
+  const auto bounds = nnz_partition(offsets, parts);
+  std::vector<T> partial(parts * m * n, T{0});
+  Thread_pool::instance().parallel_for(
+      0, parts, 1, [&](std::size_t first, std::size_t last) {
+        for (std::size_t p = first; p < last; ++p) {
+          scatter(bounds[p], bounds[p + 1], partial.data() + p * m * n, n, 1);
+        }
+      });
+  Thread_pool::instance().parallel_for(
+      0, m, grain_rows(parts * n), [&](std::size_t first, std::size_t last) {
+        for (std::size_t p = 0; p < parts; ++p) {
+          for (std::size_t i = first; i < last; ++i) {
+            axpy(n, T{1}, partial.data() + (p * m + i) * n, 1, c + i * rsc,
+                 csc);
+          }
+        }
+      });
+}
+
+template <typename M, std::size_t N>
+constexpr bool Is_matrix_of_order_v =
+    Is_matrix_v<M> && (std::remove_cv_t<std::remove_reference_t<M>>::order ==
+                       N);
+
+} // namespace matrix_impl
+
+// y = alpha * a * x + beta * y
+template <typename Policy, typename T, Sparse_layout L, typename Index,
+          typename X,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy> &&
+                                   matrix_impl::Is_matrix_of_order_v<X, 1>,
+                               void>>
+auto spmv(const Policy &policy, T alpha, const Sparse_matrix<T, L, Index> &a,
+          const X &x, T beta, Matrix_ref<T, 1> y) -> void {
+  const matrix_impl::Kernel_scope scope(matrix_instrument::Kernel::sparse);
+  const auto x_r = matrix_impl::as_ref(x);
+  const auto &dx = x_r.descriptor();
+  const auto &dy = y.descriptor();
+  assert(dx.extents[0] == a.extent(1) && dy.extents[0] == a.extent(0));
+  matrix_impl::sparse_product(policy, alpha, a, 1, x_r.pointer() + dx.start,
+                              dx.strides[0], 1, beta,
+                              y.pointer() + dy.start, dy.strides[0], 1);
+}
+
+template <typename T, Sparse_layout L, typename Index, typename X,
+          typename = Enable_if<matrix_impl::Is_matrix_of_order_v<X, 1>, void>>
+auto spmv(T alpha, const Sparse_matrix<T, L, Index> &a, const X &x, T beta,
+          Matrix_ref<T, 1> y) -> void {
+  spmv(matrix_execution::seq, alpha, a, x, beta, y);
+}
+
+// c = alpha * a * b + beta * c
+template <typename Policy, typename T, Sparse_layout L, typename Index,
+          typename B,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy> &&
+                                   matrix_impl::Is_matrix_of_order_v<B, 2>,
+                               void>>
+auto spmm(const Policy &policy, T alpha, const Sparse_matrix<T, L, Index> &a,
+          const B &b, T beta, Matrix_ref<T, 2> c) -> void {
+  const matrix_impl::Kernel_scope scope(matrix_instrument::Kernel::sparse);
+  const auto b_r = matrix_impl::as_ref(b);
+  const auto &db = b_r.descriptor();
+  const auto &dc = c.descriptor();
+  assert(db.extents[0] == a.extent(1));
+  assert(dc.extents[0] == a.extent(0) && dc.extents[1] == db.extents[1]);
+  matrix_impl::sparse_product(policy, alpha, a, db.extents[1],
+                              b_r.pointer() + db.start, db.strides[0],
+                              db.strides[1], beta, c.pointer() + dc.start,
+                              dc.strides[0], dc.strides[1]);
+}
+
+template <typename T, Sparse_layout L, typename Index, typename B,
+          typename = Enable_if<matrix_impl::Is_matrix_of_order_v<B, 2>, void>>
+auto spmm(T alpha, const Sparse_matrix<T, L, Index> &a, const B &b, T beta,
+          Matrix_ref<T, 2> c) -> void {
+  spmm(matrix_execution::seq, alpha, a, b, beta, c);
+}
+
+// a * x for a dense vector x, or a * b for a dense matrix b; products large
+// enough to be worth it run on the thread pool
+template <typename T, Sparse_layout L, typename Index, typename M,
+          typename = Enable_if<matrix_impl::Is_matrix_of_order_v<M, 1> ||
+                                   matrix_impl::Is_matrix_of_order_v<M, 2>,
+                               void>>
+auto operator*(const Sparse_matrix<T, L, Index> &a, const M &m) {
+  if constexpr (matrix_impl::Is_matrix_of_order_v<M, 1>) {
+    Matrix<T, 1> y(std::array<std::size_t, 1>{a.extent(0)});
+    spmv(matrix_execution::par, T{1}, a, m, T{0}, Matrix_ref<T, 1>(y));
+    return y;
+  } else {
+    Matrix<T, 2> c(a.extent(0), m.extent(1));
+    spmm(matrix_execution::par, T{1}, a, m, T{0}, Matrix_ref<T, 2>(c));
+    return c;
+  }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "matrix.h"
+#include "matrix_npy.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// A compact binary format for sending matrices through iostreams.
+//
+//   write_binary(os, m)         any matrix or view, in C order
+//   read_binary<T, N>(is)       the next matrix in the stream
+//
+// Each matrix is a 24-byte header (magic, dtype string, order) followed by
+// its extents as 64-bit integers and then the raw elements. Contiguous
+// matrices are written with a single write and read straight into the
+// new matrix, so a round trip runs at the speed of the stream. Several
+// matrices may follow each other in one stream. The dtype string is the one
+// of .npy files and includes the byte order; read_binary throws
+// std::runtime_error when it, the order or the stream is not as expected.
+
+namespace matrix_impl {
+
+inline constexpr char stream_magic[8] = {'M', 'D', 'M', 'A',
+                                         'T', 'R', 'X', '1'};
+
+} // namespace matrix_impl
+
+template <typename M, typename = Enable_if<matrix_impl::Is_matrix_v<M>, void>>
+auto write_binary(std::ostream &os, const M &m) -> std::ostream & {
+  using T = matrix_impl::Value_type<M>;
+  const auto m_r = matrix_impl::as_ref(m);
+  constexpr std::size_t N = decltype(m_r)::order;
+  const auto &desc = m_r.descriptor();
+
+  std::array<char, 24 + 8 * N> header{};
+  std::memcpy(header.data(), matrix_impl::stream_magic, 8);
+  const std::string descr = matrix_impl::npy_descr<T>();
+  std::memcpy(header.data() + 8, descr.data(),
+              std::min<std::size_t>(descr.size(), 8));
+  const std::uint64_t order = N;
+  std::memcpy(header.data() + 16, &order, 8);
+  for (std::size_t d = 0; d < N; ++d) {
+    const std::uint64_t extent = desc.extents[d];
+    std::memcpy(header.data() + 24 + 8 * d, &extent, 8);
+  }
+  os.write(header.data(), static_cast<std::streamsize>(header.size()));
+
+  // unit-stride runs are written in place, strided ones through a buffer
+  std::vector<T> buffer;
+  m_r.for_each_run([&](const T *first, std::size_t n, std::size_t stride) {
+    if (stride != 1) {
+      buffer.resize(n);
+      for (std::size_t i = 0; i < n; ++i) {
+        buffer[i] = first[i * stride];
+      }
+      first = buffer.data();
+    }
+    os.write(reinterpret_cast<const char *>(first),
+             static_cast<std::streamsize>(n * sizeof(T)));
+  });
+  return os;
+}
+
+template <typename T, std::size_t N>
+auto read_binary(std::istream &is) -> Matrix<T, N> {
+  std::array<char, 24> header{};
+  if (!is.read(header.data(), static_cast<std::streamsize>(header.size()))) {
+    throw std::runtime_error("read_binary: stream ended before the header");
+  }
+  if (std::memcmp(header.data(), matrix_impl::stream_magic, 8) != 0) {
+    throw std::runtime_error("read_binary: not a matrix stream");
+  }
+  const std::string descr(header.data() + 8, strnlen(header.data() + 8, 8));
+  std::uint64_t order = 0;
+  std::memcpy(&order, header.data() + 16, 8);
+  if (descr != matrix_impl::npy_descr<T>() || order != N) {
+    throw std::runtime_error("read_binary: stream holds a " +
+                             std::to_string(order) + "-d matrix of " + descr);
+  }
+  std::array<std::uint64_t, N> stored{};
+  std::array<std::size_t, N> extents{};
+  if (!is.read(reinterpret_cast<char *>(stored.data()), 8 * N)) {
+    throw std::runtime_error("read_binary: stream ended before the header");
+  }
+  std::copy(stored.begin(), stored.end(), extents.begin());
+  Matrix<T, N> m(extents);
+  const auto bytes = static_cast<std::streamsize>(m.size() * sizeof(T));
+  if (!is.read(reinterpret_cast<char *>(m.data()), bytes)) {
+    throw std::runtime_error("read_binary: stream ended inside the elements");
+  }
+  return m;
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "matrix.h"
+#include "matrix_copy.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+// Transposes and axis permutations.
+//
+//   transpose(m)           a view of m with its axes reversed (rows and
+//                          columns swapped for order 2); nothing is copied
+//   permute_axes<P...>(m)  a view whose dimension i is dimension P[i] of m
+//   transpose_in_place(m)  transpose a square matrix in its own storage
+//   nchw_to_nhwc(x)        materialize a 4-D tensor in channels-last order
+//   nhwc_to_nchw(x)        and back
+//
+// Views only permute the extents and strides of the descriptor. Building a
+// Matrix from one runs the strided copy engine, which recognizes the
+// transposing layout and copies it in cache-oblivious tiles of in-register
+// block transposes, so `Matrix<float, 2> t(transpose(m))` is the fast
+// out-of-place transpose. Like any view, the result must not outlive the
+// matrix it refers to.
+
+namespace matrix_impl {
+
+template <std::size_t N>
+constexpr auto is_permutation(const std::array<std::size_t, N> &axes)
+    -> bool {
+  std::array<bool, N> seen{};
+  for (std::size_t a : axes) {
+    if (a >= N || seen[a]) {
+      return false;
+    }
+    seen[a] = true;
+  }
+  return true;
+}
+
+template <typename T, std::size_t N>
+auto permute_view(const Matrix_ref<T, N> &m_r,
+                  const std::array<std::size_t, N> &axes) -> Matrix_ref<T, N> {
+  const auto &desc = m_r.descriptor();
+  Matrix_slice<N> permuted = desc;
+  for (std::size_t i = 0; i < N; ++i) {
+    permuted.extents[i] = desc.extents[axes[i]];
+    permuted.strides[i] = desc.strides[axes[i]];
+  }
+  return {permuted, m_r.pointer()};
+}
+
+// square in-place transpose of n x n elements with row stride ld and unit
+// column stride: tiles above the diagonal are swapped with their mirror
+// images through a tile-sized buffer
+template <typename T>
+auto transpose_square(std::size_t n, T *a, std::size_t ld) -> void {
+  std::array<T, copy_tile * copy_tile> buf;
+  for (std::size_t i = 0; i < n; i += copy_tile) {
+    const std::size_t bi = std::min(copy_tile, n - i);
+    for (std::size_t j = i; j < n; j += copy_tile) {
+      const std::size_t bj = std::min(copy_tile, n - j);
+      // buf = tile(i, j) transposed
+      transpose_copy(bi, bj, a + i * ld + j, ld, buf.data(), copy_tile);
+      if (i != j) {
+        // tile(i, j) = tile(j, i) transposed
+        transpose_copy(bj, bi, a + j * ld + i, ld, a + i * ld + j, ld);
+      }
+      // tile(j, i) = buf
+      for (std::size_t r = 0; r < bj; ++r) {
+        std::copy(buf.data() + r * copy_tile, buf.data() + r * copy_tile + bi,
+                  a + (j + r) * ld + i);
+      }
+    }
+  }
+}
+
+} // namespace matrix_impl
+
+// a view of m with dimension i taken from dimension Axes[i] of m
+template <std::size_t... Axes, typename M,
+          typename = Enable_if<matrix_impl::Is_matrix_v<M>, void>>
+auto permute_axes(M &&m) {
+  const auto m_r = matrix_impl::as_ref(m);
+  constexpr std::size_t N = decltype(m_r)::order;
+  static_assert(sizeof...(Axes) == N, "one axis per dimension");
+  static_assert(matrix_impl::is_permutation<N>({Axes...}),
+                "axes must be a permutation of 0, ..., N - 1");
+  return matrix_impl::permute_view(m_r, {Axes...});
+}
+
+// a view of m with its axes in reverse order
+template <typename M, typename = Enable_if<matrix_impl::Is_matrix_v<M>, void>>
+auto transpose(M &&m) {
+  const auto m_r = matrix_impl::as_ref(m);
+  constexpr std::size_t N = decltype(m_r)::order;
+  std::array<std::size_t, N> axes;
+  for (std::size_t i = 0; i < N; ++i) {
+    axes[i] = N - 1 - i;
+  }
+  return matrix_impl::permute_view(m_r, axes);
+}
+
+// transpose a square view in place
+template <typename T>
+auto transpose_in_place(Matrix_ref<T, 2> m_r) -> Matrix_ref<T, 2> {
+  const auto &desc = m_r.descriptor();
+  assert(desc.extents[0] == desc.extents[1]);
+  const matrix_impl::Kernel_scope scope(matrix_instrument::Kernel::transpose);
+  const std::size_t n = desc.extents[0];
+  T *a = m_r.pointer() + desc.start;
+  if constexpr (std::is_trivially_copyable_v<T> &&
+                std::is_default_constructible_v<T>) {
+    if (desc.strides[1] == 1) {
+      matrix_impl::transpose_square(n, a, desc.strides[0]);
+      return m_r;
+    }
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    for (std::size_t j = i + 1; j < n; ++j) {
+      std::swap(a[i * desc.strides[0] + j * desc.strides[1]],
+                a[j * desc.strides[0] + i * desc.strides[1]]);
+    }
+  }
+  return m_r;
+}
+
+// transpose a matrix; square matrices keep their storage, others are
+// transposed into new storage from the same allocator
+template <typename T, typename A>
+auto transpose_in_place(Matrix<T, 2, A> &m) -> Matrix<T, 2, A> & {
+  if (m.extent(0) == m.extent(1)) {
+    transpose_in_place(Matrix_ref<T, 2>(m));
+    return m;
+  }
+  return m = Matrix<T, 2, A>(transpose(std::as_const(m)), m.get_allocator());
+}
+
+// x[n][c][h][w] -> y[n][h][w][c]
+template <typename M, typename = Enable_if<matrix_impl::Is_matrix_v<M>, void>>
+auto nchw_to_nhwc(const M &x) -> Matrix<matrix_impl::Value_type<M>, 4> {
+  return Matrix<matrix_impl::Value_type<M>, 4>(permute_axes<0, 2, 3, 1>(x));
+}
+
+template <typename Policy, typename M,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy> &&
+                                   matrix_impl::Is_matrix_v<M>,
+                               void>>
+auto nchw_to_nhwc(const Policy &policy, const M &x)
+    -> Matrix<matrix_impl::Value_type<M>, 4> {
+  return {policy, permute_axes<0, 2, 3, 1>(x)};
+}
+
+// x[n][h][w][c] -> y[n][c][h][w]
+template <typename M, typename = Enable_if<matrix_impl::Is_matrix_v<M>, void>>
+auto nhwc_to_nchw(const M &x) -> Matrix<matrix_impl::Value_type<M>, 4> {
+  return Matrix<matrix_impl::Value_type<M>, 4>(permute_axes<0, 3, 1, 2>(x));
+}
+
+template <typename Policy, typename M,
+          typename = Enable_if<matrix_impl::Is_execution_policy_v<Policy> &&
+                                   matrix_impl::Is_matrix_v<M>,
+                               void>>
+auto nhwc_to_nchw(const Policy &policy, const M &x)
+    -> Matrix<matrix_impl::Value_type<M>, 4> {
+  return {policy, permute_axes<0, 3, 1, 2>(x)};
+}
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// A small work-stealing thread pool for the parallel execution policies.
+//
+// Every worker owns a deque: it pushes and pops work at the back and, when it
+// runs dry, steals from the front of the other workers' deques. A
+// parallel_for splits its range in halves, queueing one half and continuing
+// with the other, so idle workers steal large pieces first. The calling
+// thread takes part in the loop and keeps executing queued work until its
+// own loop has finished, which also makes nested parallel loops safe.
+//
+// The process-wide pool is created on first use with one thread per
+// hardware thread (counting the caller). Applications that run their own
+// workers should size it (and optionally pin it to a set of CPUs) with
+// Thread_pool::configure() before any parallel algorithm runs.
+
+class Thread_pool {
+public:
+  // `threads` counts the calling thread, so 1 means everything runs inline;
+  // worker i is pinned to cpus[i % cpus.size()] when cpus is not empty
+  explicit Thread_pool(std::size_t threads, std::vector<int> cpus = {})
+      : queues(threads > 1 ? threads - 1 : 0) {
+    workers.reserve(queues.size());
+    for (std::size_t i = 0; i < queues.size(); ++i) {
+      workers.emplace_back([this, i] { work(i); });
+      if (!cpus.empty()) {
+        pin(workers.back(), cpus[i % cpus.size()]);
+      }
+    }
+  }
+
+  Thread_pool(const Thread_pool &) = delete;
+  auto operator=(const Thread_pool &) -> Thread_pool & = delete;
+
+  ~Thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers) {
+      worker.join();
+    }
+  }
+
+  // the process-wide pool used by the parallel policies
+  static auto instance() -> Thread_pool & {
+    std::lock_guard<std::mutex> lock(global_mutex());
+    auto &pool = global();
+    if (!pool) {
+      pool = std::make_unique<Thread_pool>(
+          std::max(1U, std::thread::hardware_concurrency()));
+    }
+    return *pool;
+  }
+
+  // replace the process-wide pool; must not race with running algorithms
+  static auto configure(std::size_t threads, std::vector<int> cpus = {})
+      -> void {
+    std::lock_guard<std::mutex> lock(global_mutex());
+    auto &pool = global();
+    pool.reset();
+    pool = std::make_unique<Thread_pool>(threads, std::move(cpus));
+  }
+
+  // number of threads taking part in a loop, the caller included
+  [[nodiscard]] auto concurrency() const -> std::size_t {
+    return workers.size() + 1;
+  }
+
+  // f(first, last) over disjoint sub-ranges of [begin, end), each at most
+  // `grain` long; the first exception thrown by f is rethrown here
+  template <typename F>
+  auto parallel_for(std::size_t begin, std::size_t end, std::size_t grain,
+                    F &&f) -> void {
+    grain = std::max<std::size_t>(grain, 1);
+    if (end <= begin) {
+      return;
+    }
+    if (workers.empty() || end - begin <= grain) {
+      f(begin, end);
+      return;
+    }
+    Loop<F> loop{f, grain, end - begin};
+    split(loop, begin, end);
+    while (loop.remaining.load(std::memory_order_acquire) != 0) {
+      if (!run_one()) {
+        std::this_thread::yield();
+      }
+    }
+    if (loop.error) {
+      std::rethrow_exception(loop.error);
+    }
+  }
+
+private:
+  using Task = std::function<void()>;
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  template <typename F> struct Loop {
+    F &f;
+    std::size_t grain;
+    std::atomic<std::size_t> remaining;
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    Loop(F &f, std::size_t grain, std::size_t count)
+        : f{f}, grain{grain}, remaining{count} {}
+  };
+
+  template <typename F>
+  auto split(Loop<F> &loop, std::size_t begin, std::size_t end) -> void {
+    while (end - begin > loop.grain) {
+      const std::size_t mid = begin + (end - begin) / 2;
+      push([this, &loop, mid, end] { split(loop, mid, end); });
+      end = mid;
+    }
+    try {
+      loop.f(begin, end);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(loop.error_mutex);
+      if (!loop.error) {
+        loop.error = std::current_exception();
+      }
+    }
+    // the last access to `loop`: the owner may return as soon as it hits 0
+    loop.remaining.fetch_sub(end - begin, std::memory_order_acq_rel);
+  }
+
+  auto push(Task task) -> void {
+    const std::size_t self = worker_index();
+    const std::size_t target =
+        self < queues.size() ? self : next_queue++ % queues.size();
+    {
+      std::lock_guard<std::mutex> lock(queues[target].mutex);
+      queues[target].tasks.push_back(std::move(task));
+    }
+    pending.fetch_add(1, std::memory_order_release);
+    {
+      // pairs with the predicate check in work() so a wakeup is not lost
+      std::lock_guard<std::mutex> lock(sleep_mutex);
+    }
+    wake.notify_one();
+  }
+
+  // pop from our own queue first (LIFO), then steal (FIFO) from the others
+  auto take(Task &task) -> bool {
+    const std::size_t self = worker_index();
+    if (self < queues.size()) {
+      std::lock_guard<std::mutex> lock(queues[self].mutex);
+      if (!queues[self].tasks.empty()) {
+        task = std::move(queues[self].tasks.back());
+        queues[self].tasks.pop_back();
+        return true;
+      }
+    }
+    const std::size_t start = self < queues.size() ? self + 1 : 0;
+    for (std::size_t i = 0; i < queues.size(); ++i) {
+      Queue &victim = queues[(start + i) % queues.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.tasks.empty()) {
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  auto run_one() -> bool {
+    Task task;
+    if (!take(task)) {
+      return false;
+    }
+    pending.fetch_sub(1, std::memory_order_acq_rel);
+    task();
+    return true;
+  }
+
+  auto work(std::size_t index) -> void {
+    current_pool() = this;
+    current_index() = index;
+    while (true) {
+      if (run_one()) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(sleep_mutex);
+      wake.wait(lock, [this] {
+        return stopping || pending.load(std::memory_order_acquire) > 0;
+      });
+      if (stopping) {
+        return;
+      }
+    }
+  }
+
+  // index of the calling thread's queue, or queues.size() for outsiders
+  auto worker_index() const -> std::size_t {
+    return current_pool() == this ? current_index() : queues.size();
+  }
+
+  static auto pin(std::thread &thread, int cpu) -> void {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+    (void)thread;
+    (void)cpu;
+#endif
+  }
+
+  static auto current_pool() -> const Thread_pool *& {
+    thread_local const Thread_pool *pool = nullptr;
+    return pool;
+  }
+
+  static auto current_index() -> std::size_t & {
+    thread_local std::size_t index = 0;
+    return index;
+  }
+
+  static auto global() -> std::unique_ptr<Thread_pool> & {
+    static std::unique_ptr<Thread_pool> pool;
+    return pool;
+  }
+
+  static auto global_mutex() -> std::mutex & {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  std::vector<Queue> queues;
+  std::vector<std::thread> workers;
+  std::atomic<std::size_t> pending{0};
+  std::atomic<std::size_t> next_queue{0};
+  std::mutex sleep_mutex;
+  std::condition_variable wake;
+  bool stopping = false;
+};
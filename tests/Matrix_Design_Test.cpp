@@ -1,7 +1,29 @@
 
 #include "matrix_design/matrix.h"
+#include "matrix_design/matrix_broadcast.h"
+#include "matrix_design/matrix_chunked.h"
+#include "matrix_design/matrix_conv.h"
+#include "matrix_design/matrix_convert.h"
+#include "matrix_design/matrix_dispatch.h"
+#include "matrix_design/matrix_fixed.h"
+#include "matrix_design/matrix_gemm.h"
+#include "matrix_design/matrix_instrument.h"
+#include "matrix_design/matrix_linalg.h"
+#include "matrix_design/matrix_npy.h"
+#include "matrix_design/matrix_out_of_core.h"
+#include "matrix_design/matrix_ops.h"
+#include "matrix_design/matrix_quant.h"
+#include "matrix_design/matrix_reduce.h"
+#include "matrix_design/matrix_sparse.h"
+#include "matrix_design/matrix_stream.h"
+#include "matrix_design/matrix_transpose.h"
+#include <cmath>
+#include <cstdint>
+#include <fstream>
 #include <gtest/gtest.h>
+#include <iomanip>
 #include <iostream>
+#include <numeric>
 
 template <typename T, std::size_t N>
 auto CompareArrays(const std::array<T, N> arr1, const std::array<T, N> arr2,
@@ -159,3 +181,1886 @@ TEST(MATRIX_DESIGN_TEST, matrix_slice_test_0) {
 
     std::cout << m1 << '\n';
 }
+
+template <typename T>
+auto naive_matmul(const Matrix<T, 2> &a, const Matrix<T, 2> &b)
+    -> Matrix<T, 2> {
+    Matrix<T, 2> c(a.extent(0), b.extent(1));
+    for (std::size_t i = 0; i < a.extent(0); ++i) {
+        for (std::size_t j = 0; j < b.extent(1); ++j) {
+            T sum{};
+            for (std::size_t p = 0; p < a.extent(1); ++p) {
+                sum += a(i, p) * b(p, j);
+            }
+            c(i, j) = sum;
+        }
+    }
+    return c;
+}
+
+template <typename T>
+auto iota_matrix(std::size_t rows, std::size_t cols) -> Matrix<T, 2> {
+    Matrix<T, 2> m(rows, cols);
+    for (std::size_t i = 0; i < m.size(); ++i) {
+        m.data()[i] = static_cast<T>((i * 7 + 3) % 11) - T(5);
+    }
+    return m;
+}
+
+TEST(MATRIX_GEMM_TEST, matches_naive_product) {
+    for (auto [m, n, k] : {std::array<std::size_t, 3>{1, 1, 1},
+                           std::array<std::size_t, 3>{7, 9, 5},
+                           std::array<std::size_t, 3>{97, 130, 301},
+                           std::array<std::size_t, 3>{200, 17, 400}}) {
+        auto a = iota_matrix<double>(m, k);
+        auto b = iota_matrix<double>(k, n);
+        auto c = a * b;
+        auto expected = naive_matmul(a, b);
+        EXPECT_EQ(c.extent(0), m);
+        EXPECT_EQ(c.extent(1), n);
+        for (std::size_t i = 0; i < c.size(); ++i) {
+            EXPECT_DOUBLE_EQ(c.data()[i], expected.data()[i]);
+        }
+    }
+}
+
+TEST(MATRIX_GEMM_TEST, strided_views_are_packed) {
+    auto a = iota_matrix<float>(40, 60);
+    auto b = iota_matrix<float>(70, 50);
+    // every other row/column block of both operands
+    auto a_view = a(Slice(3, 38), Slice(10, 55));
+    auto b_view = b(Slice(5, 50), Slice(1, 34));
+    auto c = matmul(a_view, b_view);
+    auto expected = naive_matmul(Matrix<float, 2>(a_view),
+                                 Matrix<float, 2>(b_view));
+    for (std::size_t i = 0; i < c.size(); ++i) {
+        EXPECT_FLOAT_EQ(c.data()[i], expected.data()[i]);
+    }
+
+    Matrix<int, 2> c_int(3, 3);
+    auto a_int = iota_matrix<int>(3, 4);
+    auto b_int = iota_matrix<int>(4, 3);
+    gemm(2, a_int, b_int, 0, Matrix_ref<int, 2>(c_int));
+    auto expected_int = naive_matmul(a_int, b_int);
+    for (std::size_t i = 0; i < c_int.size(); ++i) {
+        EXPECT_EQ(c_int.data()[i], 2 * expected_int.data()[i]);
+    }
+}
+
+TEST(MATRIX_OPS_TEST, contiguous_arithmetic) {
+    auto a = iota_matrix<double>(13, 21);
+    auto b = iota_matrix<double>(21, 13);
+    Matrix<double, 2> b_t(13, 21);
+    for (std::size_t i = 0; i < 13; ++i) {
+        for (std::size_t j = 0; j < 21; ++j) {
+            b_t(i, j) = b.data()[j * 13 + i];
+        }
+    }
+    Matrix<double, 2> sum = a + b_t;
+    Matrix<double, 2> diff = a - b_t;
+    Matrix<double, 2> scaled = 2.0 * a / 4.0;
+    Matrix<double, 2> neg = -a;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        EXPECT_DOUBLE_EQ(sum.data()[i], a.data()[i] + b_t.data()[i]);
+        EXPECT_DOUBLE_EQ(diff.data()[i], a.data()[i] - b_t.data()[i]);
+        EXPECT_DOUBLE_EQ(scaled.data()[i], a.data()[i] / 2.0);
+        EXPECT_DOUBLE_EQ(neg.data()[i], -a.data()[i]);
+    }
+
+    a += b_t;
+    a *= 3.0;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        EXPECT_DOUBLE_EQ(a.data()[i], 3.0 * sum.data()[i]);
+    }
+    apply(a, [](double &x) { x = 1.5; });
+    EXPECT_DOUBLE_EQ(a(12, 20), 1.5);
+
+    // scalars of another arithmetic type, as with a * 2
+    a *= 2;
+    a /= 4;
+    EXPECT_DOUBLE_EQ(a(3, 7), 0.75);
+    a.row(2) *= 4;
+    EXPECT_DOUBLE_EQ(a(2, 0), 3.0);
+    EXPECT_DOUBLE_EQ(a(1, 0), 0.75);
+}
+
+TEST(MATRIX_OPS_TEST, strided_views) {
+    Matrix<float, 3> m(4, 5, 6);
+    for (std::size_t i = 0; i < m.size(); ++i) {
+        m.data()[i] = static_cast<float>(i);
+    }
+    auto inner = m(Slice(1, 3), Slice(1, 4), Slice(2, 6));
+    Matrix<float, 3> doubled = inner + inner;
+    Matrix<float, 3> copy(inner);
+    EXPECT_EQ(doubled.descriptor().extents, copy.descriptor().extents);
+    for (std::size_t i = 0; i < copy.size(); ++i) {
+        EXPECT_FLOAT_EQ(doubled.data()[i], 2 * copy.data()[i]);
+    }
+
+    // update one column plane through a view, the rest stays untouched
+    inner -= copy;
+    inner *= 5.0f;
+    for (std::size_t i = 0; i < 4; ++i) {
+        for (std::size_t j = 0; j < 5; ++j) {
+            for (std::size_t k = 0; k < 6; ++k) {
+                bool in_view = i >= 1 && i < 3 && j >= 1 && j < 4 && k >= 2;
+                float expected = in_view ? 0.0f : float(i * 30 + j * 6 + k);
+                EXPECT_FLOAT_EQ(m(i, j, k), expected);
+            }
+        }
+    }
+
+    Matrix<int, 2> counts(3, 3);
+    apply(counts.col(1), [](int &x) { x += 7; });
+    EXPECT_EQ(counts(0, 1) + counts(1, 1) + counts(2, 1), 21);
+    EXPECT_EQ(counts(0, 0) + counts(2, 2), 0);
+}
+
+TEST(MATRIX_EXPR_TEST, fused_evaluation) {
+    Matrix<double, 3> b(3, 4, 5);
+    Matrix<double, 3> c(3, 4, 5);
+    Matrix<double, 3> d(3, 4, 5);
+    for (std::size_t i = 0; i < b.size(); ++i) {
+        b.data()[i] = double(i);
+        c.data()[i] = double(i % 7);
+        d.data()[i] = 0.5 * double(i);
+    }
+    Matrix<double, 3> a = b * 2.0 + c - d;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        EXPECT_DOUBLE_EQ(a.data()[i],
+                         b.data()[i] * 2.0 + c.data()[i] - d.data()[i]);
+    }
+
+    // reassigning with a different shape reallocates
+    Matrix<double, 3> e(1, 1, 1);
+    e = (b - d) / 2.0;
+    EXPECT_EQ(e.descriptor().extents, b.descriptor().extents);
+    EXPECT_DOUBLE_EQ(e(2, 3, 4), (b(2, 3, 4) - d(2, 3, 4)) / 2.0);
+
+    // assignment through a view only touches the viewed elements
+    a.row(1) = b.row(0) + c.row(2);
+    EXPECT_DOUBLE_EQ(a(1, 2, 3), b(0, 2, 3) + c(2, 2, 3));
+    EXPECT_DOUBLE_EQ(a(0, 2, 3), b(0, 2, 3) * 2.0 + c(0, 2, 3) - d(0, 2, 3));
+}
+
+TEST(MATRIX_EXPR_TEST, aliasing_destination) {
+    Matrix<int, 1> v{1, 2, 3, 4, 5, 6, 7, 8};
+    // the same elements on both sides are evaluated in place
+    v = v + v * 2;
+    EXPECT_EQ(v(7), 24);
+
+    // overlapping but shifted views must read the old values
+    Matrix<int, 2> m(1, 8);
+    for (std::size_t j = 0; j < 8; ++j) {
+        m(0, j) = int(j);
+    }
+    auto head = m(Slice(0, 1), Slice(0, 7));
+    auto tail = m(Slice(0, 1), Slice(1, 8));
+    tail = head + head;
+    for (std::size_t j = 1; j < 8; ++j) {
+        EXPECT_EQ(m(0, j), 2 * int(j - 1));
+    }
+    EXPECT_EQ(m(0, 0), 0);
+}
+
+TEST(MATRIX_EXECUTION_TEST, thread_pool_covers_range) {
+    Thread_pool pool(4);
+    EXPECT_EQ(pool.concurrency(), 4);
+    std::vector<int> hits(10000);
+    pool.parallel_for(0, hits.size(), 7, [&](std::size_t b, std::size_t e) {
+        EXPECT_LE(e - b, 7);
+        for (std::size_t i = b; i < e; ++i) {
+            ++hits[i];
+        }
+    });
+    EXPECT_EQ(std::count(hits.begin(), hits.end(), 1), 10000);
+
+    EXPECT_THROW(pool.parallel_for(0, 100, 1,
+                                   [](std::size_t b, std::size_t) {
+                                       if (b == 42) {
+                                           throw std::runtime_error("42");
+                                       }
+                                   }),
+                 std::runtime_error);
+}
+
+TEST(MATRIX_EXECUTION_TEST, policies_agree) {
+    Thread_pool::configure(3);
+    Matrix<double, 3> b(64, 32, 40);
+    Matrix<double, 3> c(64, 32, 40);
+    for (std::size_t i = 0; i < b.size(); ++i) {
+        b.data()[i] = double(i % 101);
+        c.data()[i] = double(i % 13) * 0.25;
+    }
+    Matrix<double, 3> serial(matrix_execution::seq, b * 3.0 - c);
+    Matrix<double, 3> parallel(matrix_execution::par, b * 3.0 - c);
+    Matrix<double, 2> copy(matrix_execution::par_unseq, b.row(5));
+    EXPECT_TRUE(std::equal(serial.data(), serial.data() + serial.size(),
+                           parallel.data()));
+    EXPECT_DOUBLE_EQ(copy(7, 9), b(5, 7, 9));
+
+    assign(matrix_execution::par, parallel, parallel + c);
+    EXPECT_DOUBLE_EQ(parallel(63, 31, 39), b(63, 31, 39) * 3.0);
+    apply(matrix_execution::par, parallel, [](double &x) { x = -x; });
+    EXPECT_DOUBLE_EQ(parallel(1, 2, 3), -b(1, 2, 3) * 3.0);
+    // a temporary view comes back by value, the matrix by reference
+    auto row = apply(matrix_execution::par, parallel.row(0),
+                     [](double &x) { x = 0.5; });
+    static_assert(std::is_same_v<decltype(row), Matrix_ref<double, 2>>);
+    EXPECT_EQ(row.pointer(), parallel.data());
+    EXPECT_DOUBLE_EQ(parallel(0, 31, 39), 0.5);
+    static_assert(
+        std::is_same_v<decltype(apply(matrix_execution::par, parallel,
+                                      [](double &) {})),
+                       Matrix<double, 3> &>);
+
+    auto plus = [](double x, double y) { return x + y; };
+    double expected = std::accumulate(b.data(), b.data() + b.size(), 1.0);
+    EXPECT_DOUBLE_EQ(reduce(b, 1.0, plus), expected);
+    EXPECT_DOUBLE_EQ(reduce(matrix_execution::par, b, 1.0, plus), expected);
+    auto max = [](double x, double y) { return std::max(x, y); };
+    EXPECT_DOUBLE_EQ(reduce(matrix_execution::par, b(Slice(0, 64),
+                                                     Slice(0, 32),
+                                                     Slice(0, 40)),
+                            -1.0, max),
+                     100.0);
+    Thread_pool::configure(1);
+}
+
+TEST(MATRIX_COPY_TEST, materialize_views) {
+    Matrix<int, 4> t(3, 4, 5, 6);
+    for (std::size_t i = 0; i < t.size(); ++i) {
+        t.data()[i] = int(i);
+    }
+    // interior slice: only the outer two dimensions are partial
+    Matrix<int, 4> inner(t(Slice(1, 3), Slice(1, 3), Slice(0, 5), Slice(0, 6)));
+    EXPECT_EQ(inner.size(), 2 * 2 * 5 * 6);
+    EXPECT_EQ(inner(1, 0, 4, 5), t(2, 1, 4, 5));
+
+    // column of a 2-D matrix: a single strided run
+    Matrix<double, 2> m(50, 7);
+    for (std::size_t i = 0; i < m.size(); ++i) {
+        m.data()[i] = double(i);
+    }
+    Matrix<double, 1> col(m.col(3));
+    EXPECT_EQ(col.size(), 50);
+    for (std::size_t i = 0; i < 50; ++i) {
+        EXPECT_DOUBLE_EQ(col(i), m(i, 3));
+    }
+
+    // element type conversion from a read-only view
+    const Matrix<int, 4> &ct = t;
+    Matrix<double, 3> converted(ct.row(2));
+    EXPECT_DOUBLE_EQ(converted(3, 4, 5), double(t(2, 3, 4, 5)));
+
+    // assigning a view of the matrix itself
+    m = m(Slice(10, 20), Slice(2, 5));
+    EXPECT_EQ(m.extent(0), 10);
+    EXPECT_DOUBLE_EQ(m(9, 2), double(19 * 7 + 4));
+}
+
+TEST(MATRIX_COPY_TEST, transposing_copy) {
+    Matrix<float, 2> m(70, 45);
+    for (std::size_t i = 0; i < m.size(); ++i) {
+        m.data()[i] = float(i);
+    }
+    // a column-major view of m: unit stride along the outer dimension
+    Matrix_slice<2> desc;
+    desc.start = 0;
+    desc.extents = {45, 70};
+    desc.strides = {1, 45};
+    desc.size = 45 * 70;
+    Matrix<float, 2> t(Matrix_ref<float, 2>(desc, m.data()));
+    for (std::size_t i = 0; i < 45; ++i) {
+        for (std::size_t j = 0; j < 70; ++j) {
+            EXPECT_FLOAT_EQ(t(i, j), m(j, i));
+        }
+    }
+}
+
+TEST(MATRIX_ALLOCATOR_TEST, aligned_storage) {
+    Matrix<float, 2> m(3, 5);
+    Matrix<double, 1> v(std::array<std::size_t, 1>{7});
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(m.data()) % matrix_alignment,
+              0);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(v.data()) % matrix_alignment,
+              0);
+    Matrix<float, 2> copy(m);
+    EXPECT_EQ(
+        reinterpret_cast<std::uintptr_t>(copy.data()) % matrix_alignment, 0);
+}
+
+TEST(MATRIX_ALLOCATOR_TEST, arena_matrices) {
+    using Arena_matrix = Matrix<double, 2, Arena_allocator<double>>;
+    Monotonic_arena arena(1 << 12);
+    Arena_allocator<double> alloc(arena);
+    std::size_t capacity = 0;
+    for (int round = 0; round < 3; ++round) {
+        {
+            Arena_matrix a({8, 8}, alloc);
+            Arena_matrix b(a(Slice(0, 4), Slice(0, 8)), alloc);
+            for (std::size_t i = 0; i < a.size(); ++i) {
+                a.data()[i] = double(i);
+            }
+            b = a + a; // a new shape: storage comes from the same arena
+            a += b;
+            EXPECT_EQ(b.get_allocator(), alloc);
+            EXPECT_DOUBLE_EQ(a(7, 7), 3.0 * 63);
+            EXPECT_EQ(
+                reinterpret_cast<std::uintptr_t>(b.data()) % matrix_alignment,
+                0);
+            // larger than a block
+            Arena_matrix big({40, 40}, alloc);
+            EXPECT_DOUBLE_EQ(big(39, 39), 0.0);
+            // extents as arguments, after the allocator
+            Arena_matrix wide(alloc, 3, 50);
+            EXPECT_EQ(wide.get_allocator(), alloc);
+            EXPECT_EQ(wide.extent(1), 50u);
+            EXPECT_DOUBLE_EQ(wide(2, 49), 0.0);
+        }
+        arena.release();
+        // after the first round every allocation reuses the same blocks
+        if (round == 0) {
+            capacity = arena.capacity();
+        }
+        EXPECT_EQ(arena.capacity(), capacity);
+    }
+}
+
+TEST(MATRIX_FIXED_TEST, constexpr_indexing) {
+    using M = Fixed_matrix<int, 2, 3, 4>;
+    static_assert(M::strides == std::array<std::size_t, 3>{12, 4, 1});
+    static_assert(M::offset(1, 2, 3) == 23);
+    constexpr Fixed_matrix<int, 2, 3> m{{1, 2, 3}, {4, 5, 6}};
+    static_assert(m(1, 2) == 6);
+    static_assert(sizeof(Fixed_matrix<float, 4, 4>) == 16 * sizeof(float));
+
+    // views and rows share the inline storage
+    Fixed_matrix<double, 3, 4> f;
+    Matrix_ref<double, 2> r = f;
+    r.pointer()[r.descriptor().start + 5] = 7.0;
+    EXPECT_DOUBLE_EQ(f(1, 1), 7.0);
+    EXPECT_DOUBLE_EQ(f.row(1).pointer()[f.row(1).descriptor().start + 1],
+                     7.0);
+}
+
+TEST(MATRIX_FIXED_TEST, initializer_shape_is_checked) {
+    using M = Fixed_matrix<int, 2, 3>;
+    EXPECT_THROW((M{{1, 2, 3}, {4, 5, 6}, {7, 8, 9}}), std::invalid_argument);
+    EXPECT_THROW((M{{1, 2, 3}, {4, 5, 6, 7}}), std::invalid_argument);
+    EXPECT_THROW((M{{1, 2, 3}, {4, 5}}), std::invalid_argument);
+    EXPECT_THROW((Fixed_matrix<int, 2>{1, 2, 3}), std::invalid_argument);
+    EXPECT_NO_THROW((M{{1, 2, 3}, {4, 5, 6}}));
+}
+
+TEST(MATRIX_FIXED_TEST, interoperates_with_matrix) {
+    Fixed_matrix<double, 3, 3> rot{{0, -1, 0}, {1, 0, 0}, {0, 0, 1}};
+    Fixed_matrix<double, 3, 3> twice = rot * 2.0;
+    EXPECT_DOUBLE_EQ(twice(0, 1), -2.0);
+
+    // to and from the dynamic Matrix
+    Matrix<double, 2> d(twice);
+    EXPECT_EQ(d.extent(0), 3);
+    EXPECT_DOUBLE_EQ(d(1, 0), 2.0);
+    Fixed_matrix<double, 3, 3> back(d);
+    EXPECT_TRUE(back == twice);
+
+    // mixed operands in expressions and products
+    Matrix<double, 2> sum = d + rot;
+    EXPECT_DOUBLE_EQ(sum(1, 0), 3.0);
+    Matrix<double, 2> prod = rot * rot;
+    EXPECT_DOUBLE_EQ(prod(0, 0), -1.0);
+    EXPECT_DOUBLE_EQ(prod(2, 2), 1.0);
+    Matrix<double, 2> pts = iota_matrix<double>(3, 5);
+    Matrix<double, 2> rotated = matmul(rot, pts);
+    EXPECT_DOUBLE_EQ(rotated(0, 4), -pts(1, 4));
+}
+
+TEST(MATRIX_ITERATOR_TEST, strided_views) {
+    Matrix<int, 3> t(4, 5, 6);
+    std::iota(t.begin(), t.end(), 0);
+    auto v = t(Slice(1, 3), Slice(0, 5), Slice(2, 5));
+    static_assert(std::is_same_v<
+                  std::iterator_traits<decltype(v.begin())>::iterator_category,
+                  std::forward_iterator_tag>);
+
+    // row-major order through the strides, with carries between rows
+    std::vector<int> expected;
+    for (std::size_t i = 1; i < 3; ++i) {
+        for (std::size_t j = 0; j < 5; ++j) {
+            for (std::size_t k = 2; k < 5; ++k) {
+                expected.push_back(t(i, j, k));
+            }
+        }
+    }
+    std::vector<int> seen(v.begin(), v.end());
+    EXPECT_EQ(seen, expected);
+    EXPECT_EQ(std::distance(v.begin(), v.end()), v.size());
+
+    // writes go through to the matrix
+    std::fill(v.begin(), v.end(), -1);
+    EXPECT_EQ(std::count(t.begin(), t.end(), -1), 30);
+    EXPECT_EQ(t(2, 4, 4), -1);
+    EXPECT_EQ(t(2, 4, 5), 2 * 30 + 4 * 6 + 5);
+
+    // one run per (i, j), each three elements long
+    std::size_t runs = 0;
+    v.for_each_run([&](int *first, std::size_t n, std::size_t stride) {
+        EXPECT_EQ(n, 3);
+        EXPECT_EQ(stride, 1);
+        EXPECT_EQ(first[0], -1);
+        ++runs;
+    });
+    EXPECT_EQ(runs, 10);
+    EXPECT_FALSE(v.is_contiguous());
+
+    // the pointer stays on the view's elements, even where a row's last
+    // element plus a stride lies past the end of the storage
+    Matrix<int, 2> s(3, 4);
+    std::iota(s.begin(), s.end(), 0);
+    auto by_column = transpose(s);
+    auto it = by_column.begin();
+    for (int expect : {0, 4, 8, 1, 5, 9, 2, 6, 10, 3, 7}) {
+        EXPECT_EQ(*it++, expect);
+    }
+    EXPECT_EQ(&*it, s.data() + 11);
+    EXPECT_EQ(++it, by_column.end());
+    EXPECT_EQ(it.operator->(), by_column.end().operator->());
+}
+
+TEST(MATRIX_ITERATOR_TEST, contiguous_views) {
+    Matrix<double, 2> m(6, 4);
+    std::iota(m.begin(), m.end(), 0.0);
+    // whole rows are contiguous, and merge into a single run
+    Matrix_ref<double, 2> rows = m(Slice(2, 5), Slice(0, 4));
+    EXPECT_TRUE(rows.is_contiguous());
+    std::size_t runs = 0;
+    rows.for_each_run([&](double *first, std::size_t n, std::size_t stride) {
+        EXPECT_EQ(first, m.data() + 8);
+        EXPECT_EQ(n, 12);
+        EXPECT_EQ(stride, 1);
+        ++runs;
+    });
+    EXPECT_EQ(runs, 1);
+
+    // ... so they can be handed to random-access algorithms as a span
+    auto span = rows.as_span();
+    std::sort(span.begin(), span.end(), std::greater<>{});
+    EXPECT_DOUBLE_EQ(m(2, 0), 19.0);
+    EXPECT_DOUBLE_EQ(m(4, 3), 8.0);
+
+    // a column is a single strided run
+    Matrix_ref<const double, 1> col = m.col(1);
+    EXPECT_FALSE(col.is_contiguous());
+    col.for_each_run([&](const double *, std::size_t n, std::size_t stride) {
+        EXPECT_EQ(n, 6);
+        EXPECT_EQ(stride, 4);
+    });
+    EXPECT_DOUBLE_EQ(std::accumulate(col.begin(), col.end(), 0.0),
+                     1 + 5 + 18 + 14 + 10 + 21);
+}
+
+TEST(MATRIX_ACCESS_TEST, checked_and_unchecked) {
+    Matrix<int, 3> m(2, 3, 4);
+    std::iota(m.begin(), m.end(), 0);
+    const Matrix<int, 3> &cm = m;
+    static_assert(std::is_same_v<decltype(cm(1, 2, 3)), const int &>);
+    static_assert(std::is_same_v<decltype(cm.at(1, 2, 3)), const int &>);
+    EXPECT_EQ(cm(1, 2, 3), 23);
+    EXPECT_EQ(m.unchecked(1, 0, 2), 14);
+    EXPECT_EQ(&m.at(0, 2, 1), m.data() + 9);
+    EXPECT_THROW(m.at(2, 0, 0), std::out_of_range);
+    EXPECT_THROW(cm.at(0, 3, 0), std::out_of_range);
+    EXPECT_THROW(m.at(0, 0, -1), std::out_of_range);
+
+    Matrix<double, 1> v{1, 2, 3};
+    EXPECT_DOUBLE_EQ(v.at(2), 3.0);
+    EXPECT_THROW(v.at(3), std::out_of_range);
+
+    // a slice descriptor includes its start offset
+    Matrix_slice<2> desc;
+    desc.start = 5;
+    desc.strides = {10, 2};
+    EXPECT_EQ(desc(3, 4), 5 + 30 + 8);
+    static_assert(Fixed_matrix<float, 4, 4>().at(3, 3) == 0.0F);
+}
+
+TEST(MATRIX_TRANSPOSE_TEST, views_and_copies) {
+    Matrix<double, 2> m(37, 53);
+    std::iota(m.begin(), m.end(), 0.0);
+    auto tv = transpose(m);
+    EXPECT_EQ(tv.extent(0), 53);
+    EXPECT_EQ(tv.extent(1), 37);
+    EXPECT_EQ(tv.pointer(), m.data());
+
+    Matrix<double, 2> t(tv);
+    const Matrix_ref<const double, 2> md = m;
+    const Matrix<float, 2> mf(md);
+    Matrix<float, 2> tf(transpose(mf));
+    for (std::size_t i = 0; i < 53; ++i) {
+        for (std::size_t j = 0; j < 37; ++j) {
+            EXPECT_DOUBLE_EQ(t(i, j), m(j, i));
+            EXPECT_FLOAT_EQ(tf(i, j), float(m(j, i)));
+        }
+    }
+
+    // the permuted view walks the original elements
+    Matrix<int, 3> c(2, 3, 4);
+    std::iota(c.begin(), c.end(), 0);
+    auto p = permute_axes<2, 0, 1>(c);
+    EXPECT_EQ(p.extent(0), 4);
+    EXPECT_EQ(p.extent(2), 3);
+    Matrix<int, 3> pm(p);
+    EXPECT_EQ(pm(3, 1, 2), c(1, 2, 3));
+}
+
+TEST(MATRIX_TRANSPOSE_TEST, in_place_and_layouts) {
+    for (std::size_t n : {5, 32, 75}) {
+        Matrix<float, 2> a(n, n);
+        std::iota(a.begin(), a.end(), 0.0F);
+        const Matrix<float, 2> before = a;
+        transpose_in_place(a);
+        for (std::size_t i = 0; i < n; ++i) {
+            for (std::size_t j = 0; j < n; ++j) {
+                EXPECT_FLOAT_EQ(a(i, j), before(j, i));
+            }
+        }
+    }
+    // a square block of a larger matrix, and a non-square matrix
+    Matrix<double, 2> b(40, 50);
+    std::iota(b.begin(), b.end(), 0.0);
+    transpose_in_place(b(Slice(3, 39), Slice(10, 46)));
+    EXPECT_DOUBLE_EQ(b(3 + 4, 10 + 30), double((3 + 30) * 50 + 10 + 4));
+    EXPECT_DOUBLE_EQ(b(2, 10), 2.0 * 50 + 10);
+    transpose_in_place(b);
+    EXPECT_EQ(b.extent(0), 50);
+    EXPECT_DOUBLE_EQ(b(49, 0), 49.0);
+
+    Matrix<float, 4> nchw(2, 3, 17, 19);
+    std::iota(nchw.begin(), nchw.end(), 0.0F);
+    Matrix<float, 4> nhwc = nchw_to_nhwc(nchw);
+    EXPECT_EQ(nhwc.extent(3), 3);
+    EXPECT_FLOAT_EQ(nhwc(1, 16, 5, 2), nchw(1, 2, 16, 5));
+    Matrix<float, 4> back = nhwc_to_nchw(matrix_execution::par, nhwc);
+    EXPECT_TRUE(std::equal(back.begin(), back.end(), nchw.begin()));
+}
+
+TEST(MATRIX_NPY_TEST, save_load_and_map) {
+    const std::string path = testing::TempDir() + "matrix_npy_test.npy";
+    Matrix<double, 3> a(4, 5, 6);
+    std::iota(a.begin(), a.end(), 0.0);
+    save_npy(path, a);
+    Matrix<double, 3> b = load_npy<double, 3>(path);
+    EXPECT_EQ(b.descriptor().extents, a.descriptor().extents);
+    EXPECT_TRUE(std::equal(b.begin(), b.end(), a.begin()));
+    EXPECT_THROW((load_npy<float, 3>(path)), std::runtime_error);
+    EXPECT_THROW((load_npy<double, 2>(path)), std::runtime_error);
+
+    // a strided view is written in C order
+    Matrix<int, 2> c(9, 7);
+    std::iota(c.begin(), c.end(), 0);
+    save_npy(path, transpose(c));
+    Matrix<int, 2> t = load_npy<int, 2>(path);
+    EXPECT_EQ(t.extent(0), 7);
+    EXPECT_EQ(t(6, 8), c(8, 6));
+
+    Mapped_matrix<int, 2> m = map_npy<int, 2>(path, Access::sequential);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(m.data()) % 64, 0);
+    Matrix<int, 2> copied(m);
+    EXPECT_TRUE(std::equal(copied.begin(), copied.end(), t.begin()));
+    m.advise(Access::random);
+    EXPECT_EQ(*std::next(m.view().begin(), 3 * 9 + 4), t(3, 4));
+}
+
+TEST(MATRIX_NPY_TEST, foreign_headers) {
+    // keys in another order, 16-byte padding as older writers used, and a
+    // one-dimensional shape with its trailing comma
+    const std::string path = testing::TempDir() + "matrix_npy_foreign.npy";
+    std::string dict = "{'shape': (3,), 'fortran_order': False, "
+                       "'descr': '<i4'}";
+    dict.append(80 - 10 - dict.size() - 1, ' ');
+    dict += '\n';
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write("\x93NUMPY\x01\x00", 8);
+        out.put(static_cast<char>(dict.size()));
+        out.put(0);
+        out << dict;
+        const std::int32_t data[] = {7, -8, 9};
+        out.write(reinterpret_cast<const char *>(data), sizeof(data));
+    }
+    Matrix<std::int32_t, 1> v = load_npy<std::int32_t, 1>(path);
+    ASSERT_EQ(v.size(), 3);
+    EXPECT_EQ(v(1), -8);
+    const auto mapped = map_npy<std::int32_t, 1>(path);
+    EXPECT_EQ(mapped.data()[2], 9);
+
+    // Fortran order and truncated data are rejected
+    std::string fortran = dict;
+    fortran.replace(fortran.find("False"), 5, "True ");
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write("\x93NUMPY\x01\x00", 8);
+        out.put(static_cast<char>(fortran.size()));
+        out.put(0);
+        out << fortran;
+    }
+    EXPECT_THROW((load_npy<std::int32_t, 1>(path)), std::runtime_error);
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write("\x93NUMPY\x01\x00", 8);
+        out.put(static_cast<char>(dict.size()));
+        out.put(0);
+        out << dict;
+    }
+    EXPECT_THROW((load_npy<std::int32_t, 1>(path)), std::runtime_error);
+    EXPECT_THROW((map_npy<std::int32_t, 1>(path)), std::runtime_error);
+}
+
+TEST(MATRIX_CHUNKED_TEST, streamed_and_partial_reads) {
+    const std::string path = testing::TempDir() + "matrix_chunked_test.mdc";
+    Matrix<float, 2> a = iota_matrix<float>(100, 70);
+    {
+        Chunked_writer<float, 2> w(path, {100, 70}, {16, 16},
+                                   Chunk_codec::shuffle_lz);
+        for (std::size_t r = 0; r < 100; r += 32) {
+            const std::size_t n = std::min<std::size_t>(32, 100 - r);
+            w.append(a(Slice(r, r + n), Slice(0, 70)));
+        }
+    }
+    Chunked_file<float, 2> f(path);
+    EXPECT_EQ(f.extents()[0], 100);
+    Matrix<float, 2> all = f.read();
+    EXPECT_TRUE(std::equal(all.begin(), all.end(), a.begin()));
+    const std::size_t full = f.bytes_read();
+
+    // a box inside one chunk row touches only those chunks
+    Chunked_file<float, 2> g(path);
+    Matrix<float, 2> part = g.read(Slice(35, 47), Slice(20, 70));
+    EXPECT_EQ(part.extent(0), 12);
+    EXPECT_EQ(part.extent(1), 50);
+    EXPECT_FLOAT_EQ(part(0, 0), a(35, 20));
+    EXPECT_FLOAT_EQ(part(11, 49), a(46, 69));
+    EXPECT_LT(g.bytes_read(), full / 4);
+    Matrix<float, 2> row = g.read(99, Slice(0, 70));
+    EXPECT_FLOAT_EQ(row(0, 69), a(99, 69));
+    EXPECT_EQ(g.read_chunk({6, 4}).extent(1), 6);
+}
+
+TEST(MATRIX_CHUNKED_TEST, codecs) {
+    const std::string path = testing::TempDir() + "matrix_chunked_codec.mdc";
+    Matrix<std::int64_t, 3> a(8, 40, 50);
+    std::iota(a.begin(), a.end(), std::int64_t{1000000});
+    std::size_t sizes[3];
+    for (auto codec : {Chunk_codec::none, Chunk_codec::shuffle_lz,
+                       Chunk_codec::delta_shuffle_lz}) {
+        {
+            Chunked_writer<std::int64_t, 3> w(path, {8, 40, 50}, {4, 16, 32},
+                                              codec);
+            w.append(a);
+        }
+        Chunked_file<std::int64_t, 3> f(path);
+        Matrix<std::int64_t, 3> b = f.read();
+        EXPECT_TRUE(std::equal(b.begin(), b.end(), a.begin()));
+        sizes[static_cast<int>(codec)] = f.bytes_read();
+    }
+    EXPECT_EQ(sizes[0], a.size() * sizeof(std::int64_t));
+    EXPECT_LT(sizes[1], sizes[0]);
+    EXPECT_LT(sizes[2] * 20, sizes[0]);
+    EXPECT_THROW((Chunked_file<double, 3>(path)), std::runtime_error);
+
+    // chunks written out of order, and one never written
+    Matrix<double, 2> c = iota_matrix<double>(10, 10);
+    {
+        Chunked_writer<double, 2> w(path, {10, 10}, {5, 5},
+                                    Chunk_codec::shuffle_lz);
+        w.write_chunk({1, 1}, c(Slice(5, 10), Slice(5, 10)));
+        w.write_chunk({0, 0}, c(Slice(0, 5), Slice(0, 5)));
+        w.write_chunk({0, 1}, c(Slice(0, 5), Slice(5, 10)));
+    }
+    Matrix<double, 2> d = Chunked_file<double, 2>(path).read();
+    EXPECT_DOUBLE_EQ(d(7, 8), c(7, 8));
+    EXPECT_DOUBLE_EQ(d(2, 3), c(2, 3));
+    EXPECT_DOUBLE_EQ(d(7, 3), 0.0);
+}
+
+TEST(MATRIX_OUT_OF_CORE_TEST, tiled_gemm_and_reductions) {
+    const std::string dir = testing::TempDir();
+    Matrix<double, 2> a = iota_matrix<double>(300, 200);
+    Matrix<double, 2> b = iota_matrix<double>(200, 250);
+    apply(a, [](double &x) { x = std::sin(x); });
+    apply(b, [](double &x) { x = std::cos(x); });
+    {
+        Chunked_writer<double, 2> wa(dir + "ooc_a.mdc", {300, 200}, {64, 64});
+        wa.append(a);
+        Chunked_writer<double, 2> wb(dir + "ooc_b.mdc", {200, 250}, {64, 64});
+        wb.append(b);
+    }
+    Chunked_file<double, 2> fa(dir + "ooc_a.mdc");
+    Chunked_file<double, 2> fb(dir + "ooc_b.mdc");
+    Out_of_core_stats stats;
+    Out_of_core_options options;
+    options.memory_budget = 200 << 10; // 64 x 64 tiles
+    options.stats = &stats;
+    matmul_out_of_core(fa, fb, dir + "ooc_c.mdc", options);
+    EXPECT_GT(stats.bytes_read, (300 * 200 + 200 * 250) * sizeof(double));
+
+    Chunked_file<double, 2> fc(dir + "ooc_c.mdc");
+    EXPECT_EQ(fc.chunk_extents()[0], 64);
+    const Matrix<double, 2> c = fc.read();
+    const Matrix<double, 2> expected = matmul(a, b);
+    for (std::size_t i = 0; i < 300; ++i) {
+        for (std::size_t j = 0; j < 250; ++j) {
+            EXPECT_NEAR(c(i, j), expected(i, j), 1e-9);
+        }
+    }
+
+    const double total = reduce_out_of_core(fa, 0.0, std::plus<>{}, options);
+    EXPECT_NEAR(total, reduce(a, 0.0, std::plus<>{}), 1e-9);
+    const Matrix<double, 1> cols =
+        reduce_axis_out_of_core(fa, 0, 0.0, std::plus<>{}, options);
+    const Matrix<double, 1> rows = reduce_axis_out_of_core(
+        fa, 1, -1e300, [](double x, double y) { return std::max(x, y); });
+    ASSERT_EQ(cols.size(), 200);
+    ASSERT_EQ(rows.size(), 300);
+    double col7 = 0.0;
+    for (std::size_t i = 0; i < 300; ++i) {
+        col7 += a(i, 7);
+    }
+    EXPECT_NEAR(cols(7), col7, 1e-12);
+    EXPECT_DOUBLE_EQ(rows(123),
+                     *std::max_element(&a(123, 0), &a(123, 0) + 200));
+}
+
+TEST(MATRIX_FORMAT_TEST, text_and_summaries) {
+    Matrix<double, 2> a{{1.0, 2.5}, {-3.25, 1.0 / 3.0}};
+    std::ostringstream os;
+    os << a;
+    EXPECT_EQ(os.str(), "[[1, 2.5],\n [-3.25, 0.333333]]");
+    Format_options options;
+    options.precision = 3;
+    EXPECT_EQ(format_matrix(a, options), "[[1, 2.5],\n [-3.25, 0.333]]");
+    Matrix<int, 1> v{4, 5, 6};
+    EXPECT_EQ(format_matrix(v), "[4, 5, 6]");
+
+    // only the corners of a big matrix, including through a view
+    Matrix<int, 3> big(10, 20, 30);
+    std::iota(big.begin(), big.end(), 0);
+    options.edge_items = 1;
+    const std::string text = format_matrix(big, options);
+    EXPECT_EQ(text, "[[[0, ..., 29],\n  ...,\n  [570, ..., 599]],\n\n"
+                    " ...,\n\n"
+                    " [[5400, ..., 5429],\n  ...,\n  [5970, ..., 5999]]]");
+    EXPECT_EQ(format_matrix(transpose(a)), "[[1, -3.25],\n [2.5, 0.333333]]");
+
+    // no entries kept: only the ellipsis
+    Matrix<double, 1> w{1.0, 2.0, 3.0};
+    options.threshold = 0;
+    options.edge_items = 0;
+    EXPECT_EQ(format_matrix(w, options), "[...]");
+    EXPECT_EQ(format_matrix(big, options), "[...]");
+}
+
+TEST(MATRIX_FORMAT_TEST, stream_flags) {
+    Matrix<double, 1> a{1.0, 2.5};
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(2) << a;
+    EXPECT_EQ(os.str(), "[1.00, 2.50]");
+    os.str("");
+    os << std::scientific << std::showpos << a;
+    EXPECT_EQ(os.str(), "[+1.00e+00, +2.50e+00]");
+
+    Matrix<int, 2> b{{10, 255}, {-1, 16}};
+    os = std::ostringstream();
+    os << std::hex << b;
+    EXPECT_EQ(os.str(), "[[a, ff],\n [ffffffff, 10]]");
+    // the width pads the first thing written, the bracket
+    os = std::ostringstream();
+    os << std::setw(3) << Matrix<int, 1>{10, 255} << ' ' << 7;
+    EXPECT_EQ(os.str(), "  [10, 255] 7");
+}
+
+TEST(MATRIX_FORMAT_TEST, binary_round_trip) {
+    Matrix<float, 3> a(3, 4, 5);
+    std::iota(a.begin(), a.end(), 0.5F);
+    Matrix<std::int16_t, 2> b = iota_matrix<std::int16_t>(6, 7);
+    std::stringstream s;
+    write_binary(s, a);
+    write_binary(s, transpose(b));
+    const Matrix<float, 3> a2 = read_binary<float, 3>(s);
+    const Matrix<std::int16_t, 2> bt = read_binary<std::int16_t, 2>(s);
+    EXPECT_TRUE(std::equal(a2.begin(), a2.end(), a.begin()));
+    EXPECT_EQ(bt.extent(0), 7);
+    EXPECT_EQ(bt(6, 5), b(5, 6));
+
+    std::stringstream t;
+    write_binary(t, a);
+    EXPECT_THROW((read_binary<double, 3>(t)), std::runtime_error);
+    std::stringstream u(s.str().substr(0, 100));
+    EXPECT_THROW((read_binary<float, 3>(u)), std::runtime_error);
+}
+
+TEST(MATRIX_REDUCE_TEST, statistics_along_axes) {
+    Matrix<double, 3> a(5, 6, 7);
+    double x = 0.3;
+    for (double &e : a) {
+        e = std::sin(x += 1.1);
+    }
+    a(2, 4, 1) = 5.0;
+    a(3, 0, 6) = -5.0;
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+        const Matrix<double, 2> s = sum(a, axis);
+        const Matrix<double, 2> hi = max(a, axis);
+        const Matrix<std::size_t, 2> lo =
+            argmin(matrix_execution::par, a, axis);
+        const Matrix<double, 2> n2 = norm2(a, axis);
+        for (std::size_t i = 0; i < s.extent(0); ++i) {
+            for (std::size_t j = 0; j < s.extent(1); ++j) {
+                double ref = 0.0;
+                double sq = 0.0;
+                double big = -1e300;
+                double small = 1e300;
+                std::size_t at = 0;
+                for (std::size_t k = 0; k < a.extent(axis); ++k) {
+                    const double e = axis == 0   ? a(k, i, j)
+                                     : axis == 1 ? a(i, k, j)
+                                                 : a(i, j, k);
+                    ref += e;
+                    sq += e * e;
+                    big = std::max(big, e);
+                    if (e < small) {
+                        small = e;
+                        at = k;
+                    }
+                }
+                EXPECT_NEAR(s(i, j), ref, 1e-12);
+                EXPECT_NEAR(n2(i, j), std::sqrt(sq), 1e-12);
+                EXPECT_EQ(hi(i, j), big);
+                EXPECT_EQ(lo(i, j), at);
+            }
+        }
+    }
+    EXPECT_EQ(max(a), 5.0);
+    EXPECT_EQ(min(a), -5.0);
+    EXPECT_EQ(argmax(a), (std::array<std::size_t, 3>{2, 4, 1}));
+    EXPECT_EQ(argmin(a), (std::array<std::size_t, 3>{3, 0, 6}));
+    EXPECT_NEAR(mean(a), sum(a) / 210.0, 1e-15);
+
+    // a strided view, and integers
+    Matrix<int, 2> b(9, 11);
+    std::iota(b.begin(), b.end(), 0);
+    const auto t = transpose(b);
+    const Matrix<int, 1> cols = sum(t, 1);
+    EXPECT_EQ(cols(3), 9 * 3 + 11 * (0 + 1 + 2 + 3 + 4 + 5 + 6 + 7 + 8));
+    EXPECT_EQ(sum(b), 98 * 99 / 2);
+    EXPECT_DOUBLE_EQ(mean(b, 1)(0), 5.0);
+    EXPECT_EQ(argmax(t, 0)(4), 10);
+    Matrix<int, 1> v{3, 9, 2, 9};
+    EXPECT_EQ(argmax(v, 0)(), 1);
+}
+
+TEST(MATRIX_REDUCE_TEST, reproducible_and_accurate) {
+    // many terms of very different size: naive float accumulation drifts
+    Matrix<float, 2> a(512, 1000);
+    float x = 0.0F;
+    for (float &e : a) {
+        e = 1.0F + std::sin(x += 0.37F) * 1e-3F;
+    }
+    double exact = 0.0;
+    for (float e : a) {
+        exact += e;
+    }
+    const float s = sum(a);
+    EXPECT_NEAR(s, exact, exact * 1e-6);
+    EXPECT_EQ(sum(matrix_execution::par, a), s);
+    const Matrix<float, 1> cols = sum(a, 0);
+    const Matrix<float, 1> cols_par = sum(matrix_execution::par, a, 0);
+    EXPECT_TRUE(std::equal(cols.begin(), cols.end(), cols_par.begin()));
+    double col0 = 0.0;
+    for (std::size_t i = 0; i < 512; ++i) {
+        col0 += a(i, 0);
+    }
+    EXPECT_NEAR(cols(0), col0, col0 * 1e-6);
+    const Matrix<float, 1> rows = sum(matrix_execution::par, a, 1);
+    EXPECT_EQ(rows(7), sum(a.row(7)));
+}
+
+TEST(MATRIX_BROADCAST_TEST, views_and_extents) {
+    Matrix<int, 2> col(3, 1);
+    std::iota(col.begin(), col.end(), 1);
+    auto b = broadcast_to(col, {2, 3, 4});
+    EXPECT_EQ(b.descriptor().strides[0], 0);
+    EXPECT_EQ(b.descriptor().strides[2], 0);
+    EXPECT_EQ(b.size(), 24);
+    std::vector<int> seen(b.begin(), b.end());
+    for (std::size_t i = 0; i < seen.size(); ++i) {
+        EXPECT_EQ(seen[i], int(i / 4 % 3) + 1);
+    }
+    Matrix<int, 3> expanded(b);
+    EXPECT_EQ(expanded(1, 2, 3), 3);
+    EXPECT_EQ(sum(b), 2 * 4 * (1 + 2 + 3));
+
+    const auto e = broadcast_extents(std::array<std::size_t, 3>{5, 1, 4},
+                                     std::array<std::size_t, 2>{3, 1});
+    EXPECT_EQ(e, (std::array<std::size_t, 3>{5, 3, 4}));
+    EXPECT_TRUE(is_broadcastable(std::array<std::size_t, 1>{1},
+                                 std::array<std::size_t, 2>{7, 9}));
+    EXPECT_FALSE(is_broadcastable(std::array<std::size_t, 2>{2, 3},
+                                  std::array<std::size_t, 2>{4, 3}));
+    EXPECT_THROW(broadcast_to(col, {3}), std::invalid_argument);
+    EXPECT_THROW(broadcast_to(col, {2, 4}), std::invalid_argument);
+    EXPECT_THROW(broadcast_extents(std::array<std::size_t, 1>{2},
+                                   std::array<std::size_t, 1>{3}),
+                 std::invalid_argument);
+}
+
+TEST(MATRIX_BROADCAST_TEST, bias_and_channel_scale) {
+    // odd extents leave scalar tails after the packed part of each run
+    Matrix<float, 2> x(13, 37);
+    std::iota(x.begin(), x.end(), 0.0F);
+    Matrix<float, 1> bias(std::array<std::size_t, 1>{37});
+    std::iota(bias.begin(), bias.end(), 100.0F);
+    Matrix<float, 2> y = x + broadcast_to(bias, x.descriptor().extents);
+    for (std::size_t i = 0; i < 13; ++i) {
+        for (std::size_t j = 0; j < 37; ++j) {
+            EXPECT_FLOAT_EQ(y(i, j), x(i, j) + bias(j));
+        }
+    }
+
+    Matrix<double, 4> images(2, 5, 7, 9);
+    std::iota(images.begin(), images.end(), 1.0);
+    Matrix<double, 3> scale(5, 1, 1);
+    std::iota(scale.begin(), scale.end(), 2.0);
+    const auto s = broadcast_to(scale, images.descriptor().extents);
+    Matrix<double, 4> z = multiply(images, s) - s;
+    Matrix<double, 4> zp(matrix_execution::par, divide(images, s));
+    for (std::size_t n = 0; n < 2; ++n) {
+        for (std::size_t c = 0; c < 5; ++c) {
+            for (std::size_t h = 0; h < 7; ++h) {
+                for (std::size_t w = 0; w < 9; ++w) {
+                    const double v = images(n, c, h, w);
+                    EXPECT_DOUBLE_EQ(z(n, c, h, w), v * (c + 2.0) - (c + 2.0));
+                    EXPECT_DOUBLE_EQ(zp(n, c, h, w), v / (c + 2.0));
+                }
+            }
+        }
+    }
+
+    // a broadcast view of the destination itself is read before it changes
+    y = y + broadcast_to(y.row(0), y.descriptor().extents);
+    EXPECT_FLOAT_EQ(y(0, 5), 2 * (x(0, 5) + bias(5)));
+    EXPECT_FLOAT_EQ(y(12, 5), x(12, 5) + bias(5) + x(0, 5) + bias(5));
+}
+
+TEST(MATRIX_SPARSE_TEST, builder_and_conversions) {
+    // out of order, with a duplicate and an explicit zero
+    Coo_builder<double> b(4, 5);
+    b.add(2, 4, 1.5);
+    b.add(0, 1, 2.0);
+    b.add(3, 0, -1.0);
+    b.add(2, 0, 4.0);
+    b.add(0, 1, 0.5);
+    b.add(1, 3, 0.0);
+    const Csr_matrix<double> a = b.to_csr();
+    EXPECT_EQ(a.nnz(), 5);
+    EXPECT_EQ(std::vector<std::size_t>(a.offsets().begin(), a.offsets().end()),
+              (std::vector<std::size_t>{0, 1, 2, 4, 5}));
+    EXPECT_EQ(a.indices()[2], 0);
+    EXPECT_EQ(a.indices()[3], 4);
+    EXPECT_DOUBLE_EQ(a(0, 1), 2.5);
+    EXPECT_DOUBLE_EQ(a(2, 3), 0.0);
+
+    const Matrix<double, 2> d = a.to_dense();
+    const Csc_matrix<double> c = b.to_csc();
+    const Csc_matrix<double> c2(a);
+    const Csr_matrix<double> a2(c);
+    for (std::size_t i = 0; i < 4; ++i) {
+        for (std::size_t j = 0; j < 5; ++j) {
+            EXPECT_DOUBLE_EQ(c(i, j), d(i, j));
+            EXPECT_DOUBLE_EQ(c2(i, j), d(i, j));
+            EXPECT_DOUBLE_EQ(a2(i, j), d(i, j));
+        }
+    }
+    EXPECT_TRUE(std::equal(c.indices().begin(), c.indices().end(),
+                           c2.indices().begin(), c2.indices().end()));
+
+    // from dense operands, dropping zeros; the transposed view is strided
+    const Csr_matrix<double> from_dense(d);
+    EXPECT_EQ(from_dense.nnz(), 4);
+    const Csc_matrix<double> t(transpose(d));
+    EXPECT_EQ(t.extent(0), 5);
+    EXPECT_DOUBLE_EQ(t(4, 2), 1.5);
+    Matrix<double, 2> big(6, 7);
+    c.to_dense(big(Slice(1, 5), Slice(2, 7)));
+    EXPECT_DOUBLE_EQ(big(3, 6), 1.5);
+    EXPECT_DOUBLE_EQ(big(0, 0), 0.0);
+
+    EXPECT_THROW(Csr_matrix<double>(2, 2, {0, 1, 1}, {2}, {1.0}),
+                 std::invalid_argument);
+    EXPECT_THROW(Csr_matrix<double>(2, 3, {0, 2, 2}, {1, 0}, {1.0, 1.0}),
+                 std::invalid_argument);
+    EXPECT_THROW((Csr_matrix<float, std::uint8_t>(300, 2)),
+                 std::invalid_argument);
+}
+
+TEST(MATRIX_SPARSE_TEST, products_match_dense) {
+    // a few percent nonzeros, with one dense row to unbalance a split by
+    // rows; large enough for the parallel products to be split
+    const std::size_t m = 1500;
+    const std::size_t k = 1200;
+    Coo_builder<double> b(m, k);
+    for (std::size_t e = 0; e < 70000; ++e) {
+        b.add(e * 7919 % m, e * 104729 % k, double(e % 13) - 6.0);
+    }
+    for (std::size_t j = 0; j < k; ++j) {
+        b.add(17, j, 0.25);
+    }
+    const Csr_matrix<double> a = b.to_csr();
+    const Csc_matrix<double> ac = b.to_csc();
+    const Matrix<double, 2> dense = a.to_dense();
+
+    Matrix<double, 2> xs = iota_matrix<double>(k, 3);
+    const auto x = xs.col(1);
+    Matrix<double, 2> bm = iota_matrix<double>(k, 9);
+    const Matrix<double, 2> expected = naive_matmul(dense, bm);
+    // 2 * a * x + 1
+    Matrix<double, 1> dots(std::array<std::size_t, 1>{m});
+    for (std::size_t i = 0; i < m; ++i) {
+        double dot = 0.0;
+        for (std::size_t p = 0; p < k; ++p) {
+            dot += dense(i, p) * xs(p, 1);
+        }
+        dots(i) = 2.0 * dot + 1.0;
+    }
+
+    Thread_pool::configure(3);
+    for (int par = 0; par < 2; ++par) {
+        Matrix<double, 1> y(std::array<std::size_t, 1>{m});
+        Matrix<double, 1> yc(std::array<std::size_t, 1>{m});
+        std::fill(y.begin(), y.end(), 1.0);
+        std::fill(yc.begin(), yc.end(), 1.0);
+        Matrix<double, 2> c(m, 9);
+        Matrix<double, 2> cc(m, 9);
+        if (par != 0) {
+            spmv(matrix_execution::par, 2.0, a, x, 1.0,
+                 Matrix_ref<double, 1>(y));
+            spmv(matrix_execution::par, 2.0, ac, x, 1.0,
+                 Matrix_ref<double, 1>(yc));
+            spmm(matrix_execution::par, 1.0, a, bm, 0.0,
+                 Matrix_ref<double, 2>(c));
+            spmm(matrix_execution::par, 1.0, ac, bm, 0.0,
+                 Matrix_ref<double, 2>(cc));
+        } else {
+            spmv(2.0, a, x, 1.0, Matrix_ref<double, 1>(y));
+            spmv(2.0, ac, x, 1.0, Matrix_ref<double, 1>(yc));
+            c = a * bm;
+            cc = ac * bm;
+        }
+        for (std::size_t i = 0; i < m; ++i) {
+            EXPECT_NEAR(y(i), dots(i), 1e-9);
+            EXPECT_NEAR(yc(i), dots(i), 1e-9);
+            for (std::size_t j = 0; j < 9; ++j) {
+                EXPECT_NEAR(c(i, j), expected(i, j), 1e-9);
+                EXPECT_NEAR(cc(i, j), expected(i, j), 1e-9);
+            }
+        }
+    }
+    const Matrix<double, 1> y = a * x;
+    for (std::size_t i = 0; i < m; ++i) {
+        EXPECT_NEAR(y(i), (dots(i) - 1.0) / 2.0, 1e-9);
+    }
+    Thread_pool::configure(1);
+}
+
+TEST(MATRIX_LINALG_TEST, lu_solve_inverse_det) {
+    const Matrix<double, 2> a{
+        {0.0, 2.0, 1.0}, {1.0, 1.0, 0.0}, {3.0, 0.0, 1.0}};
+    EXPECT_NEAR(det(a), -5.0, 1e-12);
+    const Matrix<double, 1> b{5.0, 3.0, 4.0};
+    const Matrix<double, 1> x = solve(a, b);
+    EXPECT_NEAR(x(0), 1.0, 1e-12);
+    EXPECT_NEAR(x(1), 2.0, 1e-12);
+    EXPECT_NEAR(x(2), 1.0, 1e-12);
+
+    const Matrix<double, 2> inv = inverse(a);
+    const Matrix<double, 2> identity = naive_matmul(a, inv);
+    for (std::size_t i = 0; i < 3; ++i) {
+        for (std::size_t j = 0; j < 3; ++j) {
+            EXPECT_NEAR(identity(i, j), i == j ? 1.0 : 0.0, 1e-12);
+        }
+    }
+
+    const Matrix<double, 2> singular{{1.0, 2.0}, {2.0, 4.0}};
+    EXPECT_EQ(det(singular), 0.0);
+    EXPECT_THROW(solve(singular, Matrix<double, 1>({1.0, 1.0})),
+                 std::runtime_error);
+    const Matrix<double, 2> indefinite{{1.0, 2.0}, {2.0, 1.0}};
+    EXPECT_THROW(cholesky(indefinite), std::runtime_error);
+
+    // large enough for several panels, under both policies
+    const std::size_t n = 150;
+    Matrix<double, 2> big = iota_matrix<double>(n, n);
+    for (std::size_t i = 0; i < n; ++i) {
+        big(i, i) += 40.0;
+    }
+    const Matrix<double, 2> rhs = iota_matrix<double>(n, 7);
+    Thread_pool::configure(3);
+    for (int par = 0; par < 2; ++par) {
+        const Matrix<double, 2> xs =
+            par != 0 ? solve(matrix_execution::par, big, rhs) : solve(big, rhs);
+        const Matrix<double, 2> back = naive_matmul(big, xs);
+        for (std::size_t i = 0; i < n; ++i) {
+            for (std::size_t j = 0; j < 7; ++j) {
+                EXPECT_NEAR(back(i, j), rhs(i, j), 1e-8);
+            }
+        }
+    }
+    Thread_pool::configure(1);
+}
+
+TEST(MATRIX_LINALG_TEST, cholesky_and_qr) {
+    const std::size_t n = 140;
+    const Matrix<double, 2> g = iota_matrix<double>(n, n);
+    Matrix<double, 2> spd = naive_matmul(g, Matrix<double, 2>(transpose(g)));
+    for (std::size_t i = 0; i < n; ++i) {
+        spd(i, i) += double(n);
+    }
+    const Matrix<double, 2> column = iota_matrix<double>(n, 1);
+    const Matrix<double, 1> b(column.col(0));
+
+    Thread_pool::configure(3);
+    for (int par = 0; par < 2; ++par) {
+        const auto c =
+            par != 0 ? cholesky(matrix_execution::par, spd) : cholesky(spd);
+        const Matrix<double, 2> l = c.l();
+        const Matrix<double, 2> llt =
+            naive_matmul(l, Matrix<double, 2>(transpose(l)));
+        for (std::size_t i = 0; i < n; ++i) {
+            EXPECT_EQ(l(i, n - 1), i == n - 1 ? l(i, i) : 0.0);
+            for (std::size_t j = 0; j < n; ++j) {
+                EXPECT_NEAR(llt(i, j), spd(i, j), 1e-8);
+            }
+        }
+        const Matrix<double, 1> x = c.solve(b);
+        const Matrix<double, 1> xl = solve(spd, b);
+        for (std::size_t i = 0; i < n; ++i) {
+            EXPECT_NEAR(x(i), xl(i), 1e-8);
+        }
+
+        // a tall matrix: Q has orthonormal columns, Q R is the matrix
+        const std::size_t m = 200;
+        Matrix<double, 2> a = iota_matrix<double>(m, n);
+        for (std::size_t i = 0; i < n; ++i) {
+            a(i + i * (m - n) / n, i) += 20.0;
+        }
+        const auto f = par != 0 ? qr(matrix_execution::par, a) : qr(a);
+        const Matrix<double, 2> q = f.q();
+        const Matrix<double, 2> r = f.r();
+        const Matrix<double, 2> qr_product = naive_matmul(q, r);
+        const Matrix<double, 2> qtq =
+            naive_matmul(Matrix<double, 2>(transpose(q)), q);
+        for (std::size_t i = 0; i < m; ++i) {
+            for (std::size_t j = 0; j < n; ++j) {
+                EXPECT_NEAR(qr_product(i, j), a(i, j), 1e-8);
+                if (i < n) {
+                    EXPECT_NEAR(qtq(i, j), i == j ? 1.0 : 0.0, 1e-10);
+                    if (j < i) {
+                        EXPECT_EQ(r(i, j), 0.0);
+                    }
+                }
+            }
+        }
+    }
+    Thread_pool::configure(1);
+
+    // least squares: the residual of the solution is orthogonal to the columns
+    const Matrix<double, 2> a{{1.0, 0.0}, {1.0, 1.0}, {1.0, 2.0}, {1.0, 3.0}};
+    const Matrix<double, 1> y{1.0, 2.0, 2.0, 4.0};
+    const Matrix<double, 1> coef = qr(a).solve(y);
+    EXPECT_NEAR(coef(0), 0.9, 1e-12);
+    EXPECT_NEAR(coef(1), 0.9, 1e-12);
+}
+
+TEST(MATRIX_INSTRUMENT_TEST, counts_allocations_copies_and_kernels) {
+    if (!matrix_instrument::enabled) {
+        GTEST_SKIP() << "built without MATRIX_DESIGN_INSTRUMENT";
+    }
+    using matrix_instrument::Kernel;
+    const std::size_t bytes = 64 * 32 * sizeof(double);
+    matrix_instrument::Scope scope;
+    Matrix<double, 2> a(64, 32);
+    Matrix<double, 2> b = a;
+    Matrix<double, 2> c = std::move(b);
+    Matrix<double, 2> left(a(Slice(0, 64), Slice(0, 16)));
+    auto counters = scope.counters();
+    EXPECT_EQ(counters.allocations, 3u);
+    EXPECT_EQ(counters.allocated_bytes, 2 * bytes + bytes / 2);
+    EXPECT_EQ(counters.deep_copies, 1u);
+    EXPECT_EQ(counters.copied_bytes, bytes);
+    EXPECT_EQ(counters.moves, 1u);
+    EXPECT_EQ(counters.materializations, 1u);
+    EXPECT_EQ(counters.materialized_bytes, bytes / 2);
+    EXPECT_EQ(counters.calls(Kernel::copy), 1u);
+
+    // an expression into a matrix of the same shape allocates nothing
+    matrix_instrument::Scope assign;
+    c = a + a * 2.0;
+    counters = assign.counters();
+    EXPECT_EQ(counters.allocations, 0u);
+    EXPECT_EQ(counters.calls(Kernel::elementwise), 1u);
+
+    // a factorization runs its trailing updates through gemm
+    Matrix<double, 2> m = iota_matrix<double>(150, 150);
+    for (std::size_t i = 0; i < 150; ++i) {
+        m(i, i) += 40.0;
+    }
+    matrix_instrument::Scope factor;
+    const auto f = lu(m);
+    counters = factor.counters();
+    EXPECT_EQ(counters.calls(Kernel::factorization), 1u);
+    EXPECT_GE(counters.calls(Kernel::gemm), 2u);
+    EXPECT_NE(matrix_instrument::format_counters(counters).find("gemm.calls"),
+              std::string::npos);
+    EXPECT_NE(f.det(), 0.0);
+}
+
+TEST(MATRIX_INSTRUMENT_TEST, hardware_counters_around_kernels) {
+    if (!matrix_instrument::enabled) {
+        GTEST_SKIP() << "built without MATRIX_DESIGN_INSTRUMENT";
+    }
+    if (!matrix_instrument::enable_hardware_counters(true)) {
+        GTEST_SKIP() << "perf_event_open is not available here";
+    }
+    const Matrix<double, 2> a = iota_matrix<double>(128, 128);
+    matrix_instrument::Scope scope;
+    const Matrix<double, 2> c = a * a;
+    const auto counters = scope.counters();
+    matrix_instrument::enable_hardware_counters(false);
+    const auto gemm = static_cast<std::size_t>(matrix_instrument::Kernel::gemm);
+    EXPECT_EQ(counters.kernel_calls[gemm], 1u);
+    EXPECT_GT(counters.kernel_cycles[gemm], 0u);
+    EXPECT_EQ(counters.kernel_cycles[0], 0u); // nothing element-wise
+    EXPECT_EQ(c.extent(0), 128u);
+}
+
+TEST(MATRIX_GEMM_TEST, batched_matches_per_batch_products) {
+    // every kernel: n <= 8 in registers, small row updates, packed gemm
+    const std::array<std::array<std::size_t, 3>, 4> shapes = {
+        {{5, 3, 3}, {7, 9, 8}, {12, 20, 16}, {40, 40, 48}}};
+    Thread_pool::configure(3);
+    for (const auto &[m, n, k] : shapes) {
+        const std::size_t batches = 6;
+        Matrix<double, 3> a(batches, m, k);
+        Matrix<double, 3> b(batches, k, n);
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            a.data()[i] = double((i * 7 + 3) % 11) - 5.0;
+        }
+        for (std::size_t i = 0; i < b.size(); ++i) {
+            b.data()[i] = double((i * 5 + 1) % 13) - 6.0;
+        }
+        const Matrix<double, 2> shared = iota_matrix<double>(k, n);
+        for (int par = 0; par < 2; ++par) {
+            const Matrix<double, 3> c =
+                par != 0 ? matmul_batched(matrix_execution::par, a, b)
+                         : matmul_batched(a, b);
+            const Matrix<double, 3> cs = matmul_batched(a, shared);
+            // c = 2 a b^T^T + c through a transposed view of b's batches
+            Matrix<double, 3> acc(c);
+            const Matrix<double, 3> bt(permute_axes<0, 2, 1>(b));
+            const auto b_again = permute_axes<0, 2, 1>(bt);
+            if (par != 0) {
+                gemm_batched(matrix_execution::par, 2.0, a, b_again, 1.0,
+                             Matrix_ref<double, 3>(acc));
+            } else {
+                gemm_batched(2.0, a, b_again, 1.0, Matrix_ref<double, 3>(acc));
+            }
+            for (std::size_t t = 0; t < batches; ++t) {
+                const Matrix<double, 2> at(a.row(t));
+                const Matrix<double, 2> expected =
+                    naive_matmul(at, Matrix<double, 2>(b.row(t)));
+                const Matrix<double, 2> expected_shared =
+                    naive_matmul(at, shared);
+                for (std::size_t i = 0; i < m; ++i) {
+                    for (std::size_t j = 0; j < n; ++j) {
+                        EXPECT_NEAR(c(t, i, j), expected(i, j), 1e-9);
+                        EXPECT_NEAR(acc(t, i, j), 3.0 * expected(i, j), 1e-9);
+                        EXPECT_NEAR(cs(t, i, j), expected_shared(i, j), 1e-9);
+                    }
+                }
+            }
+        }
+    }
+    Thread_pool::configure(1);
+}
+
+TEST(MATRIX_GEMM_TEST, batched_broadcasts_single_batches) {
+    // the 4 x 5 x 3 stack of the demo app against one 3 x 2 operand
+    Matrix<double, 3> stack(4, 5, 3);
+    for (std::size_t i = 0; i < stack.size(); ++i) {
+        stack.data()[i] = double(i % 7) - 3.0;
+    }
+    const Matrix<double, 2> w{{1.0, -1.0}, {0.5, 2.0}, {-2.0, 0.0}};
+    Matrix<double, 3> w1(1, 3, 2);
+    std::copy(w.begin(), w.end(), w1.begin());
+    const Matrix<double, 3> c = matmul_batched(stack, w1);
+    const Matrix<double, 3> cb =
+        matmul_batched(stack, broadcast_to(w, {4, 3, 2}));
+    ASSERT_EQ(c.extent(0), 4u);
+    for (std::size_t t = 0; t < 4; ++t) {
+        const Matrix<double, 2> expected =
+            naive_matmul(Matrix<double, 2>(stack.row(t)), w);
+        for (std::size_t i = 0; i < 5; ++i) {
+            for (std::size_t j = 0; j < 2; ++j) {
+                EXPECT_EQ(c(t, i, j), expected(i, j));
+                EXPECT_EQ(cb(t, i, j), expected(i, j));
+            }
+        }
+    }
+    // a single left operand against a stack
+    const Matrix<double, 2> first(stack.row(0));
+    Matrix<double, 3> rights(2, 3, 2);
+    std::copy(w.begin(), w.end(), rights.begin());
+    std::copy(w.begin(), w.end(), rights.begin() + 6);
+    const Matrix<double, 3> left = matmul_batched(first, rights);
+    ASSERT_EQ(left.extent(0), 2u);
+    for (std::size_t i = 0; i < 5; ++i) {
+        for (std::size_t j = 0; j < 2; ++j) {
+            EXPECT_EQ(left(1, i, j), c(0, i, j));
+        }
+    }
+    EXPECT_THROW(matmul_batched(stack, Matrix<double, 3>(3, 3, 2)),
+                 std::invalid_argument);
+}
+
+// y(n, k, i, j) by the definition, reading zeros outside x
+static auto naive_conv2d(const Matrix<double, 4> &x,
+                         const Matrix<double, 4> &w, const Conv_params &p)
+    -> Matrix<double, 4> {
+    const std::size_t h = x.extent(2);
+    const std::size_t wd = x.extent(3);
+    const std::size_t span_h = p.dilation[0] * (w.extent(2) - 1) + 1;
+    const std::size_t span_w = p.dilation[1] * (w.extent(3) - 1) + 1;
+    const std::size_t ho = (h + 2 * p.padding[0] - span_h) / p.stride[0] + 1;
+    const std::size_t wo = (wd + 2 * p.padding[1] - span_w) / p.stride[1] + 1;
+    Matrix<double, 4> y(x.extent(0), w.extent(0), ho, wo);
+    for (std::size_t n = 0; n < y.extent(0); ++n) {
+        for (std::size_t k = 0; k < y.extent(1); ++k) {
+            for (std::size_t i = 0; i < ho; ++i) {
+                for (std::size_t j = 0; j < wo; ++j) {
+                    double sum = 0.0;
+                    for (std::size_t c = 0; c < x.extent(1); ++c) {
+                        for (std::size_t r = 0; r < w.extent(2); ++r) {
+                            for (std::size_t s = 0; s < w.extent(3); ++s) {
+                                // in the padded input
+                                const std::size_t row =
+                                    i * p.stride[0] + r * p.dilation[0];
+                                const std::size_t col =
+                                    j * p.stride[1] + s * p.dilation[1];
+                                if (row < p.padding[0] ||
+                                    col < p.padding[1] ||
+                                    row - p.padding[0] >= h ||
+                                    col - p.padding[1] >= wd) {
+                                    continue;
+                                }
+                                sum += w(k, c, r, s) *
+                                       x(n, c, row - p.padding[0],
+                                         col - p.padding[1]);
+                            }
+                        }
+                    }
+                    y(n, k, i, j) = sum;
+                }
+            }
+        }
+    }
+    return y;
+}
+
+TEST(MATRIX_CONV_TEST, direct_and_im2col_match_definition) {
+    Matrix<double, 4> x(2, 5, 13, 37);
+    Matrix<double, 4> w(6, 5, 3, 3);
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        x.data()[i] = double((i * 7 + 3) % 11) - 5.0;
+    }
+    for (std::size_t i = 0; i < w.size(); ++i) {
+        w.data()[i] = double((i * 5 + 1) % 9) - 4.0;
+    }
+    std::vector<Conv_params> cases(4);
+    cases[1].padding = {1, 1};
+    cases[2].stride = {2, 3};
+    cases[2].padding = {2, 0};
+    cases[3].dilation = {2, 3};
+    cases[3].padding = {1, 4};
+    for (int par = 0; par < 2; ++par) {
+        Thread_pool::configure(par != 0 ? 3 : 1);
+        for (auto p : cases) {
+            const Matrix<double, 4> expected = naive_conv2d(x, w, p);
+            for (auto algorithm :
+                 {Conv_algorithm::direct, Conv_algorithm::im2col}) {
+                p.algorithm = algorithm;
+                const Matrix<double, 4> y =
+                    par != 0 ? conv2d(matrix_execution::par, x, w, p)
+                             : conv2d(x, w, p);
+                ASSERT_EQ(y.descriptor().extents,
+                          expected.descriptor().extents);
+                for (std::size_t i = 0; i < y.size(); ++i) {
+                    EXPECT_EQ(y.data()[i], expected.data()[i]);
+                }
+                // a single image is order 3 in and out
+                const Matrix<double, 3> one = conv2d(x.row(1), w, p);
+                for (std::size_t i = 0; i < one.size(); ++i) {
+                    EXPECT_EQ(one.data()[i], expected.data()[one.size() + i]);
+                }
+            }
+        }
+    }
+    Thread_pool::configure(1);
+    EXPECT_THROW(conv2d(x, Matrix<double, 4>(6, 4, 3, 3)),
+                 std::invalid_argument);
+    Conv_params zero_stride;
+    zero_stride.stride = {0, 1};
+    EXPECT_THROW(conv2d(x, w, zero_stride), std::invalid_argument);
+    EXPECT_THROW(conv2d(x, Matrix<double, 4>(6, 5, 15, 3)),
+                 std::invalid_argument);
+    // no input channels: every output is an empty sum
+    Conv_params forced;
+    forced.algorithm = Conv_algorithm::im2col;
+    forced.padding = {1, 1};
+    const Matrix<double, 4> empty =
+        conv2d(Matrix<double, 4>(2, 0, 4, 5), Matrix<double, 4>(3, 0, 3, 3),
+               forced);
+    ASSERT_EQ(empty.descriptor().extents,
+              (std::array<std::size_t, 4>{2, 3, 4, 5}));
+    for (double v : empty) {
+        EXPECT_EQ(v, 0.0);
+    }
+}
+
+TEST(MATRIX_CONV_TEST, stencil_over_halo_view) {
+    // f = i^2 + 2 j^2 on a 2 x 20 x 30 grid; the 5-point Laplacian is 6
+    Matrix<double, 3> f(2, 20, 30);
+    for (std::size_t c = 0; c < 2; ++c) {
+        for (std::size_t i = 0; i < 20; ++i) {
+            for (std::size_t j = 0; j < 30; ++j) {
+                f(c, i, j) = double(i * i + 2 * j * j) + double(c);
+            }
+        }
+    }
+    const Matrix<double, 2> laplacian{
+        {0.0, 1.0, 0.0}, {1.0, -4.0, 1.0}, {0.0, 1.0, 0.0}};
+    const Matrix<double, 3> interior = stencil(f, laplacian);
+    ASSERT_EQ(interior.extent(1), 18u);
+    ASSERT_EQ(interior.extent(2), 28u);
+    for (double v : interior) {
+        EXPECT_EQ(v, 6.0);
+    }
+    // the interior of f with its halo as a view, padded back to full size,
+    // against the same stencil over the copied interior
+    const auto halo = f(Slice(0, 2), Slice(1, 19), Slice(1, 29));
+    Conv_params same;
+    same.padding = {1, 1};
+    const Matrix<double, 3> from_view =
+        stencil(matrix_execution::par, halo, laplacian, same);
+    const Matrix<double, 3> from_copy =
+        stencil(Matrix<double, 3>(halo), laplacian, same);
+    ASSERT_EQ(from_view.extent(1), 18u);
+    for (std::size_t i = 0; i < from_view.size(); ++i) {
+        EXPECT_EQ(from_view.data()[i], from_copy.data()[i]);
+    }
+    EXPECT_EQ(from_view(1, 5, 5), 6.0);
+    EXPECT_EQ(from_view(0, 0, 5), 6.0 - f(0, 0, 6));
+    // an order 2 plane, and a stencil that is one conv2d channel
+    const Matrix<double, 2> plane = stencil(f.row(0), laplacian);
+    EXPECT_EQ(plane(3, 4), 6.0);
+    Matrix<double, 4> w(1, 1, 3, 3);
+    std::copy(laplacian.begin(), laplacian.end(), w.begin());
+    const Matrix<double, 3> as_conv =
+        conv2d(f(Slice(0, 1), Slice(0, 20), Slice(0, 30)), w);
+    EXPECT_EQ(as_conv(0, 7, 8), interior(0, 7, 8));
+    // empty planes are all padding
+    const Matrix<double, 3> padded =
+        stencil(Matrix<double, 3>(2, 0, 5), Matrix<double, 2>{{1.0}}, same);
+    ASSERT_EQ(padded.extent(0), 2u);
+    EXPECT_EQ(padded.extent(1), 2u);
+    EXPECT_EQ(padded(1, 1, 6), 0.0);
+    const Matrix<float, 2> border =
+        stencil(Matrix<float, 2>(0, 5), Matrix<float, 2>(1, 1), same);
+    ASSERT_EQ(border.extent(0), 2u);
+    ASSERT_EQ(border.extent(1), 7u);
+    for (float v : border) {
+        EXPECT_EQ(v, 0.0F);
+    }
+}
+
+TEST(MATRIX_CONVERT_TEST, half_types_round_to_nearest_even) {
+    EXPECT_EQ(float16(1.0F).bits, 0x3C00);
+    EXPECT_EQ(float16(-2.0F).bits, 0xC000);
+    EXPECT_EQ(float16(65504.0F).bits, 0x7BFF);
+    EXPECT_EQ(float16(65519.0F).bits, 0x7BFF);
+    EXPECT_EQ(float16(65520.0F).bits, 0x7C00); // ties to even: infinity
+    EXPECT_EQ(float16(std::ldexp(1.0F, -24)).bits, 0x0001);
+    EXPECT_EQ(float16(std::ldexp(1.0F, -25)).bits, 0x0000);
+    EXPECT_EQ(float16(std::ldexp(3.0F, -25)).bits, 0x0002);
+    EXPECT_EQ(float16(1.0F + std::ldexp(1.0F, -11)).bits, 0x3C00);
+    EXPECT_EQ(float16(1.0F + std::ldexp(3.0F, -11)).bits, 0x3C02);
+    EXPECT_TRUE(std::isnan(float(float16(std::nanf("")))));
+    EXPECT_EQ(bfloat16(1.0F).bits, 0x3F80);
+    EXPECT_EQ(bfloat16(1.0F + std::ldexp(1.0F, -8)).bits, 0x3F80);
+    EXPECT_EQ(bfloat16(1.0F + std::ldexp(3.0F, -8)).bits, 0x3F82);
+    EXPECT_EQ(bfloat16(3.0e38F).bits, 0x7F62);
+    EXPECT_TRUE(std::isnan(float(bfloat16(std::nanf("")))));
+    // every half survives a round trip through float
+    for (std::uint32_t b = 0; b < 0x10000; ++b) {
+        const auto h = float16::from_bits(static_cast<std::uint16_t>(b));
+        if ((b & 0x7C00) != 0x7C00 || (b & 0x3FF) == 0) {
+            EXPECT_EQ(float16(float(h)).bits, b);
+        }
+    }
+
+    // the vector conversions of whole matrices agree with the scalar ones
+    Matrix<float, 2> f(37, 29);
+    for (std::size_t i = 0; i < f.size(); ++i) {
+        const float unit = std::ldexp(1.0F, int(i % 40) - 26);
+        f.data()[i] = (i % 3 == 0 ? -1.0F : 1.0F) * unit *
+                      (1.0F + float(i % 17) / 16.0F);
+    }
+    f(0, 0) = 70000.0F;
+    f(0, 1) = std::nanf("");
+    const Matrix<float16, 2> h(f);
+    const Matrix<bfloat16, 2> bf(f);
+    const Matrix<float, 2> from_h(h);
+    const Matrix<float, 2> from_bf(bf);
+    for (std::size_t i = 0; i < f.size(); ++i) {
+        const float x = f.data()[i];
+        ASSERT_EQ(h.data()[i].bits, float16(x).bits) << x;
+        ASSERT_EQ(bf.data()[i].bits, bfloat16(x).bits) << x;
+        if (!std::isnan(x)) {
+            EXPECT_EQ(from_h.data()[i], float(float16(x)));
+            EXPECT_EQ(from_bf.data()[i], float(bfloat16(x)));
+        }
+    }
+    // between double, float and int32, and through a strided view
+    Matrix<double, 2> d(41, 23);
+    for (std::size_t i = 0; i < d.size(); ++i) {
+        d.data()[i] = (double(i) - 400.0) * 1.37;
+    }
+    const Matrix<float, 2> df(d);
+    const Matrix<std::int32_t, 2> di(d);
+    const Matrix<double, 2> id(di);
+    const Matrix<std::int32_t, 2> fi(df);
+    const Matrix<float, 2> iff(di);
+    const Matrix<float16, 2> dh(d(Slice(1, 40), Slice(2, 21)));
+    for (std::size_t i = 0; i < d.size(); ++i) {
+        const double x = d.data()[i];
+        EXPECT_EQ(df.data()[i], static_cast<float>(x));
+        EXPECT_EQ(di.data()[i], static_cast<std::int32_t>(x));
+        EXPECT_EQ(id.data()[i], static_cast<double>(di.data()[i]));
+        EXPECT_EQ(fi.data()[i], static_cast<std::int32_t>(df.data()[i]));
+        EXPECT_EQ(iff.data()[i], static_cast<float>(di.data()[i]));
+    }
+    EXPECT_EQ(dh(0, 0).bits, float16(d(1, 2)).bits);
+
+    // doubles round once: just above a tie, not to the tie's even side as
+    // through float
+    const double above_half_tie = 1.0 + std::ldexp(1.0, -11) + 0x1p-40;
+    const double above_bf_tie = 1.0 + std::ldexp(1.0, -8) + 0x1p-40;
+    EXPECT_EQ(float16(above_half_tie).bits, 0x3C01);
+    EXPECT_EQ(float16(-above_half_tie).bits, 0xBC01);
+    EXPECT_EQ(bfloat16(above_bf_tie).bits, 0x3F81);
+    EXPECT_EQ(float16(1.0 + std::ldexp(1.0, -11)).bits, 0x3C00);
+    EXPECT_EQ(float16(1.0e300).bits, 0x7C00);
+    EXPECT_EQ(bfloat16(-1.0e300).bits, 0xFF80);
+    EXPECT_EQ(float16(std::ldexp(1.0, -25) + 0x1p-60).bits, 0x0001);
+    EXPECT_TRUE(std::isnan(float(float16(std::nan("")))));
+    Matrix<double, 1> ties(std::array<std::size_t, 1>{100});
+    std::fill(ties.begin(), ties.end(), above_half_tie);
+    const Matrix<float16, 1> tie_h(ties);
+    const Matrix<bfloat16, 1> tie_bf(ties);
+    for (std::size_t i = 0; i < ties.size(); ++i) {
+        EXPECT_EQ(tie_h(i).bits, 0x3C01);
+        EXPECT_EQ(tie_bf(i).bits, bfloat16(above_half_tie).bits);
+    }
+}
+
+TEST(MATRIX_CONVERT_TEST, reductions_and_gemm_widen_half_types) {
+    Matrix<float, 2> a(70, 45);
+    Matrix<float, 2> b(45, 33);
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        a.data()[i] = float(int(i * 7 + 3) % 23 - 11) / 8.0F;
+    }
+    for (std::size_t i = 0; i < b.size(); ++i) {
+        b.data()[i] = float(int(i * 5 + 1) % 19 - 9) / 4.0F;
+    }
+    const Matrix<bfloat16, 2> ab(a);
+    const Matrix<float16, 2> bh(b);
+    // small multiples of powers of two are exact in both 16-bit types
+    const Matrix<float, 2> a_back(ab);
+    EXPECT_EQ(a_back(3, 4), a(3, 4));
+
+    // sums come back in float and match the float matrix
+    static_assert(std::is_same_v<decltype(sum(ab)), float>);
+    EXPECT_EQ(sum(ab), sum(a));
+    EXPECT_EQ(sum(matrix_execution::par, bh), sum(b));
+    const Matrix<float, 1> col_sums = sum(ab, 0);
+    const Matrix<float, 1> expected_sums = sum(a, 0);
+    for (std::size_t j = 0; j < 45; ++j) {
+        EXPECT_EQ(col_sums(j), expected_sums(j));
+    }
+    EXPECT_EQ(mean(bh), mean(b));
+    EXPECT_EQ(float(max(bh)), max(b));
+
+    // gemm widens while packing: the float product, bit for bit
+    const Matrix<float, 2> expected = matmul(a, b);
+    const Matrix<float, 2> c = matmul(Matrix<float16, 2>(a), bh);
+    Matrix<float, 2> mixed(70, 33);
+    gemm(1.0F, ab, b, 0.0F, Matrix_ref<float, 2>(mixed));
+    Matrix<float, 2> strided(70, 33);
+    gemm(1.0F, ab, transpose(Matrix<bfloat16, 2>(transpose(b))), 0.0F,
+         Matrix_ref<float, 2>(strided));
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(c.data()[i], expected.data()[i]);
+        EXPECT_EQ(mixed.data()[i], expected.data()[i]);
+        EXPECT_EQ(strided.data()[i], expected.data()[i]);
+    }
+
+    // float16 is the .npy dtype <f2
+    const std::string path = testing::TempDir() + "half.npy";
+    save_npy(path, bh);
+    const Matrix<float16, 2> loaded = load_npy<float16, 2>(path);
+    EXPECT_EQ(loaded(44, 32).bits, bh(44, 32).bits);
+    EXPECT_THROW((load_npy<float, 2>(path)), std::runtime_error);
+}
+
+TEST(MATRIX_QUANT_TEST, int8_product_is_exact) {
+    // odd sizes leave partial tiles and k groups; k past one k block
+    const std::size_t m = 103, k = 1090, n = 71;
+    Matrix<std::int8_t, 2> a(m, k);
+    Matrix<std::int8_t, 2> b(k, n);
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        a.data()[i] = static_cast<std::int8_t>(int(i * 37 + 11) % 256 - 128);
+    }
+    for (std::size_t i = 0; i < b.size(); ++i) {
+        b.data()[i] = static_cast<std::int8_t>(int(i * 91 + 5) % 256 - 128);
+    }
+    // the extremes, where pairwise 16-bit sums would saturate
+    for (std::size_t p = 0; p < k; ++p) {
+        a(0, p) = -128;
+        b(p, 0) = -128;
+    }
+    Matrix<std::int32_t, 2> expected(m, n);
+    for (std::size_t i = 0; i < m; ++i) {
+        for (std::size_t j = 0; j < n; ++j) {
+            std::int32_t dot = 0;
+            for (std::size_t p = 0; p < k; ++p) {
+                dot += std::int32_t{a(i, p)} * std::int32_t{b(p, j)};
+            }
+            expected(i, j) = dot;
+        }
+    }
+    EXPECT_EQ(expected(0, 0), 128 * 128 * int(k));
+    const Matrix<std::int32_t, 2> c = matmul_int8(a, b);
+    const Matrix<std::int32_t, 2> c_par =
+        matmul_int8(matrix_execution::par, a, b);
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQ(c.data()[i], expected.data()[i]) << i;
+        ASSERT_EQ(c_par.data()[i], expected.data()[i]) << i;
+    }
+
+    // strided views: a transposed operand and a sub-block
+    const Matrix<std::int8_t, 2> bt(transpose(b));
+    const Matrix<std::int32_t, 2> c_t = matmul_int8(a, transpose(bt));
+    const Matrix<std::int32_t, 2> c_sub = matmul_int8(
+        a(Slice(3, 20), Slice(0, k)), b(Slice(0, k), Slice(5, 9)));
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQ(c_t.data()[i], expected.data()[i]) << i;
+    }
+    EXPECT_EQ(c_sub.extent(0), 17u);
+    EXPECT_EQ(c_sub(0, 0), expected(3, 5));
+    EXPECT_EQ(c_sub(16, 3), expected(19, 8));
+}
+
+TEST(MATRIX_QUANT_TEST, quantized_product_tracks_float) {
+    const std::size_t m = 64, k = 256, n = 48;
+    Matrix<float, 2> a(m, k);
+    Matrix<float, 2> b(k, n);
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        a.data()[i] = std::sin(float(i) * 0.37F) * (1.0F + float(i / k));
+    }
+    for (std::size_t i = 0; i < b.size(); ++i) {
+        // a shifted range for the asymmetric scheme to absorb
+        b.data()[i] = std::cos(float(i) * 0.11F) + 0.5F;
+    }
+
+    // round trips are within half a step of each group's scale
+    for (const auto scheme :
+         {Quant_scheme::symmetric, Quant_scheme::asymmetric}) {
+        const Quantized_matrix qa = quantize(a, Quant_axis::rows, scheme);
+        const Quantized_matrix qb = quantize(b, Quant_axis::cols, scheme);
+        EXPECT_EQ(qa.scales().size(), m);
+        EXPECT_EQ(qb.zero_points().size(), n);
+        const Matrix<float, 2> a_back = dequantize(qa);
+        const Matrix<float, 2> b_back = dequantize(qb);
+        for (std::size_t i = 0; i < m; ++i) {
+            for (std::size_t p = 0; p < k; ++p) {
+                ASSERT_LE(std::abs(a_back(i, p) - a(i, p)),
+                          0.501F * qa.scales()(i));
+            }
+        }
+        for (std::size_t p = 0; p < k; ++p) {
+            for (std::size_t j = 0; j < n; ++j) {
+                ASSERT_LE(std::abs(b_back(p, j) - b(p, j)),
+                          0.501F * qb.scales()(j));
+            }
+        }
+
+        // the quantized product is the product of the dequantized operands,
+        // within the rounding error of the float one: each term is off by at
+        // most |a| sb / 2 + |b| sa / 2 + sa sb / 4
+        const Matrix<float, 2> expected = matmul(a, b);
+        const Matrix<float, 2> of_back = matmul(a_back, b_back);
+        const Matrix<float, 2> c = matmul(qa, qb);
+        const Matrix<float, 2> c_par = matmul(matrix_execution::par, qa, qb);
+        for (std::size_t i = 0; i < m; ++i) {
+            for (std::size_t j = 0; j < n; ++j) {
+                const float sa = qa.scales()(i);
+                const float sb = qb.scales()(j);
+                float bound = 0.0F;
+                for (std::size_t p = 0; p < k; ++p) {
+                    bound += std::abs(a(i, p)) * sb / 2 +
+                             std::abs(b(p, j)) * sa / 2 + sa * sb / 4;
+                }
+                ASSERT_NEAR(c(i, j), of_back(i, j),
+                            1e-3F * (1.0F + std::abs(of_back(i, j))));
+                ASSERT_EQ(c_par(i, j), c(i, j));
+                ASSERT_LE(std::abs(c(i, j) - expected(i, j)), bound);
+            }
+        }
+    }
+
+    const Quantized_matrix by_row = quantize(b, Quant_axis::rows);
+    const Quantized_matrix by_col = quantize(b, Quant_axis::cols);
+    EXPECT_THROW(matmul(by_col, by_col), std::invalid_argument);
+    EXPECT_THROW(matmul(by_row, by_row), std::invalid_argument);
+    const Matrix<float, 1> scales(std::array<std::size_t, 1>{3});
+    const Matrix<std::int32_t, 1> zeros(std::array<std::size_t, 1>{3});
+    EXPECT_THROW(Quantized_matrix(Matrix<std::int8_t, 2>(4, 3), scales, zeros,
+                                  Quant_axis::rows),
+                 std::invalid_argument);
+}
+
+TEST(MATRIX_DISPATCH_TEST, detection_and_level_names) {
+    using matrix_dispatch::Isa;
+    for (const auto level : {Isa::scalar, Isa::sse2, Isa::avx2, Isa::avx512}) {
+        EXPECT_EQ(matrix_dispatch::parse_isa(matrix_dispatch::isa_name(level)),
+                  level);
+    }
+    EXPECT_FALSE(matrix_dispatch::parse_isa("avx1024").has_value());
+
+    // each level implies the ones below it
+    const auto &f = matrix_dispatch::cpu_features();
+    EXPECT_TRUE(!f.avx512_vnni || f.avx512);
+    EXPECT_TRUE(!f.avx512 || f.avx2);
+    EXPECT_TRUE(!f.avx2 || f.sse2);
+    const Isa detected = matrix_dispatch::detected_isa();
+    EXPECT_LE(detected, matrix_dispatch::widest_isa);
+    EXPECT_LE(matrix_dispatch::isa(), detected);
+
+    // set_isa returns the old level and never goes past the detected one
+    const Isa old = matrix_dispatch::set_isa(Isa::scalar);
+    EXPECT_EQ(matrix_dispatch::isa(), Isa::scalar);
+    EXPECT_EQ(matrix_dispatch::set_isa(Isa::avx512), Isa::scalar);
+    EXPECT_EQ(matrix_dispatch::isa(), detected);
+    matrix_dispatch::set_isa(old);
+}
+
+TEST(MATRIX_DISPATCH_TEST, every_level_gives_the_same_results) {
+    using matrix_dispatch::Isa;
+    // odd extents leave a tail after the packed part of every run
+    const std::size_t m = 37, k = 53, n = 41;
+    Matrix<float, 2> a(m, k);
+    Matrix<float, 2> b(k, n);
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        a.data()[i] = std::sin(float(i) * 0.37F);
+    }
+    for (std::size_t i = 0; i < b.size(); ++i) {
+        b.data()[i] = std::cos(float(i) * 0.11F);
+    }
+    const Matrix<double, 2> ad(a);
+    const Matrix<double, 2> bd(b);
+    Matrix<std::int8_t, 2> a8(m, k);
+    Matrix<std::int8_t, 2> b8(k, n);
+    for (std::size_t i = 0; i < a8.size(); ++i) {
+        a8.data()[i] = static_cast<std::int8_t>(int(i * 7 % 255) - 127);
+    }
+    for (std::size_t i = 0; i < b8.size(); ++i) {
+        b8.data()[i] = static_cast<std::int8_t>(int(i * 13 % 256) - 128);
+    }
+    Matrix<float, 3> images(3, 19, 45);
+    std::iota(images.begin(), images.end(), 0.0F);
+    Matrix<float, 4> filters(4, 3, 3, 3);
+    for (std::size_t i = 0; i < filters.size(); ++i) {
+        filters.data()[i] = float(i % 5) - 2.0F;
+    }
+    Conv_params direct;
+    direct.algorithm = Conv_algorithm::direct;
+
+    struct Results {
+        Matrix<float, 2> elementwise, transposed, roundtrip, product;
+        Matrix<double, 2> product_d;
+        Matrix<std::int32_t, 2> product_8;
+        Matrix<float, 3> conv;
+        double total;
+        float largest;
+    };
+    const auto compute = [&] {
+        return Results{a * 2.0F - a / 3.0F,
+                       Matrix<float, 2>(transpose(a)),
+                       Matrix<float, 2>(Matrix<float16, 2>(a)),
+                       matmul(a, b),
+                       matmul(ad, bd),
+                       matmul_int8(a8, b8),
+                       conv2d(images, filters, direct),
+                       sum(ad),
+                       max(a)};
+    };
+
+    const Isa old = matrix_dispatch::set_isa(Isa::scalar);
+    const Results expected = compute();
+    for (const auto level : {Isa::sse2, Isa::avx2, Isa::avx512}) {
+        if (level > matrix_dispatch::detected_isa()) {
+            break;
+        }
+        matrix_dispatch::set_isa(level);
+        const Results r = compute();
+        const std::string name(matrix_dispatch::isa_name(level));
+        // copies and integer products are exact, and so is the element-wise
+        // result, whose only product (by 2) is exact even fused into an FMA
+        for (std::size_t i = 0; i < expected.elementwise.size(); ++i) {
+            ASSERT_EQ(r.elementwise.data()[i], expected.elementwise.data()[i])
+                << name;
+            ASSERT_EQ(r.transposed.data()[i], expected.transposed.data()[i])
+                << name;
+            ASSERT_EQ(r.roundtrip.data()[i], expected.roundtrip.data()[i])
+                << name;
+        }
+        for (std::size_t i = 0; i < expected.product_8.size(); ++i) {
+            ASSERT_EQ(r.product_8.data()[i], expected.product_8.data()[i])
+                << name;
+        }
+        EXPECT_EQ(r.largest, expected.largest) << name;
+        // sums are only reassociated (and contracted into FMAs)
+        EXPECT_NEAR(r.total, expected.total, 1e-12 * double(ad.size())) << name;
+        for (std::size_t i = 0; i < expected.product.size(); ++i) {
+            ASSERT_NEAR(r.product.data()[i], expected.product.data()[i],
+                        1e-4F * k)
+                << name;
+            ASSERT_NEAR(r.product_d.data()[i], expected.product_d.data()[i],
+                        1e-12 * k)
+                << name;
+        }
+        for (std::size_t i = 0; i < expected.conv.size(); ++i) {
+            ASSERT_EQ(r.conv.data()[i], expected.conv.data()[i]) << name;
+        }
+    }
+    matrix_dispatch::set_isa(old);
+}